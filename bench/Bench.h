@@ -0,0 +1,164 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Bench.h - Minimal std::chrono microbenchmark harness used by trs_bench
+/// author: Karl-Mihkel Ott
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+// Every benchmark is a function that prepares its operands and hands one pass over them to State::Measure().
+// The pass is repeated until it takes at least the minimum time, then timed a fixed number of times and the
+// median and fastest runs are reported per item, so that single calls and batches of any size can be compared.
+
+namespace TRS {
+namespace Bench {
+
+    /// Keep _value alive so that the computation producing it is not optimized away
+    template<typename T>
+    inline void DoNotOptimize(const T &_value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r"(&_value) : "memory");
+#else
+        static volatile const void *sink;
+        sink = &_value;
+#endif
+    }
+
+
+    /// Working set sizes used for batched benchmarks, chosen to sit in each level of the memory hierarchy
+    struct Size {
+        const char *name;
+        size_t bytes;
+    };
+
+    inline const std::vector<Size> &BatchSizes() {
+        static const std::vector<Size> sizes = {
+            { "L1", size_t(16) << 10 },
+            { "L2", size_t(256) << 10 },
+            { "L3", size_t(4) << 20 },
+            { "DRAM", size_t(64) << 20 }
+        };
+        return sizes;
+    }
+
+
+    struct Result {
+        std::string name;
+        std::string type;
+        std::string operation;
+        std::string size;
+        size_t items = 0;           // items processed by one pass
+        size_t bytes = 0;           // bytes touched by one pass
+        size_t iterations = 0;      // passes per timed repetition
+        double median_ns = 0;       // per item
+        double min_ns = 0;          // per item
+    };
+
+
+    struct Options {
+        double min_time = 0.05;     // seconds per timed repetition
+        size_t repetitions = 5;
+        std::string filter;
+    };
+
+
+    class State {
+        private:
+            const Options &m_options;
+            Result &m_result;
+
+        public:
+            State(const Options &_options, Result &_result) : m_options(_options), m_result(_result) {}
+
+            /// Time _pass, which processes _items items touching _bytes bytes on every call
+            template<typename F>
+            void Measure(size_t _items, size_t _bytes, F &&_pass) {
+                typedef std::chrono::steady_clock Clock;
+                const auto run = [&](size_t _iterations) {
+                    const Clock::time_point start = Clock::now();
+                    for(size_t i = 0; i < _iterations; i++)
+                        _pass();
+                    return std::chrono::duration<double>(Clock::now() - start).count();
+                };
+
+                // warm the caches and grow the iteration count until one repetition is long enough
+                size_t iterations = 1;
+                for(double elapsed = run(1); elapsed < m_options.min_time && iterations < (size_t(1) << 40);) {
+                    const double scale = elapsed > 0 ? 1.4 * m_options.min_time / elapsed : 16.0;
+                    iterations = std::max(iterations + 1, static_cast<size_t>(static_cast<double>(iterations) * std::min(scale, 16.0)));
+                    elapsed = run(iterations);
+                }
+
+                std::vector<double> times(std::max<size_t>(m_options.repetitions, 1));
+                for(double &t : times)
+                    t = run(iterations) * 1e9 / (static_cast<double>(iterations) * static_cast<double>(std::max<size_t>(_items, 1)));
+                std::sort(times.begin(), times.end());
+
+                m_result.items = _items;
+                m_result.bytes = _bytes;
+                m_result.iterations = iterations;
+                m_result.median_ns = times[times.size() / 2];
+                m_result.min_ns = times.front();
+            }
+    };
+
+
+    struct Benchmark {
+        std::string type;
+        std::string operation;
+        std::string size;
+        std::function<void(State&)> run;
+
+        std::string Name() const { return type + "/" + operation + "/" + size; }
+    };
+
+
+    /// All benchmarks known to trs_bench, filled by the Register* functions of every suite
+    inline std::vector<Benchmark> &Registry() {
+        static std::vector<Benchmark> benchmarks;
+        return benchmarks;
+    }
+
+
+    inline void Register(const std::string &_type, const std::string &_operation, const std::string &_size, std::function<void(State&)> _run) {
+        Registry().push_back(Benchmark { _type, _operation, _size, std::move(_run) });
+    }
+
+
+    /// Type names used in benchmark names
+    template<typename T> inline const char *TypeName();
+    template<> inline const char *TypeName<float>() { return "float"; }
+    template<> inline const char *TypeName<double>() { return "double"; }
+
+
+    /// Deterministic operand values in [-1, 1)
+    class Random {
+        private:
+            uint64_t m_state;
+
+        public:
+            explicit Random(uint64_t _seed = 0x9E3779B97F4A7C15ull) : m_state(_seed) {}
+
+            double Next() {
+                m_state ^= m_state << 13;
+                m_state ^= m_state >> 7;
+                m_state ^= m_state << 17;
+                return static_cast<double>(m_state >> 11) * (2.0 / 9007199254740992.0) - 1.0;
+            }
+    };
+
+
+    void RegisterFixedBenchmarks();
+    void RegisterDynamicBenchmarks();
+}
+}
+
+#endif
@@ -0,0 +1,123 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: DynamicBench.cpp - Benchmarks of MatrixN and VectorN operations
+/// author: Karl-Mihkel Ott
+
+#include <trs/MatrixN.h>
+#include <trs/VectorN.h>
+#include <trs/LU.h>
+#include <trs/Cholesky.h>
+#include <trs/IncrementalInverse.h>
+#include <trs/IterativeSolvers.h>
+#include "Bench.h"
+
+namespace TRS {
+namespace Bench {
+
+    template<typename T>
+    VectorN<T> RandomVector(size_t _n, Random &_rnd) {
+        VectorN<T> v(_n);
+        for(T &x : v)
+            x = static_cast<T>(_rnd.Next());
+        return v;
+    }
+
+
+    /// Symmetric and diagonally dominant, so it is invertible and positive definite
+    template<typename T>
+    MatrixN<T> RandomMatrix(size_t _n, Random &_rnd) {
+        MatrixN<T> m(_n);
+        for(size_t i = 0; i < _n; i++) {
+            for(size_t j = 0; j <= i; j++)
+                m[i][j] = m[j][i] = static_cast<T>(_rnd.Next());
+            m[i][i] += static_cast<T>(_n);
+        }
+        return m;
+    }
+
+
+    /// Elementwise operations over vectors whose three operands fill each working set size
+    template<typename T>
+    void AddVectorNBenchmarks(const std::string &_type) {
+        const auto add = [&](const std::string &_operation, auto _pass) {
+            for(const Size &size : BatchSizes()) {
+                const size_t n = std::max<size_t>(size.bytes / (3 * sizeof(T)), 1);
+                Register(_type, _operation, size.name, [n, _pass](State &_state) {
+                    Random rnd;
+                    const VectorN<T> a = RandomVector<T>(n, rnd);
+                    const VectorN<T> b = RandomVector<T>(n, rnd);
+                    VectorN<T> c = RandomVector<T>(n, rnd);
+                    _state.Measure(n, 3 * n * sizeof(T), [&]() { _pass(a, b, c); });
+                });
+            }
+        };
+
+        add("add", [](const VectorN<T> &_a, const VectorN<T> &_b, VectorN<T> &_c) { _c = _a + _b; });
+        add("dot", [](const VectorN<T> &_a, const VectorN<T> &_b, VectorN<T>&) { DoNotOptimize(_a * _b); });
+    }
+
+
+    /// Operands and reusable factorizations of one MatrixN benchmark
+    template<typename T>
+    struct MatrixNWorkspace {
+        MatrixN<T> a, b, c;
+        VectorN<T> x, y;
+        LU<T> lu;
+        Cholesky<T> cholesky;
+        IncrementalInverse<T> inverse;
+    };
+
+
+    /// Matrix operations on n x n operands, one call is one item
+    template<typename T>
+    void AddMatrixNBenchmarks(const std::string &_type) {
+        typedef MatrixNWorkspace<T> Workspace;
+        static const size_t sizes[] = { 16, 64, 256, 512 };
+
+        const auto add = [&](const std::string &_operation, auto _pass) {
+            for(size_t n : sizes) {
+                Register(_type, _operation, "n" + std::to_string(n), [n, _pass](State &_state) {
+                    Random rnd;
+                    Workspace w;
+                    w.a = RandomMatrix<T>(n, rnd);
+                    w.b = RandomMatrix<T>(n, rnd);
+                    w.c = MatrixN<T>(n);
+                    w.x = RandomVector<T>(n, rnd);
+                    _state.Measure(1, 3 * n * n * sizeof(T), [&]() { _pass(w); });
+                });
+            }
+        };
+
+        add("add", [](Workspace &_w) { _w.c = _w.a + _w.b; });
+        add("transpose", [](Workspace &_w) { _w.c = _w.a.Transpose(); });
+        add("gemm", [](Workspace &_w) { Gemm(static_cast<T>(1), _w.a, false, _w.b, false, T(), _w.c); });
+        add("mul_vec", [](Workspace &_w) { DoNotOptimize(_w.a * _w.x); });
+        add("determinant", [](Workspace &_w) { DoNotOptimize(_w.a.Determinant()); });
+        add("inverse", [](Workspace &_w) { _w.c = _w.a.Inverse(); });
+        add("lu", [](Workspace &_w) { DoNotOptimize(_w.lu.Compute(_w.a)); });
+        add("lu_solve", [](Workspace &_w) {
+            _w.lu.Compute(_w.a);
+            DoNotOptimize(_w.lu.Solve(_w.x));
+        });
+        add("cholesky", [](Workspace &_w) { DoNotOptimize(_w.cholesky.Compute(_w.a)); });
+        add("replace_row", [](Workspace &_w) {
+            if(_w.inverse.Size() != _w.a.Rows())
+                _w.inverse.Compute(_w.a);
+            DoNotOptimize(_w.inverse.ReplaceRow(0, _w.x));
+        });
+        add("cg", [](Workspace &_w) {
+            // cold start every pass, the vector keeps its capacity
+            _w.y.clear();
+            DoNotOptimize(ConjugateGradient(_w.a, _w.x, _w.y).iterations);
+        });
+    }
+
+
+    void RegisterDynamicBenchmarks() {
+        AddVectorNBenchmarks<float>("VectorN<float>");
+        AddVectorNBenchmarks<double>("VectorN<double>");
+        AddMatrixNBenchmarks<float>("MatrixN<float>");
+        AddMatrixNBenchmarks<double>("MatrixN<double>");
+    }
+}
+}
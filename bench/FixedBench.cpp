@@ -0,0 +1,183 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: FixedBench.cpp - Benchmarks of fixed size vectors, matrices, points and quaternions
+/// author: Karl-Mihkel Ott
+
+#include <cmath>
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include <trs/Points.h>
+#include <trs/Quaternion.h>
+#include "Bench.h"
+
+namespace TRS {
+namespace Bench {
+
+    /*********************************/
+    /***** Random operand values *****/
+    /*********************************/
+
+    template<typename T>
+    void Randomize(Vector2<T> &_v, Random &_rnd) {
+        _v = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    template<typename T>
+    void Randomize(Vector3<T> &_v, Random &_rnd) {
+        _v = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    template<typename T>
+    void Randomize(Vector4<T> &_v, Random &_rnd) {
+        _v = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    template<typename T>
+    void Randomize(Point2D<T> &_p, Random &_rnd) {
+        _p = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    template<typename T>
+    void Randomize(Point3D<T> &_p, Random &_rnd) {
+        _p = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    template<typename T>
+    void Randomize(Point4D<T> &_p, Random &_rnd) {
+        _p = { static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()), static_cast<T>(_rnd.Next()) };
+    }
+
+    /// Diagonally dominant, so every matrix is invertible, Matrix4 gets a 0, 0, 0, 1 last row to stay affine
+    template<typename T, typename M>
+    void RandomizeMatrix(M &_m, size_t _size, Random &_rnd) {
+        T *data = &_m.row1.first;
+        for(size_t i = 0; i < _size * _size; i++)
+            data[i] = static_cast<T>(_rnd.Next());
+        for(size_t i = 0; i < _size; i++)
+            data[i * _size + i] += static_cast<T>(_size);
+        if(_size == 4) {
+            data[12] = data[13] = data[14] = 0;
+            data[15] = 1;
+        }
+    }
+
+    template<typename T>
+    void Randomize(Matrix2<T> &_m, Random &_rnd) { RandomizeMatrix<T>(_m, 2, _rnd); }
+
+    template<typename T>
+    void Randomize(Matrix3<T> &_m, Random &_rnd) { RandomizeMatrix<T>(_m, 3, _rnd); }
+
+    template<typename T>
+    void Randomize(Matrix4<T> &_m, Random &_rnd) { RandomizeMatrix<T>(_m, 4, _rnd); }
+
+    /// Unit quaternions, so that they represent rotations
+    inline void Randomize(Quaternion &_q, Random &_rnd) {
+        _q = Quaternion(static_cast<float>(_rnd.Next()), static_cast<float>(_rnd.Next()), static_cast<float>(_rnd.Next()),
+                        static_cast<float>(_rnd.Next()) + 2.0f).Normalise();
+    }
+
+
+    /// Register _op(a, b) -> Out over arrays of operands as a single call and one batch per working set size
+    template<typename A, typename B, typename Op>
+    void AddBenchmark(const std::string &_type, const std::string &_operation, Op _op) {
+        typedef decltype(_op(std::declval<const A&>(), std::declval<const B&>())) Out;
+        const size_t item_bytes = sizeof(A) + sizeof(B) + sizeof(Out);
+
+        const auto make = [_op, item_bytes](size_t _count) {
+            return [_op, item_bytes, _count](State &_state) {
+                std::vector<A> a(_count);
+                std::vector<B> b(_count);
+                std::vector<Out> out(_count);
+                Random rnd;
+                for(size_t i = 0; i < _count; i++) {
+                    Randomize(a[i], rnd);
+                    Randomize(b[i], rnd);
+                }
+
+                _state.Measure(_count, _count * item_bytes, [&]() {
+                    for(size_t i = 0; i < _count; i++)
+                        out[i] = _op(a[i], b[i]);
+                    DoNotOptimize(out.front());
+                });
+            };
+        };
+
+        Register(_type, _operation, "single", make(1));
+        for(const Size &size : BatchSizes())
+            Register(_type, _operation, size.name, make(std::max<size_t>(size.bytes / item_bytes, 1)));
+    }
+
+
+    template<typename V>
+    void AddVectorBenchmarks(const std::string &_type) {
+        typedef decltype(V().first) T;
+        AddBenchmark<V, V>(_type, "add", [](const V &_a, const V &_b) { return _a + _b; });
+        AddBenchmark<V, V>(_type, "dot", [](const V &_a, const V &_b) { return _a * _b; });
+        AddBenchmark<V, V>(_type, "scale", [](const V &_a, const V &_b) { return _a * _b.first; });
+        AddBenchmark<V, V>(_type, "magnitude", [](const V &_a, const V&) { return _a.Magnitude(); });
+        AddBenchmark<V, V>(_type, "normalise", [](const V &_a, const V&) {
+            V v = _a;
+            v.Normalise();
+            return v;
+        });
+
+        if constexpr (std::is_same<V, Vector3<T>>::value || std::is_same<V, Vector4<T>>::value)
+            AddBenchmark<V, V>(_type, "cross", [](const V &_a, const V &_b) { return V::Cross(_a, _b); });
+    }
+
+
+    template<typename P>
+    void AddPointBenchmarks(const std::string &_type) {
+        AddBenchmark<P, P>(_type, "add", [](const P &_a, const P &_b) { return _a + _b; });
+        AddBenchmark<P, P>(_type, "sub", [](const P &_a, const P &_b) { return _a - _b; });
+    }
+
+
+    template<typename M, typename V>
+    void AddMatrixBenchmarks(const std::string &_type) {
+        AddBenchmark<M, M>(_type, "add", [](const M &_a, const M &_b) { return _a + _b; });
+        AddBenchmark<M, M>(_type, "scale", [](const M &_a, const M &_b) { return _a * _b.row1.first; });
+        AddBenchmark<M, M>(_type, "transpose", [](const M &_a, const M&) { return _a.Transpose(); });
+        AddBenchmark<M, V>(_type, "mul_vec", [](const M &_a, const V &_v) { return _a * _v; });
+        AddBenchmark<M, M>(_type, "mul", [](const M &_a, const M &_b) { return _a * _b; });
+        AddBenchmark<M, M>(_type, "determinant", [](const M &_a, const M&) { return M::Determinant(_a); });
+        AddBenchmark<M, M>(_type, "inverse", [](const M &_a, const M&) { return _a.Inverse(); });
+    }
+
+
+    void AddQuaternionBenchmarks() {
+        const std::string type = "Quaternion";
+        AddBenchmark<Quaternion, Quaternion>(type, "mul", [](const Quaternion &_a, const Quaternion &_b) { return _a * _b; });
+        AddBenchmark<Quaternion, Quaternion>(type, "dot", [](const Quaternion &_a, const Quaternion &_b) { return Quaternion::Dot(_a, _b); });
+        AddBenchmark<Quaternion, Quaternion>(type, "normalise", [](const Quaternion &_a, const Quaternion&) { return _a.Normalise(); });
+        AddBenchmark<Quaternion, Quaternion>(type, "inverse", [](const Quaternion &_a, const Quaternion&) { return _a.Inverse(); });
+        AddBenchmark<Quaternion, Vector4<float>>(type, "rotate", [](const Quaternion &_q, const Vector4<float> &_v) { return _q * _v; });
+        AddBenchmark<Quaternion, Quaternion>(type, "to_matrix4", [](const Quaternion &_q, const Quaternion&) { return _q.ExpandToMatrix4(); });
+    }
+
+
+    template<typename T>
+    void AddTypedBenchmarks() {
+        const std::string t = std::string("<") + TypeName<T>() + ">";
+        AddVectorBenchmarks<Vector2<T>>("Vector2" + t);
+        AddVectorBenchmarks<Vector3<T>>("Vector3" + t);
+        AddVectorBenchmarks<Vector4<T>>("Vector4" + t);
+
+        AddPointBenchmarks<Point2D<T>>("Point2D" + t);
+        AddPointBenchmarks<Point3D<T>>("Point3D" + t);
+        AddPointBenchmarks<Point4D<T>>("Point4D" + t);
+
+        AddMatrixBenchmarks<Matrix2<T>, Vector2<T>>("Matrix2" + t);
+        AddMatrixBenchmarks<Matrix3<T>, Vector3<T>>("Matrix3" + t);
+        AddMatrixBenchmarks<Matrix4<T>, Vector4<T>>("Matrix4" + t);
+        AddBenchmark<Matrix4<T>, Matrix4<T>>("Matrix4" + t, "affine_inverse", [](const Matrix4<T> &_a, const Matrix4<T>&) { return _a.AffineInverse(); });
+    }
+
+
+    void RegisterFixedBenchmarks() {
+        AddTypedBenchmarks<float>();
+        AddTypedBenchmarks<double>();
+        AddQuaternionBenchmarks();
+    }
+}
+}
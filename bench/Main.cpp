@@ -0,0 +1,198 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Main.cpp - trs_bench command line, runs registered benchmarks and writes JSON or CSV results
+/// author: Karl-Mihkel Ott
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <trs/CpuFeatures.h>
+#include <trs/ThreadPool.h>
+#include "Bench.h"
+
+namespace TRS {
+namespace Bench {
+
+    static const char *usage =
+        "usage: trs_bench [options]\n"
+        "  --filter <text>       run benchmarks whose name contains text, names are type/operation/size\n"
+        "  --min-time <seconds>  minimum duration of one timed repetition (default 0.05)\n"
+        "  --repetitions <n>     timed repetitions per benchmark, the median is reported (default 5)\n"
+        "  --threads <n>         threads used by MatrixN and VectorN, 0 uses all hardware threads (default 1)\n"
+        "  --format <fmt>        console, json or csv (default console)\n"
+        "  --out <file>          write results to file instead of standard output\n"
+        "  --list                print benchmark names and exit\n";
+
+
+    /// Quote a string for JSON, benchmark names hold no characters that need more than this
+    static std::string Quote(const std::string &_s) {
+        std::string out = "\"";
+        for(char c : _s) {
+            if(c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+
+    static std::string Number(double _value) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", _value);
+        return buf;
+    }
+
+
+    static double BytesPerSecond(const Result &_r) {
+        return _r.median_ns > 0 && _r.items ? static_cast<double>(_r.bytes) / (_r.median_ns * static_cast<double>(_r.items)) * 1e9 : 0;
+    }
+
+
+    static void WriteJson(std::ostream &_out, const std::vector<Result> &_results, const Options &_options) {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        char date[32];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        _out << "{\n  \"context\": {\n"
+             << "    \"date\": " << Quote(date) << ",\n"
+             << "    \"threads\": " << GetThreadPool().GetThreadCount() << ",\n"
+             << "    \"min_time\": " << Number(_options.min_time) << ",\n"
+             << "    \"repetitions\": " << _options.repetitions << ",\n"
+             << "    \"avx2\": " << (cpu.avx2 ? "true" : "false") << ",\n"
+             << "    \"fma\": " << (cpu.fma ? "true" : "false") << ",\n"
+#ifdef __VERSION__
+             << "    \"compiler\": " << Quote(__VERSION__) << ",\n"
+#endif
+#ifdef NDEBUG
+             << "    \"assertions\": false\n"
+#else
+             << "    \"assertions\": true\n"
+#endif
+             << "  },\n  \"benchmarks\": [";
+
+        for(size_t i = 0; i < _results.size(); i++) {
+            const Result &r = _results[i];
+            _out << (i ? ",\n" : "\n")
+                 << "    { \"name\": " << Quote(r.name)
+                 << ", \"type\": " << Quote(r.type)
+                 << ", \"operation\": " << Quote(r.operation)
+                 << ", \"size\": " << Quote(r.size)
+                 << ", \"items\": " << r.items
+                 << ", \"bytes\": " << r.bytes
+                 << ", \"iterations\": " << r.iterations
+                 << ", \"median_ns\": " << Number(r.median_ns)
+                 << ", \"min_ns\": " << Number(r.min_ns)
+                 << ", \"bytes_per_second\": " << Number(BytesPerSecond(r)) << " }";
+        }
+        _out << "\n  ]\n}\n";
+    }
+
+
+    static void WriteCsv(std::ostream &_out, const std::vector<Result> &_results) {
+        _out << "name,type,operation,size,items,bytes,iterations,median_ns,min_ns,bytes_per_second\n";
+        for(const Result &r : _results) {
+            _out << r.name << ',' << r.type << ',' << r.operation << ',' << r.size << ',' << r.items << ',' << r.bytes << ','
+                 << r.iterations << ',' << Number(r.median_ns) << ',' << Number(r.min_ns) << ',' << Number(BytesPerSecond(r)) << '\n';
+        }
+    }
+
+
+    static void WriteConsole(std::ostream &_out, const Result &_r) {
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-44s %12.3f ns/item %12.3f min %10.3f GB/s\n", _r.name.c_str(), _r.median_ns, _r.min_ns,
+                      BytesPerSecond(_r) * 1e-9);
+        _out << line << std::flush;
+    }
+
+
+    static int Main(int _argc, char **_argv) {
+        Options options;
+        std::string format = "console";
+        std::string out_path;
+        size_t threads = 1;
+        bool list = false;
+
+        for(int i = 1; i < _argc; i++) {
+            const std::string arg = _argv[i];
+            const bool has_value = i + 1 < _argc;
+            if(arg == "--filter" && has_value)
+                options.filter = _argv[++i];
+            else if(arg == "--min-time" && has_value)
+                options.min_time = std::strtod(_argv[++i], nullptr);
+            else if(arg == "--repetitions" && has_value)
+                options.repetitions = std::strtoul(_argv[++i], nullptr, 10);
+            else if(arg == "--threads" && has_value)
+                threads = std::strtoul(_argv[++i], nullptr, 10);
+            else if(arg == "--format" && has_value)
+                format = _argv[++i];
+            else if(arg == "--out" && has_value)
+                out_path = _argv[++i];
+            else if(arg == "--list")
+                list = true;
+            else {
+                std::cerr << usage;
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+
+        if(format != "console" && format != "json" && format != "csv") {
+            std::cerr << usage;
+            return 1;
+        }
+
+        RegisterFixedBenchmarks();
+        RegisterDynamicBenchmarks();
+        SetThreadCount(threads);
+
+        std::vector<Result> results;
+        for(const Benchmark &benchmark : Registry()) {
+            const std::string name = benchmark.Name();
+            if(name.find(options.filter) == std::string::npos)
+                continue;
+            if(list) {
+                std::cout << name << '\n';
+                continue;
+            }
+
+            Result result;
+            result.name = name;
+            result.type = benchmark.type;
+            result.operation = benchmark.operation;
+            result.size = benchmark.size;
+            State state(options, result);
+            benchmark.run(state);
+            if(format == "console")
+                WriteConsole(std::cout, result);
+            results.push_back(std::move(result));
+        }
+
+        if(list || format == "console")
+            return 0;
+
+        std::ofstream file;
+        if(!out_path.empty()) {
+            file.open(out_path);
+            if(!file) {
+                std::cerr << "trs_bench: cannot write " << out_path << '\n';
+                return 1;
+            }
+        }
+
+        std::ostream &out = out_path.empty() ? std::cout : file;
+        if(format == "json")
+            WriteJson(out, results, options);
+        else WriteCsv(out, results);
+        return 0;
+    }
+}
+}
+
+
+int main(int argc, char **argv) {
+    return TRS::Bench::Main(argc, argv);
+}
@@ -0,0 +1,570 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Cholesky.h - Cholesky and LDLT factorizations for symmetric MatrixN
+/// author: Karl-Mihkel Ott
+
+#ifndef CHOLESKY_H
+#define CHOLESKY_H
+
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Gemm.h>
+#include <trs/Triangular.h>
+#include <trs/ThreadPool.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+
+// Both factorizations read only the lower triangle of the input. They are right-looking and blocked like LU:
+// a block_size wide panel is factored, then the lower triangle of the trailing matrix gets a symmetric rank-k
+// update made of GEMM calls on column tiles, which does about half the work of a full GEMM.
+// After factoring, the strictly upper triangle mirrors L^T so that both triangular solves read rows.
+
+namespace TRS {
+
+    /// Lower triangle of C += _alpha * A * B^T, where A and B are _n x _k and C is _n x _n
+    /// Elements above the diagonal of C inside the nb wide diagonal tiles are overwritten with garbage.
+    template<typename T>
+    void UpdateLowerTriangle(size_t _n, size_t _k, T _alpha, const T *_a, size_t _lda, const T *_b, size_t _ldb, T *_c, size_t _ldc) {
+        constexpr size_t nb = TriangularBlocking::nb;
+        for(size_t c0 = 0; c0 < _n; c0 += nb) {
+            const size_t cw = std::min(nb, _n - c0);
+            Gemm(false, true, _n - c0, cw, _k, _alpha, _a + c0 * _lda, _lda, _b + c0 * _ldb, _ldb,
+                 static_cast<T>(1), _c + c0 * _ldc + c0, _ldc);
+        }
+    }
+
+
+    /// Copy the strictly lower triangle of the _n x _n matrix _a into its strictly upper triangle
+    template<typename T>
+    void MirrorLowerTriangle(size_t _n, T *_a, size_t _lda) {
+        for(size_t i = 0; i < _n; i++) {
+            for(size_t j = i + 1; j < _n; j++)
+                _a[i * _lda + j] = _a[j * _lda + i];
+        }
+    }
+
+
+    /**
+     * Cholesky factorization A = L * L^T of a symmetric positive definite matrix
+     * Matrices that are not positive definite are reported by Compute() and IsPositiveDefinite(),
+     * Inverse() and Solve() then give empty results.
+     */
+    template<typename T>
+    class Cholesky {
+        static_assert(std::is_floating_point<T>::value, "Cholesky factorization needs a floating point type");
+
+        private:
+            static constexpr size_t block_size = 64;
+
+            // L on and below the diagonal, L^T above it
+            MatrixN<T> m_llt;
+            bool m_positive_definite = true;
+
+            // factor the _jb x _jb diagonal block at _j0 and solve the rows below it, false when a pivot is not positive
+            bool FactorPanel(size_t _j0, size_t _jb) {
+                const size_t n = m_llt.Rows();
+                T *a = m_llt.Data();
+
+                for(size_t j = 0; j < _jb; j++) {
+                    T *lj = a + (_j0 + j) * n + _j0;
+                    const T d = lj[j] - TriangularDot(j, lj, lj);
+                    if(!(d > T()))
+                        return false;
+
+                    lj[j] = std::sqrt(d);
+                    for(size_t r = j + 1; r < _jb; r++) {
+                        T *lr = a + (_j0 + r) * n + _j0;
+                        lr[j] = (lr[j] - TriangularDot(j, lr, lj)) / lj[j];
+                    }
+                }
+
+                // L21 = A21 * inv(L11)^T, every row is an independent forward substitution
+                const T *l11 = a + _j0 * n + _j0;
+                ParallelRows(_j0 + _jb, n, _jb * _jb / 2, [&](size_t _first, size_t _last) {
+                    for(size_t r = _first; r < _last; r++) {
+                        T *x = a + r * n + _j0;
+                        for(size_t j = 0; j < _jb; j++)
+                            x[j] = (x[j] - TriangularDot(j, x, l11 + j * n)) / l11[j * n + j];
+                    }
+                });
+
+                return true;
+            }
+
+            // modification of L with _sigma * X * X^T, one rank one pass per column of the _k column row-major X
+            // works on a copy so that a failed downdate keeps the factor
+            bool RankUpdate(const T *_x, size_t _ldx, size_t _k, T _sigma) {
+                const size_t n = Size();
+                if(!m_positive_definite)
+                    return false;
+
+                MatrixN<T> llt(m_llt);
+                Buffer<T> x(n);
+                T *a = llt.Data();
+
+                for(size_t col = 0; col < _k; col++) {
+                    for(size_t i = 0; i < n; i++)
+                        x[i] = _x[i * _ldx + col];
+
+                    for(size_t k = 0; k < n; k++) {
+                        // row k of the upper triangle holds column k of L
+                        T *lk = a + k * n;
+                        const T r2 = lk[k] * lk[k] + _sigma * x[k] * x[k];
+                        if(!(r2 > T()))
+                            return false;
+
+                        const T r = std::sqrt(r2);
+                        const T c = r / lk[k];
+                        const T s = x[k] / lk[k];
+                        lk[k] = r;
+                        for(size_t i = k + 1; i < n; i++) {
+                            lk[i] = (lk[i] + _sigma * s * x[i]) / c;
+                            x[i] = c * x[i] - s * lk[i];
+                        }
+                    }
+                }
+
+                // copy the updated upper triangle back into L
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t j = 0; j < i; j++)
+                        a[i * n + j] = a[j * n + i];
+                }
+
+                m_llt = std::move(llt);
+                return true;
+            }
+
+        public:
+            Cholesky() = default;
+
+            template<typename E>
+            explicit Cholesky(const MatrixExpression<E>& _a) {
+                Compute(_a);
+            }
+
+            /// Factor the lower triangle of _a, returns false when _a is not square or not positive definite
+            /// _a can be a MatrixN, a MatrixView or any matrix expression.
+            template<typename E>
+            bool Compute(const MatrixExpression<E>& _a) {
+                static_assert(std::is_same<typename E::value_type, T>::value, "Cholesky input must have the element type of the factorization");
+                m_llt = _a.Self();
+                m_positive_definite = m_llt.IsSquare();
+                if(!m_positive_definite)
+                    return false;
+
+                const size_t n = m_llt.Rows();
+                T *a = m_llt.Data();
+                for(size_t j0 = 0; j0 < n; j0 += block_size) {
+                    const size_t jb = std::min(block_size, n - j0);
+                    const size_t j1 = j0 + jb;
+                    if(!FactorPanel(j0, jb)) {
+                        m_positive_definite = false;
+                        return false;
+                    }
+
+                    // A22 -= L21 * L21^T
+                    if(j1 < n)
+                        UpdateLowerTriangle(n - j1, jb, static_cast<T>(-1), a + j1 * n + j0, n, a + j1 * n + j0, n, a + j1 * n + j1, n);
+                }
+
+                MirrorLowerTriangle(n, a, n);
+                return true;
+            }
+
+            bool IsPositiveDefinite() const { return m_positive_definite; }
+            size_t Size() const { return m_llt.Rows(); }
+
+            /// L on and below the diagonal, L^T above it
+            const MatrixN<T>& Factor() const { return m_llt; }
+
+            /// log(det(A)) = 2 * sum(log(L_ii)), which does not overflow like the determinant itself
+            /// NaN when the matrix is not positive definite.
+            T LogDeterminant() const {
+                if(!m_positive_definite)
+                    return std::numeric_limits<T>::quiet_NaN();
+
+                T sum = T();
+                for(size_t i = 0; i < Size(); i++)
+                    sum += std::log(m_llt[i][i]);
+
+                return static_cast<T>(2) * sum;
+            }
+
+            T Determinant() const {
+                if(!m_positive_definite)
+                    return T();
+
+                T det = static_cast<T>(1);
+                for(size_t i = 0; i < Size(); i++)
+                    det *= m_llt[i][i] * m_llt[i][i];
+
+                return det;
+            }
+
+            /// Turn the factor of A into the factor of A + x * x^T
+            bool Update(const VectorN<T>& _x) {
+                return _x.size() == Size() && RankUpdate(_x.data(), 1, 1, static_cast<T>(1));
+            }
+
+            /// Turn the factor of A into the factor of A - x * x^T, false and unchanged when the result is not positive definite
+            bool Downdate(const VectorN<T>& _x) {
+                return _x.size() == Size() && RankUpdate(_x.data(), 1, 1, static_cast<T>(-1));
+            }
+
+            /// Turn the factor of A into the factor of A + X * X^T, X is Size() x k and costs O(k * n^2)
+            bool Update(const MatrixN<T>& _x) {
+                return _x.Rows() == Size() && RankUpdate(_x.Data(), _x.Columns(), _x.Columns(), static_cast<T>(1));
+            }
+
+            /// Turn the factor of A into the factor of A - X * X^T, false and unchanged when the result is not positive definite
+            bool Downdate(const MatrixN<T>& _x) {
+                return _x.Rows() == Size() && RankUpdate(_x.Data(), _x.Columns(), _x.Columns(), static_cast<T>(-1));
+            }
+
+            /// Overwrite the Size() x _nrhs row-major matrix _b with the solution X of A * X = B
+            void SolveInPlace(T *_b, size_t _ldb, size_t _nrhs) const {
+                SolveLowerTriangular(false, Size(), _nrhs, m_llt.Data(), Size(), _b, _ldb);
+                SolveUpperTriangular(false, Size(), _nrhs, m_llt.Data(), Size(), _b, _ldb);
+            }
+
+            /// Overwrite the matrix or vector view _b with the solution of A * X = B, false and untouched when that fails
+            bool SolveInPlace(const MatrixView<T>& _b) const {
+                if(!m_positive_definite || _b.Rows() != Size())
+                    return false;
+
+                SolveInPlace(_b.Data(), _b.Stride(), _b.Columns());
+                return true;
+            }
+
+            bool SolveInPlace(const VectorView<T>& _b) const {
+                if(!m_positive_definite || _b.size() != Size())
+                    return false;
+
+                SolveInPlace(_b.data(), _b.Stride(), 1);
+                return true;
+            }
+
+            /// Solve A * x = b, the result is empty when A is not positive definite or b has the wrong size
+            VectorN<T> Solve(const VectorN<T>& _b) const {
+                if(!m_positive_definite || _b.size() != Size())
+                    return VectorN<T>();
+
+                VectorN<T> x(_b);
+                SolveInPlace(x.data(), 1, 1);
+                return x;
+            }
+
+            /// Solve A * X = B for every column of B
+            MatrixN<T> Solve(const MatrixN<T>& _b) const {
+                if(!m_positive_definite || _b.Rows() != Size())
+                    return MatrixN<T>();
+
+                MatrixN<T> x(_b);
+                SolveInPlace(x.Data(), x.Columns(), x.Columns());
+                return x;
+            }
+
+            MatrixN<T> Inverse() const {
+                return Solve(MatrixN<T>::MakeIdentity(Size()));
+            }
+    };
+
+
+    /**
+     * LDL^T factorization A = L * D * L^T of a symmetric matrix, L has a unit diagonal and D is diagonal
+     * No pivoting is done, so it handles positive definite and quasi-definite matrices without square roots.
+     * A pivot that is not finite or at most n * epsilon times the larger of its row of A and of the eliminated
+     * terms sum(L_jk^2 * |D_k|) counts as zero. Zero pivots are reported by Compute() and IsSingular().
+     */
+    template<typename T>
+    class LDLT {
+        static_assert(std::is_floating_point<T>::value, "LDLT factorization needs a floating point type");
+
+        private:
+            static constexpr size_t block_size = 64;
+
+            // D on the diagonal, L below it and L^T above it
+            MatrixN<T> m_ldlt;
+            bool m_singular = false;
+            // largest magnitude in every row of A, an upper bound of it after updates
+            Buffer<T> m_row_scale;
+
+            static bool IsZeroPivot(size_t _n, T _pivot, T _row_scale) {
+                return !std::isfinite(_pivot) || std::abs(_pivot) <= static_cast<T>(_n) * std::numeric_limits<T>::epsilon() * _row_scale;
+            }
+
+            // sum of |L_jk^2 * D_k| over k < _j, without pivoting the rounding error of pivot j grows with it
+            T EliminatedMagnitude(size_t _j) const {
+                const size_t n = m_ldlt.Rows();
+                const T *a = m_ldlt.Data();
+                T sum = T();
+                for(size_t k = 0; k < _j; k++)
+                    sum += a[_j * n + k] * a[_j * n + k] * std::abs(a[k * n + k]);
+
+                return sum;
+            }
+
+            bool FactorPanel(size_t _j0, size_t _jb) {
+                const size_t n = m_ldlt.Rows();
+                T *a = m_ldlt.Data();
+
+                // w holds L11 * D1 row by row, so that every update is a plain dot product
+                Buffer<T> w(_jb * _jb);
+                for(size_t j = 0; j < _jb; j++) {
+                    T *lj = a + (_j0 + j) * n + _j0;
+                    T *wj = w.data() + j * _jb;
+                    for(size_t k = 0; k < j; k++)
+                        wj[k] = lj[k] * a[(_j0 + k) * n + _j0 + k];
+
+                    const T d = lj[j] - TriangularDot(j, lj, wj);
+                    if(IsZeroPivot(n, d, std::max(m_row_scale[_j0 + j], EliminatedMagnitude(_j0 + j))))
+                        return false;
+
+                    lj[j] = d;
+                    for(size_t r = j + 1; r < _jb; r++) {
+                        T *lr = a + (_j0 + r) * n + _j0;
+                        lr[j] = (lr[j] - TriangularDot(j, lr, wj)) / d;
+                    }
+                }
+
+                // L21 = A21 * inv(L11 * D1)^T
+                const T *l11 = a + _j0 * n + _j0;
+                ParallelRows(_j0 + _jb, n, _jb * _jb / 2, [&](size_t _first, size_t _last) {
+                    for(size_t r = _first; r < _last; r++) {
+                        T *x = a + r * n + _j0;
+                        for(size_t j = 0; j < _jb; j++)
+                            x[j] = (x[j] - TriangularDot(j, x, w.data() + j * _jb)) / l11[j * n + j];
+                    }
+                });
+
+                return true;
+            }
+
+            // modification with _sigma * X * X^T one column of the _k column row-major X at a time,
+            // see Gill, Golub, Murray and Saunders, method C1
+            bool RankUpdate(const T *_x, size_t _ldx, size_t _k, T _sigma) {
+                const size_t n = Size();
+                if(m_singular)
+                    return false;
+
+                MatrixN<T> ldlt(m_ldlt);
+                Buffer<T> x(n), row_scale(m_row_scale);
+                T *a = ldlt.Data();
+
+                for(size_t col = 0; col < _k; col++) {
+                    T x_max = T();
+                    for(size_t i = 0; i < n; i++) {
+                        x[i] = _x[i * _ldx + col];
+                        x_max = std::max(x_max, std::abs(x[i]));
+                    }
+                    for(size_t i = 0; i < n; i++)
+                        row_scale[i] += std::abs(x[i]) * x_max;
+
+                    T alpha = _sigma;
+                    for(size_t j = 0; j < n; j++) {
+                        T *lj = a + j * n;
+                        const T p = x[j];
+                        const T d = lj[j] + alpha * p * p;
+                        if(IsZeroPivot(n, d, row_scale[j]))
+                            return false;
+
+                        const T beta = p * alpha / d;
+                        alpha = lj[j] * alpha / d;
+                        lj[j] = d;
+                        for(size_t r = j + 1; r < n; r++) {
+                            x[r] -= p * lj[r];
+                            lj[r] += beta * x[r];
+                        }
+                    }
+                }
+
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t j = 0; j < i; j++)
+                        a[i * n + j] = a[j * n + i];
+                }
+
+                m_ldlt = std::move(ldlt);
+                m_row_scale = std::move(row_scale);
+                return true;
+            }
+
+        public:
+            LDLT() = default;
+
+            template<typename E>
+            explicit LDLT(const MatrixExpression<E>& _a) {
+                Compute(_a);
+            }
+
+            /// Factor the lower triangle of _a, returns false when _a is not square or a pivot is zero
+            /// _a can be a MatrixN, a MatrixView or any matrix expression.
+            template<typename E>
+            bool Compute(const MatrixExpression<E>& _a) {
+                static_assert(std::is_same<typename E::value_type, T>::value, "LDLT input must have the element type of the factorization");
+                m_ldlt = _a.Self();
+                m_singular = !m_ldlt.IsSquare();
+                if(m_singular)
+                    return false;
+
+                // only the lower triangle is read, element (i, j) belongs to rows i and j of the symmetric matrix
+                const size_t n = m_ldlt.Rows();
+                T *a = m_ldlt.Data();
+                m_row_scale.assign(n, T());
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t j = 0; j <= i; j++) {
+                        const T v = std::abs(a[i * n + j]);
+                        m_row_scale[i] = std::max(m_row_scale[i], v);
+                        m_row_scale[j] = std::max(m_row_scale[j], v);
+                    }
+                }
+
+                Buffer<T> w;
+                for(size_t j0 = 0; j0 < n; j0 += block_size) {
+                    const size_t jb = std::min(block_size, n - j0);
+                    const size_t j1 = j0 + jb;
+                    if(!FactorPanel(j0, jb)) {
+                        m_singular = true;
+                        return false;
+                    }
+
+                    // A22 -= (L21 * D1) * L21^T
+                    if(j1 < n) {
+                        w.resize((n - j1) * jb);
+                        for(size_t r = j1; r < n; r++) {
+                            for(size_t k = 0; k < jb; k++)
+                                w[(r - j1) * jb + k] = a[r * n + j0 + k] * a[(j0 + k) * n + j0 + k];
+                        }
+
+                        UpdateLowerTriangle(n - j1, jb, static_cast<T>(-1), w.data(), jb, a + j1 * n + j0, n, a + j1 * n + j1, n);
+                    }
+                }
+
+                MirrorLowerTriangle(n, a, n);
+                return true;
+            }
+
+            bool IsSingular() const { return m_singular; }
+            size_t Size() const { return m_ldlt.Rows(); }
+
+            /// D on the diagonal, unit L below it and L^T above it
+            const MatrixN<T>& Factor() const { return m_ldlt; }
+
+            /// Diagonal of D
+            VectorN<T> Diagonal() const {
+                VectorN<T> d(Size());
+                for(size_t i = 0; i < Size(); i++)
+                    d[i] = m_ldlt[i][i];
+
+                return d;
+            }
+
+            /// log(|det(A)|) = sum(log(|D_ii|))
+            T LogAbsDeterminant() const {
+                T sum = T();
+                for(size_t i = 0; i < Size(); i++)
+                    sum += std::log(std::abs(m_ldlt[i][i]));
+
+                return m_singular ? -std::numeric_limits<T>::infinity() : sum;
+            }
+
+            /// log(det(A)), which only exists when every pivot is positive
+            T LogDeterminant() const {
+                for(size_t i = 0; i < Size(); i++) {
+                    if(!(m_ldlt[i][i] > T()))
+                        return std::numeric_limits<T>::quiet_NaN();
+                }
+
+                return LogAbsDeterminant();
+            }
+
+            T Determinant() const {
+                if(m_singular)
+                    return T();
+
+                T det = static_cast<T>(1);
+                for(size_t i = 0; i < Size(); i++)
+                    det *= m_ldlt[i][i];
+
+                return det;
+            }
+
+            /// Turn the factors of A into the factors of A + x * x^T
+            bool Update(const VectorN<T>& _x) {
+                return _x.size() == Size() && RankUpdate(_x.data(), 1, 1, static_cast<T>(1));
+            }
+
+            /// Turn the factors of A into the factors of A - x * x^T, false and unchanged when a pivot becomes zero
+            bool Downdate(const VectorN<T>& _x) {
+                return _x.size() == Size() && RankUpdate(_x.data(), 1, 1, static_cast<T>(-1));
+            }
+
+            /// Turn the factors of A into the factors of A + X * X^T, X is Size() x k and costs O(k * n^2)
+            bool Update(const MatrixN<T>& _x) {
+                return _x.Rows() == Size() && RankUpdate(_x.Data(), _x.Columns(), _x.Columns(), static_cast<T>(1));
+            }
+
+            /// Turn the factors of A into the factors of A - X * X^T, false and unchanged when a pivot becomes zero
+            bool Downdate(const MatrixN<T>& _x) {
+                return _x.Rows() == Size() && RankUpdate(_x.Data(), _x.Columns(), _x.Columns(), static_cast<T>(-1));
+            }
+
+            /// Overwrite the Size() x _nrhs row-major matrix _b with the solution X of A * X = B
+            void SolveInPlace(T *_b, size_t _ldb, size_t _nrhs) const {
+                const size_t n = Size();
+                SolveLowerTriangular(true, n, _nrhs, m_ldlt.Data(), n, _b, _ldb);
+                for(size_t i = 0; i < n; i++) {
+                    const T d = static_cast<T>(1) / m_ldlt[i][i];
+                    for(size_t j = 0; j < _nrhs; j++)
+                        _b[i * _ldb + j] *= d;
+                }
+                SolveUpperTriangular(true, n, _nrhs, m_ldlt.Data(), n, _b, _ldb);
+            }
+
+            /// Overwrite the matrix or vector view _b with the solution of A * X = B, false and untouched when that fails
+            bool SolveInPlace(const MatrixView<T>& _b) const {
+                if(m_singular || _b.Rows() != Size())
+                    return false;
+
+                SolveInPlace(_b.Data(), _b.Stride(), _b.Columns());
+                return true;
+            }
+
+            bool SolveInPlace(const VectorView<T>& _b) const {
+                if(m_singular || _b.size() != Size())
+                    return false;
+
+                SolveInPlace(_b.data(), _b.Stride(), 1);
+                return true;
+            }
+
+            /// Solve A * x = b, the result is empty when A is singular or b has the wrong size
+            VectorN<T> Solve(const VectorN<T>& _b) const {
+                if(m_singular || _b.size() != Size())
+                    return VectorN<T>();
+
+                VectorN<T> x(_b);
+                SolveInPlace(x.data(), 1, 1);
+                return x;
+            }
+
+            /// Solve A * X = B for every column of B
+            MatrixN<T> Solve(const MatrixN<T>& _b) const {
+                if(m_singular || _b.Rows() != Size())
+                    return MatrixN<T>();
+
+                MatrixN<T> x(_b);
+                SolveInPlace(x.Data(), x.Columns(), x.Columns());
+                return x;
+            }
+
+            MatrixN<T> Inverse() const {
+                return Solve(MatrixN<T>::MakeIdentity(Size()));
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,102 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: CpuFeatures.h - Runtime detection of SIMD instruction set support
+/// author: Karl-Mihkel Ott
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <cstdint>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#else
+    #include <cpuid.h>
+#endif
+
+namespace TRS {
+
+    /// Instruction set extensions that are supported by both the CPU and the operating system
+    struct CpuFeatures {
+        bool sse2 = false;
+        bool sse41 = false;
+        bool avx = false;
+        bool avx2 = false;
+        bool fma = false;
+        bool avx512f = false;
+    };
+
+
+    /// Query cpuid leaf and subleaf into _regs as eax, ebx, ecx, edx
+    inline bool QueryCpuid(uint32_t _leaf, uint32_t _subleaf, uint32_t *_regs) {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        if(static_cast<uint32_t>(regs[0]) < _leaf)
+            return false;
+        __cpuidex(regs, static_cast<int>(_leaf), static_cast<int>(_subleaf));
+        for(int i = 0; i < 4; i++)
+            _regs[i] = static_cast<uint32_t>(regs[i]);
+        return true;
+#else
+        unsigned int a, b, c, d;
+        if(!__get_cpuid_count(_leaf, _subleaf, &a, &b, &c, &d))
+            return false;
+        _regs[0] = a;
+        _regs[1] = b;
+        _regs[2] = c;
+        _regs[3] = d;
+        return true;
+#endif
+    }
+
+
+    /// Read extended control register 0, which tells what register states the operating system saves
+    inline uint64_t QueryXcr0() {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+
+
+    /// Detect supported instruction set extensions
+    inline CpuFeatures DetectCpuFeatures() {
+        CpuFeatures features;
+        uint32_t regs[4];
+        if(!QueryCpuid(1, 0, regs))
+            return features;
+
+        features.sse2 = (regs[3] >> 26) & 1;
+        features.sse41 = (regs[2] >> 19) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        const bool cpu_avx = (regs[2] >> 28) & 1;
+        const bool cpu_fma = (regs[2] >> 12) & 1;
+
+        // AVX registers are usable only if the OS saves xmm and ymm state (and opmask, zmm state for AVX-512)
+        const uint64_t xcr0 = osxsave ? QueryXcr0() : 0;
+        const bool os_avx = (xcr0 & 0x6) == 0x6;
+        const bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+        features.avx = cpu_avx && os_avx;
+        features.fma = cpu_fma && features.avx;
+        if(features.avx && QueryCpuid(7, 0, regs)) {
+            features.avx2 = (regs[1] >> 5) & 1;
+            features.avx512f = os_avx512 && ((regs[1] >> 16) & 1);
+        }
+
+        return features;
+    }
+
+
+    /// Get instruction set extensions of the current CPU, detection is done once on the first call
+    inline const CpuFeatures &GetCpuFeatures() {
+        static const CpuFeatures features = DetectCpuFeatures();
+        return features;
+    }
+}
+
+#endif
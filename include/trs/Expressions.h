@@ -0,0 +1,281 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Expressions.h - Lazy elementwise expressions for VectorN and MatrixN
+/// author: Karl-Mihkel Ott
+
+#ifndef EXPRESSIONS_H
+#define EXPRESSIONS_H
+
+#include <cstddef>
+#include <type_traits>
+
+// Elementwise operators on VectorN and MatrixN return small expression nodes instead of containers.
+// A chain such as a + b * s - c is evaluated in one pass when it is assigned to or used to construct
+// a container, assigning into an existing container of the right shape allocates nothing.
+// Containers are referenced by the nodes, so an expression must not outlive its operands: keep results
+// in VectorN / MatrixN instead of auto when the operands are temporaries. Temporary VectorN / MatrixN
+// operands are the exception, operators taking them by rvalue write the result into their buffer and return it.
+
+namespace TRS {
+
+    /// Base of every vector expression, E is the deriving type
+    /// Expressions provide value_type, size() and Element(i).
+    template<typename E>
+    struct VectorExpression {
+        const E& Self() const { return static_cast<const E&>(*this); }
+    };
+
+
+    /// Base of every matrix expression, E is the deriving type
+    /// Expressions provide value_type, Rows(), Columns() and row-major Element(i).
+    template<typename E>
+    struct MatrixExpression {
+        const E& Self() const { return static_cast<const E&>(*this); }
+    };
+
+
+    /// Containers are held by reference in expression nodes, other nodes are held by value
+    template<typename E>
+    struct IsExpressionLeaf : std::false_type {};
+
+    template<typename E>
+    using ExpressionOperand = typename std::conditional<IsExpressionLeaf<E>::value, const E&, const E>::type;
+
+
+    // elementwise operations, like the eager operators before them they leave non-arithmetic values untouched
+    struct ExpressionAdd {
+        template<typename T>
+        static T Apply(const T& _a, const T& _b) {
+            if constexpr (std::is_arithmetic<T>::value)
+                return _a + _b;
+            else
+                return _a;
+        }
+    };
+
+    struct ExpressionSubtract {
+        template<typename T>
+        static T Apply(const T& _a, const T& _b) {
+            if constexpr (std::is_arithmetic<T>::value)
+                return _a - _b;
+            else
+                return _a;
+        }
+    };
+
+    struct ExpressionMultiply {
+        template<typename T>
+        static T Apply(const T& _a, const T& _b) {
+            if constexpr (std::is_arithmetic<T>::value)
+                return _a * _b;
+            else
+                return _a;
+        }
+    };
+
+    struct ExpressionDivide {
+        template<typename T>
+        static T Apply(const T& _a, const T& _b) {
+            if constexpr (std::is_arithmetic<T>::value)
+                return _a / _b;
+            else
+                return _a;
+        }
+    };
+
+    struct ExpressionNegate {
+        template<typename T>
+        static T Apply(const T& _a) {
+            if constexpr (std::is_arithmetic<T>::value)
+                return -_a;
+            else
+                return _a;
+        }
+    };
+
+
+    /// Elementwise operation on two vectors, vectors of different length give an empty result
+    template<typename L, typename R, typename Op>
+    class VectorBinaryExpression : public VectorExpression<VectorBinaryExpression<L, R, Op>> {
+        static_assert(std::is_same<typename L::value_type, typename R::value_type>::value, "Vector expression operands must have the same element type");
+
+        private:
+            ExpressionOperand<L> m_l;
+            ExpressionOperand<R> m_r;
+
+        public:
+            typedef typename L::value_type value_type;
+
+            VectorBinaryExpression(const L& _l, const R& _r) : m_l(_l), m_r(_r) {}
+
+            size_t size() const { return m_l.size() == m_r.size() ? m_l.size() : 0; }
+            value_type Element(size_t i) const { return Op::Apply(m_l.Element(i), m_r.Element(i)); }
+            value_type operator[](size_t i) const { return Element(i); }
+    };
+
+
+    /// Elementwise operation between a vector and a scalar
+    template<typename E, typename Op>
+    class VectorScalarExpression : public VectorExpression<VectorScalarExpression<E, Op>> {
+        public:
+            typedef typename E::value_type value_type;
+
+        private:
+            ExpressionOperand<E> m_e;
+            value_type m_s;
+
+        public:
+            VectorScalarExpression(const E& _e, const value_type& _s) : m_e(_e), m_s(_s) {}
+
+            size_t size() const { return m_e.size(); }
+            value_type Element(size_t i) const { return Op::Apply(m_e.Element(i), m_s); }
+            value_type operator[](size_t i) const { return Element(i); }
+    };
+
+
+    /// Elementwise sign change of a vector
+    template<typename E>
+    class VectorNegateExpression : public VectorExpression<VectorNegateExpression<E>> {
+        private:
+            ExpressionOperand<E> m_e;
+
+        public:
+            typedef typename E::value_type value_type;
+
+            explicit VectorNegateExpression(const E& _e) : m_e(_e) {}
+
+            size_t size() const { return m_e.size(); }
+            value_type Element(size_t i) const { return ExpressionNegate::Apply(m_e.Element(i)); }
+            value_type operator[](size_t i) const { return Element(i); }
+    };
+
+
+    /// Elementwise operation on two matrices, matrices of different shape give an empty result
+    template<typename L, typename R, typename Op>
+    class MatrixBinaryExpression : public MatrixExpression<MatrixBinaryExpression<L, R, Op>> {
+        static_assert(std::is_same<typename L::value_type, typename R::value_type>::value, "Matrix expression operands must have the same element type");
+
+        private:
+            ExpressionOperand<L> m_l;
+            ExpressionOperand<R> m_r;
+            bool m_conforms;
+
+        public:
+            typedef typename L::value_type value_type;
+
+            MatrixBinaryExpression(const L& _l, const R& _r) :
+                m_l(_l), m_r(_r), m_conforms(_l.Rows() == _r.Rows() && _l.Columns() == _r.Columns()) {}
+
+            size_t Rows() const { return m_conforms ? m_l.Rows() : 0; }
+            size_t Columns() const { return m_conforms ? m_l.Columns() : 0; }
+            value_type Element(size_t i) const { return Op::Apply(m_l.Element(i), m_r.Element(i)); }
+    };
+
+
+    /// Elementwise operation between a matrix and a scalar
+    template<typename E, typename Op>
+    class MatrixScalarExpression : public MatrixExpression<MatrixScalarExpression<E, Op>> {
+        public:
+            typedef typename E::value_type value_type;
+
+        private:
+            ExpressionOperand<E> m_e;
+            value_type m_s;
+
+        public:
+            MatrixScalarExpression(const E& _e, const value_type& _s) : m_e(_e), m_s(_s) {}
+
+            size_t Rows() const { return m_e.Rows(); }
+            size_t Columns() const { return m_e.Columns(); }
+            value_type Element(size_t i) const { return Op::Apply(m_e.Element(i), m_s); }
+    };
+
+
+    /// Elementwise sign change of a matrix
+    template<typename E>
+    class MatrixNegateExpression : public MatrixExpression<MatrixNegateExpression<E>> {
+        private:
+            ExpressionOperand<E> m_e;
+
+        public:
+            typedef typename E::value_type value_type;
+
+            explicit MatrixNegateExpression(const E& _e) : m_e(_e) {}
+
+            size_t Rows() const { return m_e.Rows(); }
+            size_t Columns() const { return m_e.Columns(); }
+            value_type Element(size_t i) const { return ExpressionNegate::Apply(m_e.Element(i)); }
+    };
+
+
+    template<typename L, typename R>
+    inline VectorBinaryExpression<L, R, ExpressionAdd> operator+(const VectorExpression<L>& _l, const VectorExpression<R>& _r) {
+        return VectorBinaryExpression<L, R, ExpressionAdd>(_l.Self(), _r.Self());
+    }
+
+    template<typename L, typename R>
+    inline VectorBinaryExpression<L, R, ExpressionSubtract> operator-(const VectorExpression<L>& _l, const VectorExpression<R>& _r) {
+        return VectorBinaryExpression<L, R, ExpressionSubtract>(_l.Self(), _r.Self());
+    }
+
+    template<typename E>
+    inline VectorScalarExpression<E, ExpressionMultiply> operator*(const VectorExpression<E>& _e, const typename E::value_type& _s) {
+        return VectorScalarExpression<E, ExpressionMultiply>(_e.Self(), _s);
+    }
+
+    template<typename E>
+    inline VectorScalarExpression<E, ExpressionDivide> operator/(const VectorExpression<E>& _e, const typename E::value_type& _s) {
+        return VectorScalarExpression<E, ExpressionDivide>(_e.Self(), _s);
+    }
+
+    template<typename E>
+    inline VectorNegateExpression<E> operator-(const VectorExpression<E>& _e) {
+        return VectorNegateExpression<E>(_e.Self());
+    }
+
+    /// Dot product, vectors of different length give 0
+    template<typename L, typename R>
+    inline typename L::value_type operator*(const VectorExpression<L>& _l, const VectorExpression<R>& _r) {
+        typedef typename L::value_type T;
+        const L& l = _l.Self();
+        const R& r = _r.Self();
+
+        T dot = T();
+        if constexpr (std::is_arithmetic<T>::value) {
+            if(l.size() == r.size()) {
+                for(size_t i = 0; i < l.size(); i++)
+                    dot += l.Element(i) * r.Element(i);
+            }
+        }
+
+        return dot;
+    }
+
+
+    template<typename L, typename R>
+    inline MatrixBinaryExpression<L, R, ExpressionAdd> operator+(const MatrixExpression<L>& _l, const MatrixExpression<R>& _r) {
+        return MatrixBinaryExpression<L, R, ExpressionAdd>(_l.Self(), _r.Self());
+    }
+
+    template<typename L, typename R>
+    inline MatrixBinaryExpression<L, R, ExpressionSubtract> operator-(const MatrixExpression<L>& _l, const MatrixExpression<R>& _r) {
+        return MatrixBinaryExpression<L, R, ExpressionSubtract>(_l.Self(), _r.Self());
+    }
+
+    template<typename E>
+    inline MatrixScalarExpression<E, ExpressionMultiply> operator*(const MatrixExpression<E>& _e, const typename E::value_type& _s) {
+        return MatrixScalarExpression<E, ExpressionMultiply>(_e.Self(), _s);
+    }
+
+    template<typename E>
+    inline MatrixScalarExpression<E, ExpressionDivide> operator/(const MatrixExpression<E>& _e, const typename E::value_type& _s) {
+        return MatrixScalarExpression<E, ExpressionDivide>(_e.Self(), _s);
+    }
+
+    template<typename E>
+    inline MatrixNegateExpression<E> operator-(const MatrixExpression<E>& _e) {
+        return MatrixNegateExpression<E>(_e.Self());
+    }
+}
+
+#endif
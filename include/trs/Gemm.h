@@ -0,0 +1,373 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Gemm.h - Cache blocked general matrix multiplication for row-major storage
+/// author: Karl-Mihkel Ott
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Simd.h>
+#include <trs/CpuFeatures.h>
+#include <trs/ThreadPool.h>
+#include <trs/MemoryResource.h>
+
+// C = alpha * op(A) * op(B) + beta * C is computed in the usual three level blocking scheme:
+// NC columns of op(B) and KC rows of it are packed into NR wide panels that stay in L3 / L2 cache,
+// MC rows of op(A) are packed into MR tall panels that stay in L2 / L1 cache, and the micro kernel
+// keeps an MR x NR block of C in registers while streaming through both panels.
+
+namespace TRS {
+
+    /// Block sizes for GEMM, mr x nr is the register tile of the micro kernel
+    template<typename T>
+    struct GemmBlocking {
+        static constexpr size_t mr = 4;
+        static constexpr size_t nr = 4;
+        static constexpr size_t mc = 128;
+        static constexpr size_t kc = 256;
+        static constexpr size_t nc = 1024;
+    };
+
+    // 6 x 16 floats and 6 x 8 doubles take 12 of 16 ymm registers as accumulators
+    template<>
+    struct GemmBlocking<float> {
+        static constexpr size_t mr = 6;
+        static constexpr size_t nr = 16;
+        static constexpr size_t mc = 144;
+        static constexpr size_t kc = 256;
+        static constexpr size_t nc = 2048;
+    };
+
+    template<>
+    struct GemmBlocking<double> {
+        static constexpr size_t mr = 6;
+        static constexpr size_t nr = 8;
+        static constexpr size_t mc = 96;
+        static constexpr size_t kc = 256;
+        static constexpr size_t nc = 1024;
+    };
+
+
+    /// Micro kernel signature, computes _c += _alpha * A * B for packed mr x _kc and _kc x nr panels
+    template<typename T>
+    using GemmKernel = void(*)(size_t _kc, const T *_a, const T *_b, T *_c, size_t _ldc, T _alpha);
+
+
+    /// Portable micro kernel
+    template<typename T>
+    inline void GemmMicroKernel(size_t _kc, const T *_a, const T *_b, T *_c, size_t _ldc, T _alpha) {
+        constexpr size_t mr = GemmBlocking<T>::mr;
+        constexpr size_t nr = GemmBlocking<T>::nr;
+        T acc[mr * nr] = {};
+
+        for(size_t k = 0; k < _kc; k++, _a += mr, _b += nr) {
+            for(size_t i = 0; i < mr; i++) {
+                for(size_t j = 0; j < nr; j++)
+                    acc[i * nr + j] += _a[i] * _b[j];
+            }
+        }
+
+        for(size_t i = 0; i < mr; i++) {
+            for(size_t j = 0; j < nr; j++)
+                _c[i * _ldc + j] += _alpha * acc[i * nr + j];
+        }
+    }
+
+
+    /// AVX2 and FMA 6 x 16 float micro kernel
+    TRS_TARGET_AVX2 inline void FastGemmKernel(size_t _kc, const float *_a, const float *_b, float *_c, size_t _ldc, float _alpha) {
+        __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+        __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+        __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+        __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+        __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+        __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+        for(size_t k = 0; k < _kc; k++, _a += 6, _b += 16) {
+            const __m256 b0 = _mm256_loadu_ps(_b);
+            const __m256 b1 = _mm256_loadu_ps(_b + 8);
+            __m256 a = _mm256_broadcast_ss(_a);
+            c00 = _mm256_fmadd_ps(a, b0, c00);
+            c01 = _mm256_fmadd_ps(a, b1, c01);
+            a = _mm256_broadcast_ss(_a + 1);
+            c10 = _mm256_fmadd_ps(a, b0, c10);
+            c11 = _mm256_fmadd_ps(a, b1, c11);
+            a = _mm256_broadcast_ss(_a + 2);
+            c20 = _mm256_fmadd_ps(a, b0, c20);
+            c21 = _mm256_fmadd_ps(a, b1, c21);
+            a = _mm256_broadcast_ss(_a + 3);
+            c30 = _mm256_fmadd_ps(a, b0, c30);
+            c31 = _mm256_fmadd_ps(a, b1, c31);
+            a = _mm256_broadcast_ss(_a + 4);
+            c40 = _mm256_fmadd_ps(a, b0, c40);
+            c41 = _mm256_fmadd_ps(a, b1, c41);
+            a = _mm256_broadcast_ss(_a + 5);
+            c50 = _mm256_fmadd_ps(a, b0, c50);
+            c51 = _mm256_fmadd_ps(a, b1, c51);
+        }
+
+        const __m256 alpha = _mm256_set1_ps(_alpha);
+        const __m256 acc[12] = { c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51 };
+        for(size_t i = 0; i < 6; i++) {
+            float *c = _c + i * _ldc;
+            _mm256_storeu_ps(c, _mm256_fmadd_ps(alpha, acc[2 * i], _mm256_loadu_ps(c)));
+            _mm256_storeu_ps(c + 8, _mm256_fmadd_ps(alpha, acc[2 * i + 1], _mm256_loadu_ps(c + 8)));
+        }
+    }
+
+
+    /// AVX2 and FMA 6 x 8 double micro kernel
+    TRS_TARGET_AVX2 inline void FastGemmKernel(size_t _kc, const double *_a, const double *_b, double *_c, size_t _ldc, double _alpha) {
+        __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+        __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+        __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+        __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+        __m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+        __m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+
+        for(size_t k = 0; k < _kc; k++, _a += 6, _b += 8) {
+            const __m256d b0 = _mm256_loadu_pd(_b);
+            const __m256d b1 = _mm256_loadu_pd(_b + 4);
+            __m256d a = _mm256_broadcast_sd(_a);
+            c00 = _mm256_fmadd_pd(a, b0, c00);
+            c01 = _mm256_fmadd_pd(a, b1, c01);
+            a = _mm256_broadcast_sd(_a + 1);
+            c10 = _mm256_fmadd_pd(a, b0, c10);
+            c11 = _mm256_fmadd_pd(a, b1, c11);
+            a = _mm256_broadcast_sd(_a + 2);
+            c20 = _mm256_fmadd_pd(a, b0, c20);
+            c21 = _mm256_fmadd_pd(a, b1, c21);
+            a = _mm256_broadcast_sd(_a + 3);
+            c30 = _mm256_fmadd_pd(a, b0, c30);
+            c31 = _mm256_fmadd_pd(a, b1, c31);
+            a = _mm256_broadcast_sd(_a + 4);
+            c40 = _mm256_fmadd_pd(a, b0, c40);
+            c41 = _mm256_fmadd_pd(a, b1, c41);
+            a = _mm256_broadcast_sd(_a + 5);
+            c50 = _mm256_fmadd_pd(a, b0, c50);
+            c51 = _mm256_fmadd_pd(a, b1, c51);
+        }
+
+        const __m256d alpha = _mm256_set1_pd(_alpha);
+        const __m256d acc[12] = { c00, c01, c10, c11, c20, c21, c30, c31, c40, c41, c50, c51 };
+        for(size_t i = 0; i < 6; i++) {
+            double *c = _c + i * _ldc;
+            _mm256_storeu_pd(c, _mm256_fmadd_pd(alpha, acc[2 * i], _mm256_loadu_pd(c)));
+            _mm256_storeu_pd(c + 4, _mm256_fmadd_pd(alpha, acc[2 * i + 1], _mm256_loadu_pd(c + 4)));
+        }
+    }
+
+
+    /// Pick the fastest micro kernel supported by the running CPU
+    template<typename T>
+    inline GemmKernel<T> SelectGemmKernel() {
+        if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value) {
+            const CpuFeatures &cpu = GetCpuFeatures();
+            if(cpu.avx2 && cpu.fma)
+                return static_cast<GemmKernel<T>>(&FastGemmKernel);
+        }
+
+        return &GemmMicroKernel<T>;
+    }
+
+
+    /// Pack _mc x _kc block of op(A) into mr tall panels, rows past _mc are zero padded
+    template<typename T>
+    inline void PackGemmA(bool _trans, const T *_a, size_t _lda, size_t _mc, size_t _kc, T *_out) {
+        constexpr size_t mr = GemmBlocking<T>::mr;
+        for(size_t p = 0; p < _mc; p += mr) {
+            const size_t rows = std::min(mr, _mc - p);
+            for(size_t k = 0; k < _kc; k++, _out += mr) {
+                for(size_t i = 0; i < rows; i++)
+                    _out[i] = _trans ? _a[k * _lda + p + i] : _a[(p + i) * _lda + k];
+                for(size_t i = rows; i < mr; i++)
+                    _out[i] = T();
+            }
+        }
+    }
+
+
+    /// Pack _kc x _nc block of op(B) into nr wide panels, columns past _nc are zero padded
+    template<typename T>
+    inline void PackGemmB(bool _trans, const T *_b, size_t _ldb, size_t _kc, size_t _nc, T *_out) {
+        constexpr size_t nr = GemmBlocking<T>::nr;
+        for(size_t p = 0; p < _nc; p += nr) {
+            const size_t cols = std::min(nr, _nc - p);
+            for(size_t k = 0; k < _kc; k++, _out += nr) {
+                if(!_trans && cols == nr)
+                    std::copy(_b + k * _ldb + p, _b + k * _ldb + p + nr, _out);
+                else {
+                    for(size_t j = 0; j < cols; j++)
+                        _out[j] = _trans ? _b[(p + j) * _ldb + k] : _b[k * _ldb + p + j];
+                    for(size_t j = cols; j < nr; j++)
+                        _out[j] = T();
+                }
+            }
+        }
+    }
+
+
+    /// Scale _m x _n block of C with _beta, beta = 0 overwrites C so that NaNs in it are not propagated
+    template<typename T>
+    inline void ScaleGemmC(size_t _m, size_t _n, T _beta, T *_c, size_t _ldc) {
+        if(_beta == static_cast<T>(1))
+            return;
+
+        for(size_t i = 0; i < _m; i++) {
+            T *c = _c + i * _ldc;
+            if(_beta == T())
+                std::fill(c, c + _n, T());
+            else {
+                for(size_t j = 0; j < _n; j++)
+                    c[j] *= _beta;
+            }
+        }
+    }
+
+
+    /// Multiply packed _mc x _kc A block with packed _kc x _nc B block into C
+    template<typename T>
+    inline void GemmMacroKernel(GemmKernel<T> _kernel, size_t _mc, size_t _nc, size_t _kc, T _alpha, const T *_pack_a, const T *_pack_b, T *_c, size_t _ldc) {
+        constexpr size_t mr = GemmBlocking<T>::mr;
+        constexpr size_t nr = GemmBlocking<T>::nr;
+
+        for(size_t jr = 0; jr < _nc; jr += nr) {
+            const size_t cols = std::min(nr, _nc - jr);
+            for(size_t ir = 0; ir < _mc; ir += mr) {
+                const size_t rows = std::min(mr, _mc - ir);
+                T *c = _c + ir * _ldc + jr;
+
+                if(rows == mr && cols == nr)
+                    _kernel(_kc, _pack_a + ir * _kc, _pack_b + jr * _kc, c, _ldc, _alpha);
+                else {
+                    // edge tile goes through a full size scratch tile
+                    T tile[mr * nr] = {};
+                    _kernel(_kc, _pack_a + ir * _kc, _pack_b + jr * _kc, tile, nr, _alpha);
+                    for(size_t i = 0; i < rows; i++) {
+                        for(size_t j = 0; j < cols; j++)
+                            c[i * _ldc + j] += tile[i * nr + j];
+                    }
+                }
+            }
+        }
+    }
+
+
+    /// Packing buffer lengths needed by a _m x _n x _k product
+    template<typename T>
+    inline void GemmPackSizes(size_t _m, size_t _n, size_t _k, size_t &_a_size, size_t &_b_size) {
+        typedef GemmBlocking<T> Blocking;
+        const size_t kc_max = std::min(Blocking::kc, _k);
+        const size_t mc_max = (std::min(Blocking::mc, _m) + Blocking::mr - 1) / Blocking::mr * Blocking::mr;
+        const size_t nc_max = (std::min(Blocking::nc, _n) + Blocking::nr - 1) / Blocking::nr * Blocking::nr;
+        _a_size = mc_max * kc_max;
+        _b_size = kc_max * nc_max;
+    }
+
+
+    /// Single threaded GEMM packing into caller provided buffers of at least GemmPackSizes() elements
+    template<typename T>
+    void GemmSerialPacked(bool _trans_a, bool _trans_b, size_t _m, size_t _n, size_t _k, T _alpha, const T *_a, size_t _lda,
+                          const T *_b, size_t _ldb, T _beta, T *_c, size_t _ldc, T *_pack_a, T *_pack_b)
+    {
+        typedef GemmBlocking<T> Blocking;
+        ScaleGemmC(_m, _n, _beta, _c, _ldc);
+        if(_m == 0 || _n == 0 || _k == 0 || _alpha == T())
+            return;
+
+        const GemmKernel<T> kernel = SelectGemmKernel<T>();
+        for(size_t jc = 0; jc < _n; jc += Blocking::nc) {
+            const size_t nc = std::min(Blocking::nc, _n - jc);
+            for(size_t pc = 0; pc < _k; pc += Blocking::kc) {
+                const size_t kc = std::min(Blocking::kc, _k - pc);
+                const T *b = _trans_b ? _b + jc * _ldb + pc : _b + pc * _ldb + jc;
+                PackGemmB(_trans_b, b, _ldb, kc, nc, _pack_b);
+
+                for(size_t ic = 0; ic < _m; ic += Blocking::mc) {
+                    const size_t mc = std::min(Blocking::mc, _m - ic);
+                    const T *a = _trans_a ? _a + pc * _lda + ic : _a + ic * _lda + pc;
+                    PackGemmA(_trans_a, a, _lda, mc, kc, _pack_a);
+                    GemmMacroKernel(kernel, mc, nc, kc, _alpha, _pack_a, _pack_b, _c + ic * _ldc + jc, _ldc);
+                }
+            }
+        }
+    }
+
+
+    /// Single threaded GEMM, see Gemm() for the argument description
+    /// The packing buffers come from the current memory resource and are given back before returning.
+    template<typename T>
+    void GemmSerial(bool _trans_a, bool _trans_b, size_t _m, size_t _n, size_t _k, T _alpha, const T *_a, size_t _lda,
+              const T *_b, size_t _ldb, T _beta, T *_c, size_t _ldc)
+    {
+        size_t a_size, b_size;
+        GemmPackSizes<T>(_m, _n, _k, a_size, b_size);
+        Allocator<T> allocator;
+        T *packs = allocator.allocate(a_size + b_size);
+        GemmSerialPacked(_trans_a, _trans_b, _m, _n, _k, _alpha, _a, _lda, _b, _ldb, _beta, _c, _ldc, packs, packs + a_size);
+        allocator.deallocate(packs, a_size + b_size);
+    }
+
+
+    /// General matrix multiplication C = _alpha * op(A) * op(B) + _beta * C on row-major storage
+    /// op(A) is _m x _k and op(B) is _k x _n, op transposes its argument when the corresponding flag is set.
+    /// _lda, _ldb and _ldc are row strides of the stored matrices. C must not alias A or B.
+    /// Products of at least the pool's GEMM threshold are split into 2D tiles of C that run on the shared
+    /// thread pool, every thread packs its own panels so the threads share nothing but read-only A and B.
+    /// The packing buffers of serial and threaded products come from the current memory resource.
+    template<typename T>
+    void Gemm(bool _trans_a, bool _trans_b, size_t _m, size_t _n, size_t _k, T _alpha, const T *_a, size_t _lda,
+              const T *_b, size_t _ldb, T _beta, T *_c, size_t _ldc)
+    {
+        typedef GemmBlocking<T> Blocking;
+        // an empty C has nothing to tile, a threshold of 0 would otherwise reach the tiling below
+        if(_m == 0 || _n == 0)
+            return;
+
+        ThreadPool &pool = GetThreadPool();
+        const size_t threads = pool.GetThreadCount();
+        if(threads == 1 || _m * _n * _k < pool.GetGemmThreshold()) {
+            GemmSerial(_trans_a, _trans_b, _m, _n, _k, _alpha, _a, _lda, _b, _ldb, _beta, _c, _ldc);
+            return;
+        }
+
+        // aim for a few tiles per thread, split rows first since every column tile repacks A
+        const size_t row_panels = (_m + Blocking::mr - 1) / Blocking::mr;
+        const size_t col_panels = (_n + Blocking::nr - 1) / Blocking::nr;
+        const size_t target = 4 * threads;
+        const size_t row_tiles = std::max<size_t>(std::min(row_panels, target), 1);
+        const size_t col_tiles = std::max<size_t>(std::min(col_panels, (target + row_tiles - 1) / row_tiles), 1);
+        const size_t tile_m = (row_panels + row_tiles - 1) / row_tiles * Blocking::mr;
+        const size_t tile_n = (col_panels + col_tiles - 1) / col_tiles * Blocking::nr;
+        const size_t tiles_y = (_m + tile_m - 1) / tile_m;
+        const size_t tiles_x = (_n + tile_n - 1) / tile_n;
+
+        // one chunk per thread, each with its own packing buffers, takes tiles until none are left
+        size_t a_size, b_size;
+        GemmPackSizes<T>(tile_m, tile_n, _k, a_size, b_size);
+        Allocator<T> allocator;
+        T *packs = allocator.allocate(threads * (a_size + b_size));
+        std::atomic<size_t> next_tile(0);
+
+        pool.ParallelFor(0, threads, 1, [&](size_t _first, size_t) {
+            T *pack_a = packs + _first * (a_size + b_size);
+            T *pack_b = pack_a + a_size;
+            for(size_t t = next_tile++; t < tiles_y * tiles_x; t = next_tile++) {
+                const size_t i = t / tiles_x * tile_m;
+                const size_t j = t % tiles_x * tile_n;
+                const T *a = _trans_a ? _a + i : _a + i * _lda;
+                const T *b = _trans_b ? _b + j * _ldb : _b + j;
+                GemmSerialPacked(_trans_a, _trans_b, std::min(tile_m, _m - i), std::min(tile_n, _n - j), _k, _alpha,
+                                 a, _lda, b, _ldb, _beta, _c + i * _ldc + j, _ldc, pack_a, pack_b);
+            }
+        });
+
+        allocator.deallocate(packs, threads * (a_size + b_size));
+    }
+}
+
+#endif
@@ -0,0 +1,280 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: IncrementalInverse.h - Inverse and determinant of a MatrixN kept up to date under low rank updates
+/// author: Karl-Mihkel Ott
+
+#ifndef INCREMENTAL_INVERSE_H
+#define INCREMENTAL_INVERSE_H
+
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Gemm.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+#include <trs/LU.h>
+
+// A rank k update A + U * V^T changes the inverse and the determinant by the Woodbury identity and the matrix
+// determinant lemma, where C = I + V^T * inv(A) * U is the k x k capacitance matrix:
+//   inv(A + U * V^T) = inv(A) - inv(A) * U * inv(C) * V^T * inv(A)
+//   det(A + U * V^T) = det(A) * det(C)
+// Both cost O(k * n^2) through GEMM instead of the O(n^3) of a new factorization, k = 1 is Sherman-Morrison.
+// Rounding errors of the updates add up, so the residual of a probe solve is checked every few updates and the
+// inverse is recomputed from the tracked matrix once it drifts past the tolerance.
+
+namespace TRS {
+
+    /**
+     * Square matrix together with its inverse and determinant, updated in O(k * n^2) per rank k change
+     * The matrix itself is tracked as well, it is the source of every refactorization. Updates that make the
+     * capacitance matrix nearly singular refactor right away instead of amplifying rounding errors.
+     * While the matrix is singular no inverse exists to update, so every update refactors in O(n^3).
+     */
+    template<typename T>
+    class IncrementalInverse {
+        static_assert(std::is_floating_point<T>::value, "IncrementalInverse needs a floating point type");
+
+        private:
+            MatrixN<T> m_a;
+            MatrixN<T> m_inv;
+            T m_det = T();
+            bool m_singular = true;
+
+            size_t m_updates = 0;
+            size_t m_refactorizations = 0;
+            size_t m_check_interval = 8;
+            T m_tolerance = std::sqrt(std::numeric_limits<T>::epsilon());
+
+            // reused between updates of the same rank
+            MatrixN<T> m_w, m_z, m_c;
+
+            // 1 / |inv(C)|_1 from the factors of C, compared against 1 + |C - I|_1 to detect cancellation in C
+            bool IsWellConditioned(const LU<T>& _c) const {
+                const size_t k = _c.Size();
+                T norm = T();
+                T update_norm = T();
+                for(size_t j = 0; j < k; j++) {
+                    T sum = T(), update_sum = T();
+                    for(size_t i = 0; i < k; i++) {
+                        sum += std::abs(m_c[i][j]);
+                        update_sum += std::abs(m_c[i][j] - (i == j ? static_cast<T>(1) : T()));
+                    }
+                    norm = std::max(norm, sum);
+                    update_norm = std::max(update_norm, update_sum);
+                }
+
+                return !_c.IsSingular() && _c.ReciprocalCondition() * norm > m_tolerance * (static_cast<T>(1) + update_norm);
+            }
+
+            // count the update and refactor when the periodic drift check fails
+            bool FinishUpdate() {
+                m_updates++;
+                if(m_check_interval && m_updates % m_check_interval == 0 && Drift() > m_tolerance)
+                    return Refactor();
+
+                return true;
+            }
+
+        public:
+            IncrementalInverse() = default;
+
+            template<typename E>
+            explicit IncrementalInverse(const MatrixExpression<E>& _a) {
+                Compute(_a);
+            }
+
+            /// Take a copy of _a and compute its inverse and determinant, returns false when _a is singular or not square
+            /// A non-square _a is not kept, Size() is 0 afterwards and every update fails.
+            template<typename E>
+            bool Compute(const MatrixExpression<E>& _a) {
+                static_assert(std::is_same<typename E::value_type, T>::value, "IncrementalInverse input must have the element type of the inverse");
+                m_a = _a.Self();
+                m_updates = 0;
+                m_refactorizations = 0;
+                if(!m_a.IsSquare()) {
+                    // a non-square matrix has no inverse to update, Size() must not see its rows either
+                    m_a = MatrixN<T>();
+                    m_inv = MatrixN<T>();
+                    m_det = T();
+                    m_singular = true;
+                    return false;
+                }
+
+                return Refactor();
+            }
+
+            /// Recompute the inverse and the determinant of the tracked matrix with a pivoted LU factorization
+            bool Refactor() {
+                const LU<T> lu(m_a);
+                m_singular = lu.IsSingular();
+                m_det = lu.Determinant();
+                m_inv = lu.Inverse();
+                m_refactorizations++;
+                return !m_singular;
+            }
+
+            /// Check the inverse every _interval updates and refactor once Drift() exceeds _tolerance, 0 never checks
+            void SetDriftCheck(size_t _interval, T _tolerance) {
+                m_check_interval = _interval;
+                m_tolerance = _tolerance;
+            }
+
+            /// Backward error of a probe solve, |A * inv(A) * p - p| / (|A| * |inv(A) * p| + |p|) in the infinity norm
+            /// It is about n * epsilon right after a factorization and grows as updates add rounding errors, O(n^2).
+            T Drift() const {
+                const size_t n = Size();
+                if(m_singular || n == 0)
+                    return std::numeric_limits<T>::infinity();
+
+                // alternating signs of growing magnitude, so that the probe is not close to a special direction
+                VectorN<T> p(n);
+                for(size_t i = 0; i < n; i++) {
+                    const T magnitude = static_cast<T>(1) + static_cast<T>(i) / static_cast<T>(n);
+                    p[i] = i % 2 ? -magnitude : magnitude;
+                }
+
+                const VectorN<T> y = m_inv * p;
+                const VectorN<T> r = m_a * y;
+                T r_norm = T(), y_norm = T(), p_norm = T(), a_norm = T();
+                for(size_t i = 0; i < n; i++) {
+                    r_norm = std::max(r_norm, std::abs(r[i] - p[i]));
+                    y_norm = std::max(y_norm, std::abs(y[i]));
+                    p_norm = std::max(p_norm, std::abs(p[i]));
+
+                    T row_sum = T();
+                    for(size_t j = 0; j < n; j++)
+                        row_sum += std::abs(m_a[i][j]);
+                    a_norm = std::max(a_norm, row_sum);
+                }
+
+                const T drift = r_norm / (a_norm * y_norm + p_norm);
+                return std::isfinite(drift) ? drift : std::numeric_limits<T>::infinity();
+            }
+
+            /// A += u * v^T by the Sherman-Morrison formula, false when the updated matrix is singular
+            bool Update(const VectorN<T>& _u, const VectorN<T>& _v) {
+                const size_t n = Size();
+                if(_u.size() != n || _v.size() != n)
+                    return false;
+
+                for(size_t i = 0; i < n; i++) {
+                    T *row = m_a[i];
+                    const T u = _u[i];
+                    for(size_t j = 0; j < n; j++)
+                        row[j] += u * _v[j];
+                }
+
+                if(m_singular)
+                    return Refactor();
+
+                // w = inv(A) * u, z = v^T * inv(A), c = 1 + v^T * w
+                const VectorN<T> w = m_inv * _u;
+                const VectorN<T> z = _v * m_inv;
+                T vw = T();
+                for(size_t i = 0; i < n; i++)
+                    vw += _v[i] * w[i];
+
+                const T c = static_cast<T>(1) + vw;
+                if(!(std::abs(c) > m_tolerance * (static_cast<T>(1) + std::abs(vw))) || !std::isfinite(c))
+                    return Refactor();
+
+                const T inv_c = static_cast<T>(1) / c;
+                for(size_t i = 0; i < n; i++) {
+                    T *row = m_inv[i];
+                    const T s = w[i] * inv_c;
+                    for(size_t j = 0; j < n; j++)
+                        row[j] -= s * z[j];
+                }
+
+                m_det *= c;
+                return FinishUpdate();
+            }
+
+            /// A += U * V^T by the Woodbury formula, U and V are Size() x k, false when the updated matrix is singular
+            bool Update(const MatrixN<T>& _u, const MatrixN<T>& _v) {
+                const size_t n = Size();
+                const size_t k = _u.Columns();
+                if(_u.Rows() != n || _v.Rows() != n || _v.Columns() != k)
+                    return false;
+
+                Gemm(false, true, n, n, k, static_cast<T>(1), _u.Data(), k, _v.Data(), k, static_cast<T>(1), m_a.Data(), n);
+                if(m_singular)
+                    return Refactor();
+
+                // W = inv(A) * U, Z = V^T * inv(A), C = I + V^T * W
+                m_w.Resize(n, k);
+                m_z.Resize(k, n);
+                m_c = MatrixN<T>::MakeIdentity(k);
+                Gemm(false, false, n, k, n, static_cast<T>(1), m_inv.Data(), n, _u.Data(), k, T(), m_w.Data(), k);
+                Gemm(true, false, k, n, n, static_cast<T>(1), _v.Data(), k, m_inv.Data(), n, T(), m_z.Data(), n);
+                Gemm(true, false, k, k, n, static_cast<T>(1), _v.Data(), k, m_w.Data(), k, static_cast<T>(1), m_c.Data(), k);
+
+                const LU<T> c(m_c);
+                if(!IsWellConditioned(c))
+                    return Refactor();
+
+                // inv(A) -= W * inv(C) * Z
+                c.SolveInPlace(m_z.Data(), n, n);
+                Gemm(false, false, n, n, k, static_cast<T>(-1), m_w.Data(), k, m_z.Data(), n, static_cast<T>(1), m_inv.Data(), n);
+
+                m_det *= c.Determinant();
+                return FinishUpdate();
+            }
+
+            /// Replace row _row of A with _values, a rank one update with u = e_row
+            bool ReplaceRow(size_t _row, const VectorN<T>& _values) {
+                const size_t n = Size();
+                if(_row >= n || _values.size() != n)
+                    return false;
+
+                VectorN<T> u(n), v(_values);
+                u[_row] = static_cast<T>(1);
+                for(size_t j = 0; j < n; j++)
+                    v[j] -= m_a[_row][j];
+
+                return Update(u, v);
+            }
+
+            /// Replace column _col of A with _values, a rank one update with v = e_col
+            bool ReplaceColumn(size_t _col, const VectorN<T>& _values) {
+                const size_t n = Size();
+                if(_col >= n || _values.size() != n)
+                    return false;
+
+                VectorN<T> u(_values), v(n);
+                v[_col] = static_cast<T>(1);
+                for(size_t i = 0; i < n; i++)
+                    u[i] -= m_a[i][_col];
+
+                return Update(u, v);
+            }
+
+            bool IsSingular() const { return m_singular; }
+            size_t Size() const { return m_a.Rows(); }
+
+            /// Updates applied since Compute()
+            size_t UpdateCount() const { return m_updates; }
+            /// Full factorizations made since Compute(), including the one made by it
+            size_t RefactorizationCount() const { return m_refactorizations; }
+
+            /// The tracked matrix with every update applied
+            const MatrixN<T>& Matrix() const { return m_a; }
+
+            /// Inverse of the tracked matrix, empty when it is singular
+            const MatrixN<T>& Inverse() const { return m_inv; }
+
+            T Determinant() const { return m_det; }
+
+            /// Solve A * x = b by multiplying with the inverse, the result is empty when A is singular or b has the wrong size
+            VectorN<T> Solve(const VectorN<T>& _b) const {
+                if(m_singular || _b.size() != Size())
+                    return VectorN<T>();
+
+                return m_inv * _b;
+            }
+    };
+}
+
+#endif
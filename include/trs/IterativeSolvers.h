@@ -0,0 +1,516 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: IterativeSolvers.h - Conjugate gradient, BiCGSTAB and their preconditioners
+/// author: Karl-Mihkel Ott
+
+#ifndef ITERATIVE_SOLVERS_H
+#define ITERATIVE_SOLVERS_H
+
+#include <cassert>
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <trs/MemoryResource.h>
+#include <trs/ThreadPool.h>
+#include <trs/Triangular.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+#include <trs/SparseMatrixN.h>
+
+// The solvers only touch A through y = A * x, so A can be a MatrixN, a SparseMatrixN or any callable taking
+// (const VectorN<T>& x, VectorN<T>& y). One iteration costs one or two such products and a few vector passes,
+// which makes sparse solves scale with the number of non-zeros. The vector passes run on the shared thread pool,
+// dot products sum fixed 4096 element chunks in order so that their results do not depend on the thread count.
+
+namespace TRS {
+
+    /// Stopping rule of an iterative solve
+    template<typename T>
+    struct IterationControl {
+        /// Upper bound on the number of iterations
+        size_t max_iterations = 1000;
+        /// Stop once |b - A * x|_2 <= tolerance * |b|_2
+        T tolerance = std::sqrt(std::numeric_limits<T>::epsilon());
+    };
+
+
+    /// Outcome of an iterative solve
+    template<typename T>
+    struct IterationResult {
+        size_t iterations = 0;
+        /// |b - A * x|_2 / |b|_2 of the recursively updated residual
+        T relative_residual = std::numeric_limits<T>::infinity();
+        bool converged = false;
+    };
+
+
+    /// Sum of _f(first, last) over fixed chunks of [0, _count), chunk sums are added in chunk order
+    /// The chunks do not depend on the thread count or on how the pool splits the range, so neither does the sum.
+    template<typename T, typename F>
+    inline T ParallelSum(size_t _count, F &&_f) {
+        constexpr size_t chunk = 4096;
+        ThreadPool &pool = GetThreadPool();
+        const size_t chunks = (_count + chunk - 1) / chunk;
+        const size_t threads = pool.GetThreadCount();
+        const size_t grain = std::max(pool.GetElementwiseThreshold(), (_count + threads - 1) / threads);
+
+        Buffer<T> partials(chunks);
+
+        // the pool may run the whole range in one call, so every call sums all chunks it covers
+        T *out = partials.data();
+        pool.ParallelFor(0, _count, (grain + chunk - 1) / chunk * chunk, [&](size_t _first, size_t _last) {
+            for(size_t c = _first / chunk; c * chunk < _last; c++)
+                out[c] = _f(c * chunk, std::min(_last, c * chunk + chunk));
+        });
+
+        T sum = T();
+        for(size_t c = 0; c < chunks; c++)
+            sum += out[c];
+
+        return sum;
+    }
+
+
+    /// x^T * y over _n elements
+    template<typename T>
+    inline T Dot(size_t _n, const T *_x, const T *_y) {
+        return ParallelSum<T>(_n, [&](size_t _first, size_t _last) { return TriangularDot(_last - _first, _x + _first, _y + _first); });
+    }
+
+
+    /// y += _alpha * x over _n elements
+    template<typename T>
+    inline void Axpy(size_t _n, T _alpha, const T *_x, T *_y) {
+        ParallelElements(_n, [&](size_t _first, size_t _last) {
+            for(size_t i = _first; i < _last; i++)
+                _y[i] += _alpha * _x[i];
+        });
+    }
+
+
+    /// y = x + _beta * y over _n elements
+    template<typename T>
+    inline void Xpay(size_t _n, const T *_x, T _beta, T *_y) {
+        ParallelElements(_n, [&](size_t _first, size_t _last) {
+            for(size_t i = _first; i < _last; i++)
+                _y[i] = _x[i] + _beta * _y[i];
+        });
+    }
+
+
+    /// Dot product of two vectors of the same length
+    /// Different lengths are a caller error, they assert and only read the shared elements when asserts are off.
+    template<typename T>
+    inline T Dot(const VectorN<T>& _x, const VectorN<T>& _y) {
+        assert(_x.size() == _y.size());
+        return Dot(std::min(_x.size(), _y.size()), _x.data(), _y.data());
+    }
+
+
+    /// y += _alpha * x for two vectors of the same length, different lengths assert like Dot()
+    template<typename T>
+    inline void Axpy(T _alpha, const VectorN<T>& _x, VectorN<T>& _y) {
+        assert(_x.size() == _y.size());
+        Axpy(std::min(_x.size(), _y.size()), _alpha, _x.data(), _y.data());
+    }
+
+
+    /// y = A * x for a dense matrix, rows are split over the shared thread pool
+    template<typename T>
+    inline void ApplyOperator(const MatrixN<T>& _a, const VectorN<T>& _x, VectorN<T>& _y) {
+        const size_t n = _a.Columns();
+        ParallelRows(0, _a.Rows(), n, [&](size_t _first, size_t _last) {
+            for(size_t i = _first; i < _last; i++)
+                _y[i] = TriangularDot(n, _a[i], _x.data());
+        });
+    }
+
+    template<typename T>
+    inline void ApplyOperator(const SparseMatrixN<T>& _a, const VectorN<T>& _x, VectorN<T>& _y) {
+        _a.Multiply(_x.data(), _y.data());
+    }
+
+    /// y = A * x for a user operator, _y already holds as many elements as _x
+    template<typename F, typename T>
+    inline void ApplyOperator(const F& _a, const VectorN<T>& _x, VectorN<T>& _y) {
+        _a(_x, _y);
+    }
+
+
+    /// Whether the operator maps vectors of length _n to vectors of length _n, user operators are trusted
+    template<typename T>
+    inline bool IsOperatorOfSize(const MatrixN<T>& _a, size_t _n) { return _a.Rows() == _n && _a.Columns() == _n; }
+
+    template<typename T>
+    inline bool IsOperatorOfSize(const SparseMatrixN<T>& _a, size_t _n) { return _a.Rows() == _n && _a.Columns() == _n; }
+
+    template<typename F>
+    inline bool IsOperatorOfSize(const F&, size_t) { return true; }
+
+
+    /// M = I, it turns the preconditioned solvers into the plain ones
+    template<typename T>
+    class IdentityPreconditioner {
+        public:
+            void Apply(const VectorN<T>& _r, VectorN<T>& _z) const {
+                std::copy(_r.begin(), _r.end(), _z.begin());
+            }
+    };
+
+
+    /// M = diag(A), cheap and effective for diagonally dominant matrices
+    /// Zero diagonal elements are left unscaled.
+    template<typename T>
+    class JacobiPreconditioner {
+        private:
+            VectorN<T> m_inv_diagonal;
+
+            void SetDiagonal(size_t _i, T _d) {
+                m_inv_diagonal[_i] = _d != T() ? static_cast<T>(1) / _d : static_cast<T>(1);
+            }
+
+        public:
+            JacobiPreconditioner() = default;
+
+            explicit JacobiPreconditioner(const MatrixN<T>& _a) {
+                Compute(_a);
+            }
+
+            explicit JacobiPreconditioner(const SparseMatrixN<T>& _a) {
+                Compute(_a);
+            }
+
+            void Compute(const MatrixN<T>& _a) {
+                const size_t n = std::min(_a.Rows(), _a.Columns());
+                m_inv_diagonal.resize(n);
+                for(size_t i = 0; i < n; i++)
+                    SetDiagonal(i, _a[i][i]);
+            }
+
+            void Compute(const SparseMatrixN<T>& _a) {
+                const size_t n = std::min(_a.Rows(), _a.Columns());
+                m_inv_diagonal.resize(n);
+                for(size_t i = 0; i < n; i++)
+                    SetDiagonal(i, _a.Coefficient(i, i));
+            }
+
+            void Apply(const VectorN<T>& _r, VectorN<T>& _z) const {
+                const T *d = m_inv_diagonal.data();
+                const T *r = _r.data();
+                T *z = _z.data();
+                ParallelElements(m_inv_diagonal.size(), [&](size_t _first, size_t _last) {
+                    for(size_t i = _first; i < _last; i++)
+                        z[i] = d[i] * r[i];
+                });
+            }
+    };
+
+
+    /**
+     * Zero fill incomplete Cholesky factorization, A ~ L * L^T where L keeps the pattern of the lower triangle of A
+     * Only the lower triangle of A is read. IC(0) can break down on SPD matrices that are not M-matrices, the
+     * factorization is then retried on A + shift * diag(A) with a growing shift, see Manteuffel (1980).
+     * Applying it costs two sparse triangular solves, about 2 * NonZeros() multiply adds.
+     */
+    template<typename T>
+    class IncompleteCholesky {
+        static_assert(std::is_floating_point<T>::value, "IncompleteCholesky needs a floating point type");
+
+        private:
+            // diagonal last in every row of L and first in every row of L^T
+            SparseMatrixN<T> m_l;
+            SparseMatrixN<T> m_lt;
+            T m_shift = T();
+            bool m_valid = false;
+
+            // factor the lower triangle pattern in _l in place, false when a pivot is not positive
+            static bool FactorPattern(std::vector<T>& _values, const std::vector<T>& _lower, const std::vector<size_t>& _row_ptr,
+                                      const std::vector<size_t>& _cols, T _shift) {
+                const size_t n = _row_ptr.size() - 1;
+                for(size_t i = 0; i < n; i++) {
+                    const size_t begin = _row_ptr[i];
+                    const size_t end = _row_ptr[i + 1];
+                    if(begin == end || _cols[end - 1] != i)
+                        return false;
+
+                    for(size_t p = begin; p < end; p++) {
+                        const size_t k = _cols[p];
+
+                        // sum of L_ij * L_kj over the columns j < k both rows keep
+                        T dot = T();
+                        size_t a = begin, b = _row_ptr[k];
+                        const size_t b_end = _row_ptr[k + 1] - 1;
+                        while(a < p && b < b_end) {
+                            if(_cols[a] < _cols[b])
+                                a++;
+                            else if(_cols[b] < _cols[a])
+                                b++;
+                            else
+                                dot += _values[a++] * _values[b++];
+                        }
+
+                        if(k < i)
+                            _values[p] = (_lower[p] - dot) / _values[_row_ptr[k + 1] - 1];
+                        else {
+                            const T d = _lower[p] * (static_cast<T>(1) + _shift) - dot;
+                            if(!(d > T()) || !std::isfinite(d))
+                                return false;
+                            _values[p] = std::sqrt(d);
+                        }
+                    }
+                }
+
+                return true;
+            }
+
+        public:
+            IncompleteCholesky() = default;
+
+            explicit IncompleteCholesky(const SparseMatrixN<T>& _a) {
+                Compute(_a);
+            }
+
+            /// Factor the lower triangle of _a, false when it is not square or no tried shift gives positive pivots
+            bool Compute(const SparseMatrixN<T>& _a) {
+                m_valid = false;
+                m_shift = T();
+                if(_a.Rows() != _a.Columns())
+                    return false;
+
+                const size_t n = _a.Rows();
+                const std::vector<size_t>& row_ptr = _a.RowPointers();
+                const std::vector<size_t>& cols = _a.ColumnIndices();
+                const std::vector<T>& values = _a.Values();
+
+                std::vector<size_t> l_row_ptr(1, 0), l_cols;
+                std::vector<T> lower;
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t k = row_ptr[i]; k < row_ptr[i + 1] && cols[k] <= i; k++) {
+                        l_cols.push_back(cols[k]);
+                        lower.push_back(values[k]);
+                    }
+                    l_row_ptr.push_back(lower.size());
+                }
+
+                std::vector<T> l_values(lower.size());
+                T shift = T();
+                for(size_t attempt = 0; attempt < 16; attempt++) {
+                    if(FactorPattern(l_values, lower, l_row_ptr, l_cols, shift)) {
+                        m_l = SparseMatrixN<T>(n, n, std::move(l_row_ptr), std::move(l_cols), std::move(l_values));
+                        m_lt = m_l.Transpose();
+                        m_shift = shift;
+                        m_valid = true;
+                        return true;
+                    }
+
+                    shift = shift == T() ? static_cast<T>(1e-3) : static_cast<T>(2) * shift;
+                }
+
+                return false;
+            }
+
+            bool IsValid() const { return m_valid; }
+
+            /// Relative diagonal shift the factorization needed, 0 when plain IC(0) succeeded
+            T Shift() const { return m_shift; }
+
+            const SparseMatrixN<T>& Factor() const { return m_l; }
+
+            /// z = inv(L * L^T) * r, a copy of r when the factorization failed
+            void Apply(const VectorN<T>& _r, VectorN<T>& _z) const {
+                if(!m_valid) {
+                    std::copy(_r.begin(), _r.end(), _z.begin());
+                    return;
+                }
+
+                const size_t n = m_l.Rows();
+                const size_t *row_ptr = m_l.RowPointers().data();
+                const size_t *cols = m_l.ColumnIndices().data();
+                const T *values = m_l.Values().data();
+                T *z = _z.data();
+                for(size_t i = 0; i < n; i++) {
+                    const size_t last = row_ptr[i + 1] - 1;
+                    T s = _r[i];
+                    for(size_t k = row_ptr[i]; k < last; k++)
+                        s -= values[k] * z[cols[k]];
+                    z[i] = s / values[last];
+                }
+
+                row_ptr = m_lt.RowPointers().data();
+                cols = m_lt.ColumnIndices().data();
+                values = m_lt.Values().data();
+                for(size_t i = n; i-- > 0;) {
+                    const size_t first = row_ptr[i];
+                    T s = z[i];
+                    for(size_t k = first + 1; k < row_ptr[i + 1]; k++)
+                        s -= values[k] * z[cols[k]];
+                    z[i] = s / values[first];
+                }
+            }
+    };
+
+
+    /// Preconditioned conjugate gradient for A * x = b, A and the preconditioner M must be symmetric positive definite
+    /// _x is the starting guess when it holds b.size() elements, it is reset to zero otherwise. Stops early without
+    /// convergence when p^T * A * p is not positive, which means A is not positive definite.
+    template<typename A, typename T, typename M>
+    IterationResult<T> ConjugateGradient(const A& _a, const VectorN<T>& _b, VectorN<T>& _x, const M& _preconditioner,
+                                         const IterationControl<T>& _control = IterationControl<T>()) {
+        static_assert(std::is_floating_point<T>::value, "ConjugateGradient needs a floating point type");
+        IterationResult<T> result;
+        const size_t n = _b.size();
+        if(!IsOperatorOfSize(_a, n))
+            return result;
+        if(_x.size() != n)
+            _x.assign(n, T());
+
+        const T b_norm = std::sqrt(Dot(_b, _b));
+        if(b_norm == T()) {
+            std::fill(_x.begin(), _x.end(), T());
+            result.relative_residual = T();
+            result.converged = true;
+            return result;
+        }
+
+        // r = b - A * x
+        VectorN<T> r(n), z(n), p(n), q(n);
+        ApplyOperator(_a, _x, q);
+        for(size_t i = 0; i < n; i++)
+            r[i] = _b[i] - q[i];
+
+        _preconditioner.Apply(r, z);
+        std::copy(z.begin(), z.end(), p.begin());
+        T rz = Dot(r, z);
+        result.relative_residual = std::sqrt(Dot(r, r)) / b_norm;
+
+        while(!(result.converged = result.relative_residual <= _control.tolerance) && result.iterations < _control.max_iterations) {
+            ApplyOperator(_a, p, q);
+            const T pq = Dot(p, q);
+            if(!(pq > T()))
+                break;
+
+            const T alpha = rz / pq;
+            Axpy(alpha, p, _x);
+            Axpy(-alpha, q, r);
+            result.iterations++;
+            result.relative_residual = std::sqrt(Dot(r, r)) / b_norm;
+            if(result.relative_residual <= _control.tolerance)
+                continue;
+
+            _preconditioner.Apply(r, z);
+            const T rz_next = Dot(r, z);
+            Xpay(n, z.data(), rz_next / rz, p.data());
+            rz = rz_next;
+        }
+
+        return result;
+    }
+
+
+    /// Conjugate gradient for a symmetric positive definite A without preconditioning
+    template<typename A, typename T>
+    IterationResult<T> ConjugateGradient(const A& _a, const VectorN<T>& _b, VectorN<T>& _x,
+                                         const IterationControl<T>& _control = IterationControl<T>()) {
+        return ConjugateGradient(_a, _b, _x, IdentityPreconditioner<T>(), _control);
+    }
+
+
+    /// Right preconditioned BiCGSTAB for general square A, see van der Vorst (1992)
+    /// _x is the starting guess when it holds b.size() elements. Every iteration costs two products with A and two
+    /// preconditioner applications. Stops early without convergence on a breakdown, when rho or omega become zero.
+    template<typename A, typename T, typename M>
+    IterationResult<T> BiCGSTAB(const A& _a, const VectorN<T>& _b, VectorN<T>& _x, const M& _preconditioner,
+                                const IterationControl<T>& _control = IterationControl<T>()) {
+        static_assert(std::is_floating_point<T>::value, "BiCGSTAB needs a floating point type");
+        IterationResult<T> result;
+        const size_t n = _b.size();
+        if(!IsOperatorOfSize(_a, n))
+            return result;
+        if(_x.size() != n)
+            _x.assign(n, T());
+
+        const T b_norm = std::sqrt(Dot(_b, _b));
+        if(b_norm == T()) {
+            std::fill(_x.begin(), _x.end(), T());
+            result.relative_residual = T();
+            result.converged = true;
+            return result;
+        }
+
+        VectorN<T> r(n), r0(n), p(n), v(n), s(n), t(n), p_hat(n), s_hat(n);
+        ApplyOperator(_a, _x, v);
+        for(size_t i = 0; i < n; i++)
+            r[i] = _b[i] - v[i];
+
+        std::copy(r.begin(), r.end(), r0.begin());
+        std::fill(v.begin(), v.end(), T());
+        T rho = static_cast<T>(1), alpha = static_cast<T>(1), omega = static_cast<T>(1);
+        result.relative_residual = std::sqrt(Dot(r, r)) / b_norm;
+
+        while(!(result.converged = result.relative_residual <= _control.tolerance) && result.iterations < _control.max_iterations) {
+            const T rho_next = Dot(r0, r);
+            if(rho_next == T() || !std::isfinite(rho_next))
+                break;
+
+            // p = r + beta * (p - omega * v)
+            const T beta = (rho_next / rho) * (alpha / omega);
+            ParallelElements(n, [&](size_t _first, size_t _last) {
+                for(size_t i = _first; i < _last; i++)
+                    p[i] = r[i] + beta * (p[i] - omega * v[i]);
+            });
+            rho = rho_next;
+
+            _preconditioner.Apply(p, p_hat);
+            ApplyOperator(_a, p_hat, v);
+            const T r0v = Dot(r0, v);
+            if(r0v == T() || !std::isfinite(r0v))
+                break;
+
+            alpha = rho / r0v;
+            std::copy(r.begin(), r.end(), s.begin());
+            Axpy(-alpha, v, s);
+            Axpy(alpha, p_hat, _x);
+            result.iterations++;
+
+            const T s_norm = std::sqrt(Dot(s, s)) / b_norm;
+            if(s_norm <= _control.tolerance) {
+                std::copy(s.begin(), s.end(), r.begin());
+                result.relative_residual = s_norm;
+                continue;
+            }
+
+            _preconditioner.Apply(s, s_hat);
+            ApplyOperator(_a, s_hat, t);
+            const T tt = Dot(t, t);
+            omega = tt > T() ? Dot(t, s) / tt : T();
+            if(omega == T() || !std::isfinite(omega)) {
+                std::copy(s.begin(), s.end(), r.begin());
+                result.relative_residual = s_norm;
+                break;
+            }
+
+            // x += omega * s_hat, r = s - omega * t
+            Axpy(omega, s_hat, _x);
+            ParallelElements(n, [&](size_t _first, size_t _last) {
+                for(size_t i = _first; i < _last; i++)
+                    r[i] = s[i] - omega * t[i];
+            });
+            result.relative_residual = std::sqrt(Dot(r, r)) / b_norm;
+        }
+
+        return result;
+    }
+
+
+    /// BiCGSTAB without preconditioning
+    template<typename A, typename T>
+    IterationResult<T> BiCGSTAB(const A& _a, const VectorN<T>& _b, VectorN<T>& _x,
+                                const IterationControl<T>& _control = IterationControl<T>()) {
+        return BiCGSTAB(_a, _b, _x, IdentityPreconditioner<T>(), _control);
+    }
+}
+
+#endif
@@ -0,0 +1,358 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: LU.h - LU factorization with partial pivoting for MatrixN
+/// author: Karl-Mihkel Ott
+
+#ifndef LU_H
+#define LU_H
+
+#include <cstddef>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Gemm.h>
+#include <trs/Triangular.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+
+namespace TRS {
+
+    /**
+     * LU factorization with partial pivoting, P * A = L * U
+     * L has a unit diagonal and is stored below the diagonal of Factors(), U is stored on and above it.
+     * The factorization is right-looking and blocked: every block_size wide panel is factored column by column,
+     * the trailing matrix is then updated with one GEMM so that large matrices run at matrix multiplication speed.
+     * A pivot that is not finite or at most n * epsilon times the largest element of its own row of A marks the
+     * matrix as singular, such factorizations give a zero determinant and empty results from Inverse() and Solve().
+     * Comparing against the row keeps badly scaled but well-posed matrices like diag(1e20, 1) regular,
+     * how close a regular matrix is to a singular one is estimated separately by ReciprocalCondition().
+     */
+    template<typename T>
+    class LU {
+        static_assert(std::is_floating_point<T>::value, "LU factorization needs a floating point type");
+
+        private:
+            static constexpr size_t block_size = 64;
+
+            MatrixN<T> m_lu;
+            // row i was swapped with row m_pivots[i] at step i
+            Buffer<size_t> m_pivots;
+            bool m_odd_swaps = false;
+            bool m_singular = false;
+            // largest magnitude in every row of A, in the row order of the factors
+            Buffer<T> m_row_scale;
+            // 1-norm of A
+            T m_norm1 = T();
+
+            // a pivot is zero when it is within rounding of the scale of the row it came from
+            static bool IsZeroPivot(size_t _n, T _pivot, T _row_scale) {
+                return !std::isfinite(_pivot) || std::abs(_pivot) <= static_cast<T>(_n) * std::numeric_limits<T>::epsilon() * _row_scale;
+            }
+
+            void FactorPanel(size_t _j0, size_t _jb) {
+                const size_t n = m_lu.Rows();
+                const size_t j1 = _j0 + _jb;
+                T *a = m_lu.Data();
+
+                for(size_t j = _j0; j < j1; j++) {
+                    size_t p = j;
+                    for(size_t r = j + 1; r < n; r++) {
+                        if(std::abs(a[r * n + j]) > std::abs(a[p * n + j]))
+                            p = r;
+                    }
+
+                    // whole rows are swapped so that earlier L columns and the trailing matrix follow the pivot
+                    m_pivots[j] = p;
+                    if(p != j) {
+                        std::swap_ranges(a + j * n, a + j * n + n, a + p * n);
+                        std::swap(m_row_scale[j], m_row_scale[p]);
+                        m_odd_swaps = !m_odd_swaps;
+                    }
+
+                    const T pivot = a[j * n + j];
+                    if(IsZeroPivot(n, pivot, m_row_scale[j])) {
+                        m_singular = true;
+                        continue;
+                    }
+
+                    const T inv = static_cast<T>(1) / pivot;
+                    const T *u = a + j * n;
+                    for(size_t r = j + 1; r < n; r++) {
+                        T *row = a + r * n;
+                        const T l = row[j] *= inv;
+                        for(size_t c = j + 1; c < j1; c++)
+                            row[c] -= l * u[c];
+                    }
+                }
+            }
+
+            void ApplyPivots(T *_b, size_t _ldb, size_t _nrhs) const {
+                for(size_t i = 0; i < m_pivots.size(); i++) {
+                    if(m_pivots[i] != i)
+                        std::swap_ranges(_b + i * _ldb, _b + i * _ldb + _nrhs, _b + m_pivots[i] * _ldb);
+                }
+            }
+
+            // overwrite _b with the solution of A^T * x = _b, A^T = U^T * L^T * P
+            void SolveTransposedInPlace(T *_b) const {
+                const size_t n = Size();
+                const T *a = m_lu.Data();
+                // U^T is lower triangular, row i of U is column i of U^T
+                for(size_t i = 0; i < n; i++) {
+                    _b[i] /= a[i * n + i];
+                    for(size_t j = i + 1; j < n; j++)
+                        _b[j] -= a[i * n + j] * _b[i];
+                }
+
+                // L^T is unit upper triangular, row i of L is column i of L^T
+                for(size_t i = n; i-- > 0;) {
+                    for(size_t j = 0; j < i; j++)
+                        _b[j] -= a[i * n + j] * _b[i];
+                }
+
+                for(size_t i = n; i-- > 0;) {
+                    if(m_pivots[i] != i)
+                        std::swap(_b[i], _b[m_pivots[i]]);
+                }
+            }
+
+        public:
+            LU() = default;
+
+            template<typename E>
+            explicit LU(const MatrixExpression<E>& _a) {
+                Compute(_a);
+            }
+
+            /// Factor _a, returns false when it is singular or not square
+            /// _a can be a MatrixN, a MatrixView or any matrix expression, refactoring a matrix of the same size reuses the storage.
+            template<typename E>
+            bool Compute(const MatrixExpression<E>& _a) {
+                static_assert(std::is_same<typename E::value_type, T>::value, "LU input must have the element type of the factorization");
+                m_lu = _a.Self();
+                m_odd_swaps = false;
+                m_singular = !m_lu.IsSquare();
+                m_pivots.clear();
+                if(m_singular)
+                    return false;
+
+                const size_t n = m_lu.Rows();
+                m_pivots.resize(n);
+
+                T *a = m_lu.Data();
+                m_row_scale.assign(n, T());
+                Buffer<T> column_sums(n, T());
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t j = 0; j < n; j++) {
+                        const T v = std::abs(a[i * n + j]);
+                        m_row_scale[i] = std::max(m_row_scale[i], v);
+                        column_sums[j] += v;
+                    }
+                }
+                m_norm1 = n ? *std::max_element(column_sums.begin(), column_sums.end()) : T();
+
+                for(size_t j0 = 0; j0 < n; j0 += block_size) {
+                    const size_t jb = std::min(block_size, n - j0);
+                    const size_t j1 = j0 + jb;
+                    FactorPanel(j0, jb);
+
+                    if(j1 < n) {
+                        // U12 = inv(L11) * A12, A22 -= L21 * U12
+                        SolveLowerTriangular(true, jb, n - j1, a + j0 * n + j0, n, a + j0 * n + j1, n);
+                        Gemm(false, false, n - j1, n - j1, jb, static_cast<T>(-1), a + j1 * n + j0, n,
+                             a + j0 * n + j1, n, static_cast<T>(1), a + j1 * n + j1, n);
+                    }
+                }
+
+                return !m_singular;
+            }
+
+            bool IsSingular() const { return m_singular; }
+            size_t Size() const { return m_lu.Rows(); }
+
+            /// Packed L and U factors of the row permuted matrix
+            const MatrixN<T>& Factors() const { return m_lu; }
+            const Buffer<size_t>& Pivots() const { return m_pivots; }
+
+            T Determinant() const {
+                if(m_singular)
+                    return T();
+
+                T det = static_cast<T>(1);
+                for(size_t i = 0; i < Size(); i++)
+                    det *= m_lu[i][i];
+
+                return m_odd_swaps ? -det : det;
+            }
+
+            /// Turn the factors of A into the factors of A + u * v^T in O(n^2) with Bennett's algorithm
+            /// The pivot order of the first factorization is kept, so growth in the factors is not controlled. The row
+            /// scales and the 1-norm used by IsSingular() and ReciprocalCondition() become upper bounds of the new ones.
+            /// Returns false and keeps the factors when a pivot becomes zero, refactor the updated matrix with Compute() then.
+            bool Update(const VectorN<T>& _u, const VectorN<T>& _v) {
+                const size_t n = Size();
+                if(m_singular || _u.size() != n || _v.size() != n)
+                    return false;
+
+                // P * (A + u * v^T) = L * U + (P * u) * v^T
+                Buffer<T> x(_u.begin(), _u.end()), y(_v.begin(), _v.end());
+                ApplyPivots(x.data(), 1, 1);
+
+                T v_max = T(), u_sum = T();
+                for(size_t i = 0; i < n; i++) {
+                    v_max = std::max(v_max, std::abs(y[i]));
+                    u_sum += std::abs(x[i]);
+                }
+
+                Buffer<T> row_scale(m_row_scale);
+                for(size_t i = 0; i < n; i++)
+                    row_scale[i] += std::abs(x[i]) * v_max;
+
+                MatrixN<T> lu(m_lu);
+                T *a = lu.Data();
+                for(size_t j = 0; j < n; j++) {
+                    // the rank one term left after step j is x[j+1:] * y[j+1:]^T, see Bennett (1965)
+                    T *u = a + j * n;
+                    u[j] += x[j] * y[j];
+                    if(IsZeroPivot(n, u[j], row_scale[j]))
+                        return false;
+
+                    const T beta = y[j] / u[j];
+                    for(size_t k = j + 1; k < n; k++) {
+                        u[k] += x[j] * y[k];
+                        y[k] -= beta * u[k];
+                    }
+
+                    for(size_t i = j + 1; i < n; i++) {
+                        T &l = a[i * n + j];
+                        x[i] -= x[j] * l;
+                        l += beta * x[i];
+                    }
+                }
+
+                m_lu = std::move(lu);
+                m_row_scale = std::move(row_scale);
+                m_norm1 += u_sum * v_max;
+                return true;
+            }
+
+            /// Estimate of 1 / (|A|_1 * |inv(A)|_1) with Hager's method, it costs a few O(n^2) solves
+            /// Close to 1 for well conditioned matrices, about epsilon or below when solutions lose all their digits,
+            /// 0 when the matrix is singular. Row or column scaling of A changes it, unlike IsSingular().
+            T ReciprocalCondition() const {
+                const size_t n = Size();
+                if(m_singular || n == 0)
+                    return T();
+
+                // maximize |inv(A) * x|_1 over |x|_1 = 1 by moving x to the vertex with the steepest gradient
+                Buffer<T> x(n, static_cast<T>(1) / static_cast<T>(n)), z(n);
+                T inv_norm = T();
+                size_t last = n;
+                for(size_t iteration = 0; iteration < 5; iteration++) {
+                    SolveInPlace(x.data(), 1, 1);
+                    T norm = T();
+                    for(size_t i = 0; i < n; i++) {
+                        norm += std::abs(x[i]);
+                        z[i] = x[i] < T() ? static_cast<T>(-1) : static_cast<T>(1);
+                    }
+
+                    if(!(norm > inv_norm) && iteration)
+                        break;
+                    inv_norm = norm;
+
+                    SolveTransposedInPlace(z.data());
+                    size_t j = 0;
+                    for(size_t i = 1; i < n; i++) {
+                        if(std::abs(z[i]) > std::abs(z[j]))
+                            j = i;
+                    }
+
+                    if(j == last)
+                        break;
+                    last = j;
+                    std::fill(x.begin(), x.end(), T());
+                    x[j] = static_cast<T>(1);
+                }
+
+                // alternating probe of LAPACK's xLACN2, it catches matrices where the vertex walk stops early
+                if(n > 1) {
+                    for(size_t i = 0; i < n; i++) {
+                        const T magnitude = static_cast<T>(1) + static_cast<T>(i) / static_cast<T>(n - 1);
+                        x[i] = i % 2 ? -magnitude : magnitude;
+                    }
+
+                    SolveInPlace(x.data(), 1, 1);
+                    T norm = T();
+                    for(size_t i = 0; i < n; i++)
+                        norm += std::abs(x[i]);
+                    inv_norm = std::max(inv_norm, static_cast<T>(2) * norm / static_cast<T>(3 * n));
+                }
+
+                if(!std::isfinite(inv_norm) || !(m_norm1 > T()))
+                    return T();
+
+                return static_cast<T>(1) / (m_norm1 * inv_norm);
+            }
+
+            /// Inverse of the factored matrix, empty when it is singular
+            MatrixN<T> Inverse() const {
+                if(m_singular)
+                    return MatrixN<T>();
+
+                MatrixN<T> inv = MatrixN<T>::MakeIdentity(Size());
+                SolveInPlace(inv.Data(), inv.Columns(), inv.Columns());
+                return inv;
+            }
+
+            /// Overwrite the Size() x _nrhs row-major matrix _b with the solution X of A * X = B
+            /// The factorization must not be singular.
+            void SolveInPlace(T *_b, size_t _ldb, size_t _nrhs) const {
+                ApplyPivots(_b, _ldb, _nrhs);
+                SolveLowerTriangular(true, Size(), _nrhs, m_lu.Data(), m_lu.Columns(), _b, _ldb);
+                SolveUpperTriangular(false, Size(), _nrhs, m_lu.Data(), m_lu.Columns(), _b, _ldb);
+            }
+
+            /// Overwrite the matrix or vector view _b with the solution of A * X = B
+            /// Returns false and leaves _b untouched when A is singular or _b has the wrong row count.
+            bool SolveInPlace(const MatrixView<T>& _b) const {
+                if(m_singular || _b.Rows() != Size())
+                    return false;
+
+                SolveInPlace(_b.Data(), _b.Stride(), _b.Columns());
+                return true;
+            }
+
+            bool SolveInPlace(const VectorView<T>& _b) const {
+                if(m_singular || _b.size() != Size())
+                    return false;
+
+                SolveInPlace(_b.data(), _b.Stride(), 1);
+                return true;
+            }
+
+            /// Solve A * x = b, the result is empty when A is singular or b has the wrong size
+            VectorN<T> Solve(const VectorN<T>& _b) const {
+                if(m_singular || _b.size() != Size())
+                    return VectorN<T>();
+
+                VectorN<T> x(_b);
+                SolveInPlace(x.data(), 1, 1);
+                return x;
+            }
+
+            /// Solve A * X = B for every column of B, the result is empty when A is singular or B has the wrong row count
+            MatrixN<T> Solve(const MatrixN<T>& _b) const {
+                if(m_singular || _b.Rows() != Size())
+                    return MatrixN<T>();
+
+                MatrixN<T> x(_b);
+                SolveInPlace(x.Data(), x.Columns(), x.Columns());
+                return x;
+            }
+    };
+}
+
+#endif
@@ -6,1650 +6,1458 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include <trs/Simd.h>
+#include <trs/CpuFeatures.h>
+
 namespace TRS {
 
-    /**
-     * 2x2 matrix structure
-     */
-    template<typename T>
-    struct Matrix2 {
-#ifdef ITERATORS_H
-        typedef MatrixIterator<T> iterator;
-#endif
+    template<typename F, size_t... I>
+    constexpr void UnrollImpl(F &_f, std::index_sequence<I...>) {
+        (_f(std::integral_constant<size_t, I>()), ...);
+    }
 
-        Vector2<T> row1, row2;
 
-        Matrix2() noexcept;
-        Matrix2(const Vector2<T> &r1, const Vector2<T> &r2) noexcept;
-        Matrix2(Vector2<T> &&r1, Vector2<T> &&r2) noexcept;
-        Matrix2(const Matrix2<T> &val) noexcept;
-        Matrix2(Matrix2<T> &&val) noexcept;
-        void operator=(const Matrix2<T> &val);
+    /// Call _f(std::integral_constant<size_t, I>()) for every I from 0 to N - 1
+    /// The calls are expanded at compile time, so loops over fixed size matrices have no loop counter left.
+    template<size_t N, typename F>
+    constexpr void Unroll(F &&_f) {
+        UnrollImpl(_f, std::make_index_sequence<N>());
+    }
 
-    
-        /******************************/
-        /***** Operator overloads *****/
-        /******************************/
 
-        Matrix2<T> operator+(const Matrix2<T> &_mat) const; 
-        Matrix2<T> operator+(const T &_c) const;
-        Matrix2<T> operator-(const Matrix2<T> &_mat) const;
-        Matrix2<T> operator-(const T &_c) const;
-        Matrix2<T> operator*(const T &_c) const;
-        Matrix2<T> operator*(const Matrix2<T> &_mat) const; 
-        Vector2<T> operator*(const Vector2<T> &_vec) const;
-        Matrix2<T> operator/(const T &_c) const;
-        void operator*=(const T &_c);
-        void operator*=(const Matrix2<T> &_mat);
-        void operator+=(const T &_c);
-        void operator+=(const Matrix2<T> &_mat);
-        void operator-=(const T &_c);
-        void operator-=(const Matrix2<T> &_mat);
-        void operator/=(const T &_c);
-        bool operator==(const Matrix2<T> &_mat) const;
-        bool operator!=(const Matrix2<T> &_mat) const;
-
-        Vector2<T>& operator[] (size_t i) const { return (&row1)[i]; }
-        Vector2<T> operator[] (size_t i) { return (&row1)[i]; }
-
-
-        /** 
-         * Find the determinant of current matrix instance
-         */
-        template<typename DT>
-        static DT Determinant(const Matrix2<DT> &_mat);
-        /** 
-         * Find the inverse of the current matrix 
-         */
-        Matrix2<T> Inverse() const;
-        /** 
-         * Transpose the current matrix
-         */
-        Matrix2<T> Transpose() const;
+    /************************************/
+    /***** Four column SIMD kernels *****/
+    /************************************/
 
-#ifdef ITERATORS_H
-        // iterators
-        iterator BeginRowMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 2, true);
-        }
+    // Rows of four float or double elements fill an SSE or AVX register, so these kernels serve every matrix
+    // shape that has four columns. Kernels that only touch whole rows take the row count as a template parameter.
+    // The float kernels need SSE only. The double kernels are compiled for AVX2 and FMA with function attributes
+    // like the batch kernels in Transform.h, so they are only called after Enabled() confirmed CPU support.
 
-        iterator EndRowMajor() const {
-            return iterator(const_cast<T*>(&row2.second + 1), 2, true);
-        }
+    /// Element types with SIMD products and transposes of matrices with four columns
+    template<typename T>
+    struct FastRows4 {
+        static constexpr bool value = std::is_same<T, float>::value || std::is_same<T, double>::value;
 
-        iterator BeginColumnMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 2, false);
+        /// True when the kernels for T can run on this CPU, checked once unless the build targets AVX2 and FMA already
+        static bool Enabled() {
+#ifndef TRS_AVX2_FMA
+            if constexpr (std::is_same<T, double>::value) {
+                const CpuFeatures &cpu = GetCpuFeatures();
+                return cpu.avx2 && cpu.fma;
+            }
+#endif
+            return value;
         }
+    };
 
-        iterator EndColumnMajor() const {
-            return iterator(const_cast<T*>(&row2.second) + 1, 2, false);
-        }
-#endif
 
+    /// Element types with a SIMD 4x4 inverse, the double inverse needs AVX2 and FMA like the other double kernels
+    template<typename T>
+    struct FastInverse4x4 : FastRows4<T> {};
 
-#ifdef _DEBUG
-        /** 
-         * Log matrix into console output and add description to it
-         */
-        void Log(const std::string &_desc);
-#endif
-    };
 
-    
-    template<typename T>
-    Matrix2<T>::Matrix2() noexcept {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1 = Vector2<T>(1, 0);
-            row2 = Vector2<T>(0, 1);
+    /// Multiply row-major R x 4 float matrix with 4x4 float matrix using SSE instructions
+    /// Each output row is a linear combination of _b rows weighted by broadcasted _a row elements.
+    /// All pointers must be 16 byte aligned like Matrix4<float> rows, _out may alias either of the inputs.
+    template<size_t R = 4>
+    inline void FastMatMul4Sse(const float *_a, const float *_b, float *_out) {
+        const __m128 b0 = _mm_load_ps(_b);
+        const __m128 b1 = _mm_load_ps(_b + 4);
+        const __m128 b2 = _mm_load_ps(_b + 8);
+        const __m128 b3 = _mm_load_ps(_b + 12);
+
+        for(size_t i = 0; i < 4 * R; i += 4) {
+            const __m128 a = _mm_load_ps(_a + i);
+            __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3));
+            _mm_store_ps(_out + i, r);
         }
     }
 
 
-    template<typename T>
-    Matrix2<T>::Matrix2(const Vector2<T> &_r1, const Vector2<T> &_r2) noexcept {
-        row1 = _r1;
-        row2 = _r2;
-    }
+    /// AVX2 and FMA variant of FastMatMul4Sse, callable after checking CPU support at runtime
+    template<size_t R = 4>
+    TRS_TARGET_AVX2 inline void FastMatMul4Avx2(const float *_a, const float *_b, float *_out) {
+        // every _b row is duplicated into both 128 bit lanes, so two output rows are computed at once
+        const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(_b));
+        const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(_b + 4));
+        const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(_b + 8));
+        const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(_b + 12));
 
+        for(size_t i = 0; i + 8 <= 4 * R; i += 8) {
+            const __m256 a = _mm256_loadu_ps(_a + i);
+            __m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            r = _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1, r);
+            r = _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2, r);
+            r = _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3, r);
+            _mm256_storeu_ps(_out + i, r);
+        }
 
-    template<typename T>
-    Matrix2<T>::Matrix2(Vector2<T> &&_r1, Vector2<T> &&_r2) noexcept {
-        row1 = std::move(_r1);
-        row2 = std::move(_r2);
+        // odd row count leaves one row for the lower lanes
+        if constexpr (R % 2 != 0) {
+            const __m128 a = _mm_load_ps(_a + 4 * (R - 1));
+            __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_castps256_ps128(b0));
+            r = _mm_fmadd_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_castps256_ps128(b1), r);
+            r = _mm_fmadd_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_castps256_ps128(b2), r);
+            r = _mm_fmadd_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), _mm256_castps256_ps128(b3), r);
+            _mm_store_ps(_out + 4 * (R - 1), r);
+        }
     }
 
 
-    template<typename T>
-    Matrix2<T>::Matrix2(const Matrix2<T> &_val) noexcept {
-        row1 = _val.row1;
-        row2 = _val.row2;
+    /// Multiply row-major R x 4 float matrix with 4x4 float matrix with the best instruction set enabled at compile time
+    template<size_t R = 4>
+    inline void FastMatMul4(const float *_a, const float *_b, float *_out) {
+#ifdef TRS_AVX2_FMA
+        FastMatMul4Avx2<R>(_a, _b, _out);
+#else
+        FastMatMul4Sse<R>(_a, _b, _out);
+#endif
     }
 
 
-    template<typename T>
-    Matrix2<T>::Matrix2(Matrix2<T> &&_val) noexcept {
-        row1 = std::move(_val.row1);
-        row2 = std::move(_val.row2);
+    /// Find the linear combination of four 4 element float vectors _v[0] * _c[0] + ... + _v[3] * _c[3]
+    /// This is column-major matrix times vector or row vector times row-major matrix.
+    /// Pointers must be 16 byte aligned, _out may alias _c.
+    inline void FastLinearCombine4(const float *_v, const float *_c, float *_out) {
+        const __m128 c = _mm_load_ps(_c);
+#ifdef TRS_AVX2_FMA
+        __m128 r = _mm_mul_ps(_mm_load_ps(_v), _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_fmadd_ps(_mm_load_ps(_v + 4), _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)), r);
+        r = _mm_fmadd_ps(_mm_load_ps(_v + 8), _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)), r);
+        r = _mm_fmadd_ps(_mm_load_ps(_v + 12), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3)), r);
+#else
+        __m128 r = _mm_mul_ps(_mm_load_ps(_v), _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(_v + 4), _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(_v + 8), _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(_v + 12), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+#endif
+        _mm_store_ps(_out, r);
     }
 
 
-    template<typename T>
-    void Matrix2<T>::operator=(const Matrix2<T> &_val) {
-        row1 = _val.row1;
-        row2 = _val.row2;
+    /// Transpose row-major 4x4 float matrix in registers
+    /// Pointers must be 16 byte aligned, _out may alias _m.
+    inline void FastTranspose4(const float *_m, float *_out) {
+        __m128 r0 = _mm_load_ps(_m);
+        __m128 r1 = _mm_load_ps(_m + 4);
+        __m128 r2 = _mm_load_ps(_m + 8);
+        __m128 r3 = _mm_load_ps(_m + 12);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_store_ps(_out, r0);
+        _mm_store_ps(_out + 4, r1);
+        _mm_store_ps(_out + 8, r2);
+        _mm_store_ps(_out + 12, r3);
     }
 
 
-    /// Add two matrices together
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator+(const Matrix2<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out{}; 
-            out.row1 = Vector2<T>{row1.first + _mat.row1.first, row1.second + _mat.row1.second};
-            out.row2 = Vector2<T>{row2.first + _mat.row2.first, row1.second + _mat.row2.second};
+    /// Multiply row-major R x 4 double matrix with 4x4 double matrix using AVX2 and FMA instructions
+    /// Same scheme as the float kernel, one 256 bit register holds a whole double row.
+    /// All pointers must be 32 byte aligned like Matrix4<double> rows, _out may alias either of the inputs.
+    template<size_t R = 4>
+    TRS_TARGET_AVX2 inline void FastMatMul4(const double *_a, const double *_b, double *_out) {
+        const __m256d b0 = _mm256_load_pd(_b);
+        const __m256d b1 = _mm256_load_pd(_b + 4);
+        const __m256d b2 = _mm256_load_pd(_b + 8);
+        const __m256d b3 = _mm256_load_pd(_b + 12);
 
-            return out;
+        for(size_t i = 0; i < 4 * R; i += 4) {
+            __m256d r = _mm256_mul_pd(_mm256_broadcast_sd(_a + i), b0);
+            r = _mm256_fmadd_pd(_mm256_broadcast_sd(_a + i + 1), b1, r);
+            r = _mm256_fmadd_pd(_mm256_broadcast_sd(_a + i + 2), b2, r);
+            r = _mm256_fmadd_pd(_mm256_broadcast_sd(_a + i + 3), b3, r);
+            _mm256_store_pd(_out + i, r);
         }
-
-        else return Matrix2<T>{};
     }
 
 
-    /// Add constant to the current matrix
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator+(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out{};
-            out.row1 = Vector2<T>{row1.first + _c, row1.second + _c};
-            out.row1 = Vector2<T>{row2.first + _c, row2.second + _c};
-
-            return out;
-        }
+    /// Multiply row-major 4x4 double matrix with column vector using AVX instructions
+    /// Row products are reduced with horizontal adds, so no transpose is needed.
+    /// All pointers must be 32 byte aligned, _out may alias _v.
+    TRS_TARGET_AVX2 inline void FastMatVec4(const double *_m, const double *_v, double *_out) {
+        const __m256d v = _mm256_load_pd(_v);
+        const __m256d p0 = _mm256_mul_pd(_mm256_load_pd(_m), v);
+        const __m256d p1 = _mm256_mul_pd(_mm256_load_pd(_m + 4), v);
+        const __m256d p2 = _mm256_mul_pd(_mm256_load_pd(_m + 8), v);
+        const __m256d p3 = _mm256_mul_pd(_mm256_load_pd(_m + 12), v);
 
-        else return Matrix2<T>{};
+        // h01 = { p0[0] + p0[1], p1[0] + p1[1], p0[2] + p0[3], p1[2] + p1[3] }
+        const __m256d h01 = _mm256_hadd_pd(p0, p1);
+        const __m256d h23 = _mm256_hadd_pd(p2, p3);
+        const __m256d lo = _mm256_permute2f128_pd(h01, h23, 0x20);
+        const __m256d hi = _mm256_permute2f128_pd(h01, h23, 0x31);
+        _mm256_store_pd(_out, _mm256_add_pd(lo, hi));
     }
 
 
-    /// Substract current matrix with given matrix
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator-(const Matrix2<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out{};
-            out.row1 = Vector2<T>{row1.first - _mat.row1.first, row1.second - _mat.row1.second};
-            out.row2 = Vector2<T>{row2.first - _mat.row2.first, row2.second - _mat.row2.second};
+    /// Transpose row-major 4x4 double matrix in registers
+    /// Pointers must be 32 byte aligned, _out may alias _m.
+    TRS_TARGET_AVX2 inline void FastTranspose4(const double *_m, double *_out) {
+        const __m256d r0 = _mm256_load_pd(_m);
+        const __m256d r1 = _mm256_load_pd(_m + 4);
+        const __m256d r2 = _mm256_load_pd(_m + 8);
+        const __m256d r3 = _mm256_load_pd(_m + 12);
 
-            return out;
-        }
+        // t0 = { m00, m10, m02, m12 }, t1 = { m01, m11, m03, m13 }
+        const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+        const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+        const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+        const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
 
-        else return Matrix2<T>{};
+        _mm256_store_pd(_out, _mm256_permute2f128_pd(t0, t2, 0x20));
+        _mm256_store_pd(_out + 4, _mm256_permute2f128_pd(t1, t3, 0x20));
+        _mm256_store_pd(_out + 8, _mm256_permute2f128_pd(t0, t2, 0x31));
+        _mm256_store_pd(_out + 12, _mm256_permute2f128_pd(t1, t3, 0x31));
     }
 
 
-    /// Substract a constant number from the current matrix
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator-(const T &_c) const {  
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out{};
-            out.row1 = Vector2<T>{row1.first - _c, row1.second - _c};
-            out.row2 = Vector2<T>{row2.first - _c, row2.second - _c};
+    // 2x2 matrix helpers for the block inverse, where a register holds 2x2 matrix | x0 x1 |
+    //                                                                              | x2 x3 |
 
-            return out;
-        }
-
-        else return Matrix2<T>{};
+    /// 2x2 matrix product A * B
+    inline __m128 FastMat2Mul(const __m128 &_a, const __m128 &_b) {
+        return _mm_add_ps(_mm_mul_ps(_a, _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(3, 0, 3, 0))),
+                          _mm_mul_ps(_mm_shuffle_ps(_a, _a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(1, 2, 1, 2))));
     }
 
-    
-    /// Multiply all matrix members with a constant
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator*(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out;
-            out.row1 = {row1.first * _c, row1.second * _c};
-            out.row2 = {row2.first * _c, row2.second * _c};
-
-            return out; 
-        }
 
-        else return Matrix2<T>{};
+    /// 2x2 matrix product adj(A) * B
+    inline __m128 FastMat2AdjMul(const __m128 &_a, const __m128 &_b) {
+        return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(_a, _a, _MM_SHUFFLE(0, 0, 3, 3)), _b),
+                          _mm_mul_ps(_mm_shuffle_ps(_a, _a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(1, 0, 3, 2))));
     }
 
 
-    /// Find the dot product of two matrices
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator*(const Matrix2<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out_mat;
-            out_mat.row1 = Vector2<float>{
-                ((row1.first * _mat.row1.first) + (row1.second * _mat.row2.first)),
-                ((row1.first * _mat.row1.second) + (row1.second * _mat.row2.second))
-            }; 
-
-            out_mat.row2 = Vector2<float>{
-                ((row2.first * _mat.row1.first) + (row2.second * _mat.row2.first)),
-                ((row2.first * _mat.row1.second) + (row2.second * _mat.row2.second))
-            };
-
-            return out_mat;
-        }
-
-        else return Matrix2<T>{};
+    /// 2x2 matrix product A * adj(B)
+    inline __m128 FastMat2MulAdj(const __m128 &_a, const __m128 &_b) {
+        return _mm_sub_ps(_mm_mul_ps(_a, _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(0, 3, 0, 3))),
+                          _mm_mul_ps(_mm_shuffle_ps(_a, _a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(_b, _b, _MM_SHUFFLE(1, 2, 1, 2))));
     }
 
 
-    /// Find the dot product of current matrix and a vector
-    template<typename T>
-    Vector2<T> Matrix2<T>::operator*(const Vector2<T> &_vec) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Vector2<T> out = Vector2<T>{
-                (row1.first * _vec.first + row1.second * _vec.second),
-                (row2.first * _vec.first + row2.second * _vec.second)
-            };
+    /// Invert row-major 4x4 float matrix using 2x2 block decomposition
+    /// M = | A B |, every register holds one 2x2 block and the determinant is found along the way.
+    ///     | C D |
+    /// Returns the determinant of the input matrix. Pointers must be 16 byte aligned, _out may alias _m.
+    inline float FastInverse4(const float *_m, float *_out) {
+        const __m128 r0 = _mm_load_ps(_m);
+        const __m128 r1 = _mm_load_ps(_m + 4);
+        const __m128 r2 = _mm_load_ps(_m + 8);
+        const __m128 r3 = _mm_load_ps(_m + 12);
 
-            return out; 
-        }
+        const __m128 a = _mm_movelh_ps(r0, r1);
+        const __m128 b = _mm_movehl_ps(r1, r0);
+        const __m128 c = _mm_movelh_ps(r2, r3);
+        const __m128 d = _mm_movehl_ps(r3, r2);
 
-        else return Vector2<T>{};
-    }
+        // block determinants as (|A|, |B|, |C|, |D|)
+        const __m128 det_sub = _mm_sub_ps(
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+            _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0)))
+        );
+        const __m128 det_a = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m128 det_b = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m128 det_c = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m128 det_d = _mm_shuffle_ps(det_sub, det_sub, _MM_SHUFFLE(3, 3, 3, 3));
 
+        const __m128 d_c = FastMat2AdjMul(d, c);
+        const __m128 a_b = FastMat2AdjMul(a, b);
 
-    /// Divide all matrix elements with constant
-    template<typename T>
-    Matrix2<T> Matrix2<T>::operator/(const T &_c) const { 
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> out;
-            out.row1 = Vector2<T>{row1.first / _c, row1.second / _c};
-            out.row2 = Vector2<T>{row2.first / _c, row2.second / _c};
+        // adjugates of the inverse blocks
+        __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), FastMat2Mul(b, d_c));
+        __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), FastMat2Mul(c, a_b));
+        __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), FastMat2MulAdj(d, a_b));
+        __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), FastMat2MulAdj(a, d_c));
 
-            return out;
-        }
+        // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+        const __m128 tr = _mm_mul_ps(a_b, _mm_shuffle_ps(d_c, d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+        const __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), FastSum(tr));
 
-        else return Matrix2<T>{};
-    }
+        const __m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+        x = _mm_mul_ps(x, inv_det);
+        y = _mm_mul_ps(y, inv_det);
+        z = _mm_mul_ps(z, inv_det);
+        w = _mm_mul_ps(w, inv_det);
 
+        // adjugate swizzle and block to row conversion in one shuffle
+        _mm_store_ps(_out, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(_out + 4, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+        _mm_store_ps(_out + 8, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(_out + 12, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
 
-    /// Multiply all matrix members with a constant and
-    /// set the product as the value of the current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator*=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first *= _c;
-            row1.second *= _c;
-            row2.first *= _c;
-            row2.second *= _c;
-        }
+        return _mm_cvtss_f32(det);
     }
 
 
-    /// Find the cross product of two matrices and set the current matrix
-    /// instance value to it
-	template<typename T>
-    void Matrix2<T>::operator*=(const Matrix2<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> new_mat{};
-            new_mat.row1 = Vector2<float>{
-                (
-                    (row1.first * _mat.row1.first) +
-                    (row1.second * _mat.row2.first)
-                ),
-                (
-                    (row1.first * _mat.row1.second) +
-                    (row1.second * _mat.row2.second)
-                )
-            }; 
-
-            new_mat.row2 = Vector2<float>{
-                (
-                    (row2.first * _mat.row1.first) +
-                    (row2.second * _mat.row2.first)
-                ),
-                (
-                    (row2.first * _mat.row1.second) +
-                    (row2.second * _mat.row2.second)
-                )
-            };
+    // double precision variants of the 2x2 block helpers, one 256 bit register per block
 
-            *this = new_mat;
-        }
+    /// 2x2 matrix product A * B
+    TRS_TARGET_AVX2 inline __m256d FastMat2Mul(const __m256d &_a, const __m256d &_b) {
+        return _mm256_add_pd(_mm256_mul_pd(_a, _mm256_permute4x64_pd(_b, _MM_SHUFFLE(3, 0, 3, 0))),
+                             _mm256_mul_pd(_mm256_permute_pd(_a, 0x5), _mm256_permute4x64_pd(_b, _MM_SHUFFLE(1, 2, 1, 2))));
     }
 
 
-    /// Add constant value to matrix and store the value in current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator+=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _c;
-            row1.second += _c;
-            row2.first += _c;
-            row2.second += _c;
-        }
+    /// 2x2 matrix product adj(A) * B
+    TRS_TARGET_AVX2 inline __m256d FastMat2AdjMul(const __m256d &_a, const __m256d &_b) {
+        return _mm256_sub_pd(_mm256_mul_pd(_mm256_permute4x64_pd(_a, _MM_SHUFFLE(0, 0, 3, 3)), _b),
+                             _mm256_mul_pd(_mm256_permute4x64_pd(_a, _MM_SHUFFLE(2, 2, 1, 1)), _mm256_permute4x64_pd(_b, _MM_SHUFFLE(1, 0, 3, 2))));
     }
 
 
-    /// Add two matrices together and store the value in current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator+=(const Matrix2<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _mat.row1.first;
-            row1.second += _mat.row1.second;
-            row2.first += _mat.row2.first;
-            row2.second += _mat.row2.second;
-        }
+    /// 2x2 matrix product A * adj(B)
+    TRS_TARGET_AVX2 inline __m256d FastMat2MulAdj(const __m256d &_a, const __m256d &_b) {
+        return _mm256_sub_pd(_mm256_mul_pd(_a, _mm256_permute4x64_pd(_b, _MM_SHUFFLE(0, 3, 0, 3))),
+                             _mm256_mul_pd(_mm256_permute_pd(_a, 0x5), _mm256_permute4x64_pd(_b, _MM_SHUFFLE(1, 2, 1, 2))));
     }
 
 
-    /// Substract constant value from matrix and store the result in current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator-=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _c;
-            row1.second -= _c;
-            row2.first -= _c;
-            row2.second -= _c;
-        }
+    /// Determinant of 2x2 block broadcasted to all lanes
+    TRS_TARGET_AVX2 inline __m256d FastMat2Det(const __m256d &_a) {
+        const __m256d prod = _mm256_mul_pd(_a, _mm256_permute4x64_pd(_a, _MM_SHUFFLE(0, 1, 2, 3)));
+        const __m256d det = _mm256_sub_pd(prod, _mm256_permute_pd(prod, 0x5));
+        return _mm256_permute4x64_pd(det, _MM_SHUFFLE(0, 0, 0, 0));
     }
 
 
-    /// Substract a matrix from current matrix and store the result in current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator-=(const Matrix2<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _mat.row1.first;
-            row1.second -= _mat.row1.second;
-            row2.first -= _mat.row2.first;
-            row2.second -= _mat.row2.second;
-        }
-    }
+    /// Invert row-major 4x4 double matrix using 2x2 block decomposition in full double precision
+    /// Returns the determinant of the input matrix. Pointers must be 32 byte aligned, _out may alias _m.
+    TRS_TARGET_AVX2 inline double FastInverse4(const double *_m, double *_out) {
+        const __m256d r0 = _mm256_load_pd(_m);
+        const __m256d r1 = _mm256_load_pd(_m + 4);
+        const __m256d r2 = _mm256_load_pd(_m + 8);
+        const __m256d r3 = _mm256_load_pd(_m + 12);
+
+        const __m256d a = _mm256_permute2f128_pd(r0, r1, 0x20);
+        const __m256d b = _mm256_permute2f128_pd(r0, r1, 0x31);
+        const __m256d c = _mm256_permute2f128_pd(r2, r3, 0x20);
+        const __m256d d = _mm256_permute2f128_pd(r2, r3, 0x31);
 
+        const __m256d det_a = FastMat2Det(a);
+        const __m256d det_b = FastMat2Det(b);
+        const __m256d det_c = FastMat2Det(c);
+        const __m256d det_d = FastMat2Det(d);
 
-    /// Divide all matrix elements with constant and store the value in current matrix instance
-	template<typename T>
-    void Matrix2<T>::operator/=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first /= _c;
-            row1.second /= _c;
-            row2.first /= _c;
-            row2.second /= _c;
-        }
-    }
-    
-    
-    /// Check if current and given matrix instances have equal values
-	template<typename T>
-    bool Matrix2<T>::operator==(const Matrix2<T> &_mat) const {
-        return row1 == _mat.row1 && row2 == _mat.row2;
-    }
+        const __m256d d_c = FastMat2AdjMul(d, c);
+        const __m256d a_b = FastMat2AdjMul(a, b);
 
+        __m256d x = _mm256_sub_pd(_mm256_mul_pd(det_d, a), FastMat2Mul(b, d_c));
+        __m256d w = _mm256_sub_pd(_mm256_mul_pd(det_a, d), FastMat2Mul(c, a_b));
+        __m256d y = _mm256_sub_pd(_mm256_mul_pd(det_b, c), FastMat2MulAdj(d, a_b));
+        __m256d z = _mm256_sub_pd(_mm256_mul_pd(det_c, b), FastMat2MulAdj(a, d_c));
 
-    /// Check if current and given matrix don't have equal values
-    template<typename T>
-    bool Matrix2<T>::operator!=(const Matrix2<T> &_mat) const {
-        return row1 != _mat.row1 || row2 != _mat.row1;
-    }
+        __m256d tr = _mm256_mul_pd(a_b, _mm256_permute4x64_pd(d_c, _MM_SHUFFLE(3, 1, 2, 0)));
+        tr = _mm256_hadd_pd(tr, tr);
+        tr = _mm256_add_pd(tr, _mm256_permute2f128_pd(tr, tr, 0x01));
+        const __m256d det = _mm256_sub_pd(_mm256_add_pd(_mm256_mul_pd(det_a, det_d), _mm256_mul_pd(det_b, det_c)), tr);
 
+        const __m256d inv_det = _mm256_div_pd(_mm256_setr_pd(1.0, -1.0, -1.0, 1.0), det);
+        x = _mm256_permute4x64_pd(_mm256_mul_pd(x, inv_det), _MM_SHUFFLE(0, 2, 1, 3));
+        y = _mm256_permute4x64_pd(_mm256_mul_pd(y, inv_det), _MM_SHUFFLE(0, 2, 1, 3));
+        z = _mm256_permute4x64_pd(_mm256_mul_pd(z, inv_det), _MM_SHUFFLE(0, 2, 1, 3));
+        w = _mm256_permute4x64_pd(_mm256_mul_pd(w, inv_det), _MM_SHUFFLE(0, 2, 1, 3));
 
-    /// Find the determinant of current matrix instance
-    template<typename T>
-    template<typename DT>
-    DT Matrix2<T>::Determinant(const Matrix2<DT> &_mat) { 
-        return _mat.row1.first * _mat.row2.second - _mat.row1.second * _mat.row2.first; 
+        _mm256_store_pd(_out, _mm256_permute2f128_pd(x, y, 0x20));
+        _mm256_store_pd(_out + 4, _mm256_permute2f128_pd(x, y, 0x31));
+        _mm256_store_pd(_out + 8, _mm256_permute2f128_pd(z, w, 0x20));
+        _mm256_store_pd(_out + 12, _mm256_permute2f128_pd(z, w, 0x31));
+
+        return _mm256_cvtsd_f64(det);
     }
 
 
-    /// Find the inverse of the current matrix 
-    template<typename T>
-    Matrix2<T> Matrix2<T>::Inverse() const {
-        Matrix2<T> out_mat;
+    /// Invert row-major affine float matrix [ R | t ] using SIMD instructions
+    /// Only the first three rows are read and R rows are written, so 3x4 and 4x4 matrices share the kernel.
+    /// Returns the determinant of the 3x3 block. Pointers must be 16 byte aligned, _out may alias _m.
+    template<size_t R = 4>
+    inline float FastAffineInverse4(const float *_m, float *_out) {
+        const __m128 r0 = _mm_load_ps(_m);
+        const __m128 r1 = _mm_load_ps(_m + 4);
+        const __m128 r2 = _mm_load_ps(_m + 8);
 
-        // attempt to use gaussian elimination instead
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            T new_row1[4] = { row1.first, row1.second, 1, 0 };
-            T new_row2[4] = { row2.first, row2.second, 0, 1 };
-
-            // compiler should be smart enough to optimize this code for SIMD instructions, if not then consider using non-meme compiler like gcc or clang
-            for(int i = 0; i < 4; i++) {
-                new_row2[i] += new_row1[i];
-                new_row1[i] = -(new_row1[i] - 3 * new_row2[i]);
-                new_row2[i] *= 2;
-            }
+        // adjugate columns, the w lane of a cross product is always zero
+        __m128 c0 = FastCross(r1, r2);
+        __m128 c1 = FastCross(r2, r0);
+        __m128 c2 = FastCross(r0, r1);
+        const float det = FastDot(r0, c0);
+        const __m128 inv_det = _mm_set1_ps(1.0f / det);
+        c0 = _mm_mul_ps(c0, inv_det);
+        c1 = _mm_mul_ps(c1, inv_det);
+        c2 = _mm_mul_ps(c2, inv_det);
 
+        // t' = -(t.x * c0 + t.y * c1 + t.z * c2)
+        __m128 t = _mm_mul_ps(_mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 3, 3, 3)), c0);
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 3, 3, 3)), c1));
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 3, 3, 3)), c2));
+        t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), t);
 
-            out_mat.row1.first = new_row1[2];
-            out_mat.row1.second = new_row1[3];
-            out_mat.row2.first = new_row2[2];
-            out_mat.row2.second = new_row2[3];
-        }
-        
-        return out_mat;
+        // output columns are c0, c1, c2 and t'
+        _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+        _mm_store_ps(_out, c0);
+        _mm_store_ps(_out + 4, c1);
+        _mm_store_ps(_out + 8, c2);
+        if constexpr (R == 4)
+            _mm_store_ps(_out + 12, t);
+
+        return det;
     }
 
 
-    /// Transpose the current matrix
+    /// Invert row-major rigid body float matrix [ R | t ] using SIMD instructions
+    /// Only the first three rows are read and R rows are written. Pointers must be 16 byte aligned, _out may alias _m.
+    template<size_t R = 4>
+    inline void FastRigidInverse4(const float *_m, float *_out) {
+        const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+        const __m128 r0 = _mm_load_ps(_m);
+        const __m128 r1 = _mm_load_ps(_m + 4);
+        const __m128 r2 = _mm_load_ps(_m + 8);
+
+        // t' = -(t.x * r0 + t.y * r1 + t.z * r2)
+        __m128 t = _mm_mul_ps(_mm_shuffle_ps(r0, r0, _MM_SHUFFLE(3, 3, 3, 3)), r0);
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(r1, r1, _MM_SHUFFLE(3, 3, 3, 3)), r1));
+        t = _mm_add_ps(t, _mm_mul_ps(_mm_shuffle_ps(r2, r2, _MM_SHUFFLE(3, 3, 3, 3)), r2));
+        t = _mm_sub_ps(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f), _mm_and_ps(t, xyz_mask));
+
+        // output columns are the input rows without translation and t'
+        __m128 c0 = _mm_and_ps(r0, xyz_mask);
+        __m128 c1 = _mm_and_ps(r1, xyz_mask);
+        __m128 c2 = _mm_and_ps(r2, xyz_mask);
+        _MM_TRANSPOSE4_PS(c0, c1, c2, t);
+        _mm_store_ps(_out, c0);
+        _mm_store_ps(_out + 4, c1);
+        _mm_store_ps(_out + 8, c2);
+        if constexpr (R == 4)
+            _mm_store_ps(_out + 12, t);
+    }
+
+
+    /***************************************/
+    /***** Fixed size matrix structure *****/
+    /***************************************/
+
+    /// Vector type with N elements, used as row and column type of fixed size matrices
+    template<typename T, size_t N>
+    struct FixedVector;
+
+    template<typename T>
+    struct FixedVector<T, 2> {
+        typedef Vector2<T> type;
+    };
+
     template<typename T>
-    Matrix2<T> Matrix2<T>::Transpose() const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix2<T> new_mat{};
-            new_mat.row1 = Vector2<T>{row1.first, row2.first};
-            new_mat.row2 = Vector2<T>{row1.second, row2.second};
+    struct FixedVector<T, 3> {
+        typedef Vector3<T> type;
+    };
 
-            return new_mat;
-        }
+    template<typename T>
+    struct FixedVector<T, 4> {
+        typedef Vector4<T> type;
+    };
 
-        else return Matrix2<T>{};
-    }
+
+    /// Named rows row1 ... rowR of fixed size matrix, constructors taking all rows are inherited by Matrix
+    template<typename T, size_t R, size_t C>
+    struct MatrixRows;
+
+    template<typename T, size_t C>
+    struct MatrixRows<T, 2, C> {
+        typedef typename FixedVector<T, C>::type row_type;
+        row_type row1, row2;
+
+        MatrixRows() noexcept = default;
+        MatrixRows(const row_type &_r1, const row_type &_r2) noexcept :
+            row1(_r1), row2(_r2) {}
+    };
+
+    template<typename T, size_t C>
+    struct MatrixRows<T, 3, C> {
+        typedef typename FixedVector<T, C>::type row_type;
+        row_type row1, row2, row3;
+
+        MatrixRows() noexcept = default;
+        MatrixRows(const row_type &_r1, const row_type &_r2, const row_type &_r3) noexcept :
+            row1(_r1), row2(_r2), row3(_r3) {}
+    };
+
+    template<typename T, size_t C>
+    struct MatrixRows<T, 4, C> {
+        typedef typename FixedVector<T, C>::type row_type;
+        row_type row1, row2, row3, row4;
+
+        MatrixRows() noexcept = default;
+        MatrixRows(const row_type &_r1, const row_type &_r2, const row_type &_r3, const row_type &_r4) noexcept :
+            row1(_r1), row2(_r2), row3(_r3), row4(_r4) {}
+    };
 
 
-#ifdef _DEBUG
     template<typename T>
-    void Matrix2<T>::Log(const std::string &desc) {
-        std::cout << "MAT_LOG: " <<  desc << std::endl;
-        std::cout << row1.first << " | " << row1.second << std::endl;
-        std::cout << row2.first << " | " << row2.second << "\n" << std::endl;
-    }
-#endif
+    struct ColMatrix4;
 
 
     /**
-     * 3x3 matrix structure
+     * R x C matrix structure with row-major storage, rows and columns range from 2 to 4
+     * Rows are Vector2, Vector3 or Vector4 members row1 ... rowR that follow each other without padding,
+     * so Data() addresses all elements. Rows with four elements share the alignment of Vector4<T>.
+     * Operators are unrolled at compile time, shapes with four float or double columns use SIMD kernels
+     * and affine inverses work on both 3x4 and 4x4 matrices.
      */
-    template<typename T>
-    struct Matrix3 {
+    template<typename T, size_t R, size_t C>
+    struct Matrix : public MatrixRows<T, R, C> {
+        static_assert(R >= 2 && R <= 4 && C >= 2 && C <= 4, "Fixed size matrices have 2 to 4 rows and columns");
+
 #ifdef ITERATORS_H
         typedef MatrixIterator<T> iterator;
 #endif
-        Vector3<T> row1, row2, row3;
-
-        Matrix3() noexcept;
-        Matrix3(const Vector3<T> &r1, const Vector3<T> &r2, const Vector3<T> &r3) noexcept;
-        Matrix3(Vector3<T> &&r1, Vector3<T> &&r2, Vector3<T> &&r3) noexcept;
-        Matrix3(const Matrix3<T> &val) noexcept;
-        Matrix3(Matrix3<T>&& val) noexcept;
-        void operator=(const Matrix3<T> &val);
-        
-        
+        typedef T value_type;
+        typedef typename FixedVector<T, C>::type row_type;
+        typedef typename FixedVector<T, R>::type column_type;
+
+        static_assert(sizeof(row_type) == C * sizeof(T), "Matrix rows must not be padded");
+
+        using MatrixRows<T, R, C>::MatrixRows;
+
+        /// Identity matrix for arithmetic types, ones are placed on the main diagonal of rectangular matrices
+        Matrix() noexcept;
+
+        /// Copy the overlapping upper left block of a matrix of another shape, remaining elements are taken from identity
+        /// Matrix4 from Matrix3x4 appends 0, 0, 0, 1 row and Matrix3x4 from Matrix4 drops it.
+        template<size_t R2, size_t C2>
+        explicit Matrix(const Matrix<T, R2, C2> &_mat) noexcept;
+
+
         /******************************/
         /***** Operator overloads *****/
         /******************************/
 
-        Matrix3<T> operator+(const Matrix3<T> &_mat) const;
-        Matrix3<T> operator+(const T &_c) const;
-        Matrix3<T> operator-(const Matrix3<T> &_mat) const;
-        Matrix3<T> operator-(const T &_c) const;
-        Matrix3<T> operator*(const T &_c) const;
-        Matrix3<T> operator*(const Matrix3<T> &_mat) const;
-        Vector3<T> operator*(const Vector3<T> &_vec) const;
-        Matrix3<T> operator/(const T &_c) const;
-        void operator*=(const T &_c);
-        void operator*=(const Matrix3<T> &_mat);
-        void operator+=(const T &_c);
-        void operator+=(const Matrix3<T> &_mat);
-        void operator-=(const T &_c);
-        void operator-=(const Matrix3<T> &_mat);
-        void operator/=(const T &_c);
-        bool operator==(const Matrix3<T> &_mat) const;
-        bool operator!=(const Matrix3<T> &_mat) const;
-
-        Vector3<T> operator[](size_t i) const { return (&row1)[i]; }
-        Vector3<T>& operator[](size_t i) { return (&row1)[i]; }
-        /**
-         * Find the determinant of current matrix instance
-         */
+        Matrix<T, R, C> operator+(const Matrix<T, R, C> &_mat) const;
+        Matrix<T, R, C> operator+(const T &_c) const;
+        Matrix<T, R, C> operator-(const Matrix<T, R, C> &_mat) const;
+        Matrix<T, R, C> operator-(const T &_c) const;
+        Matrix<T, R, C> operator*(const T &_c) const;
+        template<size_t K>
+        Matrix<T, R, K> operator*(const Matrix<T, C, K> &_mat) const;
+        column_type operator*(const row_type &_vec) const;
+        Matrix<T, R, C> operator/(const T &_c) const;
+        Matrix<T, R, C>& operator*=(const T &_c);
+        Matrix<T, R, C>& operator*=(const Matrix<T, C, C> &_mat);
+        Matrix<T, R, C>& operator+=(const T &_c);
+        Matrix<T, R, C>& operator+=(const Matrix<T, R, C> &_mat);
+        Matrix<T, R, C>& operator-=(const T &_c);
+        Matrix<T, R, C>& operator-=(const Matrix<T, R, C> &_mat);
+        Matrix<T, R, C>& operator/=(const T &_c);
+        bool operator==(const Matrix<T, R, C> &_mat) const;
+        bool operator!=(const Matrix<T, R, C> &_mat) const;
+
+        const row_type& operator[](size_t i) const { return (&this->row1)[i]; }
+        row_type& operator[](size_t i) { return (&this->row1)[i]; }
+
+        /// All R * C elements in row-major order
+        T* Data() { return &this->row1.first; }
+        const T* Data() const { return &this->row1.first; }
+
+        static constexpr size_t Rows() { return R; }
+        static constexpr size_t Columns() { return C; }
+
+
+        /// Find the determinant of a square matrix
         template<typename DT>
-        static DT Determinant(const Matrix3<DT> &_mat);
-        /** 
-         * Find the inverse of the current matrix 
-         */
-        Matrix3<T> Inverse() const;
-        /** 
-         * Transpose the current matrix
-         */
-        Matrix3<T> Transpose() const;
+        static DT Determinant(const Matrix<DT, R, C> &_mat);
+
+
+        /// Find the inverse of the current square matrix
+        Matrix<T, R, C> Inverse() const;
+
+
+        /// Find the inverse of an affine 3x4 or 4x4 matrix, the last row of a 4x4 matrix is 0, 0, 0, 1
+        /// Only the 3x3 block is inverted and translation is transformed back with it
+        Matrix<T, R, C> AffineInverse() const;
+
+
+        /// Find the inverse of a rigid body 3x4 or 4x4 matrix (orthonormal rotation with translation)
+        /// Rotation is inverted by transposing it
+        Matrix<T, R, C> RigidInverse() const;
+
+
+        /// Check if the current 3x4 or 4x4 matrix is affine, the last row of a 4x4 matrix must be 0, 0, 0, 1
+        bool IsAffine() const;
+
+
+        /// Check if current matrix is affine and its 3x3 block is orthonormal within given tolerance
+        bool IsRigid(const T &_eps = static_cast<T>(1e-4)) const;
+
+
+        /// Transpose the current matrix
+        Matrix<T, C, R> Transpose() const;
+
+
+        /// Convert the current 4x4 matrix into column-major storage
+        ColMatrix4<T> ToColumnMajor() const;
 
 #ifdef ITERATORS_H
-        // iterators
+        // iterators of square matrices
         iterator BeginRowMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 3, true);
+            static_assert(R == C, "Matrix iterators need a square matrix");
+            return iterator(const_cast<T*>(Data()), R, true);
         }
 
         iterator EndRowMajor() const {
-            return iterator(const_cast<T*>(&row3.third + 1), 3, true);
+            static_assert(R == C, "Matrix iterators need a square matrix");
+            return iterator(const_cast<T*>(Data() + R * C), R, true);
         }
 
         iterator BeginColumnMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 3, false);
+            static_assert(R == C, "Matrix iterators need a square matrix");
+            return iterator(const_cast<T*>(Data()), R, false);
         }
 
         iterator EndColumnMajor() const {
-            return iterator(const_cast<T*>(&row3.third + 1), 3, false);
+            static_assert(R == C, "Matrix iterators need a square matrix");
+            return iterator(const_cast<T*>(Data() + R * C), R, false);
         }
 #endif
 
 
 #ifdef _DEBUG
-        void Log(const std::string &desc);
+        /// Log matrix into console output and add description to it
+        void Log(const std::string &_desc);
 #endif
     };
 
 
     template<typename T>
-    Matrix3<T>::Matrix3() noexcept {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1 = Vector3<T>{1, 0, 0};
-            row2 = Vector3<T>{0, 1, 0};
-            row3 = Vector3<T>{0, 0, 1};
-        }
-    }
-
+    using Matrix2 = Matrix<T, 2, 2>;
 
     template<typename T>
-    Matrix3<T>::Matrix3(const Vector3<T> &r1, const Vector3<T> &r2, const Vector3<T> &r3) noexcept {
-        row1 = r1;
-        row2 = r2;
-        row3 = r3;
-    }
-
+    using Matrix3 = Matrix<T, 3, 3>;
 
     template<typename T>
-    Matrix3<T>::Matrix3(Vector3<T> &&r1, Vector3<T> &&r2, Vector3<T> &&r3) noexcept {
-        row1 = std::move(r1);
-        row2 = std::move(r2);
-        row3 = std::move(r3);
-    }
+    using Matrix4 = Matrix<T, 4, 4>;
 
+    /// 2D affine transform, points are multiplied as Vector3(x, y, 1)
+    template<typename T>
+    using Matrix2x3 = Matrix<T, 2, 3>;
 
+    /// 3D affine transform without the constant last row
     template<typename T>
-    Matrix3<T>::Matrix3(const Matrix3<T> &val) noexcept {
-        row1 = val.row1;
-        row2 = val.row2;
-        row3 = val.row3;
-    }
+    using Matrix3x4 = Matrix<T, 3, 4>;
 
 
-    template<typename T>
-    Matrix3<T>::Matrix3(Matrix3<T> &&val) noexcept {
-        row1 = std::move(val.row1);
-        row2 = std::move(val.row2);
-        row3 = std::move(val.row3);
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>::Matrix() noexcept {
+        if constexpr (std::is_arithmetic<T>::value) {
+            T *out = Data();
+            Unroll<R * C>([&](auto i) {
+                out[i] = static_cast<T>(i / C == i % C ? 1 : 0);
+            });
+        }
     }
 
 
-    template<typename T>
-    void Matrix3<T>::operator=(const Matrix3<T> &val) {
-        row1 = val.row1;
-        row2 = val.row2;
-        row3 = val.row3;
+    template<typename T, size_t R, size_t C>
+    template<size_t R2, size_t C2>
+    Matrix<T, R, C>::Matrix(const Matrix<T, R2, C2> &_mat) noexcept : Matrix() {
+        const T *in = _mat.Data();
+        T *out = Data();
+        Unroll<(R < R2 ? R : R2)>([&](auto i) {
+            Unroll<(C < C2 ? C : C2)>([&](auto j) {
+                out[i * C + j] = in[i * C2 + j];
+            });
+        });
     }
 
 
     /// Add two matrices together
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator+(const Matrix3<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out;
-            out.row1 = Vector3<T>{row1.first + _mat.row1.first, row1.second + _mat.row1.second, row1.third + _mat.row1.third};
-            out.row2 = Vector3<T>{row2.first + _mat.row2.first, row2.second + _mat.row2.second, row2.third + _mat.row2.third};
-            out.row3 = Vector3<T>{row3.first + _mat.row3.first, row3.second + _mat.row3.second, row3.third + _mat.row3.third};
-            return out;
-        }
-
-        else return Matrix3<T>{};
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator+(const Matrix<T, R, C> &_mat) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat += _mat;
     }
 
 
     /// Add constant to the current matrix
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator+(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out{};
-            out.row1 = Vector3<T>{row1.first + _c, row1.second + _c, row1.third + _c};
-            out.row2 = Vector3<T>{row2.first + _c, row2.second + _c, row2.third + _c};
-            out.row3 = Vector3<T>{row3.first + _c, row3.second + _c, row3.third + _c};
-
-            return out;
-        }
-
-        else return Matrix3<T>{};
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator+(const T &_c) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat += _c;
     }
 
 
-    /// Substract current matrix with given matrix
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator-(const Matrix3<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out{};
-            out.row1 = Vector3<T>{row1.first - _mat.row1.first, row1.second - _mat.row1.second, row1.third - _mat.row1.third};
-            out.row2 = Vector3<T>{row2.first - _mat.row2.first, row2.second - _mat.row2.second, row2.second - _mat.row2.third};
-            out.row3 = Vector3<T>{row3.first - _mat.row3.first, row3.second - _mat.row3.second, row3.second - _mat.row3.third};
-
-            return out;
-        }
-
-        else return Matrix3<T>{};
+    /// Substract given matrix from the current matrix
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator-(const Matrix<T, R, C> &_mat) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat -= _mat;
     }
 
 
     /// Substract a constant number from the current matrix
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator-(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out{};
-            out.row1 = Vector3<T>{row1.first - _c, row1.second - _c, row1.third - _c};
-            out.row2 = Vector3<T>{row2.first - _c, row2.second - _c, row2.third - _c};
-            out.row3 = Vector3<T>{row3.first - _c, row3.second - _c, row3.third - _c};
-
-            return out;
-        }
-
-        else return Matrix3<T>{};
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator-(const T &_c) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat -= _c;
     }
 
 
     /// Multiply all matrix members with a constant
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator*(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out;
-            out.row1 = {row1.first * _c, row1.second * _c, row1.third * _c};
-            out.row2 = {row2.first * _c, row2.second * _c, row2.third * _c};
-            out.row3 = {row3.first * _c, row3.second * _c, row3.third * _c};
-            return out;
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator*(const T &_c) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat *= _c;
+    }
+
+
+    /// Find the product of R x C and C x K matrices
+    /// Four column float and double operands use SIMD kernels, so 3x4 affine matrices compose with Matrix4 like Matrix4 does.
+    template<typename T, size_t R, size_t C>
+    template<size_t K>
+    Matrix<T, R, K> Matrix<T, R, C>::operator*(const Matrix<T, C, K> &_mat) const {
+        Matrix<T, R, K> out_mat;
+        if constexpr (C == 4 && K == 4 && FastRows4<T>::value) {
+            if(FastRows4<T>::Enabled()) {
+                FastMatMul4<R>(Data(), _mat.Data(), out_mat.Data());
+                return out_mat;
+            }
         }
 
-        else return Matrix3<T>{};
+        const T *a = Data();
+        const T *b = _mat.Data();
+        T *out = out_mat.Data();
+        Unroll<R>([&](auto i) {
+            Unroll<K>([&](auto j) {
+                T sum = a[i * C] * b[j];
+                Unroll<C - 1>([&](auto k) {
+                    sum += a[i * C + k + 1] * b[(k + 1) * K + j];
+                });
+                out[i * K + j] = sum;
+            });
+        });
+
+        return out_mat;
     }
 
 
-    /// Find the dot product of two matrices
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator*(const Matrix3<T> &matrix) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out_mat;
-            out_mat.row1 = Vector3<float>{
-                ((row1.first * matrix.row1.first) + (row1.second * matrix.row2.first) + (row1.third * matrix.row3.first)), 
-                ((row1.first * matrix.row1.second) + (row1.second * matrix.row2.second) + (row1.third * matrix.row3.second)), 
-                ((row1.first * matrix.row1.third) + (row1.second * matrix.row2.third) + (row1.third * matrix.row3.third))
-            };
+    /// Multiply the current matrix with a column vector
+    template<typename T, size_t R, size_t C>
+    typename Matrix<T, R, C>::column_type Matrix<T, R, C>::operator*(const row_type &_vec) const {
+        column_type out_vec;
+        if constexpr (R == 4 && C == 4 && std::is_same<T, double>::value) {
+            if(FastRows4<T>::Enabled()) {
+                FastMatVec4(Data(), &_vec.first, &out_vec.first);
+                return out_vec;
+            }
+        }
 
-            out_mat.row2 = Vector3<float>{
-                ((row2.first * matrix.row1.first) + (row2.second * matrix.row2.first) + (row2.third * matrix.row3.first)), 
-                ((row2.first * matrix.row1.second) + (row2.second * matrix.row2.second) + (row2.third * matrix.row3.second)), 
-                ((row2.first * matrix.row1.third) + (row2.second * matrix.row2.third) + (row2.third * matrix.row3.third))
-            };
+        const T *m = Data();
+        const T *v = &_vec.first;
+        T *out = &out_vec.first;
+        Unroll<R>([&](auto i) {
+            T sum = m[i * C] * v[0];
+            Unroll<C - 1>([&](auto j) {
+                sum += m[i * C + j + 1] * v[j + 1];
+            });
+            out[i] = sum;
+        });
 
-            out_mat.row3 = Vector3<float>{
-                ((row3.first * matrix.row1.first) + (row3.second * matrix.row2.first) + (row3.third * matrix.row3.first)), 
-                ((row3.first * matrix.row1.second) + (row3.second * matrix.row2.second) + (row3.third * matrix.row3.second)), 
-                ((row3.first * matrix.row1.third) + (row3.second * matrix.row2.third) + (row3.third * matrix.row3.third))
-            };
-
-            return out_mat;
-        }
-        
-        else return Matrix3<T>{};
+        return out_vec;
     }
 
 
-    /// Find the dot product of current matrix and a vector
-    template<typename T>
-    Vector3<T> Matrix3<T>::operator*(const Vector3<T> &_vec) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Vector3<T> out = {
-                (row1.first * _vec.first + row1.second * _vec.second + row1.third * _vec.third),
-                (row2.first * _vec.first + row2.second * _vec.second + row2.third * _vec.third),
-                (row3.first * _vec.first + row3.second * _vec.second + row3.third * _vec.third)
-            }; 
+    /// Divide all matrix elements with constant
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::operator/(const T &_c) const {
+        Matrix<T, R, C> out_mat(*this);
+        return out_mat /= _c;
+    }
 
-            return out;
-        }
 
-        else return Vector3<T>{};
+    /// Multiply all matrix members with a constant and store the result in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator*=(const T &_c) {
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] *= _c;
+        });
+        return *this;
     }
 
 
-    /// Divide all matrix elements with a constant
-    template<typename T>
-    Matrix3<T> Matrix3<T>::operator/(const T &_c) const { 
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> out;
-            out.row1 = Vector3<T>{row1.first / _c, row1.second / _c, row1.third / _c};
-            out.row2 = Vector3<T>{row2.first / _c, row2.second / _c, row2.third / _c};
-            out.row3 = Vector3<T>{row3.first / _c, row3.second / _c, row3.third / _c};
-
-            return out;
+    /// Multiply the current matrix with a square matrix from the right and store the result in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator*=(const Matrix<T, C, C> &_mat) {
+        if constexpr (C == 4 && FastRows4<T>::value) {
+            if(FastRows4<T>::Enabled()) {
+                FastMatMul4<R>(Data(), _mat.Data(), Data());
+                return *this;
+            }
         }
 
-        else return Matrix3<T>{};
+        *this = *this * _mat;
+        return *this;
     }
 
 
-    /// Multiply all matrix members with a constant and set the product as the value of the current matrix instance
-	template<typename T>
-    void Matrix3<T>::operator*=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first *= _c;
-            row1.second *= _c;
-            row1.third *= _c;
+    /// Add constant value to matrix and store the value in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator+=(const T &_c) {
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] += _c;
+        });
+        return *this;
+    }
 
-            row2.first *= _c;
-            row2.second *= _c;
-            row2.third *= _c;
 
-            row3.first *= _c;
-            row3.second *= _c;
-            row3.third *= _c;
-        }
+    /// Add two matrices together and store the value in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator+=(const Matrix<T, R, C> &_mat) {
+        const T *in = _mat.Data();
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] += in[i];
+        });
+        return *this;
     }
 
 
-    /// Find the cross product of two matrices and set the current matrix instance value to it
-    template<typename T>
-    void Matrix3<T>::operator*=(const Matrix3<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> new_mat{};
-            new_mat.row1 = {
-                ((row1.first * _mat.row1.first) + (row1.second * _mat.row2.first) + (row1.third * _mat.row3.first)), 
-                ((row1.first * _mat.row1.second) + (row1.second * _mat.row2.second) + (row1.third * _mat.row3.second)), 
-                ((row1.first * _mat.row1.third) + (row1.second * _mat.row2.third) + (row1.third * _mat.row3.third)) 
-            };
-
-            new_mat.row2 = {
-                ((row2.first * _mat.row1.first) + (row2.second * _mat.row2.first) + (row2.third * _mat.row3.first)), 
-                ((row2.first * _mat.row1.second) + (row2.second * _mat.row2.second) + (row2.third * _mat.row3.second)), 
-                ((row2.first * _mat.row1.third) + (row2.second * _mat.row2.third) + (row2.third * _mat.row3.third)) 
-            };
+    /// Substract constant value from matrix and store the result in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator-=(const T &_c) {
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] -= _c;
+        });
+        return *this;
+    }
 
-            new_mat.row3 = {
-                ((row3.first * _mat.row1.first) + (row3.second * _mat.row2.first) + (row3.third * _mat.row3.first)), 
-                ((row3.first * _mat.row1.second) + (row3.second * _mat.row2.second) + (row3.third * _mat.row3.second)), 
-                ((row3.first * _mat.row1.third) + (row3.second * _mat.row2.third) + (row3.third * _mat.row3.third))
-            };
 
-            *this = new_mat;
-        }
+    /// Substract a matrix from current matrix and store the result in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator-=(const Matrix<T, R, C> &_mat) {
+        const T *in = _mat.Data();
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] -= in[i];
+        });
+        return *this;
     }
 
 
-    /// Add constant value to matrix and store the value in current matrix instance
-    template<typename T>
-    void Matrix3<T>::operator+=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _c;
-            row1.second += _c;
-            row1.third += _c;
+    /// Divide all matrix elements with constant and store the value in current matrix instance
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C>& Matrix<T, R, C>::operator/=(const T &_c) {
+        T *out = Data();
+        Unroll<R * C>([&](auto i) {
+            out[i] /= _c;
+        });
+        return *this;
+    }
 
-            row2.first += _c;
-            row2.second += _c;
-            row2.third += _c;
 
-            row3.first += _c;
-            row3.second += _c;
-            row3.third += _c;
-        }
+    /// Check if current and given matrix instances have equal values
+    template<typename T, size_t R, size_t C>
+    bool Matrix<T, R, C>::operator==(const Matrix<T, R, C> &_mat) const {
+        const T *a = Data();
+        const T *b = _mat.Data();
+        bool is_equal = true;
+        Unroll<R * C>([&](auto i) {
+            is_equal = is_equal && a[i] == b[i];
+        });
+        return is_equal;
     }
 
 
-    /// Add two matrices together and store the value in current matrix instance
-    template<typename T>
-    void Matrix3<T>::operator+=(const Matrix3<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _mat.row1.first;
-            row1.second += _mat.row1.second;
-            row1.third += _mat.row1.third;
+    /// Check if current and given matrix instances don't have equal values
+    template<typename T, size_t R, size_t C>
+    bool Matrix<T, R, C>::operator!=(const Matrix<T, R, C> &_mat) const {
+        return !(*this == _mat);
+    }
 
-            row2.first += _mat.row2.first;
-            row2.second += _mat.row2.second;
 
-            row3.first += _mat.row3.first;
-            row3.second += _mat.row3.second;
-            row3.third += _mat.row3.third;
+    /// Find the determinant of a square matrix
+    /// The 4x4 determinant shares 2x2 sub-determinants of the upper and lower row pairs between all 3x3 minors
+    template<typename T, size_t R, size_t C>
+    template<typename DT>
+    DT Matrix<T, R, C>::Determinant(const Matrix<DT, R, C> &_mat) {
+        static_assert(R == C, "Determinant needs a square matrix");
+        const DT *m = _mat.Data();
+
+        if constexpr (R == 2) {
+            return m[0] * m[3] - m[1] * m[2];
+        } else if constexpr (R == 3) {
+            return m[0] * (m[4] * m[8] - m[5] * m[7]) -
+                   m[1] * (m[3] * m[8] - m[5] * m[6]) +
+                   m[2] * (m[3] * m[7] - m[4] * m[6]);
+        } else {
+            const DT s0 = m[0] * m[5] - m[1] * m[4];
+            const DT s1 = m[0] * m[6] - m[2] * m[4];
+            const DT s2 = m[0] * m[7] - m[3] * m[4];
+            const DT s3 = m[1] * m[6] - m[2] * m[5];
+            const DT s4 = m[1] * m[7] - m[3] * m[5];
+            const DT s5 = m[2] * m[7] - m[3] * m[6];
+
+            const DT c0 = m[8] * m[13] - m[9] * m[12];
+            const DT c1 = m[8] * m[14] - m[10] * m[12];
+            const DT c2 = m[8] * m[15] - m[11] * m[12];
+            const DT c3 = m[9] * m[14] - m[10] * m[13];
+            const DT c4 = m[9] * m[15] - m[11] * m[13];
+            const DT c5 = m[10] * m[15] - m[11] * m[14];
+
+            return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+        }
+    }
+
+
+    /// Find the inverse of the current square matrix
+    /// Inverses are adjugates scaled with the reciprocal determinant, 4x4 cofactors are built from shared 2x2
+    /// sub-determinants and float and double 4x4 matrices use the SIMD block inverse.
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::Inverse() const {
+        static_assert(R == C, "Inverse needs a square matrix");
+
+        // integral matrices are scaled with a float reciprocal
+        using inv_t = typename std::conditional<std::is_floating_point<T>::value, T, float>::type;
+        const T *m = Data();
+        Matrix<T, R, C> out_mat;
+        T *out = out_mat.Data();
+
+        if constexpr (R == 4 && FastInverse4x4<T>::value) {
+            if(FastInverse4x4<T>::Enabled()) {
+                FastInverse4(m, out);
+                return out_mat;
+            }
         }
-    }
-
 
-    /// Substract constant value from matrix and store the result in current matrix instance
-    template<typename T>
-    void Matrix3<T>::operator-=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _c;
-            row1.second -= _c;
-            row1.third -= _c;
+        if constexpr (R == 2) {
+            const inv_t inv_det = static_cast<inv_t>(1) / static_cast<inv_t>(Determinant(*this));
+            out[0] = static_cast<T>(inv_det * m[3]);
+            out[1] = static_cast<T>(inv_det * -m[1]);
+            out[2] = static_cast<T>(inv_det * -m[2]);
+            out[3] = static_cast<T>(inv_det * m[0]);
+        } else if constexpr (R == 3) {
+            const T adj[9] = {
+                m[4] * m[8] - m[5] * m[7], m[2] * m[7] - m[1] * m[8], m[1] * m[5] - m[2] * m[4],
+                m[5] * m[6] - m[3] * m[8], m[0] * m[8] - m[2] * m[6], m[2] * m[3] - m[0] * m[5],
+                m[3] * m[7] - m[4] * m[6], m[1] * m[6] - m[0] * m[7], m[0] * m[4] - m[1] * m[3]
+            };
 
-            row2.first -= _c;
-            row2.second -= _c;
-            row2.third -= _c;
+            const inv_t inv_det = static_cast<inv_t>(1) / static_cast<inv_t>(m[0] * adj[0] + m[1] * adj[3] + m[2] * adj[6]);
+            Unroll<9>([&](auto i) {
+                out[i] = static_cast<T>(inv_det * adj[i]);
+            });
+        } else {
+            const T s0 = m[0] * m[5] - m[1] * m[4];
+            const T s1 = m[0] * m[6] - m[2] * m[4];
+            const T s2 = m[0] * m[7] - m[3] * m[4];
+            const T s3 = m[1] * m[6] - m[2] * m[5];
+            const T s4 = m[1] * m[7] - m[3] * m[5];
+            const T s5 = m[2] * m[7] - m[3] * m[6];
+
+            const T c0 = m[8] * m[13] - m[9] * m[12];
+            const T c1 = m[8] * m[14] - m[10] * m[12];
+            const T c2 = m[8] * m[15] - m[11] * m[12];
+            const T c3 = m[9] * m[14] - m[10] * m[13];
+            const T c4 = m[9] * m[15] - m[11] * m[13];
+            const T c5 = m[10] * m[15] - m[11] * m[14];
+
+            const inv_t inv_det = static_cast<inv_t>(1) / static_cast<inv_t>(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+            const T adj[16] = {
+                m[5] * c5 - m[6] * c4 + m[7] * c3,
+                -m[1] * c5 + m[2] * c4 - m[3] * c3,
+                m[13] * s5 - m[14] * s4 + m[15] * s3,
+                -m[9] * s5 + m[10] * s4 - m[11] * s3,
+
+                -m[4] * c5 + m[6] * c2 - m[7] * c1,
+                m[0] * c5 - m[2] * c2 + m[3] * c1,
+                -m[12] * s5 + m[14] * s2 - m[15] * s1,
+                m[8] * s5 - m[10] * s2 + m[11] * s1,
+
+                m[4] * c4 - m[5] * c2 + m[7] * c0,
+                -m[0] * c4 + m[1] * c2 - m[3] * c0,
+                m[12] * s4 - m[13] * s2 + m[15] * s0,
+                -m[8] * s4 + m[9] * s2 - m[11] * s0,
+
+                -m[4] * c3 + m[5] * c1 - m[6] * c0,
+                m[0] * c3 - m[1] * c1 + m[2] * c0,
+                -m[12] * s3 + m[13] * s1 - m[14] * s0,
+                m[8] * s3 - m[9] * s1 + m[10] * s0
+            };
 
-            row3.first -= _c;
-            row3.second -= _c;
-            row3.third -= _c;
+            Unroll<16>([&](auto i) {
+                out[i] = static_cast<T>(inv_det * adj[i]);
+            });
         }
+
+        return out_mat;
     }
 
 
-    /// Substract a matrix from current matrix and store the result in current matrix instance
-    template<typename T>
-    void Matrix3<T>::operator-=(const Matrix3<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _mat.row1.first;
-            row1.second -= _mat.row1.second;
-            row1.third -= _mat.row1.third;
+    /// Find the inverse of an affine 3x4 or 4x4 matrix
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::AffineInverse() const {
+        static_assert((R == 3 || R == 4) && C == 4, "AffineInverse needs a 3x4 or 4x4 matrix");
+        assert(IsAffine());
+
+        Matrix<T, R, C> out_mat;
+        if constexpr (std::is_same<T, float>::value) {
+            FastAffineInverse4<R>(Data(), out_mat.Data());
+        } else {
+            using inv_t = typename std::conditional<std::is_floating_point<T>::value, T, float>::type;
+
+            // columns of the 3x3 adjugate are cross products of the rows
+            const Vector3<T> r0 = { this->row1.first, this->row1.second, this->row1.third };
+            const Vector3<T> r1 = { this->row2.first, this->row2.second, this->row2.third };
+            const Vector3<T> r2 = { this->row3.first, this->row3.second, this->row3.third };
+            const Vector3<T> c0 = Vector3<T>::Cross(r1, r2);
+            const Vector3<T> c1 = Vector3<T>::Cross(r2, r0);
+            const Vector3<T> c2 = Vector3<T>::Cross(r0, r1);
+            const inv_t inv_det = static_cast<inv_t>(1) / static_cast<inv_t>(r0 * c0);
 
-            row2.first -= _mat.row2.first;
-            row2.second -= _mat.row2.second;
-            row2.third -= _mat.row2.third;
+            out_mat.row1 = { static_cast<T>(c0.first * inv_det), static_cast<T>(c1.first * inv_det), static_cast<T>(c2.first * inv_det), 0 };
+            out_mat.row2 = { static_cast<T>(c0.second * inv_det), static_cast<T>(c1.second * inv_det), static_cast<T>(c2.second * inv_det), 0 };
+            out_mat.row3 = { static_cast<T>(c0.third * inv_det), static_cast<T>(c1.third * inv_det), static_cast<T>(c2.third * inv_det), 0 };
 
-            row3.first -= _mat.row3.first;
-            row3.second -= _mat.row3.second;
-            row3.third -= _mat.row3.third;
+            // t' = -R^-1 * t
+            out_mat.row1.fourth = -(out_mat.row1.first * this->row1.fourth + out_mat.row1.second * this->row2.fourth + out_mat.row1.third * this->row3.fourth);
+            out_mat.row2.fourth = -(out_mat.row2.first * this->row1.fourth + out_mat.row2.second * this->row2.fourth + out_mat.row2.third * this->row3.fourth);
+            out_mat.row3.fourth = -(out_mat.row3.first * this->row1.fourth + out_mat.row3.second * this->row2.fourth + out_mat.row3.third * this->row3.fourth);
         }
+
+        return out_mat;
     }
 
 
-    /// Divide all matrix elements with constant and store the value in current matrix instance
-    template<typename T>
-    void Matrix3<T>::operator/=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first /= _c;
-            row1.second /= _c;
-            row1.third /= _c;
+    /// Find the inverse of a rigid body 3x4 or 4x4 matrix
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> Matrix<T, R, C>::RigidInverse() const {
+        static_assert((R == 3 || R == 4) && C == 4, "RigidInverse needs a 3x4 or 4x4 matrix");
+        assert(IsRigid());
 
-            row2.first /= _c;
-            row2.second /= _c;
-            row2.third /= _c;
+        Matrix<T, R, C> out_mat;
+        if constexpr (std::is_same<T, float>::value) {
+            FastRigidInverse4<R>(Data(), out_mat.Data());
+        } else {
+            out_mat.row1 = { this->row1.first, this->row2.first, this->row3.first, 0 };
+            out_mat.row2 = { this->row1.second, this->row2.second, this->row3.second, 0 };
+            out_mat.row3 = { this->row1.third, this->row2.third, this->row3.third, 0 };
 
-            row3.first /= _c;
-            row3.second /= _c;
-            row3.third /= _c;
+            // t' = -R^T * t
+            out_mat.row1.fourth = -(this->row1.first * this->row1.fourth + this->row2.first * this->row2.fourth + this->row3.first * this->row3.fourth);
+            out_mat.row2.fourth = -(this->row1.second * this->row1.fourth + this->row2.second * this->row2.fourth + this->row3.second * this->row3.fourth);
+            out_mat.row3.fourth = -(this->row1.third * this->row1.fourth + this->row2.third * this->row2.fourth + this->row3.third * this->row3.fourth);
         }
-    }
-    
-    
-    /// Check if current and given matrix instances have equal values
-    template<typename T>
-    bool Matrix3<T>::operator==(const Matrix3<T> &_mat) const {
-        return row1 == _mat.row1 && row2 == _mat.row2 && row3 == _mat.row3;
+
+        return out_mat;
     }
 
 
-    /// Check if current and given matrix instances don't have equal values
-    template <typename T>
-    bool Matrix3<T>::operator!=(const Matrix3<T> &_mat) const {
-        return row1 != _mat.row1 || row2 != _mat.row2 || row3 != _mat.row3;
+    /// Check if the current 3x4 or 4x4 matrix is affine
+    template<typename T, size_t R, size_t C>
+    bool Matrix<T, R, C>::IsAffine() const {
+        static_assert((R == 3 || R == 4) && C == 4, "IsAffine needs a 3x4 or 4x4 matrix");
+        if constexpr (R == 3)
+            return true;
+        else return this->row4.first == 0 && this->row4.second == 0 && this->row4.third == 0 && this->row4.fourth == 1;
     }
 
 
-    /// Find the determinant of current matrix instance
-    template<typename T>
-    template<typename DT>
-    DT Matrix3<T>::Determinant(const Matrix3<DT> &_mat) {
-        return static_cast<DT>(
-            (_mat.row1.first * _mat.row2.second * _mat.row3.third) +
-            (_mat.row1.second * _mat.row2.third * _mat.row3.first) + 
-            (_mat.row1.third * _mat.row2.first * _mat.row3.second) -
-
-            (_mat.row1.third * _mat.row2.second * _mat.row3.first) -
-            (_mat.row1.first * _mat.row2.third * _mat.row3.second) -
-            (_mat.row1.second * _mat.row2.first * _mat.row3.third) 
-        );
-    }
+    /// Check if current matrix is affine and its 3x3 block is orthonormal within given tolerance
+    template<typename T, size_t R, size_t C>
+    bool Matrix<T, R, C>::IsRigid(const T &_eps) const {
+        if(!IsAffine())
+            return false;
 
+        const Vector3<T> r0 = { this->row1.first, this->row1.second, this->row1.third };
+        const Vector3<T> r1 = { this->row2.first, this->row2.second, this->row2.third };
+        const Vector3<T> r2 = { this->row3.first, this->row3.second, this->row3.third };
 
-    /// Find the inverse of the current matrix 
-    template<typename T>
-    Matrix3<T> Matrix3<T>::Inverse() const {
-        Matrix3<float> fl_mat;
-        float inv_det = 1 / Matrix3<T>::Determinant(*this);
-
-        fl_mat.row1 = {
-            inv_det * (row2.second * row3.third - row2.third * row3.second),
-            inv_det * -(row1.second * row3.third - row1.third * row3.second),
-            inv_det * (row1.second * row2.third - row1.third * row2.second) 
-        };
-
-        fl_mat.row2 = {
-            inv_det * -(row2.first * row3.third - row2.third * row3.first),
-            inv_det * (row1.first * row3.third - row1.third * row3.first),
-            inv_det * -(row1.first * row2.third - row1.third * row2.first)
-        };
-        
-        fl_mat.row3 = {
-            inv_det * (row2.first * row3.second - row2.second * row3.first),
-            inv_det * -(row1.first * row3.second - row1.second * row3.first),
-            inv_det * (row1.first * row2.second - row1.second * row2.first)
-        };
-
-        Matrix3<T> out_mat;
-        out_mat.row1 = {(T) fl_mat.row1.first, (T) fl_mat.row1.second, (T) fl_mat.row1.third}; 
-        out_mat.row2 = {(T) fl_mat.row2.first, (T) fl_mat.row2.second, (T) fl_mat.row2.third};
-        out_mat.row3 = {(T) fl_mat.row3.first, (T) fl_mat.row3.second, (T) fl_mat.row3.third};
-        
-        return out_mat;
+        // R * R^T must be identity
+        const T dots[6] = { r0 * r0 - 1, r1 * r1 - 1, r2 * r2 - 1, r0 * r1, r0 * r2, r1 * r2 };
+        for(int i = 0; i < 6; i++) {
+            if(dots[i] > _eps || dots[i] < -_eps)
+                return false;
+        }
+
+        return true;
     }
 
 
     /// Transpose the current matrix
-    template<typename T>
-    Matrix3<T> Matrix3<T>::Transpose() const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix3<T> new_mat{};
-            new_mat.row1 = Vector3<T>{row1.first, row2.first, row3.first};
-            new_mat.row2 = Vector3<T>{row1.second, row2.second, row3.second};
-            new_mat.row3 = Vector3<T>{row1.third, row2.third, row3.third};
-
-            return new_mat;
+    template<typename T, size_t R, size_t C>
+    Matrix<T, C, R> Matrix<T, R, C>::Transpose() const {
+        Matrix<T, C, R> out_mat;
+        if constexpr (R == 4 && C == 4 && FastRows4<T>::value) {
+            if(FastRows4<T>::Enabled()) {
+                FastTranspose4(Data(), out_mat.Data());
+                return out_mat;
+            }
         }
 
-        else return Matrix3<T>{};
+        const T *in = Data();
+        T *out = out_mat.Data();
+        Unroll<R * C>([&](auto i) {
+            out[i % C * R + i / C] = in[i];
+        });
+
+        return out_mat;
     }
 
 
 #ifdef _DEBUG
-    template<typename T>
-    void Matrix3<T>::Log(const std::string &desc) {
-        std::cout << "MAT_LOG: " <<  desc << std::endl;
-        std::cout << row1.first << " | " << row1.second << " | " << row1.third << std::endl;
-        std::cout << row2.first << " | " << row2.second << " | " << row2.third << std::endl;
-        std::cout << row3.first << " | " << row3.second << " | " << row3.third << "\n" << std::endl;
+    template<typename T, size_t R, size_t C>
+    void Matrix<T, R, C>::Log(const std::string &_desc) {
+        std::cout << "MAT_LOG: " << _desc << std::endl;
+        for(size_t i = 0; i < R; i++) {
+            for(size_t j = 0; j < C; j++)
+                std::cout << Data()[i * C + j] << (j + 1 < C ? " | " : "\n");
+        }
+        std::cout << std::endl;
     }
 #endif
 
 
     /**
-     * 4x4 matrix structure
+     * 4x4 matrix structure with column-major storage
+     * Memory layout matches what graphics APIs expect, so it can be uploaded without transposing.
+     * Storage of a column-major matrix is the row-major storage of its transpose, which lets
+     * all row-major SIMD kernels be reused with swapped operands.
      */
     template<typename T>
-    struct Matrix4 {
+    struct alignas(Vector4Alignment<T>::value) ColMatrix4 {
 #ifdef ITERATORS_H
         typedef MatrixIterator<T> iterator;
 #endif
-        Matrix4() noexcept;
-        Matrix4(const Vector4<T> &_r1, const Vector4<T> &_r2, const Vector4<T> &_r3, const Vector4<T> &_r4) noexcept;
-        Matrix4(Vector4<T> &&_r1, Vector4<T> &&_r2, Vector4<T> &&_r3, Vector4<T> &&_r4) noexcept;
-        Matrix4(const Matrix4<T> &_val) noexcept;
-        Matrix4(Matrix4<T>&& _val) noexcept;
-        void operator=(const Matrix4<T> &_val);
+        ColMatrix4() noexcept;
+        ColMatrix4(const Vector4<T> &_c1, const Vector4<T> &_c2, const Vector4<T> &_c3, const Vector4<T> &_c4) noexcept;
+        ColMatrix4(const ColMatrix4<T> &_val) noexcept;
+        explicit ColMatrix4(const Matrix4<T> &_mat) noexcept;
+        void operator=(const ColMatrix4<T> &_val);
 
-        Vector4<T> row1, row2, row3, row4; 
+        Vector4<T> col1, col2, col3, col4;
 
 
         /******************************/
         /***** Operator overloads *****/
         /******************************/
 
-        Matrix4<T> operator+(const Matrix4<T> &_mat) const; 
-        Matrix4<T> operator+(const T &_c) const;
-        Matrix4<T> operator-(const Matrix4<T> &_mat) const;
-        Matrix4<T> operator-(const T &_c) const;
-        Matrix4<T> operator*(const T &_c) const;
-        Matrix4<T> operator*(const Matrix4<T> &_mat) const; 
-        Vector4<T> operator*(const Vector4<T> &_vec) const; 
-        Matrix4<T> operator/(const T &_c) const;
-        void operator*=(const T &_c);
-        void operator*=(const Matrix4<T> &_mat);
-        void operator+=(const T &_c);
-        void operator+=(const Matrix4<T> &_mat);
-        void operator-=(const T &_c);
-        void operator-=(const Matrix4<T> &_mat);
-        void operator/=(const T &_c);
-        bool operator==(const Matrix4<T> &_mat) const;
-        bool operator!=(const Matrix4<T> &_mat) const;
-
-        Vector4<T> operator[](size_t i) const { return (&row1)[i]; }
-        Vector4<T>& operator[](size_t i) { return (&row1)[i]; }
+        ColMatrix4<T> operator+(const ColMatrix4<T> &_mat) const;
+        ColMatrix4<T> operator-(const ColMatrix4<T> &_mat) const;
+        ColMatrix4<T> operator*(const T &_c) const;
+        ColMatrix4<T> operator*(const ColMatrix4<T> &_mat) const;
+        Vector4<T> operator*(const Vector4<T> &_vec) const;
+        void operator*=(const ColMatrix4<T> &_mat);
+        bool operator==(const ColMatrix4<T> &_mat) const;
+        bool operator!=(const ColMatrix4<T> &_mat) const;
 
+        Vector4<T> operator[](size_t i) const { return (&col1)[i]; }
+        Vector4<T>& operator[](size_t i) { return (&col1)[i]; }
 
-        /// Find the determinant of current matrix instance
-        template<typename DT>
-        static DT Determinant(const Matrix4<DT> &_mat);
 
-        
-        /// Find the inverse of the current matrix 
-        Matrix4<T> Inverse() const;
+        /// Find the inverse of the current matrix
+        ColMatrix4<T> Inverse() const;
 
 
         /// Transpose the current matrix
-        Matrix4<T> Transpose() const;
+        ColMatrix4<T> Transpose() const;
 
-#ifdef ITERATORS_H
-        // iterators
-        iterator BeginRowMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 4, true);
-        }
 
-        iterator EndRowMajor() const {
-            return iterator(const_cast<T*>(&row4.fourth + 1), 4, true);
-        }
+        /// Convert the current matrix into row-major storage
+        Matrix4<T> ToRowMajor() const;
 
+#ifdef ITERATORS_H
+        // iterators, storage order is column-major
         iterator BeginColumnMajor() const {
-            return iterator(const_cast<T*>(&row1.first), 4, false);
+            return iterator(const_cast<T*>(&col1.first), 4, true);
         }
 
         iterator EndColumnMajor() const {
-            return iterator(const_cast<T*>(&row4.fourth + 1), 4, false);
+            return iterator(const_cast<T*>(&col4.fourth + 1), 4, true);
         }
 #endif
-
-
-#ifdef _DEBUG
-        /// Log matrix into console output and add description to it
-        void Log(const std::string &desc);
-#endif
     };
 
 
     template<typename T>
-    Matrix4<T>::Matrix4() noexcept {
+    ColMatrix4<T>::ColMatrix4() noexcept {
         if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1 = Vector4<T>{1, 0, 0, 0};
-            row2 = Vector4<T>{0, 1, 0, 0};
-            row3 = Vector4<T>{0, 0, 1, 0};
-            row4 = Vector4<T>{0, 0, 0, 1};
+            col1 = Vector4<T>{1, 0, 0, 0};
+            col2 = Vector4<T>{0, 1, 0, 0};
+            col3 = Vector4<T>{0, 0, 1, 0};
+            col4 = Vector4<T>{0, 0, 0, 1};
         }
     }
 
 
     template<typename T>
-    Matrix4<T>::Matrix4(const Vector4<T> &_r1, const Vector4<T> &_r2, const Vector4<T> &_r3, const Vector4<T> &_r4) noexcept {
-        row1 = _r1;
-        row2 = _r2;
-        row3 = _r3;
-        row4 = _r4;
+    ColMatrix4<T>::ColMatrix4(const Vector4<T> &_c1, const Vector4<T> &_c2, const Vector4<T> &_c3, const Vector4<T> &_c4) noexcept {
+        col1 = _c1;
+        col2 = _c2;
+        col3 = _c3;
+        col4 = _c4;
     }
 
 
     template<typename T>
-    Matrix4<T>::Matrix4(Vector4<T> &&_r1, Vector4<T> &&_r2, Vector4<T> &&_r3, Vector4<T> &&_r4) noexcept {
-        row1 = std::move(_r1);
-        row2 = std::move(_r2);
-        row3 = std::move(_r3);
-        row4 = std::move(_r4);
+    ColMatrix4<T>::ColMatrix4(const ColMatrix4<T> &_val) noexcept {
+        col1 = _val.col1;
+        col2 = _val.col2;
+        col3 = _val.col3;
+        col4 = _val.col4;
     }
 
 
     template<typename T>
-    Matrix4<T>::Matrix4(const Matrix4<T> &_val) noexcept {
-        row1 = _val.row1;
-        row2 = _val.row2;
-        row3 = _val.row3;
-        row4 = _val.row4;
+    ColMatrix4<T>::ColMatrix4(const Matrix4<T> &_mat) noexcept {
+        if constexpr (std::is_same<T, float>::value)
+            FastTranspose4(&_mat.row1.first, &col1.first);
+        else {
+            const Matrix4<T> t = _mat.Transpose();
+            col1 = t.row1;
+            col2 = t.row2;
+            col3 = t.row3;
+            col4 = t.row4;
+        }
     }
 
 
     template<typename T>
-    Matrix4<T>::Matrix4(Matrix4<T> &&_val) noexcept {
-        row1 = std::move(_val.row1);
-        row2 = std::move(_val.row2);
-        row3 = std::move(_val.row3);
-        row4 = std::move(_val.row4);
+    void ColMatrix4<T>::operator=(const ColMatrix4<T> &_val) {
+        col1 = _val.col1;
+        col2 = _val.col2;
+        col3 = _val.col3;
+        col4 = _val.col4;
     }
 
 
-    template<typename T>
-    void Matrix4<T>::operator=(const Matrix4<T> &_val) {
-        row1 = _val.row1;
-        row2 = _val.row2;
-        row3 = _val.row3;
-        row4 = _val.row4;
-    }
-
-    
     /// Add two matrices together
     template<typename T>
-    Matrix4<T> Matrix4<T>::operator+(const Matrix4<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out;
-            out.row1 = {row1.first + _mat.row1.first, row1.second + _mat.row1.second, row1.third + _mat.row1.third, row1.fourth + _mat.row1.fourth};
-            out.row2 = {row2.first + _mat.row2.first, row2.second + _mat.row2.second, row2.third + _mat.row2.third, row2.fourth + _mat.row2.fourth};
-            out.row3 = {row3.first + _mat.row3.first, row3.second + _mat.row3.second, row3.third + _mat.row3.third, row3.fourth + _mat.row3.fourth};
-            out.row4 = {row4.first + _mat.row4.first, row4.second + _mat.row4.second, row4.third + _mat.row4.third, row4.fourth + _mat.row4.fourth};
-
-            return out;
-        }
-
-        else return Matrix4<T>{};
+    ColMatrix4<T> ColMatrix4<T>::operator+(const ColMatrix4<T> &_mat) const {
+        return ColMatrix4<T>(col1 + _mat.col1, col2 + _mat.col2, col3 + _mat.col3, col4 + _mat.col4);
     }
 
 
-    /// Add constant to the current matrix
+    /// Substract given matrix from current matrix
     template<typename T>
-    Matrix4<T> Matrix4<T>::operator+(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out{};
-            out.row1 = Vector4<T>{row1.first + _c, row1.second + _c, row1.third + _c, row1.fourth + _c};
-            out.row2 = Vector4<T>{row2.first + _c, row2.second + _c, row2.third + _c, row2.fourth + _c};
-            out.row3 = Vector4<T>{row3.first + _c, row3.second + _c, row3.third + _c, row3.fourth + _c};
-            out.row4 = Vector4<T>{row4.first + _c, row4.second + _c, row4.third + _c, row4.fourth + _c};
-
-            return out;
-        }
-
-        else return Matrix4<T>{};
+    ColMatrix4<T> ColMatrix4<T>::operator-(const ColMatrix4<T> &_mat) const {
+        return ColMatrix4<T>(col1 - _mat.col1, col2 - _mat.col2, col3 - _mat.col3, col4 - _mat.col4);
     }
 
 
-    /// Substract current matrix with given matrix
-    template<typename T>
-    Matrix4<T> Matrix4<T>::operator-(const Matrix4<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out{};
-            out.row1 = Vector4<T>{row1.first - _mat.row1.first, row1.second - _mat.row1.second, row1.third - _mat.row1.third, row1.fourth - _mat.row1.fourth};
-            out.row2 = Vector4<T>{row2.first - _mat.row2.first, row2.second - _mat.row2.second, row2.second - _mat.row2.third, row2.fourth - _mat.row2.fourth};
-            out.row3 = Vector4<T>{row3.first - _mat.row3.first, row3.second - _mat.row3.second, row3.second - _mat.row3.third, row3.fourth - _mat.row3.fourth};
-            out.row4 = Vector4<T>{row4.first - _mat.row4.first, row4.second - _mat.row4.second, row4.second - _mat.row4.third, row4.fourth - _mat.row4.fourth};
-
-            return out;
-        }
-
-        else return Matrix4<T>{};
-    }
-
-
-    /// Substract a constant number from the current matrix
+    /// Multiply all matrix members with a constant
     template<typename T>
-    Matrix4<T> Matrix4<T>::operator-(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out{};
-            out.row1 = Vector4<T>{row1.first - _c, row1.second - _c, row1.third - _c, row1.fourth - _c};
-            out.row2 = Vector4<T>{row2.first - _c, row2.second - _c, row2.third - _c, row2.fourth - _c};
-            out.row3 = Vector4<T>{row3.first - _c, row3.second - _c, row3.third - _c, row3.fourth - _c};
-            out.row4 = Vector4<T>{row4.first - _c, row4.second - _c, row4.third - _c, row4.fourth - _c};
-
-            return out;
-        }
-
-        else return Matrix4<T>{};
+    ColMatrix4<T> ColMatrix4<T>::operator*(const T &_c) const {
+        return ColMatrix4<T>(col1 * _c, col2 * _c, col3 * _c, col4 * _c);
     }
 
 
-    /// Multiply all matrix members with a constant
-    template<typename T>
-    Matrix4<T> Matrix4<T>::operator*(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out;
-            out.row1 = {row1.first * _c, row1.second * _c, row1.third * _c, row1.fourth * _c};
-            out.row2 = {row2.first * _c, row2.second * _c, row2.third * _c, row2.fourth * _c};
-            out.row3 = {row3.first * _c, row3.second * _c, row3.third * _c, row3.fourth * _c};
-            out.row4 = {row4.first * _c, row4.second * _c, row4.third * _c, row4.fourth * _c};
-            return out;
-        }
-
-        else return Matrix4<T>{};
-    }
- 
-    
     /// Find the dot product of two matrices
+    /// Every output column is a linear combination of current matrix columns
     template<typename T>
-    Matrix4<T> Matrix4<T>::operator*(const Matrix4<T> &_mat) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out_mat;
-            out_mat.row1 = Vector4<T>{
-                ((row1.first * _mat.row1.first) + (row1.second * _mat.row2.first) + (row1.third * _mat.row3.first) + (row1.fourth * _mat.row4.first)), 
-                ((row1.first * _mat.row1.second) + (row1.second * _mat.row2.second) + (row1.third * _mat.row3.second) + (row1.fourth * _mat.row4.second)), 
-                ((row1.first * _mat.row1.third) + (row1.second * _mat.row2.third) + (row1.third * _mat.row3.third) + (row1.fourth * _mat.row4.third)), 
-                ((row1.first * _mat.row1.fourth) + (row1.second * _mat.row2.fourth) + (row1.third * _mat.row3.fourth) + (row1.fourth * _mat.row4.fourth))
-            };
-
-            out_mat.row2 = Vector4<T>{ 
-                ((row2.first * _mat.row1.first) + (row2.second * _mat.row2.first) + (row2.third * _mat.row3.first) + (row2.fourth * _mat.row4.first)), 
-                ((row2.first * _mat.row1.second) + (row2.second * _mat.row2.second) + (row2.third * _mat.row3.second) + (row2.fourth * _mat.row4.second)), 
-                ((row2.first * _mat.row1.third) + (row2.second * _mat.row2.third) + (row2.third * _mat.row3.third) + (row2.fourth * _mat.row4.third)), 
-                ((row2.first * _mat.row1.fourth) + (row2.second * _mat.row2.fourth) + (row2.third * _mat.row3.fourth) + (row2.fourth * _mat.row4.fourth))
-            };
-
-            out_mat.row3 = Vector4<T>{
-                ((row3.first * _mat.row1.first) + (row3.second * _mat.row2.first) + (row3.third * _mat.row3.first) + (row3.fourth * _mat.row4.first)), 
-                ((row3.first * _mat.row1.second) + (row3.second * _mat.row2.second) + (row3.third * _mat.row3.second) + (row3.fourth * _mat.row4.second)), 
-                ((row3.first * _mat.row1.third) + (row3.second * _mat.row2.third) + (row3.third * _mat.row3.third) + (row3.fourth * _mat.row4.third)), 
-                ((row3.first * _mat.row1.fourth) + (row3.second * _mat.row2.fourth) + (row3.third * _mat.row3.fourth) + (row3.fourth * _mat.row4.fourth))
-            };
-
-            out_mat.row4 = Vector4<T>{
-                ((row4.first * _mat.row1.first) + (row4.second * _mat.row2.first) + (row4.third * _mat.row3.first) + (row4.fourth * _mat.row4.first)), 
-                ((row4.first * _mat.row1.second) + (row4.second * _mat.row2.second) + (row4.third * _mat.row3.second) + (row4.fourth * _mat.row4.second)), 
-                ((row4.first * _mat.row1.third) + (row4.second * _mat.row2.third) + (row4.third * _mat.row3.third) + (row4.fourth * _mat.row4.third)), 
-                ((row4.first * _mat.row1.fourth) + (row4.second * _mat.row2.fourth) + (row4.third * _mat.row3.fourth) + (row4.fourth * _mat.row4.fourth))
-            };
-
+    ColMatrix4<T> ColMatrix4<T>::operator*(const ColMatrix4<T> &_mat) const {
+        if constexpr (std::is_same<T, float>::value) {
+            // column-major A * B is row-major B^T * A^T
+            ColMatrix4<T> out_mat;
+            FastMatMul4(&_mat.col1.first, &col1.first, &out_mat.col1.first);
             return out_mat;
+        } else {
+            return ColMatrix4<T>((*this) * _mat.col1, (*this) * _mat.col2, (*this) * _mat.col3, (*this) * _mat.col4);
         }
-
-        else return Matrix4<T>{};
     }
 
 
     /// Multiply with column vector
     template<typename T>
-    Vector4<T> Matrix4<T>::operator*(const Vector4<T> &_vec) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
+    Vector4<T> ColMatrix4<T>::operator*(const Vector4<T> &_vec) const {
+        if constexpr (std::is_same<T, float>::value) {
             Vector4<T> out_vec;
-            out_vec.first = { _vec.first * row1.first + _vec.second * row1.second + _vec.third * row1.third + _vec.fourth * row1.fourth };
-            out_vec.second = { _vec.first * row2.first + _vec.second * row2.second + _vec.third * row2.third + _vec.fourth * row2.fourth };
-            out_vec.third = { _vec.first * row3.first + _vec.second * row3.second + _vec.third * row3.third + _vec.fourth * row3.fourth };
-            out_vec.fourth = { _vec.first * row4.first + _vec.second * row4.second + _vec.third * row4.third + _vec.fourth * row4.fourth };
-
+            FastLinearCombine4(&col1.first, &_vec.first, &out_vec.first);
             return out_vec;
+        } else {
+            return col1 * _vec.first + col2 * _vec.second + col3 * _vec.third + col4 * _vec.fourth;
         }
-
-        else return Vector4<T>{};
     }
 
 
-    /// Divide all matrix elements with a constant
+    /// Find the dot product of two matrices and set the current matrix instance value to it
     template<typename T>
-    Matrix4<T> Matrix4<T>::operator/(const T &_c) const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> out;
-            out.row1 = Vector4<T>{row1.first / _c, row1.second / _c, row1.third / _c, row1.fourth / _c};
-            out.row2 = Vector4<T>{row2.first / _c, row2.second / _c, row2.third / _c, row2.fourth / _c};
-            out.row3 = Vector4<T>{row3.first / _c, row3.second / _c, row3.third / _c, row3.fourth / _c};
-            out.row4 = Vector4<T>{row4.first / _c, row4.second / _c, row4.third / _c, row4.fourth / _c};
-
-            return out;
-        }
-
-        else return Matrix4<T>{};
+    void ColMatrix4<T>::operator*=(const ColMatrix4<T> &_mat) {
+        if constexpr (std::is_same<T, float>::value)
+            FastMatMul4(&_mat.col1.first, &col1.first, &col1.first);
+        else *this = (*this) * _mat;
     }
 
 
-    /// Multiply all matrix members with a constant and set the product as the value of the current matrix instance
-	template<typename T>
-    void Matrix4<T>::operator*=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first *= _c;
-            row1.second *= _c;
-            row1.third *= _c;
-            row1.fourth *= _c;
-
-            row2.first *= _c;
-            row2.second *= _c;
-            row2.third *= _c;
-            row2.fourth *= _c;
-
-            row3.first *= _c;
-            row3.second *= _c;
-            row3.third *= _c;
-            row3.fourth *= _c;
-
-            row4.first *= _c;
-            row4.second *= _c;
-            row4.third *= _c;
-            row4.fourth *= _c;
-        }
+    /// Check if current and given matrix instances have equal values
+    template<typename T>
+    bool ColMatrix4<T>::operator==(const ColMatrix4<T> &_mat) const {
+        return col1 == _mat.col1 && col2 == _mat.col2 && col3 == _mat.col3 && col4 == _mat.col4;
     }
 
 
-    /// Find the cross product of two matrices and set the current matrix instance value to it
+    /// Check if current and given matrices don't have equal values
     template<typename T>
-    void Matrix4<T>::operator*=(const Matrix4<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> new_mat{};
-            new_mat.row1 = Vector4<T>{
-                ((row1.first * _mat.row1.first) + (row1.second * _mat.row2.first) + (row1.third * _mat.row3.first) + (row1.fourth * _mat.row4.first)), 
-                ((row1.first * _mat.row1.second) + (row1.second * _mat.row2.second) + (row1.third * _mat.row3.second) + (row1.fourth * _mat.row4.second)), 
-                ((row1.first * _mat.row1.third) + (row1.second * _mat.row2.third) + (row1.third * _mat.row3.third) + (row1.fourth * _mat.row4.third)), 
-                ((row1.first * _mat.row1.fourth) + (row1.second * _mat.row2.fourth) + (row1.third * _mat.row3.fourth) + (row1.fourth * _mat.row4.fourth))
-            };
+    bool ColMatrix4<T>::operator!=(const ColMatrix4<T> &_mat) const {
+        return col1 != _mat.col1 || col2 != _mat.col2 || col3 != _mat.col3 || col4 != _mat.col4;
+    }
 
-            new_mat.row2 = Vector4<T>{ 
-                ((row2.first * _mat.row1.first) + (row2.second * _mat.row2.first) + (row2.third * _mat.row3.first) + (row2.fourth * _mat.row4.first)), 
-                ((row2.first * _mat.row1.second) + (row2.second * _mat.row2.second) + (row2.third * _mat.row3.second) + (row2.fourth * _mat.row4.second)), 
-                ((row2.first * _mat.row1.third) + (row2.second * _mat.row2.third) + (row2.third * _mat.row3.third) + (row2.fourth * _mat.row4.third)), 
-                ((row2.first * _mat.row1.fourth) + (row2.second * _mat.row2.fourth) + (row2.third * _mat.row3.fourth) + (row2.fourth * _mat.row4.fourth))
-            };
 
-            new_mat.row3 = Vector4<T>{
-                ((row3.first * _mat.row1.first) + (row3.second * _mat.row2.first) + (row3.third * _mat.row3.first) + (row3.fourth * _mat.row4.first)), 
-                ((row3.first * _mat.row1.second) + (row3.second * _mat.row2.second) + (row3.third * _mat.row3.second) + (row3.fourth * _mat.row4.second)), 
-                ((row3.first * _mat.row1.third) + (row3.second * _mat.row2.third) + (row3.third * _mat.row3.third) + (row3.fourth * _mat.row4.third)), 
-                ((row3.first * _mat.row1.fourth) + (row3.second * _mat.row2.fourth) + (row3.third * _mat.row3.fourth) + (row3.fourth * _mat.row4.fourth))
-            };
+    /// Find the inverse of the current matrix
+    /// Inverse and transpose commute, so the row-major inverse of the storage is the column-major inverse
+    template<typename T>
+    ColMatrix4<T> ColMatrix4<T>::Inverse() const {
+        const Matrix4<T> inv = Matrix4<T>(col1, col2, col3, col4).Inverse();
+        return ColMatrix4<T>(inv.row1, inv.row2, inv.row3, inv.row4);
+    }
 
-            new_mat.row4 = Vector4<T>{
-                ((row4.first * _mat.row1.first) + (row4.second * _mat.row2.first) + (row4.third * _mat.row3.first) + (row4.fourth * _mat.row4.first)), 
-                ((row4.first * _mat.row1.second) + (row4.second * _mat.row2.second) + (row4.third * _mat.row3.second) + (row4.fourth * _mat.row4.second)), 
-                ((row4.first * _mat.row1.third) + (row4.second * _mat.row2.third) + (row4.third * _mat.row3.third) + (row4.fourth * _mat.row4.third)), 
-                ((row4.first * _mat.row1.fourth) + (row4.second * _mat.row2.fourth) + (row4.third * _mat.row3.fourth) + (row4.fourth * _mat.row4.fourth))
-            };
 
-            *this = new_mat;
-        }
+    /// Transpose the current matrix
+    template<typename T>
+    ColMatrix4<T> ColMatrix4<T>::Transpose() const {
+        return ColMatrix4<T>(Matrix4<T>(col1, col2, col3, col4));
     }
 
 
-    /// Add constant value to matrix and store the value in current matrix instance
+    /// Convert the current matrix into row-major storage
     template<typename T>
-    void Matrix4<T>::operator+=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _c;
-            row1.second += _c;
-            row1.third += _c;
-            row1.fourth += _c;
-
-            row2.first += _c;
-            row2.second += _c;
-            row2.third += _c;
-            row2.fourth += _c;
-
-            row3.first += _c;
-            row3.second += _c;
-            row3.third += _c;
-            row3.fourth += _c;
-
-            row4.first += _c;
-            row4.second += _c;
-            row4.third += _c;
-            row4.fourth += _c;
+    Matrix4<T> ColMatrix4<T>::ToRowMajor() const {
+        if constexpr (std::is_same<T, float>::value) {
+            Matrix4<T> out_mat;
+            FastTranspose4(&col1.first, &out_mat.row1.first);
+            return out_mat;
+        } else {
+            return Matrix4<T>(col1, col2, col3, col4).Transpose();
         }
     }
 
 
-    /// Add two matrices together and store the value in current matrix instance
-    template<typename T>
-    void Matrix4<T>::operator+=(const Matrix4<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first += _mat.row1.first;
-            row1.second += _mat.row1.second;
-            row1.third += _mat.row1.third;
-            row1.fourth += _mat.row1.fourth;
-
-            row2.first += _mat.row2.first;
-            row2.second += _mat.row2.second;
-            row2.third += _mat.row2.third;
-            row2.fourth += _mat.row2.fourth;
-
-            row3.first += _mat.row3.first;
-            row3.second += _mat.row3.second;
-            row3.third += _mat.row3.third;
-            row3.fourth += _mat.row3.fourth;
-
-            row4.first += _mat.row4.first;
-            row4.second += _mat.row4.second;
-            row4.third += _mat.row4.third;
-            row4.fourth += _mat.row4.fourth;
-        }
+    /// Convert the current 4x4 matrix into column-major storage
+    template<typename T, size_t R, size_t C>
+    ColMatrix4<T> Matrix<T, R, C>::ToColumnMajor() const {
+        static_assert(R == 4 && C == 4, "ToColumnMajor needs a 4x4 matrix");
+        return ColMatrix4<T>(*this);
     }
 
 
-    /// Substract constant value from matrix and store the result in current matrix instance
-    template<typename T>
-    void Matrix4<T>::operator-=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _c;
-            row1.second -= _c;
-            row1.third -= _c;
-            row1.fourth -= _c;
-
-            row2.first -= _c;
-            row2.second -= _c;
-            row2.third -= _c;
-            row2.fourth -= _c;
-
-            row3.first -= _c;
-            row3.second -= _c;
-            row3.third -= _c;
-            row3.fourth -= _c;
-
-            row4.first -= _c;
-            row4.second -= _c;
-            row4.third -= _c;
-            row4.fourth -= _c;
+    /**
+     * 3x3 float matrix with rows padded to 16 bytes for SIMD instructions
+     * Padding elements of all rows are always kept at zero.
+     */
+    struct alignas(16) Matrix3A {
+        Vector3A row1, row2, row3;
+
+        Matrix3A() noexcept : row1(1, 0, 0), row2(0, 1, 0), row3(0, 0, 1) {}
+        Matrix3A(const Vector3A &_r1, const Vector3A &_r2, const Vector3A &_r3) noexcept : row1(_r1), row2(_r2), row3(_r3) {}
+        explicit Matrix3A(const Matrix3<float> &_mat) noexcept : row1(_mat.row1), row2(_mat.row2), row3(_mat.row3) {}
+
+        /// Convert into packed 3x3 matrix
+        inline Matrix3<float> ToMatrix3() const {
+            return Matrix3<float>(row1.ToVector3(), row2.ToVector3(), row3.ToVector3());
         }
-    }
 
+        ////////////////////////////////////
+        // ***** Operator overloads ***** //
+        ////////////////////////////////////
 
-    /// Substract a matrix from current matrix and store the result in current matrix instance
-    template<typename T>
-    void Matrix4<T>::operator-=(const Matrix4<T> &_mat) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first -= _mat.row1.first;
-            row1.second -= _mat.row1.second;
-            row1.third -= _mat.row1.third;
-            row1.fourth -= _mat.row1.fourth;
-
-            row2.first -= _mat.row2.first;
-            row2.second -= _mat.row2.second;
-            row2.third -= _mat.row2.third;
-            row2.fourth -= _mat.row2.fourth;
-
-            row3.first -= _mat.row3.first;
-            row3.second -= _mat.row3.second;
-            row3.third -= _mat.row3.third;
-            row3.fourth -= _mat.row3.fourth;
-
-            row4.first -= _mat.row4.first;
-            row4.second -= _mat.row4.second;
-            row4.third -= _mat.row4.third;
-            row4.fourth -= _mat.row4.fourth;
+        inline Matrix3A operator+(const Matrix3A &_mat) const {
+            return Matrix3A(row1 + _mat.row1, row2 + _mat.row2, row3 + _mat.row3);
         }
-    }
 
+        inline Matrix3A operator-(const Matrix3A &_mat) const {
+            return Matrix3A(row1 - _mat.row1, row2 - _mat.row2, row3 - _mat.row3);
+        }
 
-    /// Divide all matrix elements with constant and store the value in current matrix instance
-    template<typename T>
-    void Matrix4<T>::operator/=(const T &_c) {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            row1.first /= _c;
-            row1.second /= _c;
-            row1.third /= _c;
-            row1.fourth /= _c;
-
-            row2.first /= _c;
-            row2.second /= _c;
-            row2.third /= _c;
-            row2.fourth /= _c;
-
-            row3.first /= _c;
-            row3.second /= _c;
-            row3.third /= _c;
-            row3.fourth /= _c;
-
-            row4.first /= _c;
-            row4.second /= _c;
-            row4.third /= _c;
-            row4.fourth /= _c;
+        inline Matrix3A operator*(const float _c) const {
+            return Matrix3A(row1 * _c, row2 * _c, row3 * _c);
         }
-    }
-    
-    
-    /// Check if current and given matrix instances have equal values
-    template<typename T>
-    bool Matrix4<T>::operator==(const Matrix4<T> &_mat) const {
-        return row1 == _mat.row1 && row2 == _mat.row2 && row3 == _mat.row3 && row4 == _mat.row4;
-    }
 
+        /// Find the dot product of two matrices, each output row is a combination of _mat rows
+        inline Matrix3A operator*(const Matrix3A &_mat) const {
+            const __m128 b0 = _mat.row1.Load();
+            const __m128 b1 = _mat.row2.Load();
+            const __m128 b2 = _mat.row3.Load();
 
-    /// Check if current and given matrices don't have equal values
-    template<typename T>
-    bool Matrix4<T>::operator!=(const Matrix4<T> &_mat) const {
-        return row1 != _mat.row1 || row2 != _mat.row2 || row3 != _mat.row3 || row4 != _mat.row4;
-    }
+            Matrix3A out_mat;
+            const Vector3A *rows = &row1;
+            Vector3A *out_rows = &out_mat.row1;
+            for(int i = 0; i < 3; i++) {
+                const __m128 a = rows[i].Load();
+                __m128 r = _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+                r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+                r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+                out_rows[i] = Vector3A(r);
+            }
 
-    
-    /// Find the determinant of current matrix instance
-    template<typename T>
-    template<typename DT>
-    DT Matrix4<T>::Determinant(const Matrix4<DT> &_mat) {
-        Matrix3<DT> adj_mat[4];
-        
-        adj_mat[0].row1 = Vector3<float>{_mat.row2.second, _mat.row2.third, _mat.row2.fourth};
-        adj_mat[0].row2 = Vector3<float>{_mat.row3.second, _mat.row3.third, _mat.row3.fourth};
-        adj_mat[0].row3 = Vector3<float>{_mat.row4.second, _mat.row4.third, _mat.row4.fourth};
-
-        adj_mat[1].row1 = Vector3<float>{_mat.row2.first, _mat.row2.third, _mat.row2.fourth};
-        adj_mat[1].row2 = Vector3<float>{_mat.row3.first, _mat.row3.third, _mat.row3.fourth};
-        adj_mat[1].row3 = Vector3<float>{_mat.row4.first, _mat.row4.third, _mat.row4.fourth};
-
-        adj_mat[2].row1 = Vector3<float>{_mat.row2.first, _mat.row2.second, _mat.row2.fourth};
-        adj_mat[2].row2 = Vector3<float>{_mat.row3.first, _mat.row3.second, _mat.row3.fourth};
-        adj_mat[2].row3 = Vector3<float>{_mat.row4.first, _mat.row4.second, _mat.row4.fourth};
-
-        adj_mat[3].row1 = Vector3<float>{_mat.row2.first, _mat.row2.second, _mat.row2.third};
-        adj_mat[3].row2 = Vector3<float>{_mat.row3.first, _mat.row3.second, _mat.row3.third};
-        adj_mat[3].row3 = Vector3<float>{_mat.row4.first, _mat.row4.second, _mat.row4.third};
-
-        Vector4<DT> out;
-        out.first = _mat.row1.first * Matrix3<DT>::Determinant(adj_mat[0]);
-        out.second = _mat.row1.second * Matrix3<DT>::Determinant(adj_mat[1]);
-        out.third = _mat.row1.third * Matrix3<DT>::Determinant(adj_mat[2]);
-        out.fourth = _mat.row1.fourth * Matrix3<DT>::Determinant(adj_mat[3]); 
-        
-        return out.first - out.second + out.third - out.fourth;
-    };
+            return out_mat;
+        }
 
+        /// Multiply with column vector
+        inline Vector3A operator*(const Vector3A &_vec) const {
+            // transposing the row products lets a vertical add produce all three dot products
+            const __m128 v = _vec.Load();
+            __m128 x = _mm_mul_ps(row1.Load(), v);
+            __m128 y = _mm_mul_ps(row2.Load(), v);
+            __m128 z = _mm_mul_ps(row3.Load(), v);
+            __m128 w = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            return Vector3A(_mm_add_ps(_mm_add_ps(x, y), _mm_add_ps(z, w)));
+        }
 
-    /// Find the inverse of the current matrix 
-    template<typename T>
-    Matrix4<T> Matrix4<T>::Inverse() const {
-        float inv_det = 1 / Matrix4<T>::Determinant(*this);
-        Matrix4<T> out_mat;
-        Matrix3<float> adj_mat;
-        
-        // Row 1
-        adj_mat = {
-            {row2.second, row2.third, row2.fourth},
-            {row3.second, row3.third, row3.fourth},
-            {row4.second, row4.third, row4.fourth}
-        };
-        out_mat.row1.first = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.second, row1.third, row1.fourth},
-            {row3.second, row3.third, row3.fourth},
-            {row4.second, row4.third, row4.fourth}
-        };
-        out_mat.row1.second = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.second, row1.third, row1.fourth},
-            {row2.second, row2.third, row2.fourth},
-            {row4.second, row4.third, row4.fourth}
-        };
-        out_mat.row1.third = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-        
-        adj_mat = {
-            {row1.second, row1.third, row1.fourth},
-            {row2.second, row2.third, row2.fourth},
-            {row3.second, row3.third, row3.fourth}
-        };
-        out_mat.row1.fourth = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat)); 
-
-        // Row 2
-        adj_mat = {
-            {row2.first, row2.third, row2.fourth},
-            {row3.first, row3.third, row3.fourth},
-            {row4.first, row4.third, row4.fourth}
-        };
-        out_mat.row2.first = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.third, row1.fourth},
-            {row3.first, row3.third, row3.fourth},
-            {row4.first, row4.third, row4.fourth}
-        };
-        out_mat.row2.second = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.third, row1.fourth},
-            {row2.first, row2.third, row2.fourth},
-            {row4.first, row4.third, row4.fourth}
-        };
-        out_mat.row2.third = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.third, row1.fourth},
-            {row2.first, row2.third, row2.fourth},
-            {row3.first, row3.third, row3.fourth}
-        };
-        out_mat.row2.fourth = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat)); 
-
-        // Row 3
-        adj_mat = {
-            {row2.first, row2.second, row2.fourth},
-            {row3.first, row3.second, row3.fourth},
-            {row4.first, row4.second, row4.fourth}
-        };
-        out_mat.row3.first = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.fourth},
-            {row3.first, row3.second, row3.fourth},
-            {row4.first, row4.second, row4.fourth}
-        };
-        out_mat.row3.second = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.fourth},
-            {row2.first, row2.second, row2.fourth},
-            {row4.first, row4.second, row4.fourth}
-        };
-        out_mat.row3.third = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.fourth},
-            {row2.first, row2.second, row2.fourth},
-            {row3.first, row3.second, row3.fourth}
-        };
-        out_mat.row3.fourth = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat)); 
-
-        // Row 4
-        adj_mat = {
-            {row2.first, row2.second, row2.third},
-            {row3.first, row3.second, row3.third},
-            {row4.first, row4.second, row4.third}
-        };
-        out_mat.row4.first = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.third},
-            {row3.first, row3.second, row3.third},
-            {row4.first, row4.second, row4.third}
-        };
-        out_mat.row4.second = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.third},
-            {row2.first, row2.second, row2.third},
-            {row4.first, row4.second, row4.third}
-        };
-        out_mat.row4.third = static_cast<T>(-inv_det * Matrix3<T>::Determinant(adj_mat));
-
-        adj_mat = {
-            {row1.first, row1.second, row1.third},
-            {row2.first, row2.second, row2.third},
-            {row3.first, row3.second, row3.third}
-        };
-        out_mat.row4.fourth = static_cast<T>(inv_det * Matrix3<T>::Determinant(adj_mat)); 
+        inline void operator*=(const Matrix3A &_mat) {
+            *this = (*this) * _mat;
+        }
 
-        return out_mat;
-    }
+        inline bool operator==(const Matrix3A &_mat) const {
+            return row1 == _mat.row1 && row2 == _mat.row2 && row3 == _mat.row3;
+        }
 
+        inline bool operator!=(const Matrix3A &_mat) const {
+            return row1 != _mat.row1 || row2 != _mat.row2 || row3 != _mat.row3;
+        }
 
-    /// Transpose the current matrix
-    template<typename T>
-    Matrix4<T> Matrix4<T>::Transpose() const {
-        if constexpr (std::is_floating_point<T>::value || std::is_integral<T>::value) {
-            Matrix4<T> new_mat;
-            new_mat.row1 = Vector4<T>{row1.first, row2.first, row3.first, row4.first};
-            new_mat.row2 = Vector4<T>{row1.second, row2.second, row3.second, row4.second};
-            new_mat.row3 = Vector4<T>{row1.third, row2.third, row3.third, row4.third};
-            new_mat.row4 = Vector4<T>{row1.fourth, row2.fourth, row3.fourth, row4.fourth};
+        inline Vector3A operator[](size_t i) const { return (&row1)[i]; }
+        inline Vector3A& operator[](size_t i) { return (&row1)[i]; }
 
-            return new_mat;
-        } else {
-            return Matrix4<T>();
+        /// Find the determinant of current matrix instance
+        inline float Determinant() const {
+            return FastDot(row1.Load(), FastCross(row2.Load(), row3.Load()));
         }
-    }
 
+        /// Find the inverse of the current matrix
+        /// Adjugate columns are cross products of the rows
+        inline Matrix3A Inverse() const {
+            const __m128 r0 = row1.Load();
+            const __m128 r1 = row2.Load();
+            const __m128 r2 = row3.Load();
+            __m128 c0 = FastCross(r1, r2);
+            __m128 c1 = FastCross(r2, r0);
+            __m128 c2 = FastCross(r0, r1);
+            __m128 c3 = _mm_setzero_ps();
 
-#ifdef _DEBUG
-    template<typename T>
-    void Matrix4<T>::Log(const std::string &desc) {
-        std::cout << "MAT_LOG: " <<  desc << std::endl;
-        std::cout << row1.first << " | " << row1.second << " | " << row1.third << " | " << row1.fourth << std::endl;
-        std::cout << row2.first << " | " << row2.second << " | " << row2.third << " | " << row2.fourth << std::endl;
-        std::cout << row3.first << " | " << row3.second << " | " << row3.third << " | " << row3.fourth << std::endl;
-        std::cout << row4.first << " | " << row4.second << " | " << row4.third << " | " << row4.fourth << "\n" << std::endl;
-    }
-#endif
+            const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), FastSum(_mm_mul_ps(r0, c0)));
+            c0 = _mm_mul_ps(c0, inv_det);
+            c1 = _mm_mul_ps(c1, inv_det);
+            c2 = _mm_mul_ps(c2, inv_det);
+            _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+            return Matrix3A(Vector3A(c0), Vector3A(c1), Vector3A(c2));
+        }
+
+        /// Transpose the current matrix
+        inline Matrix3A Transpose() const {
+            __m128 r0 = row1.Load();
+            __m128 r1 = row2.Load();
+            __m128 r2 = row3.Load();
+            __m128 r3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            return Matrix3A(Vector3A(r0), Vector3A(r1), Vector3A(r2));
+        }
+    };
 }
 
 #endif
@@ -3,47 +3,121 @@
 
 #include <type_traits>
 #include <vector>
+#include <initializer_list>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <functional>
 #include <trs/VectorN.h>
+#include <trs/MatrixView.h>
+#include <trs/Gemm.h>
+#include <trs/Expressions.h>
+#include <trs/ThreadPool.h>
 
 namespace TRS {
 	template<typename T>
-	class MatrixN : public std::vector<std::vector<T>> {
+	class LU;
+
+	template<typename T>
+	class MatrixN;
+
+	template<typename T>
+	struct IsExpressionLeaf<MatrixN<T>> : std::true_type {};
+
+	template<typename L, typename R>
+	MatrixN<typename L::value_type> MultiplyDense(const L& _l, const R& _r);
+
+	template<typename M, typename V>
+	VectorN<typename M::value_type> MultiplyDenseVector(const M& _m, const V& _v);
+
+	/// Dynamically sized R x C matrix stored in one contiguous row-major buffer
+	/// operator[] returns a pointer to the beginning of a row, so elements are accessed as m[i][j].
+	/// Elementwise arithmetic builds expressions from Expressions.h that are evaluated on assignment.
+	/// Storage comes from the current memory resource unless a resource is given, see MemoryResource.h.
+	template<typename T>
+	class MatrixN : public MatrixExpression<MatrixN<T>> {
+		private:
+			Buffer<T> m_data;
+			size_t m_rows = 0;
+			size_t m_cols = 0;
+
+			// factorizations of integral matrices run in double precision
+			using real_t = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+
+			// call _f(first, last) on element ranges made of whole rows, large matrices are split over the shared thread pool
+			template<typename F>
+			void ForEachRowBlock(F&& _f) const {
+				ThreadPool& pool = GetThreadPool();
+				const size_t cols = std::max<size_t>(m_cols, 1);
+				const size_t threads = pool.GetThreadCount();
+				const size_t rows = std::max((pool.GetElementwiseThreshold() + cols - 1) / cols, (m_rows + threads - 1) / threads);
+				pool.ParallelFor(0, m_rows, rows, [&](size_t _first, size_t _last) { _f(_first * m_cols, _last * m_cols); });
+			}
+
+			// write every element of _e, which has the same shape as this matrix
+			template<typename E>
+			void Assign(const E& _e) {
+				ForEachRowBlock([&](size_t _first, size_t _last) {
+					for (size_t i = _first; i < _last; i++)
+						m_data[i] = _e.Element(i);
+				});
+			}
+
 		public:
-			MatrixN() : std::vector<std::vector<T>>() {}
-			MatrixN(const MatrixN& m) {
-				resize(m.size());
-				for (auto it = begin(); it != end(); it++)
-					it->resize(m.size());
-
-				for (size_t i = 0; i < size(); i++)
-					for (size_t j = 0; j < size(); j++)
-						(*this)[i][j] = m[i][j];
-			};
+			typedef T value_type;
+
+			MatrixN() = default;
+			MatrixN(const MatrixN&) = default;
 			MatrixN(MatrixN&&) noexcept = default;
-			
-			void operator=(const MatrixN& m) {
-				resize(m.size());
-
-				for (size_t i = 0; i < size(); i++) {
-					(*this)[i].resize(m.size());
-					for (size_t j = 0; j < (*this)[i].size(); j++)
-						(*this)[i][j] = m[i][j];
-				}
+			MatrixN& operator=(const MatrixN&) = default;
+			MatrixN& operator=(MatrixN&&) noexcept = default;
+
+			explicit MatrixN(const Allocator<T>& _alloc) :
+				m_data(_alloc) {}
+
+			// square matrix
+			explicit MatrixN(size_t _count, const T& _value = T(), const Allocator<T>& _alloc = Allocator<T>()) :
+				m_data(_count * _count, _value, _alloc), m_rows(_count), m_cols(_count) {}
+
+			// rectangular matrix, value has to be given explicitly to avoid confusion with the square constructor
+			MatrixN(size_t _rows, size_t _cols, const T& _value, const Allocator<T>& _alloc = Allocator<T>()) :
+				m_data(_rows * _cols, _value, _alloc), m_rows(_rows), m_cols(_cols) {}
+
+			// every initializer list element is one row, shorter rows are padded with T()
+			MatrixN(std::initializer_list<std::vector<T>> _init, const Allocator<T>& _alloc = Allocator<T>()) :
+				m_data(_alloc), m_rows(_init.size())
+			{
+				for (const std::vector<T>& row : _init)
+					m_cols = std::max(m_cols, row.size());
+
+				m_data.resize(m_rows * m_cols);
+				size_t i = 0;
+				for (const std::vector<T>& row : _init)
+					std::copy(row.begin(), row.end(), (*this)[i++]);
 			}
 
-			explicit MatrixN(size_t _count, const T& _value = T()) :
-				std::vector<std::vector<T>>(_count) 
+			// evaluate an elementwise expression in one pass
+			template<typename E>
+			MatrixN(const MatrixExpression<E>& _e, const Allocator<T>& _alloc = Allocator<T>()) :
+				m_data(_e.Self().Rows() * _e.Self().Columns(), _alloc), m_rows(_e.Self().Rows()), m_cols(_e.Self().Columns())
 			{
-				for (size_t i = 0; i < size(); i++)
-					(*this)[i].resize(size(), _value);
+				Assign(_e.Self());
 			}
 
-			MatrixN(std::initializer_list<std::vector<T>> _init) :
-				std::vector<std::vector<T>>(_init) {}
+			// evaluate an elementwise expression into this matrix, no allocation is made when the shapes match
+			template<typename E>
+			MatrixN& operator=(const MatrixExpression<E>& _e) {
+				if (m_rows == _e.Self().Rows() && m_cols == _e.Self().Columns())
+					Assign(_e.Self());
+				else
+					*this = MatrixN<T>(_e);
+
+				return *this;
+			}
 
 			static MatrixN<T> MakeIdentity(size_t n) {
 				MatrixN<T> matrix(n);
-				
+
 				if constexpr (std::is_arithmetic<T>::value) {
 					for (size_t i = 0; i < n; i++)
 						matrix[i][i] = static_cast<T>(1);
@@ -52,266 +126,422 @@ namespace TRS {
 				return matrix;
 			}
 
-			void operator+=(const MatrixN<T>& m) {
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++)
-						for (size_t j = 0; j < (*this)[i].size(); j++)
-							(*this)[i][j] += m[i][j];
-				}
-			}
+			// row count, kept as size() from the time MatrixN was a vector of rows
+			size_t size() const { return m_rows; }
+			size_t Rows() const { return m_rows; }
+			size_t Columns() const { return m_cols; }
+			size_t Stride() const { return m_cols; }
+			bool IsSquare() const { return m_rows == m_cols; }
 
-			void operator-=(const MatrixN<T>& m) {
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++)
-						for (size_t j = 0; j < (*this)[i].size(); j++)
-							(*this)[i][j] -= m[i][j];
-				}
-			}
+			T* Data() { return m_data.data(); }
+			const T* Data() const { return m_data.data(); }
 
-			// multiplication with a scalar
-			MatrixN<T> operator*(const T v) const {
-				MatrixN<T> result(*this);
+			Allocator<T> GetAllocator() const { return m_data.get_allocator(); }
 
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < result.size(); i++)
-						for (size_t j = 0; j < result[i].size(); j++)
-							result[i][j] *= v;
-				}
+			// row view
+			T* operator[](size_t i) { return m_data.data() + i * m_cols; }
+			const T* operator[](size_t i) const { return m_data.data() + i * m_cols; }
 
-				return result;
-			}
+			// row-major element access used by expressions
+			const T& Element(size_t i) const { return m_data[i]; }
 
-			// division with a scalar
-			MatrixN<T> operator/(const T v) const {
-				MatrixN<T> result(*this);
+			// views into the matrix, they stay valid until the matrix is resized
+			MatrixView<T> View() { return MatrixView<T>(*this); }
+			MatrixView<const T> View() const { return MatrixView<const T>(*this); }
 
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < result.size(); i++)
-						for (size_t j = 0; j < result[i].size(); j++)
-							result[i][j] /= v;
-				}
+			MatrixView<T> Block(size_t _row, size_t _col, size_t _rows, size_t _cols) { return View().Block(_row, _col, _rows, _cols); }
+			MatrixView<const T> Block(size_t _row, size_t _col, size_t _rows, size_t _cols) const { return View().Block(_row, _col, _rows, _cols); }
 
-				return result;
-			}
+			VectorView<T> Row(size_t _row) { return View().Row(_row); }
+			VectorView<const T> Row(size_t _row) const { return View().Row(_row); }
 
-			// unary sign change
-			MatrixN<T> operator-() const {
-				MatrixN<T> result(*this);
+			VectorView<T> Column(size_t _col) { return View().Column(_col); }
+			VectorView<const T> Column(size_t _col) const { return View().Column(_col); }
 
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < result.size(); i++)
-						for (size_t j = 0; j < result[i].size(); j++)
-							result[i][j] = -result[i][j];
-				}
+			// reshape the matrix, existing elements are not preserved
+			void Resize(size_t _rows, size_t _cols, const T& _value = T()) {
+				m_rows = _rows;
+				m_cols = _cols;
+				m_data.assign(_rows * _cols, _value);
+			}
 
-				return result;
+			bool operator==(const MatrixN<T>& m) const {
+				return m_rows == m.m_rows && m_cols == m.m_cols && m_data == m.m_data;
 			}
 
+			bool operator!=(const MatrixN<T>& m) const {
+				return !(*this == m);
+			}
 
-			// matrix addition
-			MatrixN<T> operator+(const MatrixN<T>& m2) const {
-				MatrixN<T> result(*this);
+			// elementwise addition of a matrix of the same shape, like a + b another shape leaves an empty matrix
+			template<typename E>
+			MatrixN& operator+=(const MatrixExpression<E>& _m) {
+				const E& m = _m.Self();
+				if (m.Rows() != m_rows || m.Columns() != m_cols) {
+					Resize(0, 0);
+					return *this;
+				}
 
 				if constexpr (std::is_arithmetic<T>::value) {
-					if (size() == m2.size()) {
-						for (size_t i = 0; i < result.size(); i++)
-							for (size_t j = 0; j < result[i].size(); j++)
-								result[i][j] += m2[i][j];
-					}
+					ForEachRowBlock([&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							m_data[i] += m.Element(i);
+					});
 				}
 
-				return result;
+				return *this;
 			}
 
-			// matrix subtraction
-			MatrixN<T> operator-(const MatrixN<T>& m2) const {
-				MatrixN<T> result(*this);
+			// elementwise subtraction of a matrix of the same shape, like a - b another shape leaves an empty matrix
+			template<typename E>
+			MatrixN& operator-=(const MatrixExpression<E>& _m) {
+				const E& m = _m.Self();
+				if (m.Rows() != m_rows || m.Columns() != m_cols) {
+					Resize(0, 0);
+					return *this;
+				}
 
 				if constexpr (std::is_arithmetic<T>::value) {
-					if (size() == m2.size()) {
-						for (size_t i = 0; i < result.size(); i++)
-							for (size_t j = 0; j < result[i].size(); j++)
-								result[i][j] -= m2[i][j];
-					}
+					ForEachRowBlock([&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							m_data[i] -= m.Element(i);
+					});
 				}
 
-				return result;
+				return *this;
 			}
 
+			MatrixN& operator*=(const T& _s) {
+				if constexpr (std::is_arithmetic<T>::value) {
+					ForEachRowBlock([&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							m_data[i] *= _s;
+					});
+				}
 
-			// matrix multiplication
-			MatrixN<T> operator*(const MatrixN<T>& m2) const {
-				MatrixN<T> result(size());
+				return *this;
+			}
 
+			MatrixN& operator/=(const T& _s) {
 				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < result.size(); i++) {
-						for (size_t j = 0; j < result[i].size(); j++) {
-							result[i][j] = 0;
-							for (size_t k = 0; k < size(); k++) {
-								result[i][j] += (*this)[i][k] * m2[k][j];
-							}
-						}
+					ForEachRowBlock([&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							m_data[i] /= _s;
+					});
+				}
+
+				return *this;
+			}
+
+			// this = this * _m
+			// When _m is a square matrix or view with as many rows as this has columns and it does not share storage
+			// with this matrix, rows are multiplied a panel at a time through a scratch buffer from the current memory
+			// resource and written back, so only one panel is held instead of a whole product. Other operands fall back
+			// to a product.
+			template<typename E>
+			MatrixN& operator*=(const MatrixExpression<E>& _m) {
+				if constexpr (!IsDenseMatrix<E>::value || !std::is_arithmetic<T>::value)
+					return *this = *this * _m.Self();
+				else {
+					const E& m = _m.Self();
+					const T* b = m.Data();
+					const T* b_end = m.Rows() ? b + (m.Rows() - 1) * m.Stride() + m.Columns() : b;
+					const std::less<const T*> less;
+					const bool overlaps = less(b, m_data.data() + m_data.size()) && less(m_data.data(), b_end);
+					if (!m.IsSquare() || m.Rows() != m_cols || overlaps)
+						return *this = *this * m;
+
+					constexpr size_t panel = 4 * GemmBlocking<T>::mc;
+					Buffer<T> scratch(std::min(panel, m_rows) * m_cols);
+
+					for (size_t i = 0; i < m_rows; i += panel) {
+						const size_t mb = std::min(panel, m_rows - i);
+						Gemm(false, false, mb, m_cols, m_cols, static_cast<T>(1), (*this)[i], m_cols, b, m.Stride(), T(), scratch.data(), m_cols);
+						std::copy(scratch.begin(), scratch.begin() + mb * m_cols, (*this)[i]);
 					}
+
+					return *this;
 				}
+			}
 
-				return result;
+			// matrix multiplication, R x K times K x C gives R x C and operands that do not conform give an empty matrix
+			MatrixN<T> operator*(const MatrixN<T>& m2) const {
+				return MultiplyDense(*this, m2);
 			}
 
 			// matrix multiplication with a column vector
 			VectorN<T> operator*(const VectorN<T>& v1) const {
-				VectorN<T> result(size());
+				return MultiplyDenseVector(*this, v1);
+			}
 
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++) {
-						for (size_t j = 0; j < size(); j++)
-							result[i] += (*this)[i][j] * v1[j];
-					}
-				}
+			// views are multiplied where they are, other unevaluated right operands are evaluated first
+			template<typename E>
+			MatrixN<T> operator*(const MatrixExpression<E>& _m) const {
+				if constexpr (IsDenseMatrix<E>::value)
+					return MultiplyDense(*this, _m.Self());
+				else
+					return *this * MatrixN<T>(_m);
+			}
+
+			template<typename E>
+			VectorN<T> operator*(const VectorExpression<E>& _v) const {
+				if constexpr (IsDenseVector<E>::value)
+					return MultiplyDenseVector(*this, _v.Self());
+				else
+					return *this * VectorN<T>(_v);
+			}
+
+			MatrixN<T> Transpose() const {
+				MatrixN<T> result(m_cols, m_rows, T());
+				for (size_t i = 0; i < m_rows; i++)
+					for (size_t j = 0; j < m_cols; j++)
+						result[j][i] = (*this)[i][j];
 
 				return result;
 			}
 
+			// determinant from a pivoted LU factorization
 			T Determinant() const {
-				T det = T();
-
-				if constexpr (std::is_arithmetic<T>::value) {
-					MatrixN<T> upper(size()), lower(size());
-
-					for (size_t i = 0; i < size(); i++) {
-						// upper triangular
-						for (size_t j = i; j < size(); j++) {
-							T sum = T();
-							for (size_t k = 0; k < i; k++)
-								sum += lower[i][k] * upper[k][j];
-
-							upper[i][j] = (*this)[i][j] - sum;
-						}
-
-						// lower triangular
-						for (size_t j = i; j < size(); j++) {
-							if (i == j)
-								lower[i][i] = static_cast<T>(1);
-							else {
-								T sum = T();
-								for (size_t k = 0; k < i; k++)
-									sum += (lower[j][k] * upper[k][i]);
-
-								if (!upper[i][i])
-									return static_cast<T>(0);
-								else
-									lower[j][i] = ((*this)[j][i] - sum) / upper[i][i];
-							}
-						}
-					}
+				if constexpr (std::is_floating_point<T>::value)
+					return LU<T>(*this).Determinant();
+				else if constexpr (std::is_arithmetic<T>::value) {
+					MatrixN<real_t> a(m_rows, m_cols, real_t());
+					std::copy(m_data.begin(), m_data.end(), a.Data());
+					return static_cast<T>(std::round(LU<real_t>(a).Determinant()));
+				}
+				else
+					return T();
+			}
 
-					det = static_cast<T>(1);
-					for (size_t i = 0; i < upper.size(); i++)
-						det *= upper[i][i];
+			// inverse from a pivoted LU factorization, singular matrices give an empty matrix
+			MatrixN<T> Inverse() const {
+				if constexpr (std::is_floating_point<T>::value)
+					return LU<T>(*this).Inverse();
+				else if constexpr (std::is_arithmetic<T>::value) {
+					MatrixN<real_t> a(m_rows, m_cols, real_t());
+					std::copy(m_data.begin(), m_data.end(), a.Data());
+					const MatrixN<real_t> inv = LU<real_t>(a).Inverse();
+
+					MatrixN<T> result(inv.Rows(), inv.Columns(), T());
+					for (size_t i = 0; i < result.m_data.size(); i++)
+						result.m_data[i] = static_cast<T>(inv.Data()[i]);
+					return result;
 				}
+				else
+					return *this;
+			}
 
-				return det;
+			// solve A * x = b from a pivoted LU factorization without forming the inverse
+			// the result is empty when the matrix is singular or b has the wrong size, use LU directly to reuse the factors
+			VectorN<T> Solve(const VectorN<T>& _b) const {
+				static_assert(std::is_floating_point<T>::value, "Solve needs a floating point matrix");
+				return LU<T>(*this).Solve(_b);
 			}
 
-		MatrixN<T> Inverse() const {
-			MatrixN<T> inv(size());
+			// solve A * X = B for every column of B
+			MatrixN<T> Solve(const MatrixN<T>& _b) const {
+				static_assert(std::is_floating_point<T>::value, "Solve needs a floating point matrix");
+				return LU<T>(*this).Solve(_b);
+			}
+	};
 
-			if constexpr (std::is_arithmetic<T>::value) {
-				MatrixN<T> upper(size()), lower(size());
 
-				// find LU matrices
-				for (size_t i = 0; i < size(); i++) {
-					// upper triangular
-					for (size_t j = 0; j < size(); j++) {
-						T sum = T();
-						for (size_t k = 0; k < i; k++)
-							sum += lower[i][k] * upper[k][j];
+	// C = alpha * op(A) * op(B) + beta * C, where op transposes the operand when its flag is set
+	// C is reshaped and zeroed first when its shape does not match the product. Returns false and leaves C
+	// untouched when the inner sizes of op(A) and op(B) differ, like the view overload in MatrixView.h.
+	template<typename T>
+	bool Gemm(T _alpha, const MatrixN<T>& _a, bool _trans_a, const MatrixN<T>& _b, bool _trans_b, T _beta, MatrixN<T>& _c) {
+		if constexpr (std::is_arithmetic<T>::value) {
+			const size_t m = _trans_a ? _a.Columns() : _a.Rows();
+			const size_t k = _trans_a ? _a.Rows() : _a.Columns();
+			const size_t n = _trans_b ? _b.Rows() : _b.Columns();
+			if ((_trans_b ? _b.Columns() : _b.Rows()) != k)
+				return false;
 
-						upper[i][j] = (*this)[i][j] - sum;
-					}
+			if (_c.Rows() != m || _c.Columns() != n)
+				_c.Resize(m, n);
 
-					// lower triangular
-					for (size_t j = 0; j < size(); j++) {
-						if (i == j)
-							lower[i][j] = static_cast<T>(1);
-						else {
-							T sum = T();
-							for (size_t k = 0; k < i; k++)
-								sum += (lower[j][k] * upper[k][i]);
-
-							lower[j][i] = ((*this)[j][i] - sum) / upper[i][i];
-						}
-					}
-				}
+			Gemm(_trans_a, _trans_b, m, n, k, _alpha, _a.Data(), _a.Columns(), _b.Data(), _b.Columns(), _beta, _c.Data(), _c.Columns());
+			return true;
+		}
 
-				// calculate inverse of these matrices
-				MatrixN<T> inverseUpper(size()), inverseLower(size());
-					
-				// lower triangular
-				for (size_t i = 0; i < size(); i++) {
-					for (size_t j = 0; j <= i; j++) {
-						T sum = static_cast<T>(0);
-						for (size_t k = 0; k < i; k++)
-							sum += lower[i][k] * inverseLower[k][j];
-
-						float b = 0.0f;
-						if (i == j)
-							b = 1.0f;
-
-						inverseLower[i][j] = (static_cast<T>(b) - sum) / lower[i][i];
-					}
-				}
+		return false;
+	}
 
-				// upper triangular
-				for (int i = (int)size() - 1; i >= 0; i--) {
-					for (int j = (int)size() - 1; j >= i; j--) {
-						T sum = static_cast<T>(0);
-						for (int k = (int)size() - 1; k > i; k--)
-							sum += upper[i][k] * inverseUpper[k][j];
 
-						float b = 0.0f;
-						if (i == j)
-							b = 1.0f;
+	// R x K times K x C product of matrices or views through Gemm, operands that do not conform give an empty matrix
+	template<typename L, typename R>
+	MatrixN<typename L::value_type> MultiplyDense(const L& _l, const R& _r) {
+		typedef typename L::value_type T;
+		if (_l.Columns() != _r.Rows())
+			return MatrixN<T>();
 
-						inverseUpper[i][j] = (b - sum) / upper[i][i];
-					}
-				}
+		MatrixN<T> result(_l.Rows(), _r.Columns(), T());
 
-				//return inverseLower;
-				inv = inverseUpper * inverseLower;
-			}
-			else {
-				inv = *this;
-			}
+		if constexpr (std::is_arithmetic<T>::value) {
+			Gemm(false, false, _l.Rows(), _r.Columns(), _l.Columns(), static_cast<T>(1), _l.Data(), _l.Stride(),
+				 _r.Data(), _r.Stride(), T(), result.Data(), result.Columns());
+		}
 
-			return inv;
+		return result;
+	}
+
+	// matrix or view times a column vector or vector view, a vector of the wrong length gives an empty vector
+	template<typename M, typename V>
+	VectorN<typename M::value_type> MultiplyDenseVector(const M& _m, const V& _v) {
+		typedef typename M::value_type T;
+		if (_m.Columns() != _v.size())
+			return VectorN<T>();
+
+		VectorN<T> result(_m.Rows());
+
+		if constexpr (std::is_arithmetic<T>::value) {
+			const size_t n = _m.Columns();
+			for (size_t i = 0; i < _m.Rows(); i++) {
+				const T* row = _m[i];
+				for (size_t j = 0; j < n; j++)
+					result[i] += row[j] * _v[j];
+			}
 		}
-	};
 
+		return result;
+	}
 
-	// row vector multiplication with matrix
-	template<typename T>
-	VectorN<T> VectorN<T>::operator*(const MatrixN<T>& m1) const {
-		VectorN<T> result(size());
+	// row vector or vector view times a matrix or view, a vector of the wrong length gives an empty vector
+	template<typename V, typename M>
+	VectorN<typename M::value_type> MultiplyDenseRowVector(const V& _v, const M& _m) {
+		typedef typename M::value_type T;
+		if (_v.size() != _m.Rows())
+			return VectorN<T>();
+
+		VectorN<T> result(_m.Columns());
 
 		if constexpr (std::is_arithmetic<T>::value) {
-			for (size_t i = 0; i < size(); i++) {
-				for (size_t j = 0; j < size(); j++) {
-					result[i] += (*this)[j] * m1[j][i];
-				}
+			const size_t n = _m.Rows();
+			for (size_t j = 0; j < n; j++) {
+				const T a = _v[j];
+				const T* row = _m[j];
+				for (size_t i = 0; i < _m.Columns(); i++)
+					result[i] += a * row[i];
 			}
 		}
 
 		return result;
 	}
 
+
+	// products with an unevaluated left operand evaluate it first, views are used where they are
+	template<typename L, typename R>
+	MatrixN<typename L::value_type> operator*(const MatrixExpression<L>& _l, const MatrixExpression<R>& _r) {
+		typedef typename L::value_type T;
+		if constexpr (!IsDenseMatrix<L>::value)
+			return MatrixN<T>(_l) * _r.Self();
+		else if constexpr (IsDenseMatrix<R>::value)
+			return MultiplyDense(_l.Self(), _r.Self());
+		else
+			return MultiplyDense(_l.Self(), MatrixN<T>(_r));
+	}
+
+	template<typename L, typename R>
+	VectorN<typename L::value_type> operator*(const MatrixExpression<L>& _m, const VectorExpression<R>& _v) {
+		typedef typename L::value_type T;
+		if constexpr (!IsDenseMatrix<L>::value)
+			return MatrixN<T>(_m) * _v.Self();
+		else if constexpr (IsDenseVector<R>::value)
+			return MultiplyDenseVector(_m.Self(), _v.Self());
+		else
+			return MultiplyDenseVector(_m.Self(), VectorN<T>(_v));
+	}
+
+	template<typename L, typename R>
+	VectorN<typename L::value_type> operator*(const VectorExpression<L>& _v, const MatrixExpression<R>& _m) {
+		typedef typename L::value_type T;
+		if constexpr (!IsDenseVector<L>::value)
+			return VectorN<T>(_v) * _m.Self();
+		else if constexpr (IsDenseMatrix<R>::value)
+			return MultiplyDenseRowVector(_v.Self(), _m.Self());
+		else
+			return MultiplyDenseRowVector(_v.Self(), MatrixN<T>(_m));
+	}
+
+
+	// an expiring matrix operand is overwritten with the result and returned, so the result reuses its buffer
+	template<typename T, typename R>
+	inline MatrixN<T> operator+(MatrixN<T>&& _l, const MatrixExpression<R>& _r) {
+		_l = _l + _r.Self();
+		return std::move(_l);
+	}
+
+	template<typename T, typename L>
+	inline MatrixN<T> operator+(const MatrixExpression<L>& _l, MatrixN<T>&& _r) {
+		_r = _l.Self() + _r;
+		return std::move(_r);
+	}
+
+	template<typename T>
+	inline MatrixN<T> operator+(MatrixN<T>&& _l, MatrixN<T>&& _r) {
+		return std::move(_l) + _r;
+	}
+
+	template<typename T, typename R>
+	inline MatrixN<T> operator-(MatrixN<T>&& _l, const MatrixExpression<R>& _r) {
+		_l = _l - _r.Self();
+		return std::move(_l);
+	}
+
+	template<typename T, typename L>
+	inline MatrixN<T> operator-(const MatrixExpression<L>& _l, MatrixN<T>&& _r) {
+		_r = _l.Self() - _r;
+		return std::move(_r);
+	}
+
+	template<typename T>
+	inline MatrixN<T> operator-(MatrixN<T>&& _l, MatrixN<T>&& _r) {
+		return std::move(_l) - _r;
+	}
+
+	template<typename T>
+	inline MatrixN<T> operator*(MatrixN<T>&& _m, const NonDeduced<T>& _s) {
+		_m *= _s;
+		return std::move(_m);
+	}
+
+	template<typename T>
+	inline MatrixN<T> operator/(MatrixN<T>&& _m, const NonDeduced<T>& _s) {
+		_m /= _s;
+		return std::move(_m);
+	}
+
+	template<typename T>
+	inline MatrixN<T> operator-(MatrixN<T>&& _m) {
+		_m = -_m;
+		return std::move(_m);
+	}
+
+
+	// row vector multiplication with matrix
+	template<typename T>
+	VectorN<T> VectorN<T>::operator*(const MatrixN<T>& m1) const {
+		return MultiplyDenseRowVector(*this, m1);
+	}
+
+	template<typename T>
+	template<typename E>
+	VectorN<T> VectorN<T>::operator*(const MatrixExpression<E>& _m) const {
+		if constexpr (IsDenseMatrix<E>::value)
+			return MultiplyDenseRowVector(*this, _m.Self());
+		else
+			return *this * MatrixN<T>(_m);
+	}
+
 	// v * v.Transpose()
 	template<typename T>
 	MatrixN<T> VectorN<T>::ExpandToMatrix() {
-		MatrixN<T> result(size());
+		MatrixN<T> result(this->size());
 
 		if constexpr (std::is_arithmetic<T>::value) {
-			for (size_t i = 0; i < size(); i++)
-				for (size_t j = 0; j < size(); j++)
+			for (size_t i = 0; i < this->size(); i++)
+				for (size_t j = 0; j < this->size(); j++)
 					result[i][j] += (*this)[i] * (*this)[j];
 		}
 
@@ -319,4 +549,7 @@ namespace TRS {
 	}
 }
 
-#endif
\ No newline at end of file
+// LU needs the complete MatrixN definition
+#include <trs/LU.h>
+
+#endif
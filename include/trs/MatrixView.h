@@ -0,0 +1,289 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: MatrixView.h - Non-owning strided views of MatrixN and VectorN storage
+/// author: Karl-Mihkel Ott
+
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Gemm.h>
+#include <trs/ThreadPool.h>
+#include <trs/Expressions.h>
+
+// Views point into storage owned by someone else, typically a MatrixN or a VectorN, and never allocate.
+// Like pointers they are const only on the surface: a const MatrixView<T> still writes T, use MatrixView<const T>
+// for read-only access. Assigning to a view writes its elements instead of rebinding it, so blocks of a matrix
+// can be updated with the same expressions as whole matrices. A view is invalidated when its owner is resized.
+
+namespace TRS {
+
+    template<typename T>
+    class MatrixN;
+
+    template<typename T>
+    class VectorN;
+
+    template<typename T>
+    class MatrixView;
+
+    template<typename T>
+    class VectorView;
+
+
+    /// Matrices with row-major storage that is addressed as Data()[i * Stride() + j]
+    template<typename E>
+    struct IsDenseMatrix : std::false_type {};
+
+    template<typename T>
+    struct IsDenseMatrix<MatrixN<T>> : std::true_type {};
+
+    template<typename T>
+    struct IsDenseMatrix<MatrixView<T>> : std::true_type {};
+
+
+    /// Vectors with storage that is addressed as data()[i * Stride()], VectorN has stride 1
+    template<typename E>
+    struct IsDenseVector : std::false_type {};
+
+    template<typename T>
+    struct IsDenseVector<VectorN<T>> : std::true_type {};
+
+    template<typename T>
+    struct IsDenseVector<VectorView<T>> : std::true_type {};
+
+
+    // keeps a parameter out of template argument deduction, so that matrices and views convert to it
+    template<typename T>
+    struct NonDeducedType {
+        typedef T type;
+    };
+
+    template<typename T>
+    using NonDeduced = typename NonDeducedType<T>::type;
+
+
+    /// Non-owning _rows x _cols block of row-major storage with row stride _stride
+    template<typename T>
+    class MatrixView : public MatrixExpression<MatrixView<T>> {
+        private:
+            T *m_data = nullptr;
+            size_t m_rows = 0;
+            size_t m_cols = 0;
+            size_t m_stride = 0;
+
+            template<typename E>
+            void Assign(const E& _e) {
+                ParallelRows(0, m_rows, m_cols, [&](size_t _first, size_t _last) {
+                    for(size_t i = _first; i < _last; i++) {
+                        T *row = (*this)[i];
+                        for(size_t j = 0; j < m_cols; j++)
+                            row[j] = _e.Element(i * m_cols + j);
+                    }
+                });
+            }
+
+        public:
+            typedef typename std::remove_const<T>::type value_type;
+
+            MatrixView() = default;
+            MatrixView(const MatrixView&) = default;
+
+            MatrixView(T *_data, size_t _rows, size_t _cols, size_t _stride) :
+                m_data(_data), m_rows(_rows), m_cols(_cols), m_stride(_stride) {}
+
+            MatrixView(T *_data, size_t _rows, size_t _cols) :
+                MatrixView(_data, _rows, _cols, _cols) {}
+
+            // view of less const elements
+            template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+            MatrixView(const MatrixView<U>& _v) :
+                MatrixView(_v.Data(), _v.Rows(), _v.Columns(), _v.Stride()) {}
+
+            // whole MatrixN
+            template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+            MatrixView(MatrixN<U>& _m) :
+                MatrixView(_m.Data(), _m.Rows(), _m.Columns(), _m.Stride()) {}
+
+            template<typename U, typename = typename std::enable_if<std::is_convertible<const U*, T*>::value>::type>
+            MatrixView(const MatrixN<U>& _m) :
+                MatrixView(_m.Data(), _m.Rows(), _m.Columns(), _m.Stride()) {}
+
+            // copy the elements of a view of the same shape, views of another shape are left untouched
+            // the views must not overlap
+            MatrixView& operator=(const MatrixView& _v) {
+                if(m_rows == _v.Rows() && m_cols == _v.Columns())
+                    Assign(_v);
+
+                return *this;
+            }
+
+            // evaluate an elementwise expression of the same shape into the viewed elements
+            template<typename E>
+            MatrixView& operator=(const MatrixExpression<E>& _e) {
+                if(m_rows == _e.Self().Rows() && m_cols == _e.Self().Columns())
+                    Assign(_e.Self());
+
+                return *this;
+            }
+
+            size_t Rows() const { return m_rows; }
+            size_t Columns() const { return m_cols; }
+            size_t Stride() const { return m_stride; }
+            bool IsSquare() const { return m_rows == m_cols; }
+
+            T* Data() const { return m_data; }
+
+            // row view
+            T* operator[](size_t i) const { return m_data + i * m_stride; }
+
+            // row-major element access used by expressions
+            const value_type& Element(size_t i) const {
+                if(m_stride == m_cols)
+                    return m_data[i];
+                return m_data[i / m_cols * m_stride + i % m_cols];
+            }
+
+            /// _rows x _cols block starting at row _row and column _col
+            MatrixView<T> Block(size_t _row, size_t _col, size_t _rows, size_t _cols) const {
+                return MatrixView<T>(m_data + _row * m_stride + _col, _rows, _cols, m_stride);
+            }
+
+            VectorView<T> Row(size_t _row) const {
+                return VectorView<T>(m_data + _row * m_stride, m_cols, 1);
+            }
+
+            VectorView<T> Column(size_t _col) const {
+                return VectorView<T>(m_data + _col, m_rows, m_stride);
+            }
+
+            void Fill(const value_type& _value) {
+                for(size_t i = 0; i < m_rows; i++)
+                    std::fill((*this)[i], (*this)[i] + m_cols, _value);
+            }
+
+            // elementwise addition of an expression of the same shape
+            template<typename E>
+            MatrixView& operator+=(const MatrixExpression<E>& _m) {
+                return *this = *this + _m.Self();
+            }
+
+            // elementwise subtraction of an expression of the same shape
+            template<typename E>
+            MatrixView& operator-=(const MatrixExpression<E>& _m) {
+                return *this = *this - _m.Self();
+            }
+    };
+
+
+    /// Non-owning view of _size elements that are _stride elements apart
+    template<typename T>
+    class VectorView : public VectorExpression<VectorView<T>> {
+        private:
+            T *m_data = nullptr;
+            size_t m_size = 0;
+            size_t m_stride = 1;
+
+            template<typename E>
+            void Assign(const E& _e) {
+                ParallelElements(m_size, [&](size_t _first, size_t _last) {
+                    for(size_t i = _first; i < _last; i++)
+                        m_data[i * m_stride] = _e.Element(i);
+                });
+            }
+
+        public:
+            typedef typename std::remove_const<T>::type value_type;
+
+            VectorView() = default;
+            VectorView(const VectorView&) = default;
+
+            VectorView(T *_data, size_t _size, size_t _stride = 1) :
+                m_data(_data), m_size(_size), m_stride(_stride) {}
+
+            // view of less const elements
+            template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+            VectorView(const VectorView<U>& _v) :
+                VectorView(_v.data(), _v.size(), _v.Stride()) {}
+
+            // whole VectorN
+            template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+            VectorView(VectorN<U>& _v) :
+                VectorView(_v.data(), _v.size()) {}
+
+            template<typename U, typename = typename std::enable_if<std::is_convertible<const U*, T*>::value>::type>
+            VectorView(const VectorN<U>& _v) :
+                VectorView(_v.data(), _v.size()) {}
+
+            // copy the elements of a view of the same size, views of another size are left untouched
+            // the views must not overlap
+            VectorView& operator=(const VectorView& _v) {
+                if(m_size == _v.size())
+                    Assign(_v);
+
+                return *this;
+            }
+
+            // evaluate an elementwise expression of the same size into the viewed elements
+            template<typename E>
+            VectorView& operator=(const VectorExpression<E>& _e) {
+                if(m_size == _e.Self().size())
+                    Assign(_e.Self());
+
+                return *this;
+            }
+
+            size_t size() const { return m_size; }
+            size_t Stride() const { return m_stride; }
+
+            T* data() const { return m_data; }
+
+            T& operator[](size_t i) const { return m_data[i * m_stride]; }
+            const value_type& Element(size_t i) const { return m_data[i * m_stride]; }
+
+            /// _count elements starting at element _first
+            VectorView<T> Segment(size_t _first, size_t _count) const {
+                return VectorView<T>(m_data + _first * m_stride, _count, m_stride);
+            }
+
+            void Fill(const value_type& _value) {
+                for(size_t i = 0; i < m_size; i++)
+                    m_data[i * m_stride] = _value;
+            }
+
+            // elementwise addition of an expression of the same size
+            template<typename E>
+            VectorView& operator+=(const VectorExpression<E>& _v) {
+                return *this = *this + _v.Self();
+            }
+
+            // elementwise subtraction of an expression of the same size
+            template<typename E>
+            VectorView& operator-=(const VectorExpression<E>& _v) {
+                return *this = *this - _v.Self();
+            }
+    };
+
+
+    /// C = _alpha * op(A) * op(B) + _beta * C on views, MatrixN operands convert to views
+    /// Returns false and leaves C untouched when the shapes do not conform. C must not overlap A or B.
+    template<typename T>
+    bool Gemm(NonDeduced<T> _alpha, const MatrixView<const NonDeduced<T>>& _a, bool _trans_a,
+              const MatrixView<const NonDeduced<T>>& _b, bool _trans_b, NonDeduced<T> _beta, const MatrixView<T>& _c)
+    {
+        static_assert(std::is_arithmetic<T>::value, "Gemm needs an arithmetic element type");
+        const size_t m = _trans_a ? _a.Columns() : _a.Rows();
+        const size_t k = _trans_a ? _a.Rows() : _a.Columns();
+        const size_t n = _trans_b ? _b.Rows() : _b.Columns();
+        if(_c.Rows() != m || _c.Columns() != n || (_trans_b ? _b.Columns() : _b.Rows()) != k)
+            return false;
+
+        Gemm(_trans_a, _trans_b, m, n, k, _alpha, _a.Data(), _a.Stride(), _b.Data(), _b.Stride(), _beta, _c.Data(), _c.Stride());
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,236 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: MemoryResource.h - Allocator and bump arena for MatrixN and VectorN storage
+/// author: Karl-Mihkel Ott
+
+#ifndef MEMORY_RESOURCE_H
+#define MEMORY_RESOURCE_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <memory_resource>
+
+// MatrixN, VectorN and the scratch buffers of the factorizations allocate through TRS::Allocator, which draws from
+// a std::pmr::memory_resource. Containers that are not given a resource explicitly, including copies and all
+// temporaries made by operators, Determinant() and Inverse(), use the resource of the innermost MemoryResourceScope
+// on the constructing thread, or std::pmr::get_default_resource() outside of any scope:
+//
+//     TRS::BumpArena arena;
+//     for(;;) {
+//         TRS::MemoryResourceScope scope(&arena);
+//         ... per-frame linear algebra, every temporary comes from the arena ...
+//         arena.Reset();
+//     }
+//
+// Like std::pmr containers, a container keeps its resource for life: assigning to it copies the elements into
+// its own storage instead of adopting the resource of the source, so results assigned to long lived matrices
+// survive the arena being reset. Containers still using the arena must be gone before Reset().
+//
+// The thread pool hands work to its workers without allocating, and scratch buffers, including the packing buffers
+// of Gemm, the panel buffer of MatrixN::operator*= and the partial sums of the iterative solvers, come from the
+// scope of the calling thread and are given back before the call returns. A frame run on several threads is
+// therefore as allocation free as a serial one, and no buffer outlives the call that made it.
+
+namespace TRS {
+
+    // resource of the innermost scope on this thread, null outside of any scope
+    inline std::pmr::memory_resource *&CurrentMemoryResource() {
+        thread_local std::pmr::memory_resource *resource = nullptr;
+        return resource;
+    }
+
+
+    /// Resource used for containers created on this thread without an explicit one
+    inline std::pmr::memory_resource *GetMemoryResource() {
+        std::pmr::memory_resource *resource = CurrentMemoryResource();
+        return resource ? resource : std::pmr::get_default_resource();
+    }
+
+
+    /// Make _resource the resource of containers created on this thread until the scope ends, scopes nest
+    /// Work that the thread pool runs on its workers does not see the scope.
+    class MemoryResourceScope {
+        private:
+            std::pmr::memory_resource *m_previous;
+
+        public:
+            explicit MemoryResourceScope(std::pmr::memory_resource *_resource) :
+                m_previous(CurrentMemoryResource())
+            {
+                CurrentMemoryResource() = _resource;
+            }
+
+            ~MemoryResourceScope() {
+                CurrentMemoryResource() = m_previous;
+            }
+
+            MemoryResourceScope(const MemoryResourceScope&) = delete;
+            MemoryResourceScope& operator=(const MemoryResourceScope&) = delete;
+    };
+
+
+    /// Allocator over a std::pmr::memory_resource, default constructed and copied containers take the current resource
+    template<typename T>
+    class Allocator {
+        private:
+            std::pmr::memory_resource *m_resource;
+
+        public:
+            typedef T value_type;
+            typedef std::false_type propagate_on_container_copy_assignment;
+            typedef std::false_type propagate_on_container_move_assignment;
+            typedef std::false_type propagate_on_container_swap;
+            typedef std::false_type is_always_equal;
+
+            Allocator() noexcept : m_resource(GetMemoryResource()) {}
+
+            Allocator(std::pmr::memory_resource *_resource) noexcept :
+                m_resource(_resource ? _resource : GetMemoryResource()) {}
+
+            template<typename U>
+            Allocator(const Allocator<U>& _other) noexcept : m_resource(_other.Resource()) {}
+
+            T *allocate(size_t _n) {
+                return static_cast<T*>(m_resource->allocate(_n * sizeof(T), alignof(T)));
+            }
+
+            void deallocate(T *_p, size_t _n) noexcept {
+                m_resource->deallocate(_p, _n * sizeof(T), alignof(T));
+            }
+
+            // copies of a container allocate from the resource that is current where the copy is made
+            Allocator select_on_container_copy_construction() const {
+                return Allocator();
+            }
+
+            std::pmr::memory_resource *Resource() const { return m_resource; }
+
+            template<typename U>
+            bool operator==(const Allocator<U>& _other) const {
+                return m_resource == _other.Resource() || m_resource->is_equal(*_other.Resource());
+            }
+
+            template<typename U>
+            bool operator!=(const Allocator<U>& _other) const {
+                return !(*this == _other);
+            }
+    };
+
+
+    /// std::vector that allocates from the current memory resource, used for scratch space
+    template<typename T>
+    using Buffer = std::vector<T, Allocator<T>>;
+
+
+    /**
+     * Bump allocator for short lived containers, typically everything made during one frame
+     * Allocation moves a pointer forward and deallocation does nothing, Reset() frees everything at once.
+     * Memory is requested from the upstream resource in chunks that are kept across Reset(), and chunks
+     * used in one cycle are merged into one, so a steady workload stops touching the upstream resource
+     * after its first cycle. An arena must only be used by one thread at a time.
+     */
+    class BumpArena : public std::pmr::memory_resource {
+        private:
+            struct Chunk {
+                std::byte *data;
+                size_t size;
+            };
+
+            std::pmr::memory_resource *m_upstream;
+            std::vector<Chunk> m_chunks;
+            size_t m_chunk = 0;
+            size_t m_offset = 0;
+            size_t m_used = 0;
+
+            static constexpr size_t chunk_align = alignof(std::max_align_t);
+
+            void AddChunk(size_t _size) {
+                m_chunks.push_back(Chunk { static_cast<std::byte*>(m_upstream->allocate(_size, chunk_align)), _size });
+            }
+
+            void ReleaseChunks() {
+                for(const Chunk &chunk : m_chunks)
+                    m_upstream->deallocate(chunk.data, chunk.size, chunk_align);
+                m_chunks.clear();
+            }
+
+        protected:
+            void *do_allocate(size_t _bytes, size_t _alignment) override {
+                for(;;) {
+                    if(m_chunk < m_chunks.size()) {
+                        const Chunk &chunk = m_chunks[m_chunk];
+                        const size_t start = (m_offset + _alignment - 1) / _alignment * _alignment;
+                        if(start <= chunk.size && _bytes <= chunk.size - start) {
+                            m_used += start + _bytes - m_offset;
+                            m_offset = start + _bytes;
+                            return chunk.data + start;
+                        }
+
+                        if(m_chunk + 1 < m_chunks.size()) {
+                            m_chunk++;
+                            m_offset = 0;
+                            continue;
+                        }
+                    }
+
+                    // grow geometrically, the chunk also fits the request with any alignment
+                    const size_t last = m_chunks.empty() ? 0 : m_chunks.back().size;
+                    AddChunk(std::max(2 * last, _bytes + _alignment));
+                    m_chunk = m_chunks.size() - 1;
+                    m_offset = 0;
+                }
+            }
+
+            void do_deallocate(void*, size_t, size_t) override {}
+
+            bool do_is_equal(const std::pmr::memory_resource &_other) const noexcept override {
+                return this == &_other;
+            }
+
+        public:
+            explicit BumpArena(size_t _initial_size = 1 << 20, std::pmr::memory_resource *_upstream = std::pmr::new_delete_resource()) :
+                m_upstream(_upstream)
+            {
+                if(_initial_size)
+                    AddChunk(_initial_size);
+            }
+
+            ~BumpArena() {
+                ReleaseChunks();
+            }
+
+            BumpArena(const BumpArena&) = delete;
+            BumpArena& operator=(const BumpArena&) = delete;
+
+            /// Free every allocation, the memory is kept for the next cycle
+            void Reset() {
+                if(m_chunks.size() > 1) {
+                    size_t total = 0;
+                    for(const Chunk &chunk : m_chunks)
+                        total += chunk.size;
+
+                    ReleaseChunks();
+                    AddChunk(total);
+                }
+
+                m_chunk = 0;
+                m_offset = 0;
+                m_used = 0;
+            }
+
+            /// Bytes handed out since the last Reset(), including alignment padding
+            size_t Used() const { return m_used; }
+
+            /// Bytes held from the upstream resource
+            size_t Capacity() const {
+                size_t total = 0;
+                for(const Chunk &chunk : m_chunks)
+                    total += chunk.size;
+                return total;
+            }
+    };
+}
+
+#endif
@@ -6,38 +6,13 @@
 #ifndef QUATERNION_H
 #define QUATERNION_H
 
-#ifndef TRS_USE_SIMD
-#define TRS_USE_SIMD
-    #include <xmmintrin.h>
-    #include <smmintrin.h>
-#endif
+#include <trs/Simd.h>
 
 namespace TRS {
 
-    /// Fast 3D vector cross product using SIMD instructions
-    inline __m128 FastCross(const __m128 &_vec1, const __m128 &_vec2) {
-        __m128 tmp0 = _mm_shuffle_ps(_vec1, _vec1, _MM_SHUFFLE(3, 0, 2, 1));
-        __m128 tmp1 = _mm_shuffle_ps(_vec2, _vec2, _MM_SHUFFLE(3, 1, 0, 2));
-        __m128 tmp2 = _mm_mul_ps(tmp0, _vec2);
-        __m128 tmp3 = _mm_mul_ps(tmp0, tmp1);
-        __m128 tmp4 = _mm_shuffle_ps(tmp2, tmp2, _MM_SHUFFLE(3, 0, 2, 1));
-        return _mm_sub_ps(tmp3, tmp4);
-    }
-
-
-	inline float FastDot(const __m128 &_vec1, const __m128 &_vec2) {
-		__m128 mul_res, shuf_reg, sums_reg;
-		mul_res = _mm_mul_ps(_vec1, _vec2);
-
-		shuf_reg = _mm_movehdup_ps(mul_res);
-		sums_reg = _mm_add_ps(mul_res, shuf_reg);
-		shuf_reg = _mm_movehl_ps(shuf_reg, sums_reg);
-		sums_reg = _mm_add_ss(sums_reg, shuf_reg);
-		return _mm_cvtss_f32(sums_reg);
-	}
-
     /// Quaternion structure for TRS
-    struct Quaternion {
+    /// Aligned to 16 bytes so that x, y, z, w can be loaded into a single SIMD register
+    struct alignas(16) Quaternion {
         float x, y, z, w;
 
         Quaternion(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
@@ -52,46 +27,41 @@ namespace TRS {
          * Calculate Grassman product of two quaternions
          */
         inline Quaternion operator*(const Quaternion &_q) const {
+            const __m128 xyz_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
             const __m128 pw_vec = _mm_set_ps1(w);
             const __m128 qw_vec = _mm_set_ps1(_q.w);
-            const __m128 p_vec = _mm_set_ps(0, z, y, x);
-            const __m128 q_vec = _mm_set_ps(0, _q.z, _q.y, _q.x);
+            const __m128 p_vec = _mm_and_ps(_mm_load_ps(&x), xyz_mask);
+            const __m128 q_vec = _mm_and_ps(_mm_load_ps(&_q.x), xyz_mask);
             const __m128 vec3 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pw_vec, q_vec), _mm_mul_ps(qw_vec, p_vec)), FastCross(p_vec, q_vec));
             float scalar = w * _q.w - FastDot(p_vec, q_vec);
 
             Quaternion out;
-            _mm_storeu_ps(&out.x, vec3);
+            _mm_store_ps(&out.x, vec3);
             out.w = scalar;
             return out;
         }
 
         inline static float Dot(const Quaternion &_q1, const Quaternion &_q2) {
-            const __m128 q1_vec = _mm_set_ps(_q1.w, _q1.z, _q1.y, _q1.x);
-            const __m128 q2_vec = _mm_set_ps(_q2.w, _q2.z, _q2.y, _q2.x);
-            return FastDot(q1_vec, q2_vec);
+            return FastDot(_mm_load_ps(&_q1.x), _mm_load_ps(&_q2.x));
         }
 
         inline Quaternion operator*(const float _c) const {
             Quaternion out;
             const __m128 c = _mm_set_ps1(_c);
-            const __m128 vec = _mm_set_ps(w, z, y, x);
-            _mm_storeu_ps(&out.x, _mm_mul_ps(vec, c));
+            _mm_store_ps(&out.x, _mm_mul_ps(_mm_load_ps(&x), c));
             return out;
         }
 
         inline Quaternion operator/(const float _c) const {
             Quaternion out;
             const __m128 c = _mm_set_ps1(1 / _c);
-            const __m128 vec = _mm_set_ps(w, z, y, x);
-            _mm_storeu_ps(&out.x, _mm_mul_ps(vec, c));
+            _mm_store_ps(&out.x, _mm_mul_ps(_mm_load_ps(&x), c));
             return out;
         }
 
         inline Quaternion operator+(const Quaternion &_q) const {
             Quaternion out;
-            const __m128 q1 = _mm_set_ps(w, z, y, x);
-            const __m128 q2 = _mm_set_ps(_q.w, _q.z, _q.y, _q.x);
-            _mm_storeu_ps(&out.x, _mm_add_ps(q1, q2));
+            _mm_store_ps(&out.x, _mm_add_ps(_mm_load_ps(&x), _mm_load_ps(&_q.x)));
             return out;
         }
 
@@ -0,0 +1,56 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Simd.h - Common SIMD intrinsics and helper functions
+/// author: Karl-Mihkel Ott
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#ifndef TRS_USE_SIMD
+#define TRS_USE_SIMD
+#endif
+
+#include <immintrin.h>
+
+// AVX2 and FMA are enabled together (-mavx2 -mfma or /arch:AVX2)
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+    #define TRS_AVX2_FMA
+#endif
+
+// Kernels that are selected at runtime are compiled for their instruction set with function attributes,
+// so the rest of the binary can target the baseline CPU. MSVC allows any intrinsic without attributes.
+#if defined(__GNUC__) || defined(__clang__)
+    #define TRS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+    #define TRS_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+    #define TRS_TARGET_AVX2
+    #define TRS_TARGET_AVX512
+#endif
+
+namespace TRS {
+
+    /// Fast 3D vector cross product using SIMD instructions
+    inline __m128 FastCross(const __m128 &_vec1, const __m128 &_vec2) {
+        __m128 tmp0 = _mm_shuffle_ps(_vec1, _vec1, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 tmp1 = _mm_shuffle_ps(_vec2, _vec2, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 tmp2 = _mm_mul_ps(tmp0, _vec2);
+        __m128 tmp3 = _mm_mul_ps(tmp0, tmp1);
+        __m128 tmp4 = _mm_shuffle_ps(tmp2, tmp2, _MM_SHUFFLE(3, 0, 2, 1));
+        return _mm_sub_ps(tmp3, tmp4);
+    }
+
+
+    /// Sum all four elements of the register, the result is broadcasted into every element
+    inline __m128 FastSum(const __m128 &_vec) {
+        const __m128 sums = _mm_add_ps(_vec, _mm_shuffle_ps(_vec, _vec, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_add_ps(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+
+
+    /// Fast 4 element dot product using SSE2 instructions only
+    inline float FastDot(const __m128 &_vec1, const __m128 &_vec2) {
+        return _mm_cvtss_f32(FastSum(_mm_mul_ps(_vec1, _vec2)));
+    }
+}
+
+#endif
@@ -0,0 +1,343 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: SparseMatrixN.h - Compressed sparse row matrix with products against VectorN and MatrixN
+/// author: Karl-Mihkel Ott
+
+#ifndef SPARSE_MATRIXN_H
+#define SPARSE_MATRIXN_H
+
+#include <cstddef>
+#include <cassert>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Simd.h>
+#include <trs/CpuFeatures.h>
+#include <trs/ThreadPool.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+
+namespace TRS {
+
+    /// One (row, column, value) entry used to build sparse matrices
+    template<typename T>
+    struct Triplet {
+        size_t row;
+        size_t col;
+        T value;
+    };
+
+
+    /// Sparse dot product of one CSR row with a dense vector
+    template<typename T>
+    using SparseDotKernel = T(*)(size_t _n, const T *_values, const size_t *_cols, const T *_x);
+
+    template<typename T>
+    inline T ScalarSparseDot(size_t _n, const T *_values, const size_t *_cols, const T *_x) {
+        T s0 = T(), s1 = T();
+        size_t k = 0;
+        for(; k + 2 <= _n; k += 2) {
+            s0 += _values[k] * _x[_cols[k]];
+            s1 += _values[k + 1] * _x[_cols[k + 1]];
+        }
+        if(k < _n)
+            s0 += _values[k] * _x[_cols[k]];
+
+        return s0 + s1;
+    }
+
+
+    /// AVX2 gather kernel for float rows, column indices are gathered as 64 bit offsets
+    /// SpMV is bound by memory, a single four lane gather per step suits the short rows of typical meshes best.
+    TRS_TARGET_AVX2 inline float FastSparseDot(size_t _n, const float *_values, const size_t *_cols, const float *_x) {
+        __m128 acc = _mm_setzero_ps();
+        size_t k = 0;
+        for(; k + 4 <= _n; k += 4) {
+            const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_cols + k));
+            acc = _mm_fmadd_ps(_mm_loadu_ps(_values + k), _mm256_i64gather_ps(_x, idx, 4), acc);
+        }
+
+        float sum = _mm_cvtss_f32(FastSum(acc));
+        for(; k < _n; k++)
+            sum += _values[k] * _x[_cols[k]];
+
+        return sum;
+    }
+
+
+    /// AVX2 gather kernel for double rows
+    TRS_TARGET_AVX2 inline double FastSparseDot(size_t _n, const double *_values, const size_t *_cols, const double *_x) {
+        __m256d acc = _mm256_setzero_pd();
+        size_t k = 0;
+        for(; k + 4 <= _n; k += 4) {
+            const __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_cols + k));
+            acc = _mm256_fmadd_pd(_mm256_loadu_pd(_values + k), _mm256_i64gather_pd(_x, idx, 8), acc);
+        }
+
+        const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for(; k < _n; k++)
+            sum += _values[k] * _x[_cols[k]];
+
+        return sum;
+    }
+
+
+    /// Pick the fastest sparse dot kernel supported by the running CPU
+    template<typename T>
+    inline SparseDotKernel<T> SelectSparseDotKernel() {
+        if constexpr (sizeof(size_t) == 8 && (std::is_same<T, float>::value || std::is_same<T, double>::value)) {
+            const CpuFeatures &cpu = GetCpuFeatures();
+            if(cpu.avx2 && cpu.fma)
+                return static_cast<SparseDotKernel<T>>(&FastSparseDot);
+        }
+
+        return &ScalarSparseDot<T>;
+    }
+
+
+    /**
+     * Sparse matrix in compressed sparse row form
+     * Row i keeps its column indices sorted in ColumnIndices()[RowPointers()[i] .. RowPointers()[i + 1]) together
+     * with the values at the same positions. Storage and products scale with the number of non-zeros, products
+     * with many non-zeros are split over the shared thread pool by row blocks.
+     */
+    template<typename T>
+    class SparseMatrixN {
+        private:
+            size_t m_rows = 0;
+            size_t m_cols = 0;
+            std::vector<size_t> m_row_ptr = std::vector<size_t>(1, 0);
+            std::vector<size_t> m_col_idx;
+            std::vector<T> m_values;
+
+            // call _f(first_row, last_row) on row blocks that hold at least the elementwise threshold of non-zeros on average
+            template<typename F>
+            void ForEachRowBlock(size_t _work_per_nonzero, F &&_f) const {
+                ThreadPool &pool = GetThreadPool();
+                const size_t per_row = std::max<size_t>(NonZeros() * _work_per_nonzero / std::max<size_t>(m_rows, 1), 1);
+                const size_t chunks = 4 * pool.GetThreadCount();
+                const size_t rows = std::max((pool.GetElementwiseThreshold() + per_row - 1) / per_row, (m_rows + chunks - 1) / chunks);
+                pool.ParallelFor(0, m_rows, rows, std::forward<F>(_f));
+            }
+
+        public:
+            typedef T value_type;
+
+            SparseMatrixN() = default;
+
+            /// Empty _rows x _cols matrix
+            SparseMatrixN(size_t _rows, size_t _cols) :
+                m_rows(_rows), m_cols(_cols), m_row_ptr(_rows + 1, 0) {}
+
+            /// Take over CSR arrays, columns have to be sorted within every row
+            SparseMatrixN(size_t _rows, size_t _cols, std::vector<size_t> _row_ptr, std::vector<size_t> _col_idx, std::vector<T> _values) :
+                m_rows(_rows), m_cols(_cols), m_row_ptr(std::move(_row_ptr)), m_col_idx(std::move(_col_idx)), m_values(std::move(_values))
+            {
+                assert(m_row_ptr.size() == m_rows + 1 && m_col_idx.size() == m_values.size() && m_row_ptr.back() == m_values.size());
+            }
+
+            /// Keep the elements of a dense matrix whose magnitude is above _tolerance
+            explicit SparseMatrixN(const MatrixN<T>& _dense, const T& _tolerance = T()) :
+                m_rows(_dense.Rows()), m_cols(_dense.Columns()), m_row_ptr(1, 0)
+            {
+                m_row_ptr.reserve(m_rows + 1);
+                for(size_t i = 0; i < m_rows; i++) {
+                    const T *row = _dense[i];
+                    for(size_t j = 0; j < m_cols; j++) {
+                        if(row[j] > _tolerance || -row[j] > _tolerance) {
+                            m_col_idx.push_back(j);
+                            m_values.push_back(row[j]);
+                        }
+                    }
+                    m_row_ptr.push_back(m_values.size());
+                }
+            }
+
+            /// Build from (row, column, value) entries in any order, duplicate entries are summed
+            static SparseMatrixN<T> FromTriplets(size_t _rows, size_t _cols, const std::vector<Triplet<T>>& _triplets) {
+                SparseMatrixN<T> matrix(_rows, _cols);
+
+                // counting sort by row
+                for(const Triplet<T>& t : _triplets) {
+                    assert(t.row < _rows && t.col < _cols);
+                    matrix.m_row_ptr[t.row + 1]++;
+                }
+                for(size_t i = 0; i < _rows; i++)
+                    matrix.m_row_ptr[i + 1] += matrix.m_row_ptr[i];
+
+                std::vector<std::pair<size_t, T>> entries(_triplets.size());
+                std::vector<size_t> fill(matrix.m_row_ptr.begin(), matrix.m_row_ptr.end() - 1);
+                for(const Triplet<T>& t : _triplets)
+                    entries[fill[t.row]++] = std::make_pair(t.col, t.value);
+
+                // sort every row by column and merge duplicates in place
+                matrix.m_col_idx.reserve(entries.size());
+                matrix.m_values.reserve(entries.size());
+                size_t begin = 0;
+                for(size_t i = 0; i < _rows; i++) {
+                    const size_t end = matrix.m_row_ptr[i + 1];
+                    std::sort(entries.begin() + begin, entries.begin() + end,
+                              [](const std::pair<size_t, T>& _a, const std::pair<size_t, T>& _b) { return _a.first < _b.first; });
+
+                    const size_t row_begin = matrix.m_values.size();
+                    for(size_t k = begin; k < end; k++) {
+                        if(matrix.m_values.size() > row_begin && matrix.m_col_idx.back() == entries[k].first)
+                            matrix.m_values.back() += entries[k].second;
+                        else {
+                            matrix.m_col_idx.push_back(entries[k].first);
+                            matrix.m_values.push_back(entries[k].second);
+                        }
+                    }
+
+                    begin = end;
+                    matrix.m_row_ptr[i + 1] = matrix.m_values.size();
+                }
+
+                return matrix;
+            }
+
+            size_t Rows() const { return m_rows; }
+            size_t Columns() const { return m_cols; }
+            size_t NonZeros() const { return m_values.size(); }
+
+            const std::vector<size_t>& RowPointers() const { return m_row_ptr; }
+            const std::vector<size_t>& ColumnIndices() const { return m_col_idx; }
+            const std::vector<T>& Values() const { return m_values; }
+            std::vector<T>& Values() { return m_values; }
+
+            /// Element at (_row, _col), T() when it is not stored
+            T Coefficient(size_t _row, size_t _col) const {
+                const size_t *first = m_col_idx.data() + m_row_ptr[_row];
+                const size_t *last = m_col_idx.data() + m_row_ptr[_row + 1];
+                const size_t *it = std::lower_bound(first, last, _col);
+                return it != last && *it == _col ? m_values[it - m_col_idx.data()] : T();
+            }
+
+            MatrixN<T> ToDense() const {
+                MatrixN<T> dense(m_rows, m_cols, T());
+                for(size_t i = 0; i < m_rows; i++) {
+                    for(size_t k = m_row_ptr[i]; k < m_row_ptr[i + 1]; k++)
+                        dense[i][m_col_idx[k]] = m_values[k];
+                }
+
+                return dense;
+            }
+
+            SparseMatrixN<T> Transpose() const {
+                SparseMatrixN<T> t(m_cols, m_rows);
+                t.m_col_idx.resize(NonZeros());
+                t.m_values.resize(NonZeros());
+
+                for(size_t k = 0; k < NonZeros(); k++)
+                    t.m_row_ptr[m_col_idx[k] + 1]++;
+                for(size_t j = 0; j < m_cols; j++)
+                    t.m_row_ptr[j + 1] += t.m_row_ptr[j];
+
+                // walking rows in order keeps the transposed rows sorted
+                std::vector<size_t> fill(t.m_row_ptr.begin(), t.m_row_ptr.end() - 1);
+                for(size_t i = 0; i < m_rows; i++) {
+                    for(size_t k = m_row_ptr[i]; k < m_row_ptr[i + 1]; k++) {
+                        const size_t dst = fill[m_col_idx[k]]++;
+                        t.m_col_idx[dst] = i;
+                        t.m_values[dst] = m_values[k];
+                    }
+                }
+
+                return t;
+            }
+
+            /// y = A * x, _x holds Columns() and _y holds Rows() elements, they must not overlap
+            void Multiply(const T *_x, T *_y) const {
+                if constexpr (std::is_arithmetic<T>::value) {
+                    const SparseDotKernel<T> kernel = SelectSparseDotKernel<T>();
+                    ForEachRowBlock(1, [&](size_t _first, size_t _last) {
+                        for(size_t i = _first; i < _last; i++) {
+                            const size_t k = m_row_ptr[i];
+                            _y[i] = kernel(m_row_ptr[i + 1] - k, m_values.data() + k, m_col_idx.data() + k, _x);
+                        }
+                    });
+                }
+            }
+
+            /// Sparse matrix-vector product, vectors of the wrong length give an empty result
+            VectorN<T> operator*(const VectorN<T>& _v) const {
+                if(_v.size() != m_cols)
+                    return VectorN<T>();
+
+                VectorN<T> result(m_rows);
+                Multiply(_v.data(), result.data());
+                return result;
+            }
+
+            template<typename E>
+            VectorN<T> operator*(const VectorExpression<E>& _v) const {
+                return *this * VectorN<T>(_v);
+            }
+
+            /// Sparse times dense product, Rows() x K times K x C gives Rows() x C and operands that do not conform give an empty matrix
+            MatrixN<T> operator*(const MatrixN<T>& _m) const {
+                if(_m.Rows() != m_cols)
+                    return MatrixN<T>();
+
+                MatrixN<T> result(m_rows, _m.Columns(), T());
+                if constexpr (std::is_arithmetic<T>::value) {
+                    const size_t n = _m.Columns();
+                    ForEachRowBlock(n, [&](size_t _first, size_t _last) {
+                        for(size_t i = _first; i < _last; i++) {
+                            T *out = result[i];
+                            for(size_t k = m_row_ptr[i]; k < m_row_ptr[i + 1]; k++) {
+                                const T a = m_values[k];
+                                const T *row = _m[m_col_idx[k]];
+                                for(size_t j = 0; j < n; j++)
+                                    out[j] += a * row[j];
+                            }
+                        }
+                    });
+                }
+
+                return result;
+            }
+
+            template<typename E>
+            MatrixN<T> operator*(const MatrixExpression<E>& _m) const {
+                return *this * MatrixN<T>(_m);
+            }
+    };
+
+
+    /// Dense times sparse product, R x K times K x Columns() gives R x Columns() and operands that do not conform give an empty matrix
+    template<typename T>
+    MatrixN<T> operator*(const MatrixN<T>& _m, const SparseMatrixN<T>& _s) {
+        if(_m.Columns() != _s.Rows())
+            return MatrixN<T>();
+
+        MatrixN<T> result(_m.Rows(), _s.Columns(), T());
+        if constexpr (std::is_arithmetic<T>::value) {
+            const size_t *row_ptr = _s.RowPointers().data();
+            const size_t *cols = _s.ColumnIndices().data();
+            const T *values = _s.Values().data();
+
+            ThreadPool &pool = GetThreadPool();
+            const size_t work = std::max<size_t>(_s.NonZeros(), 1);
+            const size_t rows = std::max<size_t>((pool.GetElementwiseThreshold() + work - 1) / work, 1);
+            pool.ParallelFor(0, _m.Rows(), rows, [&](size_t _first, size_t _last) {
+                for(size_t i = _first; i < _last; i++) {
+                    const T *a = _m[i];
+                    T *out = result[i];
+                    for(size_t p = 0; p < _m.Columns(); p++) {
+                        if(a[p] == T())
+                            continue;
+                        for(size_t k = row_ptr[p]; k < row_ptr[p + 1]; k++)
+                            out[cols[k]] += a[p] * values[k];
+                    }
+                }
+            });
+        }
+
+        return result;
+    }
+}
+
+#endif
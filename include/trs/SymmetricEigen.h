@@ -0,0 +1,555 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: SymmetricEigen.h - Eigen decomposition of symmetric MatrixN and Matrix3
+/// author: Karl-Mihkel Ott
+
+#ifndef SYMMETRIC_EIGEN_H
+#define SYMMETRIC_EIGEN_H
+
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+#include <trs/Simd.h>
+#include <trs/CpuFeatures.h>
+#include <trs/ThreadPool.h>
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+#include <trs/Triangular.h>
+
+namespace TRS {
+
+    /// Plane rotation of two rows, x = c * x - s * y and y = s * x + c * y
+    template<typename T>
+    using PlaneRotationKernel = void(*)(size_t _n, T _c, T _s, T *_x, T *_y);
+
+
+    template<typename T>
+    inline void ScalarPlaneRotation(size_t _n, T _c, T _s, T *_x, T *_y) {
+        for(size_t i = 0; i < _n; i++) {
+            const T x = _x[i], y = _y[i];
+            _x[i] = _c * x - _s * y;
+            _y[i] = _s * x + _c * y;
+        }
+    }
+
+
+    TRS_TARGET_AVX2 inline void FastPlaneRotation(size_t _n, float _c, float _s, float *_x, float *_y) {
+        const __m256 c = _mm256_set1_ps(_c);
+        const __m256 s = _mm256_set1_ps(_s);
+        size_t i = 0;
+        for(; i + 8 <= _n; i += 8) {
+            const __m256 x = _mm256_loadu_ps(_x + i);
+            const __m256 y = _mm256_loadu_ps(_y + i);
+            _mm256_storeu_ps(_x + i, _mm256_fmsub_ps(c, x, _mm256_mul_ps(s, y)));
+            _mm256_storeu_ps(_y + i, _mm256_fmadd_ps(s, x, _mm256_mul_ps(c, y)));
+        }
+
+        ScalarPlaneRotation(_n - i, _c, _s, _x + i, _y + i);
+    }
+
+
+    TRS_TARGET_AVX2 inline void FastPlaneRotation(size_t _n, double _c, double _s, double *_x, double *_y) {
+        const __m256d c = _mm256_set1_pd(_c);
+        const __m256d s = _mm256_set1_pd(_s);
+        size_t i = 0;
+        for(; i + 4 <= _n; i += 4) {
+            const __m256d x = _mm256_loadu_pd(_x + i);
+            const __m256d y = _mm256_loadu_pd(_y + i);
+            _mm256_storeu_pd(_x + i, _mm256_fmsub_pd(c, x, _mm256_mul_pd(s, y)));
+            _mm256_storeu_pd(_y + i, _mm256_fmadd_pd(s, x, _mm256_mul_pd(c, y)));
+        }
+
+        ScalarPlaneRotation(_n - i, _c, _s, _x + i, _y + i);
+    }
+
+
+    /// Pick the fastest plane rotation kernel supported by the running CPU
+    template<typename T>
+    inline PlaneRotationKernel<T> SelectPlaneRotationKernel() {
+        if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value) {
+            const CpuFeatures &cpu = GetCpuFeatures();
+            if(cpu.avx2 && cpu.fma)
+                return static_cast<PlaneRotationKernel<T>>(&FastPlaneRotation);
+        }
+
+        return &ScalarPlaneRotation<T>;
+    }
+
+
+    /**
+     * Eigen decomposition A = V * diag(w) * V^T of a symmetric MatrixN
+     * The matrix is reduced to tridiagonal form with Householder reflections, then the tridiagonal matrix is
+     * diagonalized with implicit QL iterations and Wilkinson shifts. Eigenvectors are accumulated as rows so that
+     * every plane rotation touches two contiguous rows, without eigenvectors the QL stage is only O(n^2).
+     * Only the lower triangle of the input is read.
+     */
+    template<typename T>
+    class SymmetricEigen {
+        static_assert(std::is_floating_point<T>::value, "SymmetricEigen needs a floating point type");
+
+        private:
+            VectorN<T> m_values;
+            MatrixN<T> m_vectors;
+            bool m_converged = true;
+
+            // reduce the symmetric _a to tridiagonal form, the reflectors are accumulated into _q when it is not null
+            static void Tridiagonalize(MatrixN<T>& _a, T *_d, T *_e, MatrixN<T> *_q) {
+                const size_t n = _a.Rows();
+                Buffer<T> betas(n, T());
+                Buffer<T> p(n);
+
+                for(size_t k = 0; k + 1 < n; k++) {
+                    const size_t m = n - k - 1;
+                    T *v = _a[k] + k + 1;
+                    _d[k] = _a[k][k];
+
+                    // row k holds column k below the diagonal since the trailing matrix is kept full
+                    T norm2 = T();
+                    for(size_t i = 0; i < m; i++)
+                        norm2 += v[i] * v[i];
+
+                    if(m == 1 || norm2 == v[0] * v[0]) {
+                        _e[k] = v[0];
+                        continue;
+                    }
+
+                    const T alpha = v[0] > T() ? -std::sqrt(norm2) : std::sqrt(norm2);
+                    _e[k] = alpha;
+                    v[0] -= alpha;
+                    // v^T v = norm2 - 2 * alpha * x0 + alpha^2 = 2 * (norm2 - alpha * x0)
+                    betas[k] = static_cast<T>(1) / (norm2 - alpha * (v[0] + alpha));
+
+                    // B -= v * w^T + w * v^T with p = beta * B * v and w = p - beta / 2 * (p . v) * v
+                    const T beta = betas[k];
+                    ParallelRows(0, m, 2 * m, [&](size_t _first, size_t _last) {
+                        for(size_t i = _first; i < _last; i++)
+                            p[i] = beta * TriangularDot(m, _a[k + 1 + i] + k + 1, v);
+                    });
+
+                    const T half = beta * TriangularDot(m, p.data(), v) / static_cast<T>(2);
+                    for(size_t i = 0; i < m; i++)
+                        p[i] -= half * v[i];
+
+                    ParallelRows(0, m, 4 * m, [&](size_t _first, size_t _last) {
+                        for(size_t i = _first; i < _last; i++) {
+                            T *row = _a[k + 1 + i] + k + 1;
+                            const T vi = v[i], wi = p[i];
+                            for(size_t j = 0; j < m; j++)
+                                row[j] -= vi * p[j] + wi * v[j];
+                        }
+                    });
+                }
+
+                if(n)
+                    _d[n - 1] = _a[n - 1][n - 1];
+                if(!_q)
+                    return;
+
+                // Q = H_0 * H_1 * ... accumulated backwards, H_k only touches rows and columns past k
+                MatrixN<T>& q = *_q;
+                q = MatrixN<T>::MakeIdentity(n);
+                for(size_t k = n >= 2 ? n - 2 : 0; k-- > 0;) {
+                    if(betas[k] == T())
+                        continue;
+
+                    const size_t m = n - k - 1;
+                    const T *v = _a[k] + k + 1;
+                    // p = v^T * Q and Q -= beta * v * p on independent column blocks
+                    ParallelRows(0, m, 4 * m, [&](size_t _first, size_t _last) {
+                        std::fill(p.begin() + _first, p.begin() + _last, T());
+                        for(size_t i = 0; i < m; i++) {
+                            const T *row = q[k + 1 + i] + k + 1;
+                            for(size_t j = _first; j < _last; j++)
+                                p[j] += v[i] * row[j];
+                        }
+
+                        for(size_t i = 0; i < m; i++) {
+                            T *row = q[k + 1 + i] + k + 1;
+                            const T s = betas[k] * v[i];
+                            for(size_t j = _first; j < _last; j++)
+                                row[j] -= s * p[j];
+                        }
+                    });
+                }
+            }
+
+            // implicit QL on diagonal _d and off-diagonal _e, rotations are applied to the rows of _w when it is not null
+            static bool DiagonalizeTridiagonal(size_t _n, T *_d, T *_e, MatrixN<T> *_w) {
+                const T eps = std::numeric_limits<T>::epsilon();
+                const size_t max_iterations = 30;
+                T shift = T(), tst = T();
+                Buffer<T> rotations(_w ? 2 * _n : 0);
+                const PlaneRotationKernel<T> rotate = SelectPlaneRotationKernel<T>();
+                if(_n)
+                    _e[_n - 1] = T();
+
+                for(size_t l = 0; l < _n; l++) {
+                    tst = std::max(tst, std::abs(_d[l]) + std::abs(_e[l]));
+                    size_t m = l;
+                    while(m < _n && std::abs(_e[m]) > eps * tst)
+                        m++;
+
+                    size_t iterations = 0;
+                    while(m > l) {
+                        if(++iterations > max_iterations)
+                            return false;
+
+                        // Wilkinson shift from the leading 2x2 block
+                        T g = _d[l];
+                        T p = (_d[l + 1] - g) / (static_cast<T>(2) * _e[l]);
+                        T r = std::hypot(p, static_cast<T>(1));
+                        if(p < T())
+                            r = -r;
+
+                        _d[l] = _e[l] / (p + r);
+                        _d[l + 1] = _e[l] * (p + r);
+                        const T dl1 = _d[l + 1];
+                        T h = g - _d[l];
+                        for(size_t i = l + 2; i < _n; i++)
+                            _d[i] -= h;
+                        shift += h;
+
+                        // chase the bulge with plane rotations
+                        p = _d[m];
+                        T c = static_cast<T>(1), c2 = c, c3 = c;
+                        const T el1 = _e[l + 1];
+                        T s = T(), s2 = T();
+                        for(size_t i = m; i-- > l;) {
+                            c3 = c2;
+                            c2 = c;
+                            s2 = s;
+                            g = c * _e[i];
+                            h = c * p;
+                            r = std::hypot(p, _e[i]);
+                            _e[i + 1] = s * r;
+                            s = _e[i] / r;
+                            c = p / r;
+                            p = c * _d[i] - s * g;
+                            _d[i + 1] = h + s * (c * g + s * _d[i]);
+                            if(_w) {
+                                rotations[2 * i] = c;
+                                rotations[2 * i + 1] = s;
+                            }
+                        }
+
+                        // the sweep's rotations go through the eigenvectors together, column blocks are independent
+                        if(_w) {
+                            ParallelRows(0, _n, 6 * (m - l), [&](size_t _first, size_t _last) {
+                                for(size_t i = m; i-- > l;)
+                                    rotate(_last - _first, rotations[2 * i], rotations[2 * i + 1], (*_w)[i] + _first, (*_w)[i + 1] + _first);
+                            });
+                        }
+
+                        p = -s * s2 * c3 * el1 * _e[l] / dl1;
+                        _e[l] = s * p;
+                        _d[l] = c * p;
+
+                        if(std::abs(_e[l]) <= eps * tst)
+                            break;
+                    }
+
+                    _d[l] += shift;
+                    _e[l] = T();
+                }
+
+                return true;
+            }
+
+        public:
+            SymmetricEigen() = default;
+
+            template<typename E>
+            explicit SymmetricEigen(const MatrixExpression<E>& _a, bool _compute_vectors = true) {
+                Compute(_a, _compute_vectors);
+            }
+
+            /// Decompose the lower triangle of _a, returns false when _a is not square or QL did not converge
+            /// _a can be a MatrixN, a MatrixView or any matrix expression.
+            template<typename E>
+            bool Compute(const MatrixExpression<E>& _a, bool _compute_vectors = true) {
+                static_assert(std::is_same<typename E::value_type, T>::value, "SymmetricEigen input must have the element type of the decomposition");
+                m_values = VectorN<T>();
+                m_vectors = MatrixN<T>();
+                MatrixN<T> a(_a.Self());
+                m_converged = a.IsSquare();
+                if(!m_converged)
+                    return false;
+
+                const size_t n = a.Rows();
+                for(size_t i = 0; i < n; i++) {
+                    for(size_t j = i + 1; j < n; j++)
+                        a[i][j] = a[j][i];
+                }
+
+                VectorN<T> d(n), e(n);
+                MatrixN<T> q;
+                Tridiagonalize(a, d.data(), e.data(), _compute_vectors ? &q : nullptr);
+
+                // rows of Q^T are the columns of Q, rotations then update contiguous rows
+                MatrixN<T> w;
+                if(_compute_vectors)
+                    w = q.Transpose();
+
+                m_converged = DiagonalizeTridiagonal(n, d.data(), e.data(), _compute_vectors ? &w : nullptr);
+                if(!m_converged)
+                    return false;
+
+                // ascending eigenvalues, eigenvectors become columns
+                Buffer<size_t> order(n);
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](size_t _i, size_t _j) { return d[_i] < d[_j]; });
+
+                m_values = VectorN<T>(n);
+                for(size_t i = 0; i < n; i++)
+                    m_values[i] = d[order[i]];
+
+                if(_compute_vectors) {
+                    m_vectors = MatrixN<T>(n, n, T());
+                    for(size_t j = 0; j < n; j++) {
+                        const T *row = w[order[j]];
+                        for(size_t i = 0; i < n; i++)
+                            m_vectors[i][j] = row[i];
+                    }
+                }
+
+                return true;
+            }
+
+            bool IsConverged() const { return m_converged; }
+
+            /// Eigenvalues in ascending order
+            const VectorN<T>& Eigenvalues() const { return m_values; }
+
+            /// Orthonormal eigenvectors in the columns, column i belongs to Eigenvalues()[i]
+            const MatrixN<T>& Eigenvectors() const { return m_vectors; }
+    };
+
+
+    /// Number of cyclic Jacobi sweeps for 3x3 matrices, enough to reach machine precision for well scaled input
+    template<typename T>
+    struct Jacobi3Sweeps {
+        static constexpr int value = std::is_same<T, float>::value ? 5 : 6;
+    };
+
+
+    // one Jacobi rotation that zeroes a[pq], a holds a00, a11, a22, a01, a02, a12 and v holds the row-major eigenvectors
+    // t = sgn(d) * 2 * a_pq / (|d| + sqrt(d^2 + 4 * a_pq^2)) needs no branch and gives t = 0 for a_pq = 0
+    template<typename T>
+    inline void Jacobi3Rotate(T *_a, T *_v, int _p, int _q, int _pp, int _qq, int _pq, int _rp, int _rq) {
+        const T apq = _a[_pq];
+        const T d = _a[_qq] - _a[_pp];
+        const T num = static_cast<T>(2) * apq;
+        T t = num / (std::abs(d) + std::sqrt(d * d + num * num) + std::numeric_limits<T>::min());
+        t = d < T() ? -t : t;
+        const T c = static_cast<T>(1) / std::sqrt(t * t + static_cast<T>(1));
+        const T s = t * c;
+
+        _a[_pp] -= t * apq;
+        _a[_qq] += t * apq;
+        _a[_pq] = T();
+        const T arp = _a[_rp], arq = _a[_rq];
+        _a[_rp] = c * arp - s * arq;
+        _a[_rq] = s * arp + c * arq;
+
+        for(int k = 0; k < 3; k++) {
+            const T vp = _v[k * 3 + _p], vq = _v[k * 3 + _q];
+            _v[k * 3 + _p] = c * vp - s * vq;
+            _v[k * 3 + _q] = s * vp + c * vq;
+        }
+    }
+
+
+    /// Eigenvalues in ascending order and orthonormal eigenvectors in the columns of a symmetric Matrix3
+    /// Fixed count cyclic Jacobi sweeps, the lower triangle of _m is read.
+    template<typename T>
+    void SymmetricEigen3(const Matrix3<T>& _m, Vector3<T>& _values, Matrix3<T>& _vectors) {
+        T a[6] = { _m.row1.first, _m.row2.second, _m.row3.third, _m.row2.first, _m.row3.first, _m.row3.second };
+        T v[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+
+        for(int sweep = 0; sweep < Jacobi3Sweeps<T>::value; sweep++) {
+            Jacobi3Rotate(a, v, 0, 1, 0, 1, 3, 4, 5);
+            Jacobi3Rotate(a, v, 0, 2, 0, 2, 4, 3, 5);
+            Jacobi3Rotate(a, v, 1, 2, 1, 2, 5, 3, 4);
+        }
+
+        // sorting network on three values, eigenvector columns follow
+        auto swap_columns = [&](int _i, int _j) {
+            if(a[_i] > a[_j]) {
+                std::swap(a[_i], a[_j]);
+                for(int k = 0; k < 3; k++)
+                    std::swap(v[k * 3 + _i], v[k * 3 + _j]);
+            }
+        };
+        swap_columns(0, 1);
+        swap_columns(1, 2);
+        swap_columns(0, 1);
+
+        _values = Vector3<T>(a[0], a[1], a[2]);
+        _vectors = Matrix3<T>(Vector3<T>(v[0], v[1], v[2]), Vector3<T>(v[3], v[4], v[5]), Vector3<T>(v[6], v[7], v[8]));
+    }
+
+
+    // AVX2 lanes for the batch kernel, one register holds the same element of 8 float or 4 double matrices
+    TRS_TARGET_AVX2 inline __m256 LaneSet(float _x) { return _mm256_set1_ps(_x); }
+    TRS_TARGET_AVX2 inline __m256 LaneAdd(__m256 _a, __m256 _b) { return _mm256_add_ps(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256 LaneSub(__m256 _a, __m256 _b) { return _mm256_sub_ps(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256 LaneMul(__m256 _a, __m256 _b) { return _mm256_mul_ps(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256 LaneDiv(__m256 _a, __m256 _b) { return _mm256_div_ps(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256 LaneFma(__m256 _a, __m256 _b, __m256 _c) { return _mm256_fmadd_ps(_a, _b, _c); }
+    TRS_TARGET_AVX2 inline __m256 LaneFnma(__m256 _a, __m256 _b, __m256 _c) { return _mm256_fnmadd_ps(_a, _b, _c); }
+    TRS_TARGET_AVX2 inline __m256 LaneSqrt(__m256 _a) { return _mm256_sqrt_ps(_a); }
+    TRS_TARGET_AVX2 inline __m256 LaneAbs(__m256 _a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), _a); }
+    TRS_TARGET_AVX2 inline __m256 LaneCopySign(__m256 _a, __m256 _s) { return _mm256_xor_ps(_a, _mm256_and_ps(_s, _mm256_set1_ps(-0.0f))); }
+    TRS_TARGET_AVX2 inline __m256 LaneGreater(__m256 _a, __m256 _b) { return _mm256_cmp_ps(_a, _b, _CMP_GT_OQ); }
+    TRS_TARGET_AVX2 inline __m256 LaneSelect(__m256 _mask, __m256 _a, __m256 _b) { return _mm256_blendv_ps(_b, _a, _mask); }
+
+    TRS_TARGET_AVX2 inline __m256d LaneSet(double _x) { return _mm256_set1_pd(_x); }
+    TRS_TARGET_AVX2 inline __m256d LaneAdd(__m256d _a, __m256d _b) { return _mm256_add_pd(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256d LaneSub(__m256d _a, __m256d _b) { return _mm256_sub_pd(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256d LaneMul(__m256d _a, __m256d _b) { return _mm256_mul_pd(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256d LaneDiv(__m256d _a, __m256d _b) { return _mm256_div_pd(_a, _b); }
+    TRS_TARGET_AVX2 inline __m256d LaneFma(__m256d _a, __m256d _b, __m256d _c) { return _mm256_fmadd_pd(_a, _b, _c); }
+    TRS_TARGET_AVX2 inline __m256d LaneFnma(__m256d _a, __m256d _b, __m256d _c) { return _mm256_fnmadd_pd(_a, _b, _c); }
+    TRS_TARGET_AVX2 inline __m256d LaneSqrt(__m256d _a) { return _mm256_sqrt_pd(_a); }
+    TRS_TARGET_AVX2 inline __m256d LaneAbs(__m256d _a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), _a); }
+    TRS_TARGET_AVX2 inline __m256d LaneCopySign(__m256d _a, __m256d _s) { return _mm256_xor_pd(_a, _mm256_and_pd(_s, _mm256_set1_pd(-0.0))); }
+    TRS_TARGET_AVX2 inline __m256d LaneGreater(__m256d _a, __m256d _b) { return _mm256_cmp_pd(_a, _b, _CMP_GT_OQ); }
+    TRS_TARGET_AVX2 inline __m256d LaneSelect(__m256d _mask, __m256d _a, __m256d _b) { return _mm256_blendv_pd(_b, _a, _mask); }
+
+
+    /// AVX2 register holding one matrix element of a lane group
+    template<typename T>
+    struct Jacobi3Lanes;
+
+    template<>
+    struct Jacobi3Lanes<float> {
+        typedef __m256 type;
+    };
+
+    template<>
+    struct Jacobi3Lanes<double> {
+        typedef __m256d type;
+    };
+
+
+    // Jacobi3Rotate on AVX2 lanes
+    template<typename V, typename T>
+    TRS_TARGET_AVX2 inline void FastJacobi3Rotate(V *_a, V *_v, int _p, int _q, int _pp, int _qq, int _pq, int _rp, int _rq) {
+        const V apq = _a[_pq];
+        const V d = LaneSub(_a[_qq], _a[_pp]);
+        const V num = LaneAdd(apq, apq);
+        const V den = LaneAdd(LaneAdd(LaneAbs(d), LaneSqrt(LaneFma(d, d, LaneMul(num, num)))), LaneSet(std::numeric_limits<T>::min()));
+        const V t = LaneCopySign(LaneDiv(num, den), d);
+        const V c = LaneDiv(LaneSet(static_cast<T>(1)), LaneSqrt(LaneFma(t, t, LaneSet(static_cast<T>(1)))));
+        const V s = LaneMul(t, c);
+
+        _a[_pp] = LaneFnma(t, apq, _a[_pp]);
+        _a[_qq] = LaneFma(t, apq, _a[_qq]);
+        _a[_pq] = LaneSet(T());
+        const V arp = _a[_rp], arq = _a[_rq];
+        _a[_rp] = LaneFnma(s, arq, LaneMul(c, arp));
+        _a[_rq] = LaneFma(s, arp, LaneMul(c, arq));
+
+        for(int k = 0; k < 3; k++) {
+            const V vp = _v[k * 3 + _p], vq = _v[k * 3 + _q];
+            _v[k * 3 + _p] = LaneFnma(s, vq, LaneMul(c, vp));
+            _v[k * 3 + _q] = LaneFma(s, vp, LaneMul(c, vq));
+        }
+    }
+
+
+    template<typename V>
+    TRS_TARGET_AVX2 inline void FastSortColumns3(V *_a, V *_v, int _i, int _j) {
+        const V swap = LaneGreater(_a[_i], _a[_j]);
+        const V ai = _a[_i];
+        _a[_i] = LaneSelect(swap, _a[_j], ai);
+        _a[_j] = LaneSelect(swap, ai, _a[_j]);
+        for(int k = 0; k < 3; k++) {
+            const V vi = _v[k * 3 + _i];
+            _v[k * 3 + _i] = LaneSelect(swap, _v[k * 3 + _j], vi);
+            _v[k * 3 + _j] = LaneSelect(swap, vi, _v[k * 3 + _j]);
+        }
+    }
+
+
+    /// Diagonalize one lane group of matrices stored as structure of arrays, _a[6][W] in and eigenvalues out, _v[9][W] out
+    template<typename V, typename T>
+    TRS_TARGET_AVX2 inline void FastSymmetricEigen3(T (*_a)[sizeof(V) / sizeof(T)], T (*_v)[sizeof(V) / sizeof(T)]) {
+        V a[6], v[9];
+        for(int i = 0; i < 6; i++)
+            std::memcpy(&a[i], _a[i], sizeof(V));
+        for(int i = 0; i < 9; i++)
+            v[i] = LaneSet(i % 4 == 0 ? static_cast<T>(1) : T());
+
+        for(int sweep = 0; sweep < Jacobi3Sweeps<T>::value; sweep++) {
+            FastJacobi3Rotate<V, T>(a, v, 0, 1, 0, 1, 3, 4, 5);
+            FastJacobi3Rotate<V, T>(a, v, 0, 2, 0, 2, 4, 3, 5);
+            FastJacobi3Rotate<V, T>(a, v, 1, 2, 1, 2, 5, 3, 4);
+        }
+
+        FastSortColumns3(a, v, 0, 1);
+        FastSortColumns3(a, v, 1, 2);
+        FastSortColumns3(a, v, 0, 1);
+
+        for(int i = 0; i < 3; i++)
+            std::memcpy(_a[i], &a[i], sizeof(V));
+        for(int i = 0; i < 9; i++)
+            std::memcpy(_v[i], &v[i], sizeof(V));
+    }
+
+
+    /// Diagonalize _count symmetric 3x3 matrices, see SymmetricEigen3()
+    /// With AVX2 and FMA 8 float or 4 double matrices go through the Jacobi sweeps at once, large batches are
+    /// also split over the shared thread pool.
+    template<typename T>
+    void SymmetricEigen3(const Matrix3<T> *_m, Vector3<T> *_values, Matrix3<T> *_vectors, size_t _count) {
+        size_t simd_count = 0;
+
+        if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value) {
+            typedef typename Jacobi3Lanes<T>::type V;
+            constexpr size_t lanes = sizeof(V) / sizeof(T);
+
+            const CpuFeatures &cpu = GetCpuFeatures();
+            if(cpu.avx2 && cpu.fma) {
+                simd_count = _count / lanes * lanes;
+                // about 300 flops per matrix
+                ParallelRows(0, simd_count / lanes, 300 * lanes, [&](size_t _first, size_t _last) {
+                    for(size_t g = _first; g < _last; g++) {
+                        T a[6][lanes], v[9][lanes];
+                        const size_t base = g * lanes;
+                        for(size_t l = 0; l < lanes; l++) {
+                            const Matrix3<T> &m = _m[base + l];
+                            a[0][l] = m.row1.first;
+                            a[1][l] = m.row2.second;
+                            a[2][l] = m.row3.third;
+                            a[3][l] = m.row2.first;
+                            a[4][l] = m.row3.first;
+                            a[5][l] = m.row3.second;
+                        }
+
+                        FastSymmetricEigen3<V, T>(a, v);
+
+                        for(size_t l = 0; l < lanes; l++) {
+                            _values[base + l] = Vector3<T>(a[0][l], a[1][l], a[2][l]);
+                            _vectors[base + l] = Matrix3<T>(Vector3<T>(v[0][l], v[1][l], v[2][l]),
+                                                            Vector3<T>(v[3][l], v[4][l], v[5][l]),
+                                                            Vector3<T>(v[6][l], v[7][l], v[8][l]));
+                        }
+                    }
+                });
+            }
+        }
+
+        for(size_t i = simd_count; i < _count; i++)
+            SymmetricEigen3(_m[i], _values[i], _vectors[i]);
+    }
+}
+
+#endif
@@ -0,0 +1,237 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: ThreadPool.h - Shared worker pool for parallel N-dimensional operations
+/// author: Karl-Mihkel Ott
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+
+namespace TRS {
+
+    /**
+     * Fixed size pool of worker threads used by MatrixN, VectorN and Gemm
+     * The calling thread always takes part in the work, so a pool with thread count 1 has no workers and
+     * everything runs serially. Nested ParallelFor calls from inside a running chunk run serially as well.
+     * Work is handed to the workers through a single job slot that lives in the pool, so dispatching it never
+     * allocates. A ParallelFor issued while another thread owns the slot runs serially on its own thread.
+     */
+    class ThreadPool {
+        private:
+            /// Chunked range together with a type erased reference to the caller's function
+            struct Job {
+                void (*invoke)(void *_f, size_t _first, size_t _last) = nullptr;
+                void *f = nullptr;
+                size_t begin = 0;
+                size_t end = 0;
+                size_t grain = 1;
+                size_t chunks = 0;
+                std::atomic<size_t> next { 0 };
+            };
+
+            std::vector<std::thread> m_workers;
+            std::mutex m_mutex;
+            std::condition_variable m_cond;
+            std::condition_variable m_done_cond;
+            bool m_stop = false;
+
+            // m_job is owned by whoever holds m_job_mutex, m_mutex guards the helper counts
+            std::mutex m_job_mutex;
+            Job m_job;
+            size_t m_open_slots = 0;        // helpers the current job still wants
+            size_t m_running = 0;           // helpers inside the current job
+
+            // problems smaller than these run on the calling thread only
+            size_t m_elementwise_threshold = 1 << 16;
+            size_t m_gemm_threshold = 1 << 21;
+
+            static bool &IsWorkerThread() {
+                static thread_local bool is_worker = false;
+                return is_worker;
+            }
+
+            void RunJob() {
+                for(size_t c = m_job.next++; c < m_job.chunks; c = m_job.next++) {
+                    const size_t first = m_job.begin + c * m_job.grain;
+                    m_job.invoke(m_job.f, first, std::min(m_job.end, first + m_job.grain));
+                }
+            }
+
+            void WorkerLoop() {
+                IsWorkerThread() = true;
+                for(;;) {
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_cond.wait(lock, [this] { return m_stop || m_open_slots; });
+                        if(m_stop)
+                            return;
+                        m_open_slots--;
+                        m_running++;
+                    }
+
+                    RunJob();
+
+                    bool last;
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        last = !--m_running;
+                    }
+                    if(last)
+                        m_done_cond.notify_one();
+                }
+            }
+
+            void Start(size_t _threads) {
+                m_stop = false;
+                for(size_t i = 1; i < _threads; i++)
+                    m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+            }
+
+            void Stop() {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_stop = true;
+                }
+                m_cond.notify_all();
+                for(std::thread &worker : m_workers)
+                    worker.join();
+                m_workers.clear();
+            }
+
+        public:
+            /// Create a pool with _threads threads including the caller, 0 uses all hardware threads
+            explicit ThreadPool(size_t _threads = 0) {
+                SetThreadCount(_threads);
+            }
+
+            ~ThreadPool() {
+                Stop();
+            }
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /// Resize the pool, 0 uses all hardware threads and 1 disables parallel execution
+            /// Must not be called while parallel work is running.
+            void SetThreadCount(size_t _threads) {
+                if(!_threads)
+                    _threads = std::max(1u, std::thread::hardware_concurrency());
+                Stop();
+                Start(_threads);
+            }
+
+            /// Number of threads taking part in parallel work, including the caller
+            size_t GetThreadCount() const {
+                return m_workers.size() + 1;
+            }
+
+            /// Minimum element count for parallel elementwise operations
+            void SetElementwiseThreshold(size_t _elements) { m_elementwise_threshold = std::max<size_t>(_elements, 1); }
+            size_t GetElementwiseThreshold() const { return m_elementwise_threshold; }
+
+            /// Minimum m * n * k multiply-add count for parallel matrix multiplication
+            void SetGemmThreshold(size_t _madds) { m_gemm_threshold = _madds; }
+            size_t GetGemmThreshold() const { return m_gemm_threshold; }
+
+            /// Call _f(first, last) on chunks of [_begin, _end) that are _grain long, the last chunk may be shorter
+            /// Returns once every chunk is done. A single chunk is run directly on the calling thread.
+            template<typename F>
+            void ParallelFor(size_t _begin, size_t _end, size_t _grain, F &&_f) {
+                if(_end <= _begin)
+                    return;
+
+                _grain = std::max<size_t>(_grain, 1);
+                const size_t chunks = (_end - _begin + _grain - 1) / _grain;
+                const size_t helpers = std::min(m_workers.size(), chunks - 1);
+                if(!helpers || IsWorkerThread()) {
+                    _f(_begin, _end);
+                    return;
+                }
+
+                std::unique_lock<std::mutex> owner(m_job_mutex, std::try_to_lock);
+                if(!owner.owns_lock()) {
+                    _f(_begin, _end);
+                    return;
+                }
+
+                typedef typename std::remove_reference<F>::type Fn;
+                m_job.invoke = [](void *_fn, size_t _first, size_t _last) { (*static_cast<Fn*>(_fn))(_first, _last); };
+                m_job.f = const_cast<void*>(static_cast<const void*>(std::addressof(_f)));
+                m_job.begin = _begin;
+                m_job.end = _end;
+                m_job.grain = _grain;
+                m_job.chunks = chunks;
+                m_job.next.store(0, std::memory_order_relaxed);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_open_slots = helpers;
+                }
+                if(helpers == m_workers.size())
+                    m_cond.notify_all();
+                else {
+                    for(size_t i = 0; i < helpers; i++)
+                        m_cond.notify_one();
+                }
+
+                // nested calls from the caller's own chunks must not try to take the job slot it already holds
+                IsWorkerThread() = true;
+                RunJob();
+                IsWorkerThread() = false;
+
+                // helpers that have not woken up yet are no longer needed, wait only for those already running
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_open_slots = 0;
+                m_done_cond.wait(lock, [this] { return !m_running; });
+            }
+    };
+
+
+    /// Get the pool shared by all TRS operations, it is created on first use
+    inline ThreadPool &GetThreadPool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+
+    /// Cap the number of threads used by TRS, 0 uses all hardware threads and 1 runs everything serially
+    inline void SetThreadCount(size_t _threads) {
+        GetThreadPool().SetThreadCount(_threads);
+    }
+
+
+    /// Run _f(first, last) over element ranges of [0, _count) on the shared pool
+    /// Ranges hold at least the elementwise threshold of elements, so small inputs stay on the calling thread.
+    template<typename F>
+    inline void ParallelElements(size_t _count, F &&_f) {
+        ThreadPool &pool = GetThreadPool();
+        const size_t grain = std::max(pool.GetElementwiseThreshold(), (_count + pool.GetThreadCount() - 1) / pool.GetThreadCount());
+        pool.ParallelFor(0, _count, grain, std::forward<F>(_f));
+    }
+
+
+    /// Run _f(first, last) over row blocks of [_first, _last) on the shared pool, where every row costs about _work_per_row
+    /// Blocks hold at least the elementwise threshold of work, so small inputs stay on the calling thread.
+    template<typename F>
+    inline void ParallelRows(size_t _first, size_t _last, size_t _work_per_row, F &&_f) {
+        if(_last <= _first)
+            return;
+
+        ThreadPool &pool = GetThreadPool();
+        const size_t work = std::max<size_t>(_work_per_row, 1);
+        const size_t threads = pool.GetThreadCount();
+        const size_t grain = std::max((pool.GetElementwiseThreshold() + work - 1) / work, (_last - _first + threads - 1) / threads);
+        pool.ParallelFor(_first, _last, grain, std::forward<F>(_f));
+    }
+}
+
+#endif
@@ -0,0 +1,553 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Transform.h - Batched point, vector, matrix and quaternion operations
+/// author: Karl-Mihkel Ott
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <cstddef>
+#include <trs/Simd.h>
+#include <trs/CpuFeatures.h>
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include <trs/Points.h>
+#include <trs/Quaternion.h>
+
+// Batch kernels come in scalar, SSE, AVX2 + FMA and AVX-512 variants. The public functions at the end of
+// this file pick the best variant supported by the running CPU, so the binary itself can be built for the
+// baseline instruction set. Every variant hands the remainder that does not fill its registers to the
+// next narrower one.
+
+namespace TRS {
+
+    /// Deinterleave four packed xyz triplets (a, b, c) into x, y and z registers
+    inline void FastDeinterleave3(const __m128 &_a, const __m128 &_b, const __m128 &_c, __m128 &_x, __m128 &_y, __m128 &_z) {
+        const __m128 u = _mm_shuffle_ps(_b, _c, _MM_SHUFFLE(2, 1, 3, 2));  // b2, b3, c1, c2
+        const __m128 v = _mm_shuffle_ps(_a, _b, _MM_SHUFFLE(1, 0, 2, 1));  // a1, a2, b0, b1
+        _x = _mm_shuffle_ps(_a, u, _MM_SHUFFLE(2, 0, 3, 0));
+        _y = _mm_shuffle_ps(v, u, _MM_SHUFFLE(3, 1, 2, 0));
+        _z = _mm_shuffle_ps(v, _c, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+
+    /// Interleave x, y and z registers back into four packed xyz triplets (a, b, c)
+    inline void FastInterleave3(const __m128 &_x, const __m128 &_y, const __m128 &_z, __m128 &_a, __m128 &_b, __m128 &_c) {
+        const __m128 p = _mm_shuffle_ps(_x, _y, _MM_SHUFFLE(1, 0, 1, 0));  // x0, x1, y0, y1
+        const __m128 r = _mm_shuffle_ps(_z, _x, _MM_SHUFFLE(3, 1, 2, 0));  // z0, z2, x1, x3
+        const __m128 s = _mm_shuffle_ps(_y, _z, _MM_SHUFFLE(3, 1, 3, 1));  // y1, y3, z1, z3
+        const __m128 t = _mm_shuffle_ps(_x, _y, _MM_SHUFFLE(3, 2, 3, 2));  // x2, x3, y2, y3
+        _a = _mm_shuffle_ps(p, r, _MM_SHUFFLE(2, 0, 2, 0));
+        _b = _mm_shuffle_ps(s, t, _MM_SHUFFLE(2, 0, 2, 0));
+        _c = _mm_shuffle_ps(r, s, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+
+
+    /// 256 bit variant of FastDeinterleave3, where both 128 bit lanes hold four triplets
+    TRS_TARGET_AVX2 inline void FastDeinterleave3(const __m256 &_a, const __m256 &_b, const __m256 &_c, __m256 &_x, __m256 &_y, __m256 &_z) {
+        const __m256 u = _mm256_shuffle_ps(_b, _c, _MM_SHUFFLE(2, 1, 3, 2));
+        const __m256 v = _mm256_shuffle_ps(_a, _b, _MM_SHUFFLE(1, 0, 2, 1));
+        _x = _mm256_shuffle_ps(_a, u, _MM_SHUFFLE(2, 0, 3, 0));
+        _y = _mm256_shuffle_ps(v, u, _MM_SHUFFLE(3, 1, 2, 0));
+        _z = _mm256_shuffle_ps(v, _c, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+
+    /// 256 bit variant of FastInterleave3
+    TRS_TARGET_AVX2 inline void FastInterleave3(const __m256 &_x, const __m256 &_y, const __m256 &_z, __m256 &_a, __m256 &_b, __m256 &_c) {
+        const __m256 p = _mm256_shuffle_ps(_x, _y, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m256 r = _mm256_shuffle_ps(_z, _x, _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256 s = _mm256_shuffle_ps(_y, _z, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m256 t = _mm256_shuffle_ps(_x, _y, _MM_SHUFFLE(3, 2, 3, 2));
+        _a = _mm256_shuffle_ps(p, r, _MM_SHUFFLE(2, 0, 2, 0));
+        _b = _mm256_shuffle_ps(s, t, _MM_SHUFFLE(2, 0, 2, 0));
+        _c = _mm256_shuffle_ps(r, s, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+
+
+    /// 512 bit variant of FastDeinterleave3, where all four 128 bit lanes hold four triplets
+    TRS_TARGET_AVX512 inline void FastDeinterleave3(const __m512 &_a, const __m512 &_b, const __m512 &_c, __m512 &_x, __m512 &_y, __m512 &_z) {
+        const __m512 u = _mm512_shuffle_ps(_b, _c, _MM_SHUFFLE(2, 1, 3, 2));
+        const __m512 v = _mm512_shuffle_ps(_a, _b, _MM_SHUFFLE(1, 0, 2, 1));
+        _x = _mm512_shuffle_ps(_a, u, _MM_SHUFFLE(2, 0, 3, 0));
+        _y = _mm512_shuffle_ps(v, u, _MM_SHUFFLE(3, 1, 2, 0));
+        _z = _mm512_shuffle_ps(v, _c, _MM_SHUFFLE(3, 0, 3, 1));
+    }
+
+
+    /// 512 bit variant of FastInterleave3
+    TRS_TARGET_AVX512 inline void FastInterleave3(const __m512 &_x, const __m512 &_y, const __m512 &_z, __m512 &_a, __m512 &_b, __m512 &_c) {
+        const __m512 p = _mm512_shuffle_ps(_x, _y, _MM_SHUFFLE(1, 0, 1, 0));
+        const __m512 r = _mm512_shuffle_ps(_z, _x, _MM_SHUFFLE(3, 1, 2, 0));
+        const __m512 s = _mm512_shuffle_ps(_y, _z, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m512 t = _mm512_shuffle_ps(_x, _y, _MM_SHUFFLE(3, 2, 3, 2));
+        _a = _mm512_shuffle_ps(p, r, _MM_SHUFFLE(2, 0, 2, 0));
+        _b = _mm512_shuffle_ps(s, t, _MM_SHUFFLE(2, 0, 2, 0));
+        _c = _mm512_shuffle_ps(r, s, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+
+
+    /// Load four 128 bit lanes that are 12 floats (four triplets) apart into one register
+    /// Masked loads place the k-th lane from _src + 12k, because lane k starts at element 4k.
+    TRS_TARGET_AVX512 inline __m512 FastLoadLanes12(const float *_src) {
+        __m512 v = _mm512_maskz_loadu_ps(0x000f, _src);
+        v = _mm512_mask_loadu_ps(v, 0x00f0, _src + 8);
+        v = _mm512_mask_loadu_ps(v, 0x0f00, _src + 16);
+        return _mm512_mask_loadu_ps(v, 0xf000, _src + 24);
+    }
+
+
+    /// Store four 128 bit lanes of a register 12 floats apart, inverse of FastLoadLanes12
+    TRS_TARGET_AVX512 inline void FastStoreLanes12(float *_dst, const __m512 &_v) {
+        _mm512_mask_storeu_ps(_dst, 0x000f, _v);
+        _mm512_mask_storeu_ps(_dst + 8, 0x00f0, _v);
+        _mm512_mask_storeu_ps(_dst + 16, 0x0f00, _v);
+        _mm512_mask_storeu_ps(_dst + 24, 0xf000, _v);
+    }
+
+
+    /*****************************************/
+    /***** Packed xyz triplet transforms *****/
+    /*****************************************/
+
+    /// Transform _count packed xyz triplets with a row-major matrix, treating the fourth coordinate as _w
+    /// Use _w = 1 for points and _w = 0 for directions. Projected w is dropped, no perspective division is done.
+    /// _out may alias _in.
+    inline void ScalarTransform3(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const float *m = &_mat.row1.first;
+        for(size_t i = 0; i < _count; i++) {
+            const float x = _in[3 * i], y = _in[3 * i + 1], z = _in[3 * i + 2];
+            _out[3 * i] = m[0] * x + m[1] * y + m[2] * z + m[3] * _w;
+            _out[3 * i + 1] = m[4] * x + m[5] * y + m[6] * z + m[7] * _w;
+            _out[3 * i + 2] = m[8] * x + m[9] * y + m[10] * z + m[11] * _w;
+        }
+    }
+
+
+    /// SSE variant of ScalarTransform3, four triplets per iteration
+    inline void FastTransform3Sse(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const float *m = &_mat.row1.first;
+        __m128 mat[12];
+        for(int j = 0; j < 12; j++)
+            mat[j] = _mm_set1_ps(m[j]);
+        const __m128 tx = _mm_set1_ps(m[3] * _w);
+        const __m128 ty = _mm_set1_ps(m[7] * _w);
+        const __m128 tz = _mm_set1_ps(m[11] * _w);
+
+        size_t i = 0;
+        for(; i + 4 <= _count; i += 4) {
+            const float *src = _in + 3 * i;
+            __m128 x, y, z;
+            FastDeinterleave3(_mm_loadu_ps(src), _mm_loadu_ps(src + 4), _mm_loadu_ps(src + 8), x, y, z);
+
+            const __m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[0], x), _mm_mul_ps(mat[1], y)), _mm_add_ps(_mm_mul_ps(mat[2], z), tx));
+            const __m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[4], x), _mm_mul_ps(mat[5], y)), _mm_add_ps(_mm_mul_ps(mat[6], z), ty));
+            const __m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mat[8], x), _mm_mul_ps(mat[9], y)), _mm_add_ps(_mm_mul_ps(mat[10], z), tz));
+
+            __m128 oa, ob, oc;
+            FastInterleave3(ox, oy, oz, oa, ob, oc);
+
+            float *dst = _out + 3 * i;
+            _mm_storeu_ps(dst, oa);
+            _mm_storeu_ps(dst + 4, ob);
+            _mm_storeu_ps(dst + 8, oc);
+        }
+
+        ScalarTransform3(_mat, _in + 3 * i, _out + 3 * i, _count - i, _w);
+    }
+
+
+    /// AVX2 variant of ScalarTransform3, eight triplets per iteration
+    TRS_TARGET_AVX2 inline void FastTransform3Avx2(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const float *m = &_mat.row1.first;
+        __m256 mat[12];
+        for(int j = 0; j < 12; j++)
+            mat[j] = _mm256_set1_ps(m[j]);
+        const __m256 tx = _mm256_set1_ps(m[3] * _w);
+        const __m256 ty = _mm256_set1_ps(m[7] * _w);
+        const __m256 tz = _mm256_set1_ps(m[11] * _w);
+
+        size_t i = 0;
+        for(; i + 8 <= _count; i += 8) {
+            // lower lane holds elements i..i+3 and upper lane i+4..i+7
+            const float *src = _in + 3 * i;
+            const __m256 a = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src)), _mm_loadu_ps(src + 12), 1);
+            const __m256 b = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + 4)), _mm_loadu_ps(src + 16), 1);
+            const __m256 c = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(src + 8)), _mm_loadu_ps(src + 20), 1);
+
+            __m256 x, y, z;
+            FastDeinterleave3(a, b, c, x, y, z);
+
+            const __m256 ox = _mm256_fmadd_ps(mat[0], x, _mm256_fmadd_ps(mat[1], y, _mm256_fmadd_ps(mat[2], z, tx)));
+            const __m256 oy = _mm256_fmadd_ps(mat[4], x, _mm256_fmadd_ps(mat[5], y, _mm256_fmadd_ps(mat[6], z, ty)));
+            const __m256 oz = _mm256_fmadd_ps(mat[8], x, _mm256_fmadd_ps(mat[9], y, _mm256_fmadd_ps(mat[10], z, tz)));
+
+            __m256 oa, ob, oc;
+            FastInterleave3(ox, oy, oz, oa, ob, oc);
+
+            float *dst = _out + 3 * i;
+            _mm_storeu_ps(dst, _mm256_castps256_ps128(oa));
+            _mm_storeu_ps(dst + 4, _mm256_castps256_ps128(ob));
+            _mm_storeu_ps(dst + 8, _mm256_castps256_ps128(oc));
+            _mm_storeu_ps(dst + 12, _mm256_extractf128_ps(oa, 1));
+            _mm_storeu_ps(dst + 16, _mm256_extractf128_ps(ob, 1));
+            _mm_storeu_ps(dst + 20, _mm256_extractf128_ps(oc, 1));
+        }
+
+        FastTransform3Sse(_mat, _in + 3 * i, _out + 3 * i, _count - i, _w);
+    }
+
+
+    /// AVX-512 variant of ScalarTransform3, sixteen triplets per iteration
+    TRS_TARGET_AVX512 inline void FastTransform3Avx512(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const float *m = &_mat.row1.first;
+        __m512 mat[12];
+        for(int j = 0; j < 12; j++)
+            mat[j] = _mm512_set1_ps(m[j]);
+        const __m512 tx = _mm512_set1_ps(m[3] * _w);
+        const __m512 ty = _mm512_set1_ps(m[7] * _w);
+        const __m512 tz = _mm512_set1_ps(m[11] * _w);
+
+        size_t i = 0;
+        for(; i + 16 <= _count; i += 16) {
+            // lane k holds elements i + 4k..i + 4k + 3
+            const float *src = _in + 3 * i;
+            __m512 x, y, z;
+            FastDeinterleave3(FastLoadLanes12(src), FastLoadLanes12(src + 4), FastLoadLanes12(src + 8), x, y, z);
+
+            const __m512 ox = _mm512_fmadd_ps(mat[0], x, _mm512_fmadd_ps(mat[1], y, _mm512_fmadd_ps(mat[2], z, tx)));
+            const __m512 oy = _mm512_fmadd_ps(mat[4], x, _mm512_fmadd_ps(mat[5], y, _mm512_fmadd_ps(mat[6], z, ty)));
+            const __m512 oz = _mm512_fmadd_ps(mat[8], x, _mm512_fmadd_ps(mat[9], y, _mm512_fmadd_ps(mat[10], z, tz)));
+
+            __m512 oa, ob, oc;
+            FastInterleave3(ox, oy, oz, oa, ob, oc);
+
+            float *dst = _out + 3 * i;
+            FastStoreLanes12(dst, oa);
+            FastStoreLanes12(dst + 4, ob);
+            FastStoreLanes12(dst + 8, oc);
+        }
+
+        FastTransform3Avx2(_mat, _in + 3 * i, _out + 3 * i, _count - i, _w);
+    }
+
+
+    /*****************************************/
+    /***** Homogeneous vector transforms *****/
+    /*****************************************/
+
+    /// Transform _count 4 element vectors with a row-major matrix, _out may alias _in
+    inline void ScalarTransform4(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count) {
+        const float *m = &_mat.row1.first;
+        for(size_t i = 0; i < _count; i++) {
+            const float *v = _in + 4 * i;
+            const float x = v[0], y = v[1], z = v[2], w = v[3];
+            for(int r = 0; r < 4; r++)
+                _out[4 * i + r] = m[4 * r] * x + m[4 * r + 1] * y + m[4 * r + 2] * z + m[4 * r + 3] * w;
+        }
+    }
+
+
+    /// SSE variant of ScalarTransform4, _cols is the transposed matrix and _in, _out must be 16 byte aligned
+    inline void FastTransform4Sse(const Matrix4<float> &_cols, const float *_in, float *_out, size_t _count) {
+        for(size_t i = 0; i < _count; i++)
+            FastLinearCombine4(&_cols.row1.first, _in + 4 * i, _out + 4 * i);
+    }
+
+
+    /// AVX2 variant of FastTransform4Sse, four vectors per iteration
+    TRS_TARGET_AVX2 inline void FastTransform4Avx2(const Matrix4<float> &_cols, const float *_in, float *_out, size_t _count) {
+        const __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&_cols.row1.first));
+        const __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&_cols.row2.first));
+        const __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&_cols.row3.first));
+        const __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&_cols.row4.first));
+
+        size_t i = 0;
+        for(; i + 4 <= _count; i += 4) {
+            const __m256 v01 = _mm256_loadu_ps(_in + 4 * i);
+            const __m256 v23 = _mm256_loadu_ps(_in + 4 * i + 8);
+
+            __m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(v01, v01, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+            __m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(v23, v23, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+            r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(v01, v01, _MM_SHUFFLE(1, 1, 1, 1)), c1, r01);
+            r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(v23, v23, _MM_SHUFFLE(1, 1, 1, 1)), c1, r23);
+            r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(v01, v01, _MM_SHUFFLE(2, 2, 2, 2)), c2, r01);
+            r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(v23, v23, _MM_SHUFFLE(2, 2, 2, 2)), c2, r23);
+            r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(v01, v01, _MM_SHUFFLE(3, 3, 3, 3)), c3, r01);
+            r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(v23, v23, _MM_SHUFFLE(3, 3, 3, 3)), c3, r23);
+
+            _mm256_storeu_ps(_out + 4 * i, r01);
+            _mm256_storeu_ps(_out + 4 * i + 8, r23);
+        }
+
+        FastTransform4Sse(_cols, _in + 4 * i, _out + 4 * i, _count - i);
+    }
+
+
+// GCC 12 falsely reports _mm512_undefined_ps() used inside _mm512_shuffle_f32x4 as uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wuninitialized"
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    /// AVX-512 variant of FastTransform4Sse, four vectors per register and eight per iteration
+    TRS_TARGET_AVX512 inline void FastTransform4Avx512(const Matrix4<float> &_cols, const float *_in, float *_out, size_t _count) {
+        // every column is broadcasted into all four 128 bit lanes
+        const __m512 cols = _mm512_loadu_ps(&_cols.row1.first);
+        const __m512 c0 = _mm512_shuffle_f32x4(cols, cols, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m512 c1 = _mm512_shuffle_f32x4(cols, cols, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m512 c2 = _mm512_shuffle_f32x4(cols, cols, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m512 c3 = _mm512_shuffle_f32x4(cols, cols, _MM_SHUFFLE(3, 3, 3, 3));
+
+        size_t i = 0;
+        for(; i + 8 <= _count; i += 8) {
+            const __m512 v0 = _mm512_loadu_ps(_in + 4 * i);
+            const __m512 v1 = _mm512_loadu_ps(_in + 4 * i + 16);
+
+            __m512 r0 = _mm512_mul_ps(_mm512_shuffle_ps(v0, v0, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+            __m512 r1 = _mm512_mul_ps(_mm512_shuffle_ps(v1, v1, _MM_SHUFFLE(0, 0, 0, 0)), c0);
+            r0 = _mm512_fmadd_ps(_mm512_shuffle_ps(v0, v0, _MM_SHUFFLE(1, 1, 1, 1)), c1, r0);
+            r1 = _mm512_fmadd_ps(_mm512_shuffle_ps(v1, v1, _MM_SHUFFLE(1, 1, 1, 1)), c1, r1);
+            r0 = _mm512_fmadd_ps(_mm512_shuffle_ps(v0, v0, _MM_SHUFFLE(2, 2, 2, 2)), c2, r0);
+            r1 = _mm512_fmadd_ps(_mm512_shuffle_ps(v1, v1, _MM_SHUFFLE(2, 2, 2, 2)), c2, r1);
+            r0 = _mm512_fmadd_ps(_mm512_shuffle_ps(v0, v0, _MM_SHUFFLE(3, 3, 3, 3)), c3, r0);
+            r1 = _mm512_fmadd_ps(_mm512_shuffle_ps(v1, v1, _MM_SHUFFLE(3, 3, 3, 3)), c3, r1);
+
+            _mm512_storeu_ps(_out + 4 * i, r0);
+            _mm512_storeu_ps(_out + 4 * i + 16, r1);
+        }
+
+        FastTransform4Avx2(_cols, _in + 4 * i, _out + 4 * i, _count - i);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+
+    /*****************************************/
+    /***** Matrix and quaternion batches *****/
+    /*****************************************/
+
+    /// Multiply _count pairs of row-major 4x4 float matrices, _out may alias either of the inputs
+    inline void ScalarMatMul4(const float *_a, const float *_b, float *_out, size_t _count) {
+        for(size_t n = 0; n < _count; n++, _a += 16, _b += 16, _out += 16) {
+            float res[16];
+            for(int i = 0; i < 4; i++) {
+                for(int j = 0; j < 4; j++)
+                    res[4 * i + j] = _a[4 * i] * _b[j] + _a[4 * i + 1] * _b[4 + j] + _a[4 * i + 2] * _b[8 + j] + _a[4 * i + 3] * _b[12 + j];
+            }
+
+            for(int i = 0; i < 16; i++)
+                _out[i] = res[i];
+        }
+    }
+
+
+// GCC 12 falsely reports _mm512_undefined_ps() used inside _mm512_shuffle_f32x4 as uninitialized
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wuninitialized"
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    /// AVX-512 4x4 matrix product, the whole matrix fits into a single register
+    TRS_TARGET_AVX512 inline void FastMatMul4Avx512(const float *_a, const float *_b, float *_out) {
+        // _b rows are broadcasted into all four 128 bit lanes, which hold _a rows
+        const __m512 a = _mm512_loadu_ps(_a);
+        const __m512 b = _mm512_loadu_ps(_b);
+        const __m512 b0 = _mm512_shuffle_f32x4(b, b, _MM_SHUFFLE(0, 0, 0, 0));
+        const __m512 b1 = _mm512_shuffle_f32x4(b, b, _MM_SHUFFLE(1, 1, 1, 1));
+        const __m512 b2 = _mm512_shuffle_f32x4(b, b, _MM_SHUFFLE(2, 2, 2, 2));
+        const __m512 b3 = _mm512_shuffle_f32x4(b, b, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m512 r = _mm512_mul_ps(_mm512_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        r = _mm512_fmadd_ps(_mm512_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)), b1, r);
+        r = _mm512_fmadd_ps(_mm512_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 2, 2)), b2, r);
+        r = _mm512_fmadd_ps(_mm512_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3)), b3, r);
+        _mm512_storeu_ps(_out, r);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC diagnostic pop
+#endif
+
+
+    /// Multiply _count pairs of quaternions stored as x, y, z, w, _out may alias either of the inputs
+    inline void ScalarQuatMul(const float *_p, const float *_q, float *_out, size_t _count) {
+        for(size_t i = 0; i < _count; i++, _p += 4, _q += 4, _out += 4) {
+            const float px = _p[0], py = _p[1], pz = _p[2], pw = _p[3];
+            const float qx = _q[0], qy = _q[1], qz = _q[2], qw = _q[3];
+            _out[0] = pw * qx + px * qw + py * qz - pz * qy;
+            _out[1] = pw * qy - px * qz + py * qw + pz * qx;
+            _out[2] = pw * qz + px * qy - py * qx + pz * qw;
+            _out[3] = pw * qw - px * qx - py * qy - pz * qz;
+        }
+    }
+
+
+    // Grassman product p * q is written as
+    // pw * (qx, qy, qz, qw) + px * (qw, -qz, qy, -qx) + py * (qz, qw, -qx, -qy) + pz * (-qy, qx, qw, -qz),
+    // where every permutation of q stays within 128 bit lanes, so wider registers hold several quaternions.
+
+    /// SSE variant of ScalarQuatMul, pointers must be 16 byte aligned
+    inline void FastQuatMulSse(const float *_p, const float *_q, float *_out, size_t _count) {
+        const __m128 sx = _mm_setr_ps(0.0f, -0.0f, 0.0f, -0.0f);
+        const __m128 sy = _mm_setr_ps(0.0f, 0.0f, -0.0f, -0.0f);
+        const __m128 sz = _mm_setr_ps(-0.0f, 0.0f, 0.0f, -0.0f);
+
+        for(size_t i = 0; i < 4 * _count; i += 4) {
+            const __m128 p = _mm_load_ps(_p + i);
+            const __m128 q = _mm_load_ps(_q + i);
+            __m128 r = _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)), q);
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 1, 2, 3)), sx)));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 3, 2)), sy)));
+            r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 3, 0, 1)), sz)));
+            _mm_store_ps(_out + i, r);
+        }
+    }
+
+
+    /// AVX2 variant of FastQuatMulSse, two quaternions per register
+    TRS_TARGET_AVX2 inline void FastQuatMulAvx2(const float *_p, const float *_q, float *_out, size_t _count) {
+        const __m256 sx = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+        const __m256 sy = _mm256_setr_ps(0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f, -0.0f, -0.0f);
+        const __m256 sz = _mm256_setr_ps(-0.0f, 0.0f, 0.0f, -0.0f, -0.0f, 0.0f, 0.0f, -0.0f);
+
+        size_t i = 0;
+        for(; i + 2 <= _count; i += 2) {
+            const __m256 p = _mm256_loadu_ps(_p + 4 * i);
+            const __m256 q = _mm256_loadu_ps(_q + 4 * i);
+            __m256 r = _mm256_mul_ps(_mm256_permute_ps(p, _MM_SHUFFLE(3, 3, 3, 3)), q);
+            r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_xor_ps(_mm256_permute_ps(q, _MM_SHUFFLE(0, 1, 2, 3)), sx), r);
+            r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_xor_ps(_mm256_permute_ps(q, _MM_SHUFFLE(1, 0, 3, 2)), sy), r);
+            r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_xor_ps(_mm256_permute_ps(q, _MM_SHUFFLE(2, 3, 0, 1)), sz), r);
+            _mm256_storeu_ps(_out + 4 * i, r);
+        }
+
+        FastQuatMulSse(_p + 4 * i, _q + 4 * i, _out + 4 * i, _count - i);
+    }
+
+
+    /// AVX-512 variant of FastQuatMulSse, four quaternions per register
+    /// Signs are flipped with integer xor, since floating point xor needs AVX-512DQ.
+    TRS_TARGET_AVX512 inline void FastQuatMulAvx512(const float *_p, const float *_q, float *_out, size_t _count) {
+        const int n = static_cast<int>(0x80000000u);
+        const __m512i sx = _mm512_setr_epi32(0, n, 0, n, 0, n, 0, n, 0, n, 0, n, 0, n, 0, n);
+        const __m512i sy = _mm512_setr_epi32(0, 0, n, n, 0, 0, n, n, 0, 0, n, n, 0, 0, n, n);
+        const __m512i sz = _mm512_setr_epi32(n, 0, 0, n, n, 0, 0, n, n, 0, 0, n, n, 0, 0, n);
+
+        size_t i = 0;
+        for(; i + 4 <= _count; i += 4) {
+            const __m512 p = _mm512_loadu_ps(_p + 4 * i);
+            const __m512 q = _mm512_loadu_ps(_q + 4 * i);
+            const __m512 qx = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_shuffle_ps(q, q, _MM_SHUFFLE(0, 1, 2, 3))), sx));
+            const __m512 qy = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 3, 2))), sy));
+            const __m512 qz = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_shuffle_ps(q, q, _MM_SHUFFLE(2, 3, 0, 1))), sz));
+
+            __m512 r = _mm512_mul_ps(_mm512_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)), q);
+            r = _mm512_fmadd_ps(_mm512_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), qx, r);
+            r = _mm512_fmadd_ps(_mm512_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), qy, r);
+            r = _mm512_fmadd_ps(_mm512_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), qz, r);
+            _mm512_storeu_ps(_out + 4 * i, r);
+        }
+
+        FastQuatMulAvx2(_p + 4 * i, _q + 4 * i, _out + 4 * i, _count - i);
+    }
+
+
+    /*********************************/
+    /***** Runtime kernel choice *****/
+    /*********************************/
+
+    // The AVX-512 kernels hand their tails to the AVX2 ones, so they are only chosen together with AVX2 and FMA.
+
+    /// Transform packed xyz triplets with the best kernel supported by the running CPU
+    inline void FastTransform3(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        if(cpu.avx512f && cpu.avx2 && cpu.fma)
+            FastTransform3Avx512(_mat, _in, _out, _count, _w);
+        else if(cpu.avx2 && cpu.fma)
+            FastTransform3Avx2(_mat, _in, _out, _count, _w);
+        else if(cpu.sse2)
+            FastTransform3Sse(_mat, _in, _out, _count, _w);
+        else ScalarTransform3(_mat, _in, _out, _count, _w);
+    }
+
+
+    /// Transform 16 byte aligned 4 element vectors with the best kernel supported by the running CPU
+    inline void FastTransform4(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count) {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        if(!cpu.sse2) {
+            ScalarTransform4(_mat, _in, _out, _count);
+            return;
+        }
+
+        // matrix columns, so that every output is a linear combination of them
+        Matrix4<float> cols;
+        FastTranspose4(&_mat.row1.first, &cols.row1.first);
+        if(cpu.avx512f && cpu.avx2 && cpu.fma)
+            FastTransform4Avx512(cols, _in, _out, _count);
+        else if(cpu.avx2 && cpu.fma)
+            FastTransform4Avx2(cols, _in, _out, _count);
+        else FastTransform4Sse(cols, _in, _out, _count);
+    }
+
+
+    /// Transform an array of points (w = 1) with given matrix
+    inline void TransformPoints(const Matrix4<float> &_mat, const Vector3<float> *_in, Vector3<float> *_out, size_t _count) {
+        FastTransform3(_mat, &_in->first, &_out->first, _count, 1.0f);
+    }
+
+
+    /// Transform an array of directions (w = 0) with given matrix
+    inline void TransformVectors(const Matrix4<float> &_mat, const Vector3<float> *_in, Vector3<float> *_out, size_t _count) {
+        FastTransform3(_mat, &_in->first, &_out->first, _count, 0.0f);
+    }
+
+
+    /// Transform an array of points (w = 1) with given matrix
+    inline void TransformPoints(const Matrix4<float> &_mat, const Point3D<float> *_in, Point3D<float> *_out, size_t _count) {
+        FastTransform3(_mat, &_in->x, &_out->x, _count, 1.0f);
+    }
+
+
+    /// Transform an array of directions (w = 0) with given matrix
+    inline void TransformVectors(const Matrix4<float> &_mat, const Point3D<float> *_in, Point3D<float> *_out, size_t _count) {
+        FastTransform3(_mat, &_in->x, &_out->x, _count, 0.0f);
+    }
+
+
+    /// Transform an array of homogeneous vectors with given matrix, w is taken from each vector
+    inline void TransformVectors(const Matrix4<float> &_mat, const Vector4<float> *_in, Vector4<float> *_out, size_t _count) {
+        FastTransform4(_mat, &_in->first, &_out->first, _count);
+    }
+
+
+    /// Multiply matrix arrays element wise, _out[i] = _a[i] * _b[i]
+    inline void MultiplyMatrices(const Matrix4<float> *_a, const Matrix4<float> *_b, Matrix4<float> *_out, size_t _count) {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        if(cpu.avx512f && cpu.avx2 && cpu.fma) {
+            for(size_t i = 0; i < _count; i++)
+                FastMatMul4Avx512(&_a[i].row1.first, &_b[i].row1.first, &_out[i].row1.first);
+        } else if(cpu.avx2 && cpu.fma) {
+            for(size_t i = 0; i < _count; i++)
+                FastMatMul4Avx2(&_a[i].row1.first, &_b[i].row1.first, &_out[i].row1.first);
+        } else if(cpu.sse2) {
+            for(size_t i = 0; i < _count; i++)
+                FastMatMul4Sse(&_a[i].row1.first, &_b[i].row1.first, &_out[i].row1.first);
+        } else ScalarMatMul4(&_a->row1.first, &_b->row1.first, &_out->row1.first, _count);
+    }
+
+
+    /// Multiply quaternion arrays element wise, _out[i] = _p[i] * _q[i]
+    inline void MultiplyQuaternions(const Quaternion *_p, const Quaternion *_q, Quaternion *_out, size_t _count) {
+        const CpuFeatures &cpu = GetCpuFeatures();
+        if(cpu.avx512f && cpu.avx2 && cpu.fma)
+            FastQuatMulAvx512(&_p->x, &_q->x, &_out->x, _count);
+        else if(cpu.avx2 && cpu.fma)
+            FastQuatMulAvx2(&_p->x, &_q->x, &_out->x, _count);
+        else if(cpu.sse2)
+            FastQuatMulSse(&_p->x, &_q->x, &_out->x, _count);
+        else ScalarQuatMul(&_p->x, &_q->x, &_out->x, _count);
+    }
+}
+
+#endif
@@ -0,0 +1,186 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Triangular.h - Triangular solves with many right hand sides for row-major storage
+/// author: Karl-Mihkel Ott
+
+#ifndef TRIANGULAR_H
+#define TRIANGULAR_H
+
+#include <cstddef>
+#include <algorithm>
+#include <trs/Gemm.h>
+#include <trs/MatrixView.h>
+
+// Blocked solves split the triangle into nb x nb diagonal blocks. Each diagonal block is solved by substitution,
+// the rows it feeds are then updated with one GEMM. Few right hand sides do not amortize the packing in GEMM,
+// so those are solved by substitution alone.
+
+namespace TRS {
+
+    /// Block sizes for triangular solves
+    struct TriangularBlocking {
+        static constexpr size_t nb = 64;
+        static constexpr size_t min_rhs = 4;
+    };
+
+
+    /// Dot product of _n elements with four partial sums, so that the loop vectorizes
+    template<typename T>
+    inline T TriangularDot(size_t _n, const T *_a, const T *_b) {
+        T s0 = T(), s1 = T(), s2 = T(), s3 = T();
+        size_t i = 0;
+        for(; i + 4 <= _n; i += 4) {
+            s0 += _a[i] * _b[i];
+            s1 += _a[i + 1] * _b[i + 1];
+            s2 += _a[i + 2] * _b[i + 2];
+            s3 += _a[i + 3] * _b[i + 3];
+        }
+        for(; i < _n; i++)
+            s0 += _a[i] * _b[i];
+
+        return (s0 + s1) + (s2 + s3);
+    }
+
+
+    /// Unblocked forward substitution, see SolveLowerTriangular()
+    template<typename T>
+    void SolveLowerTriangularSerial(bool _unit_diagonal, size_t _n, size_t _nrhs, const T *_l, size_t _ldl, T *_b, size_t _ldb) {
+        for(size_t i = 0; i < _n; i++) {
+            T *x = _b + i * _ldb;
+            if(_nrhs == 1 && _ldb == 1)
+                x[0] -= TriangularDot(i, _l + i * _ldl, _b);
+            else {
+                for(size_t k = 0; k < i; k++) {
+                    const T l = _l[i * _ldl + k];
+                    const T *y = _b + k * _ldb;
+                    for(size_t j = 0; j < _nrhs; j++)
+                        x[j] -= l * y[j];
+                }
+            }
+
+            if(!_unit_diagonal) {
+                const T d = static_cast<T>(1) / _l[i * _ldl + i];
+                for(size_t j = 0; j < _nrhs; j++)
+                    x[j] *= d;
+            }
+        }
+    }
+
+
+    /// Unblocked back substitution, see SolveUpperTriangular()
+    template<typename T>
+    void SolveUpperTriangularSerial(bool _unit_diagonal, size_t _n, size_t _nrhs, const T *_u, size_t _ldu, T *_b, size_t _ldb) {
+        for(size_t i = _n; i-- > 0;) {
+            T *x = _b + i * _ldb;
+            if(_nrhs == 1 && _ldb == 1)
+                x[0] -= TriangularDot(_n - i - 1, _u + i * _ldu + i + 1, _b + i + 1);
+            else {
+                for(size_t k = i + 1; k < _n; k++) {
+                    const T u = _u[i * _ldu + k];
+                    const T *y = _b + k * _ldb;
+                    for(size_t j = 0; j < _nrhs; j++)
+                        x[j] -= u * y[j];
+                }
+            }
+
+            if(!_unit_diagonal) {
+                const T d = static_cast<T>(1) / _u[i * _ldu + i];
+                for(size_t j = 0; j < _nrhs; j++)
+                    x[j] *= d;
+            }
+        }
+    }
+
+
+    /// Overwrite _n x _nrhs matrix B with inv(L) * B, where L is the lower triangle of the _n x _n matrix _l
+    /// Elements above the diagonal of _l are never read, the diagonal is assumed to be 1 when _unit_diagonal is set.
+    template<typename T>
+    void SolveLowerTriangular(bool _unit_diagonal, size_t _n, size_t _nrhs, const T *_l, size_t _ldl, T *_b, size_t _ldb) {
+        constexpr size_t nb = TriangularBlocking::nb;
+        if(_n <= nb || _nrhs < TriangularBlocking::min_rhs) {
+            SolveLowerTriangularSerial(_unit_diagonal, _n, _nrhs, _l, _ldl, _b, _ldb);
+            return;
+        }
+
+        for(size_t i0 = 0; i0 < _n; i0 += nb) {
+            const size_t ib = std::min(nb, _n - i0);
+            const size_t i1 = i0 + ib;
+            SolveLowerTriangularSerial(_unit_diagonal, ib, _nrhs, _l + i0 * _ldl + i0, _ldl, _b + i0 * _ldb, _ldb);
+
+            // B2 -= L21 * X1
+            if(i1 < _n) {
+                Gemm(false, false, _n - i1, _nrhs, ib, static_cast<T>(-1), _l + i1 * _ldl + i0, _ldl,
+                     _b + i0 * _ldb, _ldb, static_cast<T>(1), _b + i1 * _ldb, _ldb);
+            }
+        }
+    }
+
+
+    /// Overwrite _n x _nrhs matrix B with inv(U) * B, where U is the upper triangle of the _n x _n matrix _u
+    /// Elements below the diagonal of _u are never read, the diagonal is assumed to be 1 when _unit_diagonal is set.
+    template<typename T>
+    void SolveUpperTriangular(bool _unit_diagonal, size_t _n, size_t _nrhs, const T *_u, size_t _ldu, T *_b, size_t _ldb) {
+        constexpr size_t nb = TriangularBlocking::nb;
+        if(_n <= nb || _nrhs < TriangularBlocking::min_rhs) {
+            SolveUpperTriangularSerial(_unit_diagonal, _n, _nrhs, _u, _ldu, _b, _ldb);
+            return;
+        }
+
+        // the last block takes the remainder, so that the others stay aligned to nb from the top
+        for(size_t i1 = _n; i1 > 0;) {
+            const size_t i0 = (i1 - 1) / nb * nb;
+            SolveUpperTriangularSerial(_unit_diagonal, i1 - i0, _nrhs, _u + i0 * _ldu + i0, _ldu, _b + i0 * _ldb, _ldb);
+
+            // B1 -= U12 * X2
+            if(i0 > 0) {
+                Gemm(false, false, i0, _nrhs, i1 - i0, static_cast<T>(-1), _u + i0, _ldu,
+                     _b + i0 * _ldb, _ldb, static_cast<T>(1), _b, _ldb);
+            }
+            i1 = i0;
+        }
+    }
+
+
+    /// Overwrite the view _b with inv(L) * _b, where L is the lower triangle of the square view _l
+    /// Returns false and leaves _b untouched when the shapes do not conform.
+    template<typename T>
+    bool SolveLowerTriangular(bool _unit_diagonal, const MatrixView<const NonDeduced<T>>& _l, const MatrixView<T>& _b) {
+        if(!_l.IsSquare() || _l.Rows() != _b.Rows())
+            return false;
+
+        SolveLowerTriangular(_unit_diagonal, _b.Rows(), _b.Columns(), _l.Data(), _l.Stride(), _b.Data(), _b.Stride());
+        return true;
+    }
+
+    template<typename T>
+    bool SolveLowerTriangular(bool _unit_diagonal, const MatrixView<const NonDeduced<T>>& _l, const VectorView<T>& _b) {
+        if(!_l.IsSquare() || _l.Rows() != _b.size())
+            return false;
+
+        SolveLowerTriangular(_unit_diagonal, _b.size(), 1, _l.Data(), _l.Stride(), _b.data(), _b.Stride());
+        return true;
+    }
+
+
+    /// Overwrite the view _b with inv(U) * _b, where U is the upper triangle of the square view _u
+    /// Returns false and leaves _b untouched when the shapes do not conform.
+    template<typename T>
+    bool SolveUpperTriangular(bool _unit_diagonal, const MatrixView<const NonDeduced<T>>& _u, const MatrixView<T>& _b) {
+        if(!_u.IsSquare() || _u.Rows() != _b.Rows())
+            return false;
+
+        SolveUpperTriangular(_unit_diagonal, _b.Rows(), _b.Columns(), _u.Data(), _u.Stride(), _b.Data(), _b.Stride());
+        return true;
+    }
+
+    template<typename T>
+    bool SolveUpperTriangular(bool _unit_diagonal, const MatrixView<const NonDeduced<T>>& _u, const VectorView<T>& _b) {
+        if(!_u.IsSquare() || _u.Rows() != _b.size())
+            return false;
+
+        SolveUpperTriangular(_unit_diagonal, _b.size(), 1, _u.Data(), _u.Stride(), _b.data(), _b.Stride());
+        return true;
+    }
+}
+
+#endif
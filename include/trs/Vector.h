@@ -6,9 +6,12 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
-#ifndef TRS_USE_SIMD
-    #include <xmmintrin.h>
-#endif
+#include <cstring>
+#include <cmath>
+#include <utility>
+#include <type_traits>
+
+#include <trs/Simd.h>
 
 namespace TRS {
 
@@ -686,12 +689,22 @@ namespace TRS {
     }
 
 
+    /**
+     * Alignment of 4D float and double vectors, so that they can be loaded
+     * directly into 128 bit (float) or 256 bit (double) SIMD registers
+     */
+    template<typename T>
+    struct Vector4Alignment {
+        static constexpr size_t value = std::is_same<T, float>::value || std::is_same<T, double>::value ? 4 * sizeof(T) : alignof(T);
+    };
+
+
     /**
      * 4D vector structure
      */
     //template<typename T> struct Matrix4;
     template<typename T>
-    struct Vector4 {
+    struct alignas(Vector4Alignment<T>::value) Vector4 {
 #ifdef ITERATORS_H
         typedef VectorIterator<T> iterator;
 #endif
@@ -829,7 +842,8 @@ namespace TRS {
             Vector4<T> out = {
                 first + _vec.first,
                 second + _vec.second,
-                third + _vec.third
+                third + _vec.third,
+                fourth + _vec.fourth
             };
             return out; 
         }
@@ -1117,6 +1131,107 @@ namespace TRS {
 
         else return Vector4<T>{};
     }
+
+
+    /**
+     * 3D float vector padded to 16 bytes, so that it can be loaded into a single SIMD register
+     * The padding element is always kept at zero.
+     */
+    struct alignas(16) Vector3A {
+        float first, second, third, pad;
+
+        Vector3A() noexcept : first(0), second(0), third(0), pad(0) {}
+        Vector3A(float _x, float _y, float _z) noexcept : first(_x), second(_y), third(_z), pad(0) {}
+        explicit Vector3A(const Vector3<float> &_vec) noexcept : first(_vec.first), second(_vec.second), third(_vec.third), pad(0) {}
+        explicit Vector3A(const __m128 &_reg) noexcept { _mm_store_ps(&first, _reg); }
+
+        /// Load vector elements into SIMD register
+        inline __m128 Load() const {
+            return _mm_load_ps(&first);
+        }
+
+        /// Convert into packed 3D vector
+        inline Vector3<float> ToVector3() const {
+            return Vector3<float>(first, second, third);
+        }
+
+        /// Zero the padding lane, scaling by 0, infinity or NaN would leave NaN in it
+        inline static __m128 ClearPad(__m128 _vec) {
+            return _mm_and_ps(_vec, _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0)));
+        }
+
+        ////////////////////////////////////
+        // ***** Operator overloads ***** //
+        ////////////////////////////////////
+
+        inline Vector3A operator+(const Vector3A &_vec) const {
+            return Vector3A(_mm_add_ps(Load(), _vec.Load()));
+        }
+
+        inline Vector3A operator-(const Vector3A &_vec) const {
+            return Vector3A(_mm_sub_ps(Load(), _vec.Load()));
+        }
+
+        inline Vector3A operator*(const float _c) const {
+            return Vector3A(ClearPad(_mm_mul_ps(Load(), _mm_set1_ps(_c))));
+        }
+
+        /// Dot product
+        inline float operator*(const Vector3A &_vec) const {
+            return FastDot(Load(), _vec.Load());
+        }
+
+        inline Vector3A operator/(const float _c) const {
+            return Vector3A(ClearPad(_mm_div_ps(Load(), _mm_set1_ps(_c))));
+        }
+
+        inline void operator+=(const Vector3A &_vec) {
+            _mm_store_ps(&first, _mm_add_ps(Load(), _vec.Load()));
+        }
+
+        inline void operator-=(const Vector3A &_vec) {
+            _mm_store_ps(&first, _mm_sub_ps(Load(), _vec.Load()));
+        }
+
+        inline void operator*=(const float _c) {
+            _mm_store_ps(&first, ClearPad(_mm_mul_ps(Load(), _mm_set1_ps(_c))));
+        }
+
+        inline void operator/=(const float _c) {
+            _mm_store_ps(&first, ClearPad(_mm_div_ps(Load(), _mm_set1_ps(_c))));
+        }
+
+        inline Vector3A operator-() const {
+            return Vector3A(_mm_sub_ps(_mm_setzero_ps(), Load()));
+        }
+
+        inline bool operator==(const Vector3A &_vec) const {
+            return _mm_movemask_ps(_mm_cmpeq_ps(Load(), _vec.Load())) == 0xf;
+        }
+
+        inline bool operator!=(const Vector3A &_vec) const {
+            return !(*this == _vec);
+        }
+
+        inline float operator[](size_t i) const { return (&first)[i]; }
+        inline float& operator[](size_t i) { return (&first)[i]; }
+
+        /// Get the current length of the vector
+        inline float Magnitude() const {
+            return _mm_cvtss_f32(_mm_sqrt_ss(FastSum(_mm_mul_ps(Load(), Load()))));
+        }
+
+        /// Normalise the vector to length 1
+        inline void Normalise() {
+            const __m128 vec = Load();
+            _mm_store_ps(&first, ClearPad(_mm_div_ps(vec, _mm_sqrt_ps(FastSum(_mm_mul_ps(vec, vec))))));
+        }
+
+        /// Find the crossproduct of two vectors
+        inline static Vector3A Cross(const Vector3A &_vec1, const Vector3A &_vec2) {
+            return Vector3A(FastCross(_vec1.Load(), _vec2.Load()));
+        }
+    };
 }
 
 #endif
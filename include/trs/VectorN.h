@@ -4,6 +4,12 @@
 #include <type_traits>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <utility>
+#include <trs/ThreadPool.h>
+#include <trs/MemoryResource.h>
+#include <trs/Expressions.h>
+#include <trs/MatrixView.h>
 
 namespace TRS {
 
@@ -11,101 +17,154 @@ namespace TRS {
 	class MatrixN;
 
 	template<typename T>
-	class VectorN : public std::vector<T> {
+	class VectorN;
+
+	template<typename T>
+	struct IsExpressionLeaf<VectorN<T>> : std::true_type {};
+
+	/// Dynamically sized vector, elementwise arithmetic builds expressions from Expressions.h that are evaluated on assignment
+	/// Storage comes from the current memory resource unless a resource is given, see MemoryResource.h.
+	template<typename T>
+	class VectorN : public Buffer<T>, public VectorExpression<VectorN<T>> {
+		private:
+			// write the first size() elements of _e, large vectors are split over the shared thread pool
+			template<typename E>
+			void Assign(const E& _e) {
+				T* out = this->data();
+				ParallelElements(size(), [&](size_t _first, size_t _last) {
+					for (size_t i = _first; i < _last; i++)
+						out[i] = _e.Element(i);
+				});
+			}
+
 		public:
-			VectorN() : vector<T>() {}
+			using Buffer<T>::size;
+			using Buffer<T>::resize;
+
+			VectorN() : Buffer<T>() {}
+
+			explicit VectorN(const Allocator<T>& _alloc) : Buffer<T>(_alloc) {}
+
 			VectorN(const VectorN&) = default;
 			VectorN(VectorN&&) noexcept = default;
 
-			void operator=(const VectorN& v) {
-				resize(v.size());
-				for (size_t i = 0; i < size(); i++)
-					(*this)[i] = v[i];
+			// assignment keeps this vector's memory resource and reuses its buffer when it is large enough
+			VectorN& operator=(const VectorN&) = default;
+			VectorN& operator=(VectorN&&) = default;
+
+			explicit VectorN(size_t _count, const T& _value = T(), const Allocator<T>& _alloc = Allocator<T>()) :
+				Buffer<T>(_count, _value, _alloc) {}
+
+			VectorN(std::initializer_list<T> _init, const Allocator<T>& _alloc = Allocator<T>()) :
+				Buffer<T>(_init, _alloc) {}
+
+			// evaluate an elementwise expression in one pass
+			template<typename E>
+			VectorN(const VectorExpression<E>& _e, const Allocator<T>& _alloc = Allocator<T>()) :
+				Buffer<T>(_e.Self().size(), _alloc)
+			{
+				Assign(_e.Self());
 			}
 
-			explicit VectorN(size_t _count, const T& _value = T()) :
-				vector<T>(_count, _value) {}
+			// evaluate an elementwise expression into this vector, no allocation is made when it is long enough
+			template<typename E>
+			VectorN& operator=(const VectorExpression<E>& _e) {
+				const size_t n = _e.Self().size();
+				// an operand of the expression is never shorter than it, so only a vector that is not an operand can grow here
+				if (n > size())
+					resize(n);
 
-			VectorN(std::initializer_list<T> _init) :
-				vector<T>(_init) {}
+				Assign(_e.Self());
+				resize(n);
+				return *this;
+			}
 
-			
-			
-			bool operator==(const VectorN<T>& v2) const {
-				bool isEqual = size() == v2.size();
+			const T& Element(size_t i) const { return (*this)[i]; }
 
-				if (isEqual) {
-					for (size_t i = 0; i < size(); i++) {
-						isEqual = (*this)[i] == v2[i];
+			// _count elements starting at element _first, the view stays valid until the vector is resized
+			VectorView<T> Segment(size_t _first, size_t _count) { return VectorView<T>(this->data() + _first, _count); }
+			VectorView<const T> Segment(size_t _first, size_t _count) const { return VectorView<const T>(this->data() + _first, _count); }
 
-						if (!isEqual) break;
-					}
+			// elementwise addition of a vector of the same length, like a + b another length leaves an empty vector
+			template<typename E>
+			VectorN& operator+=(const VectorExpression<E>& _v) {
+				const E& v = _v.Self();
+				if (v.size() != size()) {
+					resize(0);
+					return *this;
 				}
 
-				return isEqual;
-			}
+				if constexpr (std::is_arithmetic<T>::value) {
+					T* out = this->data();
+					ParallelElements(size(), [&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							out[i] += v.Element(i);
+					});
+				}
 
-			bool operator!=(const VectorN<T>& v2) const {
-				return !(*this == v2);
+				return *this;
 			}
 
-			// addition
-			VectorN<T> operator+(const VectorN<T>& v2) const {
-				VectorN<T> result(std::min(size(), v2.size()));
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < std::min(size(), v2.size()); i++) {
-						result[i] = (*this)[i] + v2[i];
-					}
+			// elementwise subtraction of a vector of the same length, like a - b another length leaves an empty vector
+			template<typename E>
+			VectorN& operator-=(const VectorExpression<E>& _v) {
+				const E& v = _v.Self();
+				if (v.size() != size()) {
+					resize(0);
+					return *this;
 				}
-				return result;
-			}
 
-			// subtraction
-			VectorN<T> operator-(const VectorN<T>& v2) const {
-				VectorN<T> result(std::min(size(), v2.size()));
 				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < std::min(size(), v2.size()); i++) {
-						result[i] = (*this)[i] - v2[i];
-					}
+					T* out = this->data();
+					ParallelElements(size(), [&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							out[i] -= v.Element(i);
+					});
 				}
 
-				return result;
+				return *this;
 			}
 
-			// multiplication with a scalar
-			VectorN<T> operator*(const T v) const {
-				VectorN<T> result(*this);
-
+			VectorN& operator*=(const T& _s) {
 				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++)
-						result[i] *= v;
+					T* out = this->data();
+					ParallelElements(size(), [&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							out[i] *= _s;
+					});
 				}
 
-				return result;
+				return *this;
 			}
 
-			// division with a scalar
-			VectorN<T> operator/(const T v) const {
-				VectorN<T> result(*this);
-				
+			VectorN& operator/=(const T& _s) {
 				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++)
-						result[i] /= v;
+					T* out = this->data();
+					ParallelElements(size(), [&](size_t _first, size_t _last) {
+						for (size_t i = _first; i < _last; i++)
+							out[i] /= _s;
+					});
 				}
-			
-				return result;
+
+				return *this;
 			}
 
-			// unary - operation
-			VectorN<T> operator-() const {
-				VectorN<T> result = *this;
+			bool operator==(const VectorN<T>& v2) const {
+				bool isEqual = size() == v2.size();
 
-				if constexpr (std::is_arithmetic<T>::value) {
-					for (size_t i = 0; i < size(); i++)
-						result[i] = -result[i];
+				if (isEqual) {
+					for (size_t i = 0; i < size(); i++) {
+						isEqual = (*this)[i] == v2[i];
+
+						if (!isEqual) break;
+					}
 				}
 
-				return result;
+				return isEqual;
+			}
+
+			bool operator!=(const VectorN<T>& v2) const {
+				return !(*this == v2);
 			}
 
 			T Length() const {
@@ -114,7 +173,7 @@ namespace TRS {
 					for (size_t i = 0; i < size(); i++)
 						sig += (*this)[i] * (*this)[i];
 
-					return std::sqrtf(sig);
+					return static_cast<T>(std::sqrt(sig));
 				}
 
 				return sig;
@@ -131,26 +190,70 @@ namespace TRS {
 				}
 			}
 
-			// dot product
-			T operator*(const VectorN<T>& v2) const {
-				T dotProduct = T();
-				if constexpr (std::is_arithmetic<T>::value) {
-					if (size() == v2.size()) {
-						for (size_t i = 0; i < size(); i++) {
-							dotProduct += (*this)[i] * v2[i];
-						}
-					}
-				}
-
-				return dotProduct;
-			}
-
 			// multiplication with matrix
 			VectorN<T> operator*(const MatrixN<T>& mat) const;
+
+			// multiplication with an unevaluated matrix expression
+			template<typename E>
+			VectorN<T> operator*(const MatrixExpression<E>& _m) const;
 			
 			// v * v.Transpose()
 			MatrixN<T> ExpandToMatrix();
 	};
+
+
+	// an expiring vector operand is overwritten with the result and returned, so the result reuses its buffer
+	template<typename T, typename R>
+	inline VectorN<T> operator+(VectorN<T>&& _l, const VectorExpression<R>& _r) {
+		_l = _l + _r.Self();
+		return std::move(_l);
+	}
+
+	template<typename T, typename L>
+	inline VectorN<T> operator+(const VectorExpression<L>& _l, VectorN<T>&& _r) {
+		_r = _l.Self() + _r;
+		return std::move(_r);
+	}
+
+	template<typename T>
+	inline VectorN<T> operator+(VectorN<T>&& _l, VectorN<T>&& _r) {
+		return std::move(_l) + _r;
+	}
+
+	template<typename T, typename R>
+	inline VectorN<T> operator-(VectorN<T>&& _l, const VectorExpression<R>& _r) {
+		_l = _l - _r.Self();
+		return std::move(_l);
+	}
+
+	template<typename T, typename L>
+	inline VectorN<T> operator-(const VectorExpression<L>& _l, VectorN<T>&& _r) {
+		_r = _l.Self() - _r;
+		return std::move(_r);
+	}
+
+	template<typename T>
+	inline VectorN<T> operator-(VectorN<T>&& _l, VectorN<T>&& _r) {
+		return std::move(_l) - _r;
+	}
+
+	template<typename T>
+	inline VectorN<T> operator*(VectorN<T>&& _v, const NonDeduced<T>& _s) {
+		_v = _v * _s;
+		return std::move(_v);
+	}
+
+	template<typename T>
+	inline VectorN<T> operator/(VectorN<T>&& _v, const NonDeduced<T>& _s) {
+		_v = _v / _s;
+		return std::move(_v);
+	}
+
+	template<typename T>
+	inline VectorN<T> operator-(VectorN<T>&& _v) {
+		_v = -_v;
+		return std::move(_v);
+	}
 }
 
 #endif
\ No newline at end of file
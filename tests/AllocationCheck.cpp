@@ -0,0 +1,106 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: AllocationCheck.cpp - Counts operator new calls of a frame of MatrixN and VectorN work inside a BumpArena
+/// author: Karl-Mihkel Ott
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include <trs/MatrixN.h>
+#include <trs/VectorN.h>
+#include <trs/Cholesky.h>
+
+// Every allocation that reaches the global operator new is counted, on any thread. A frame of linear algebra
+// inside a MemoryResourceScope must not make any once the arena has grown, whether the thread pool runs it serially
+// or on several threads.
+
+static std::atomic<size_t> allocations(0);
+
+void *operator new(size_t _size) {
+    allocations++;
+    if(void *p = std::malloc(_size ? _size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t _size, std::align_val_t _align) {
+    allocations++;
+    const size_t align = static_cast<size_t>(_align);
+    if(void *p = std::aligned_alloc(align, (std::max<size_t>(_size, 1) + align - 1) / align * align))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *_p) noexcept { std::free(_p); }
+void operator delete(void *_p, size_t) noexcept { std::free(_p); }
+void operator delete(void *_p, std::align_val_t) noexcept { std::free(_p); }
+void operator delete(void *_p, size_t, std::align_val_t) noexcept { std::free(_p); }
+
+
+namespace TRS {
+
+    template<typename T>
+    static T Frame(const MatrixN<T> &_a, const MatrixN<T> &_spd, const VectorN<T> &_b) {
+        const MatrixN<T> c = _a * _a;
+        const MatrixN<T> d = c + _a * static_cast<T>(2);
+        MatrixN<T> e(d);
+        e *= _a;
+        const VectorN<T> x = e * _b;
+        const MatrixN<T> inv = _spd.Inverse();
+        const Cholesky<T> cholesky(_spd);
+        return (x * _b) + _a.Determinant() + inv[0][0] + cholesky.Solve(_b)[0];
+    }
+
+
+    /// Allocations made by _frames frames after _warmup frames that are not counted
+    template<typename T>
+    static size_t CountAllocations(size_t _threads, size_t _warmup, size_t _frames) {
+        const size_t n = 96;
+        MatrixN<T> a(n), spd(n);
+        VectorN<T> b(n);
+        for(size_t i = 0; i < n; i++) {
+            b[i] = static_cast<T>(i % 7) - 3;
+            for(size_t j = 0; j < n; j++) {
+                a[i][j] = static_cast<T>((i * 31 + j * 17) % 13) / 13 - static_cast<T>(0.5);
+                spd[i][j] = i == j ? static_cast<T>(n) : static_cast<T>(1) / static_cast<T>(1 + i + j);
+            }
+        }
+
+        SetThreadCount(_threads);
+        BumpArena arena;
+        T sink = T();
+        size_t before = 0;
+        for(size_t frame = 0; frame < _warmup + _frames; frame++) {
+            if(frame == _warmup)
+                before = allocations.load();
+
+            {
+                MemoryResourceScope scope(&arena);
+                sink += Frame(a, spd, b);
+            }
+            arena.Reset();
+        }
+
+        const size_t count = allocations.load() - before;
+        std::printf("%s, %zu threads: %zu allocations in %zu frames (checksum %g)\n", std::is_same<T, float>::value ? "float" : "double",
+                    _threads, count, _frames, static_cast<double>(sink));
+        return count;
+    }
+}
+
+
+int main() {
+    // small thresholds, so that every parallel path of the frame is taken
+    TRS::ThreadPool &pool = TRS::GetThreadPool();
+    pool.SetElementwiseThreshold(256);
+    pool.SetGemmThreshold(0);
+
+    size_t total = 0;
+    for(size_t threads : { 1, 4 }) {
+        total += TRS::CountAllocations<float>(threads, 3, 50);
+        total += TRS::CountAllocations<double>(threads, 3, 50);
+    }
+
+    return total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
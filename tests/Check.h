@@ -0,0 +1,192 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: Check.h - Shared helpers of the numeric checks run by ctest
+/// author: Karl-Mihkel Ott
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+
+// Results are compared against plain triple loop references, so that a broken kernel cannot check itself.
+// Every failed expectation is printed and makes the check exit with EXIT_FAILURE.
+
+namespace TRS {
+namespace Check {
+
+    inline size_t &Failures() {
+        static size_t failures = 0;
+        return failures;
+    }
+
+
+    /// Record a failure unless _ok, _value is printed next to _what
+    inline void Expect(bool _ok, const std::string &_what, double _value = 0.0) {
+        if(!_ok) {
+            Failures()++;
+            std::printf("FAIL %s (%g)\n", _what.c_str(), _value);
+        }
+    }
+
+
+    /// Record a failure unless _error is finite and at most _limit
+    inline void ExpectBelow(double _error, double _limit, const std::string &_what) {
+        char limit[32];
+        std::snprintf(limit, sizeof(limit), " above %g", _limit);
+        Expect(std::isfinite(_error) && _error <= _limit, _what + limit, _error);
+    }
+
+
+    inline int Finish(const char *_name) {
+        std::printf("%s: %zu failures\n", _name, Failures());
+        return Failures() ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+
+    template<typename T>
+    const char *TypeName() {
+        return std::is_same<T, float>::value ? "float" : "double";
+    }
+
+
+    template<typename T>
+    double Epsilon() {
+        return static_cast<double>(std::numeric_limits<T>::epsilon());
+    }
+
+
+    /// Deterministic values in [-1, 1)
+    class Random {
+        private:
+            unsigned long long m_state;
+
+        public:
+            explicit Random(unsigned long long _seed = 1) : m_state(_seed * 2862933555777941757ull + 3037000493ull) {}
+
+            double Next() {
+                m_state = m_state * 6364136223846793005ull + 1442695040888963407ull;
+                return static_cast<double>(m_state >> 11) / static_cast<double>(1ull << 52) - 1.0;
+            }
+    };
+
+
+    template<typename T>
+    VectorN<T> RandomVector(size_t _n, Random &_rnd) {
+        VectorN<T> v(_n);
+        for(T &x : v)
+            x = static_cast<T>(_rnd.Next());
+        return v;
+    }
+
+
+    template<typename T>
+    MatrixN<T> RandomMatrix(size_t _rows, size_t _cols, Random &_rnd) {
+        MatrixN<T> m(_rows, _cols, T());
+        for(size_t i = 0; i < _rows; i++) {
+            for(size_t j = 0; j < _cols; j++)
+                m[i][j] = static_cast<T>(_rnd.Next());
+        }
+        return m;
+    }
+
+
+    /// Symmetric positive definite with eigenvalues spread over a small range
+    template<typename T>
+    MatrixN<T> RandomSpd(size_t _n, Random &_rnd) {
+        MatrixN<T> m(_n);
+        for(size_t i = 0; i < _n; i++) {
+            for(size_t j = 0; j <= i; j++)
+                m[i][j] = m[j][i] = static_cast<T>(_rnd.Next());
+            m[i][i] += static_cast<T>(_n);
+        }
+        return m;
+    }
+
+
+    /// Scalar reference product in double precision
+    template<typename T>
+    MatrixN<double> Multiply(const MatrixN<T> &_a, const MatrixN<T> &_b) {
+        MatrixN<double> c(_a.Rows(), _b.Columns(), 0.0);
+        for(size_t i = 0; i < _a.Rows(); i++) {
+            for(size_t k = 0; k < _a.Columns(); k++) {
+                for(size_t j = 0; j < _b.Columns(); j++)
+                    c[i][j] += static_cast<double>(_a[i][k]) * static_cast<double>(_b[k][j]);
+            }
+        }
+        return c;
+    }
+
+
+    template<typename T>
+    VectorN<double> Multiply(const MatrixN<T> &_a, const VectorN<T> &_x) {
+        VectorN<double> y(_a.Rows());
+        for(size_t i = 0; i < _a.Rows(); i++) {
+            for(size_t j = 0; j < _a.Columns(); j++)
+                y[i] += static_cast<double>(_a[i][j]) * static_cast<double>(_x[j]);
+        }
+        return y;
+    }
+
+
+    /// Largest elementwise difference, infinity when the shapes differ
+    template<typename L, typename R>
+    double MaxDifference(const MatrixN<L> &_a, const MatrixN<R> &_b) {
+        if(_a.Rows() != _b.Rows() || _a.Columns() != _b.Columns())
+            return std::numeric_limits<double>::infinity();
+
+        double diff = 0.0;
+        for(size_t i = 0; i < _a.Rows(); i++) {
+            for(size_t j = 0; j < _a.Columns(); j++)
+                diff = std::max(diff, std::abs(static_cast<double>(_a[i][j]) - static_cast<double>(_b[i][j])));
+        }
+        return diff;
+    }
+
+
+    template<typename L, typename R>
+    double MaxDifference(const VectorN<L> &_a, const VectorN<R> &_b) {
+        if(_a.size() != _b.size())
+            return std::numeric_limits<double>::infinity();
+
+        double diff = 0.0;
+        for(size_t i = 0; i < _a.size(); i++)
+            diff = std::max(diff, std::abs(static_cast<double>(_a[i]) - static_cast<double>(_b[i])));
+        return diff;
+    }
+
+
+    /// |A * X - B|_max / (|A|_max * |X|_max * n), about epsilon for a backward stable solve
+    template<typename T>
+    double RelativeResidual(const MatrixN<T> &_a, const MatrixN<T> &_x, const MatrixN<T> &_b) {
+        const MatrixN<double> ax = Multiply(_a, _x);
+        double a_max = 0.0, x_max = 0.0;
+        for(size_t i = 0; i < _a.Rows() * _a.Columns(); i++)
+            a_max = std::max(a_max, std::abs(static_cast<double>(_a.Data()[i])));
+        for(size_t i = 0; i < _x.Rows() * _x.Columns(); i++)
+            x_max = std::max(x_max, std::abs(static_cast<double>(_x.Data()[i])));
+        return MaxDifference(ax, _b) / (a_max * x_max * static_cast<double>(_a.Columns()));
+    }
+
+
+    template<typename T>
+    double RelativeResidual(const MatrixN<T> &_a, const VectorN<T> &_x, const VectorN<T> &_b) {
+        if(_x.size() != _a.Columns())
+            return std::numeric_limits<double>::infinity();
+
+        MatrixN<T> x(_x.size(), 1, T()), b(_b.size(), 1, T());
+        std::copy(_x.begin(), _x.end(), x.Data());
+        std::copy(_b.begin(), _b.end(), b.Data());
+        return RelativeResidual(_a, x, b);
+    }
+}
+}
+
+#endif
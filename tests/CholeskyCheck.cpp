@@ -0,0 +1,99 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: CholeskyCheck.cpp - Residuals, determinants and pivot checks of the Cholesky and LDLT factorizations
+/// author: Karl-Mihkel Ott
+
+#include <trs/MatrixN.h>
+#include <trs/LU.h>
+#include <trs/Cholesky.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// [[A, B^T], [B, -C]] with A and C positive definite, LDLT factors it although it is indefinite
+    template<typename T>
+    MatrixN<T> RandomQuasiDefinite(size_t _n, Random &_rnd) {
+        const size_t half = _n / 2;
+        const MatrixN<T> a = RandomSpd<T>(half, _rnd);
+        const MatrixN<T> c = RandomSpd<T>(_n - half, _rnd);
+        MatrixN<T> m(_n);
+        for(size_t i = 0; i < _n; i++) {
+            for(size_t j = 0; j <= i; j++) {
+                if(i < half)
+                    m[i][j] = a[i][j];
+                else if(j >= half)
+                    m[i][j] = -c[i - half][j - half];
+                else
+                    m[i][j] = static_cast<T>(_rnd.Next());
+                m[j][i] = m[i][j];
+            }
+        }
+        return m;
+    }
+
+
+    template<typename T>
+    void CheckCholesky() {
+        const std::string type = TypeName<T>();
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(18);
+
+        for(size_t n : { 1, 5, 64, 150 }) {
+            const std::string name = "<" + type + "> n" + std::to_string(n);
+            const MatrixN<T> spd = RandomSpd<T>(n, rnd);
+            const VectorN<T> b = RandomVector<T>(n, rnd);
+            const MatrixN<T> rhs = RandomMatrix<T>(n, 6, rnd);
+            // the determinant itself overflows for the larger sizes, compare logarithms from the LU diagonal
+            const LU<T> lu(spd);
+            double log_det = 0.0;
+            for(size_t i = 0; i < n; i++)
+                log_det += std::log(std::abs(static_cast<double>(lu.Factors()[i][i])));
+
+            const Cholesky<T> cholesky(spd);
+            Expect(cholesky.IsPositiveDefinite(), "Cholesky" + name + " SPD matrix is not positive definite");
+            ExpectBelow(RelativeResidual(spd, cholesky.Solve(b), b), tolerance, "Cholesky" + name + " vector residual");
+            ExpectBelow(RelativeResidual(spd, cholesky.Solve(rhs), rhs), tolerance, "Cholesky" + name + " matrix residual");
+            ExpectBelow(std::abs(static_cast<double>(cholesky.LogDeterminant()) - log_det), tolerance * n,
+                        "Cholesky" + name + " log determinant");
+
+            const LDLT<T> ldlt(spd);
+            Expect(!ldlt.IsSingular(), "LDLT" + name + " SPD matrix is singular");
+            ExpectBelow(RelativeResidual(spd, ldlt.Solve(b), b), tolerance, "LDLT" + name + " SPD vector residual");
+            ExpectBelow(std::abs(static_cast<double>(ldlt.LogDeterminant()) - log_det), tolerance * n,
+                        "LDLT" + name + " log determinant");
+
+            const MatrixN<T> indefinite = RandomQuasiDefinite<T>(n, rnd);
+            const LDLT<T> quasi(indefinite);
+            Expect(!quasi.IsSingular(), "LDLT" + name + " quasi-definite matrix is singular");
+            ExpectBelow(RelativeResidual(indefinite, quasi.Solve(rhs), rhs), tolerance, "LDLT" + name + " quasi-definite residual");
+            if(n > 1)
+                Expect(!Cholesky<T>(indefinite).IsPositiveDefinite(), "Cholesky" + name + " indefinite matrix is positive definite");
+        }
+
+        // row and column 5 repeat row and column 0, so the last pivot cancels to rounding noise
+        MatrixN<T> repeated = RandomSpd<T>(6, rnd);
+        for(size_t j = 0; j < 6; j++)
+            repeated[5][j] = repeated[j][5] = repeated[0][j];
+        repeated[5][5] = repeated[0][0];
+        const LDLT<T> singular(repeated);
+        Expect(singular.IsSingular(), "LDLT<" + type + "> repeated row is not singular");
+        Expect(singular.Solve(VectorN<T>(6, static_cast<T>(1))).size() == 0, "LDLT<" + type + "> singular solve is not empty");
+
+        // rank 5 Gram matrix of a 6 x 5 matrix, its last pivot is rounding noise that is not exactly zero
+        Random gram_rnd(4);
+        const MatrixN<T> b = RandomMatrix<T>(6, 5, gram_rnd);
+        Expect(LDLT<T>(b * b.Transpose()).IsSingular(), "LDLT<" + type + "> rank deficient Gram matrix is not singular");
+
+        const MatrixN<T> exact = { { 1, 2 }, { 2, 4 } };
+        Expect(LDLT<T>(exact).IsSingular(), "LDLT<" + type + "> exactly singular matrix is not singular");
+    }
+}
+}
+
+
+int main() {
+    TRS::Check::CheckCholesky<float>();
+    TRS::Check::CheckCholesky<double>();
+    return TRS::Check::Finish("trs_cholesky_check");
+}
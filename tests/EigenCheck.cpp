@@ -0,0 +1,162 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: EigenCheck.cpp - Reconstruction and orthogonality of SymmetricEigen and the batched SymmetricEigen3
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include <trs/SymmetricEigen.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// |A * V - V * diag(values)|_max / max |values|
+    template<typename T>
+    double EigenResidual(const MatrixN<T> &_a, const VectorN<T> &_values, const MatrixN<T> &_vectors) {
+        MatrixN<double> av = Multiply(_a, _vectors);
+        double scale = std::numeric_limits<double>::min();
+        for(size_t j = 0; j < _values.size(); j++) {
+            scale = std::max(scale, std::abs(static_cast<double>(_values[j])));
+            for(size_t i = 0; i < _a.Rows(); i++)
+                av[i][j] -= static_cast<double>(_vectors[i][j]) * static_cast<double>(_values[j]);
+        }
+        return MaxDifference(av, MatrixN<double>(_a.Rows(), _values.size(), 0.0)) / scale;
+    }
+
+
+    /// |V^T * V - I|_max
+    template<typename T>
+    double OrthogonalityError(const MatrixN<T> &_vectors) {
+        return MaxDifference(Multiply(_vectors.Transpose(), _vectors), MatrixN<double>::MakeIdentity(_vectors.Columns()));
+    }
+
+
+    template<typename T>
+    bool IsAscending(const VectorN<T> &_values) {
+        for(size_t i = 1; i < _values.size(); i++) {
+            if(_values[i - 1] > _values[i])
+                return false;
+        }
+        return true;
+    }
+
+
+    template<typename T>
+    MatrixN<T> ToMatrixN(const Matrix3<T> &_m) {
+        MatrixN<T> m(3, 3, T());
+        std::copy(_m.Data(), _m.Data() + 9, m.Data());
+        return m;
+    }
+
+
+    template<typename T>
+    VectorN<T> ToVectorN(const Vector3<T> &_v) {
+        return VectorN<T>({ _v.first, _v.second, _v.third });
+    }
+
+
+    template<typename T>
+    void CheckSymmetricEigen() {
+        const std::string type = TypeName<T>();
+        Random rnd(19);
+
+        // with the low threshold the larger sizes split the reflector and rotation updates over the pool
+        for(size_t n : { 1, 5, 64, 150 }) {
+            const std::string name = "SymmetricEigen<" + type + "> n" + std::to_string(n);
+            const double tolerance = 16 * Epsilon<T>() * n;
+            MatrixN<T> a(n);
+            for(size_t i = 0; i < n; i++) {
+                for(size_t j = 0; j <= i; j++)
+                    a[i][j] = a[j][i] = static_cast<T>(rnd.Next());
+            }
+
+            const SymmetricEigen<T> eigen(a);
+            Expect(eigen.IsConverged(), name + " did not converge");
+            Expect(IsAscending(eigen.Eigenvalues()), name + " eigenvalues are not ascending");
+            ExpectBelow(EigenResidual(a, eigen.Eigenvalues(), eigen.Eigenvectors()), tolerance, name + " residual");
+            ExpectBelow(OrthogonalityError(eigen.Eigenvectors()), tolerance, name + " orthogonality");
+
+            const SymmetricEigen<T> values_only(a, false);
+            ExpectBelow(MaxDifference(values_only.Eigenvalues(), eigen.Eigenvalues()), tolerance, name + " eigenvalues without vectors");
+        }
+
+        // I + u * u^T has the eigenvalue 1 repeated n - 1 times, the eigenvectors must still be orthonormal
+        const size_t n = 40;
+        const VectorN<T> u = RandomVector<T>(n, rnd);
+        MatrixN<T> repeated(n);
+        for(size_t i = 0; i < n; i++) {
+            for(size_t j = 0; j < n; j++)
+                repeated[i][j] = u[i] * u[j] + (i == j ? static_cast<T>(1) : T());
+        }
+        const SymmetricEigen<T> eigen(repeated);
+        const std::string name = "SymmetricEigen<" + type + "> repeated eigenvalue";
+        ExpectBelow(EigenResidual(repeated, eigen.Eigenvalues(), eigen.Eigenvectors()), 16 * Epsilon<T>() * n, name + " residual");
+        ExpectBelow(OrthogonalityError(eigen.Eigenvectors()), 16 * Epsilon<T>() * n, name + " orthogonality");
+        ExpectBelow(std::abs(static_cast<double>(eigen.Eigenvalues()[n - 2]) - 1.0), 16 * Epsilon<T>() * n, name + " value");
+    }
+
+
+    template<typename T>
+    void CheckSymmetricEigen3() {
+        const std::string type = TypeName<T>();
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(119);
+
+        // not a multiple of the lane width so that the scalar tail runs too
+        const size_t count = 1003;
+        std::vector<Matrix3<T>> matrices(count);
+        for(Matrix3<T> &m : matrices) {
+            for(size_t i = 0; i < 3; i++) {
+                for(size_t j = 0; j <= i; j++)
+                    m[i][j] = m[j][i] = static_cast<T>(rnd.Next());
+            }
+        }
+        // a diagonal and a repeated eigenvalue in the middle of a lane group
+        matrices[9] = Matrix3<T>(Vector3<T>(3, 0, 0), Vector3<T>(0, -1, 0), Vector3<T>(0, 0, 2));
+        matrices[10] = Matrix3<T>(Vector3<T>(2, 1, 1), Vector3<T>(1, 2, 1), Vector3<T>(1, 1, 2));
+
+        std::vector<Vector3<T>> values(count);
+        std::vector<Matrix3<T>> vectors(count);
+        SymmetricEigen3(matrices.data(), values.data(), vectors.data(), count);
+
+        double batch_residual = 0.0, batch_orthogonality = 0.0, single_residual = 0.0, value_difference = 0.0;
+        bool ascending = true;
+        for(size_t i = 0; i < count; i++) {
+            const MatrixN<T> a = ToMatrixN(matrices[i]);
+            const VectorN<T> batch_values = ToVectorN(values[i]);
+            const MatrixN<T> batch_vectors = ToMatrixN(vectors[i]);
+            batch_residual = std::max(batch_residual, EigenResidual(a, batch_values, batch_vectors));
+            batch_orthogonality = std::max(batch_orthogonality, OrthogonalityError(batch_vectors));
+            ascending = ascending && IsAscending(batch_values);
+
+            Vector3<T> single_values;
+            Matrix3<T> single_vectors;
+            SymmetricEigen3(matrices[i], single_values, single_vectors);
+            single_residual = std::max(single_residual, EigenResidual(a, ToVectorN(single_values), ToMatrixN(single_vectors)));
+            value_difference = std::max(value_difference, MaxDifference(batch_values, ToVectorN(single_values)));
+        }
+
+        const std::string name = "SymmetricEigen3<" + type + ">";
+        Expect(ascending, name + " batch eigenvalues are not ascending");
+        ExpectBelow(batch_residual, tolerance, name + " batch residual");
+        ExpectBelow(batch_orthogonality, tolerance, name + " batch orthogonality");
+        ExpectBelow(single_residual, tolerance, name + " single residual");
+        ExpectBelow(value_difference, tolerance, name + " batch and single eigenvalues");
+        ExpectBelow(MaxDifference(ToVectorN(values[9]), VectorN<T>({ -1, 2, 3 })), tolerance, name + " diagonal matrix");
+        ExpectBelow(MaxDifference(ToVectorN(values[10]), VectorN<T>({ 1, 1, 4 })), 4 * tolerance, name + " repeated eigenvalue");
+    }
+}
+}
+
+
+int main() {
+    // a low threshold splits the batch over the pool as well
+    TRS::GetThreadPool().SetElementwiseThreshold(64);
+    TRS::Check::CheckSymmetricEigen<float>();
+    TRS::Check::CheckSymmetricEigen<double>();
+    TRS::Check::CheckSymmetricEigen3<float>();
+    TRS::Check::CheckSymmetricEigen3<double>();
+    return TRS::Check::Finish("trs_eigen_check");
+}
@@ -0,0 +1,85 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: ExpressionCheck.cpp - Elementwise expressions and compound assignment of VectorN and MatrixN
+/// author: Karl-Mihkel Ott
+
+#include <trs/VectorN.h>
+#include <trs/MatrixN.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    template<typename T>
+    void CheckVectorExpressions() {
+        const std::string name = std::string("VectorN<") + TypeName<T>() + ">";
+        Random rnd(22);
+
+        const VectorN<T> a = RandomVector<T>(5000, rnd), b = RandomVector<T>(5000, rnd);
+        const T s = static_cast<T>(3);
+        VectorN<double> expected(5000);
+        for(size_t i = 0; i < 5000; i++)
+            expected[i] = static_cast<double>(a[i]) - static_cast<double>(b[i]) * static_cast<double>(s);
+        ExpectBelow(MaxDifference(VectorN<T>(a - b * s), expected), 4 * Epsilon<T>(), name + " fused expression");
+
+        const VectorN<T> three(3, static_cast<T>(1)), five(5, static_cast<T>(1));
+        Expect(VectorN<T>(three + five).size() == 0 && VectorN<T>(five - three).size() == 0, name + " sum of different lengths is not empty");
+        Expect((VectorN<T>(five) + three).size() == 0, name + " sum into an expiring operand of different length is not empty");
+
+        VectorN<T> sum(a);
+        sum += b * s;
+        sum -= b * s;
+        ExpectBelow(MaxDifference(sum, a), 8 * Epsilon<T>(), name + " compound assignment");
+        VectorN<T> target(five);
+        target += three;
+        Expect(target.size() == 0, name + " += of a different length is not empty");
+        target = three;
+        target -= five;
+        Expect(target.size() == 0, name + " -= of a different length is not empty");
+    }
+
+
+    template<typename T>
+    void CheckMatrixExpressions() {
+        const std::string name = std::string("MatrixN<") + TypeName<T>() + ">";
+        Random rnd(16);
+
+        // large enough for the row blocks to be split over the pool
+        const MatrixN<T> a = RandomMatrix<T>(70, 90, rnd), b = RandomMatrix<T>(70, 90, rnd), c = RandomMatrix<T>(70, 90, rnd);
+        const T s = static_cast<T>(0.5);
+        MatrixN<double> expected(70, 90, 0.0);
+        for(size_t i = 0; i < 70 * 90; i++) {
+            const double x = static_cast<double>(a.Data()[i]), y = static_cast<double>(b.Data()[i]), z = static_cast<double>(c.Data()[i]);
+            expected.Data()[i] = x + y * static_cast<double>(s) - z / static_cast<double>(s);
+        }
+
+        const double tolerance = 4 * Epsilon<T>();
+        ExpectBelow(MaxDifference(MatrixN<T>(a + b * s - c / s), expected), tolerance, name + " fused expression");
+        MatrixN<T> sum(a);
+        sum += b * s;
+        sum -= c / s;
+        ExpectBelow(MaxDifference(sum, expected), tolerance, name + " compound assignment");
+
+        // a 2 x 3 and a 3 x 2 matrix hold the same number of elements but do not conform
+        const MatrixN<T> wide(2, 3, static_cast<T>(1)), tall(3, 2, static_cast<T>(2));
+        Expect(MatrixN<T>(wide + tall).Rows() == 0 && MatrixN<T>(wide - tall).Rows() == 0, name + " sum of different shapes is not empty");
+        Expect((MatrixN<T>(wide) + tall).Rows() == 0, name + " sum into an expiring operand of different shape is not empty");
+        MatrixN<T> target(wide);
+        target += tall;
+        Expect(target.Rows() == 0 && target.Columns() == 0, name + " += of a different shape is not empty");
+        target = wide;
+        target -= tall;
+        Expect(target.Rows() == 0 && target.Columns() == 0, name + " -= of a different shape is not empty");
+    }
+}
+}
+
+
+int main() {
+    TRS::GetThreadPool().SetElementwiseThreshold(64);
+    TRS::Check::CheckVectorExpressions<float>();
+    TRS::Check::CheckVectorExpressions<double>();
+    TRS::Check::CheckMatrixExpressions<float>();
+    TRS::Check::CheckMatrixExpressions<double>();
+    return TRS::Check::Finish("trs_expression_check");
+}
@@ -0,0 +1,415 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: FixedCheck.cpp - Fixed size matrix operators and their SIMD kernels against scalar references
+/// author: Karl-Mihkel Ott
+
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    template<typename T, size_t R, size_t C>
+    Matrix<T, R, C> RandomFixed(Random &_rnd) {
+        Matrix<T, R, C> m;
+        for(size_t i = 0; i < R * C; i++)
+            m.Data()[i] = static_cast<T>(_rnd.Next());
+        return m;
+    }
+
+
+    /// Random matrix with a dominant diagonal, far from singular
+    template<typename T, size_t N>
+    Matrix<T, N, N> RandomInvertible(Random &_rnd) {
+        Matrix<T, N, N> m = RandomFixed<T, N, N>(_rnd);
+        for(size_t i = 0; i < N; i++)
+            m.Data()[i * N + i] += static_cast<T>(N);
+        return m;
+    }
+
+
+    template<typename T, size_t R, size_t C>
+    MatrixN<T> ToMatrixN(const Matrix<T, R, C> &_m) {
+        MatrixN<T> m(R, C, T());
+        std::copy(_m.Data(), _m.Data() + R * C, m.Data());
+        return m;
+    }
+
+
+    /// Copy of an N element fixed size vector, the elements follow each other from first
+    template<typename T, size_t N>
+    VectorN<T> ToVectorN(const typename FixedVector<T, N>::type &_v) {
+        VectorN<T> v(N);
+        std::copy(&_v.first, &_v.first + N, v.begin());
+        return v;
+    }
+
+
+    template<typename T, size_t N>
+    typename FixedVector<T, N>::type RandomFixedVector(Random &_rnd) {
+        typename FixedVector<T, N>::type v;
+        for(size_t i = 0; i < N; i++)
+            (&v.first)[i] = static_cast<T>(_rnd.Next());
+        return v;
+    }
+
+
+    /// Laplace expansion along the first row in double precision
+    template<typename T>
+    double ReferenceDeterminant(const MatrixN<T> &_m) {
+        const size_t n = _m.Rows();
+        if(n == 1)
+            return static_cast<double>(_m[0][0]);
+
+        double det = 0.0;
+        for(size_t j = 0; j < n; j++) {
+            MatrixN<T> minor(n - 1, n - 1, T());
+            for(size_t r = 1; r < n; r++) {
+                for(size_t c = 0, k = 0; c < n; c++) {
+                    if(c != j)
+                        minor[r - 1][k++] = _m[r][c];
+                }
+            }
+            det += (j % 2 ? -1.0 : 1.0) * static_cast<double>(_m[0][j]) * ReferenceDeterminant(minor);
+        }
+        return det;
+    }
+
+
+    /// R x C times C x K, four column float and double operands take the SIMD kernels and the rest the unrolled loops
+    template<typename T, size_t R, size_t C, size_t K>
+    void CheckProduct(Random &_rnd) {
+        const std::string name = std::string("Matrix<") + TypeName<T>() + ", " + std::to_string(R) + ", " + std::to_string(C) + ">";
+        const double tolerance = 16 * Epsilon<T>();
+        const Matrix<T, R, C> a = RandomFixed<T, R, C>(_rnd);
+        const Matrix<T, C, K> b = RandomFixed<T, C, K>(_rnd);
+        const MatrixN<double> expected = Multiply(ToMatrixN(a), ToMatrixN(b));
+
+        ExpectBelow(MaxDifference(ToMatrixN(a * b), expected), tolerance, name + " times " + std::to_string(C) + "x" + std::to_string(K));
+        if constexpr (C == K) {
+            Matrix<T, R, C> product(a);
+            product *= b;
+            ExpectBelow(MaxDifference(ToMatrixN(product), expected), tolerance, name + " *=");
+        }
+
+        const typename FixedVector<T, C>::type v = RandomFixedVector<T, C>(_rnd);
+        ExpectBelow(MaxDifference(ToVectorN<T, R>(a * v), Multiply(ToMatrixN(a), ToVectorN<T, C>(v))), tolerance, name + " times vector");
+        ExpectBelow(MaxDifference(ToMatrixN(a.Transpose()), ToMatrixN(a).Transpose()), 0.0, name + " transpose");
+    }
+
+
+    template<typename T, size_t N>
+    void CheckInverse(Random &_rnd) {
+        const std::string name = std::string("Matrix<") + TypeName<T>() + ", " + std::to_string(N) + ", " + std::to_string(N) + ">";
+        const Matrix<T, N, N> a = RandomInvertible<T, N>(_rnd);
+        const MatrixN<T> an = ToMatrixN(a);
+
+        ExpectBelow(MaxDifference(Multiply(an, ToMatrixN(a.Inverse())), MatrixN<double>::MakeIdentity(N)), 16 * Epsilon<T>(), name + " inverse");
+        const double det = ReferenceDeterminant(an);
+        ExpectBelow(std::abs(static_cast<double>(Matrix<T, N, N>::Determinant(a)) - det) / std::abs(det), 16 * Epsilon<T>(), name + " determinant");
+
+        // a repeated row gives a zero determinant
+        Matrix<T, N, N> singular = RandomFixed<T, N, N>(_rnd);
+        singular[N - 1] = singular[0];
+        ExpectBelow(std::abs(static_cast<double>(Matrix<T, N, N>::Determinant(singular))), 16 * Epsilon<T>(), name + " determinant of a singular matrix");
+    }
+
+
+    template<typename T>
+    void CheckShapes() {
+        Random rnd(23);
+        CheckProduct<T, 2, 2, 2>(rnd);
+        CheckProduct<T, 2, 3, 3>(rnd);
+        CheckProduct<T, 2, 3, 4>(rnd);
+        CheckProduct<T, 3, 3, 3>(rnd);
+        CheckProduct<T, 3, 4, 4>(rnd);
+        CheckProduct<T, 3, 4, 2>(rnd);
+        CheckProduct<T, 4, 3, 4>(rnd);
+        CheckProduct<T, 4, 4, 4>(rnd);
+        CheckProduct<T, 4, 4, 3>(rnd);
+        CheckInverse<T, 2>(rnd);
+        CheckInverse<T, 3>(rnd);
+        CheckInverse<T, 4>(rnd);
+    }
+
+
+    /// Random affine matrix with a well conditioned 3x3 block
+    template<typename T>
+    Matrix4<T> RandomAffine(Random &_rnd) {
+        Matrix4<T> m(RandomFixed<T, 3, 4>(_rnd));
+        for(size_t i = 0; i < 3; i++)
+            m.Data()[i * 4 + i] += static_cast<T>(3);
+        return m;
+    }
+
+
+    /// Random rotation from Gram-Schmidt orthonormalised rows and a random translation
+    template<typename T>
+    Matrix4<T> RandomRigid(Random &_rnd) {
+        double r[3][3];
+        for(size_t i = 0; i < 3; i++) {
+            for(size_t j = 0; j < 3; j++)
+                r[i][j] = _rnd.Next() + (i == j ? 2.0 : 0.0);
+            for(size_t k = 0; k < i; k++) {
+                const double dot = r[i][0] * r[k][0] + r[i][1] * r[k][1] + r[i][2] * r[k][2];
+                for(size_t j = 0; j < 3; j++)
+                    r[i][j] -= dot * r[k][j];
+            }
+            const double norm = std::sqrt(r[i][0] * r[i][0] + r[i][1] * r[i][1] + r[i][2] * r[i][2]);
+            for(size_t j = 0; j < 3; j++)
+                r[i][j] /= norm;
+        }
+
+        Matrix4<T> m;
+        for(size_t i = 0; i < 3; i++) {
+            for(size_t j = 0; j < 3; j++)
+                m.Data()[i * 4 + j] = static_cast<T>(r[i][j]);
+            m.Data()[i * 4 + 3] = static_cast<T>(_rnd.Next());
+        }
+        return m;
+    }
+
+
+    /// Affine and rigid inverses of 4x4 and 3x4 matrices against the general 4x4 inverse, float also through the kernels
+    template<typename T>
+    void CheckAffineInverse() {
+        const std::string type = TypeName<T>();
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(3);
+        double affine = 0.0, affine3 = 0.0, rigid = 0.0, rigid3 = 0.0;
+        for(int n = 0; n < 100; n++) {
+            const Matrix4<T> a = RandomAffine<T>(rnd);
+            const MatrixN<T> inv = ToMatrixN(a.Inverse());
+            affine = std::max(affine, MaxDifference(ToMatrixN(a.AffineInverse()), inv));
+            affine3 = std::max(affine3, MaxDifference(ToMatrixN(Matrix3x4<T>(a).AffineInverse()), ToMatrixN(Matrix3x4<T>(a.Inverse()))));
+
+            const Matrix4<T> r = RandomRigid<T>(rnd);
+            const MatrixN<T> rinv = ToMatrixN(r.Inverse());
+            rigid = std::max(rigid, MaxDifference(ToMatrixN(r.RigidInverse()), rinv));
+            rigid3 = std::max(rigid3, MaxDifference(ToMatrixN(Matrix3x4<T>(r).RigidInverse()), ToMatrixN(Matrix3x4<T>(r.Inverse()))));
+
+            if constexpr (std::is_same<T, float>::value) {
+                Matrix4<float> out;
+                const float det = FastAffineInverse4<4>(a.Data(), out.Data());
+                affine = std::max(affine, MaxDifference(ToMatrixN(out), inv));
+                affine = std::max(affine, std::abs(static_cast<double>(det) - ReferenceDeterminant(ToMatrixN(a))) / std::abs(det));
+                out = a;
+                FastAffineInverse4<4>(out.Data(), out.Data());
+                affine = std::max(affine, MaxDifference(ToMatrixN(out), inv));
+                Matrix3x4<float> out3(a);
+                FastAffineInverse4<3>(out3.Data(), out3.Data());
+                affine3 = std::max(affine3, MaxDifference(ToMatrixN(Matrix4<float>(out3)), inv));
+
+                out = r;
+                FastRigidInverse4<4>(out.Data(), out.Data());
+                rigid = std::max(rigid, MaxDifference(ToMatrixN(out), rinv));
+                out3 = Matrix3x4<float>(r);
+                FastRigidInverse4<3>(out3.Data(), out3.Data());
+                rigid3 = std::max(rigid3, MaxDifference(ToMatrixN(Matrix4<float>(out3)), rinv));
+            }
+        }
+
+        ExpectBelow(affine, tolerance, "Matrix4<" + type + "> AffineInverse");
+        ExpectBelow(affine3, tolerance, "Matrix3x4<" + type + "> AffineInverse");
+        ExpectBelow(rigid, tolerance, "Matrix4<" + type + "> RigidInverse");
+        ExpectBelow(rigid3, tolerance, "Matrix3x4<" + type + "> RigidInverse");
+    }
+
+
+    /// Column-major matrices converted from row-major ones must agree with them in every operation
+    template<typename T>
+    void CheckColMatrix4() {
+        const std::string name = std::string("ColMatrix4<") + TypeName<T>() + ">";
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(5);
+        const Matrix4<T> a = RandomInvertible<T, 4>(rnd), b = RandomFixed<T, 4, 4>(rnd);
+        const Vector4<T> v = RandomFixedVector<T, 4>(rnd);
+        const ColMatrix4<T> ca(a), cb(b);
+
+        // the columns hold what the rows of the transpose hold
+        const Matrix4<T> t = a.Transpose();
+        Expect(ca.col1 == t.row1 && ca.col2 == t.row2 && ca.col3 == t.row3 && ca.col4 == t.row4, name + " columns of a row-major matrix");
+        Expect(ca.ToRowMajor() == a, name + " round trip through column-major storage");
+        Expect(ca.Transpose().ToRowMajor() == t, name + " transpose");
+
+        const MatrixN<double> expected = Multiply(ToMatrixN(a), ToMatrixN(b));
+        ExpectBelow(MaxDifference(ToMatrixN((ca * cb).ToRowMajor()), expected), tolerance, name + " product");
+        ColMatrix4<T> product(ca);
+        product *= cb;
+        ExpectBelow(MaxDifference(ToMatrixN(product.ToRowMajor()), expected), tolerance, name + " *=");
+        ExpectBelow(MaxDifference(ToVectorN<T, 4>(ca * v), ToVectorN<T, 4>(a * v)), tolerance, name + " times vector");
+        ExpectBelow(MaxDifference(ToMatrixN(ca.Inverse().ToRowMajor()), ToMatrixN(a.Inverse())), tolerance, name + " inverse");
+    }
+
+
+    /// The padding lane of Vector3A and Matrix3A rows must stay zero when the visible lanes become infinite or NaN,
+    /// otherwise comparisons and magnitudes of later values read the garbage
+    void CheckPadLane() {
+        const float zero = 0.0f;
+        Vector3A v;
+        v /= zero;
+        Expect(v.pad == 0.0f, "Vector3A /= 0 of a zero vector left the padding lane nonzero", v.pad);
+        Vector3A w = Vector3A() / zero;
+        Expect(w.pad == 0.0f, "Vector3A / 0 of a zero vector left the padding lane nonzero", w.pad);
+        Vector3A n;
+        n.Normalise();
+        Expect(n.pad == 0.0f, "Vector3A normalised zero vector left the padding lane nonzero", n.pad);
+        Vector3A s = Vector3A(1, 0, 0) * (1.0f / zero);
+        Expect(s.pad == 0.0f, "Vector3A scaled by infinity left the padding lane nonzero", s.pad);
+
+        // reusing the vectors only through the visible lanes
+        for(Vector3A *u : { &v, &w, &n, &s }) {
+            u->first = 3.0f;
+            u->second = 4.0f;
+            u->third = 0.0f;
+            Expect(*u == Vector3A(3, 4, 0), "Vector3A with a reused padding lane compared unequal");
+            Expect(u->Magnitude() == 5.0f, "Vector3A with a reused padding lane has a wrong magnitude", u->Magnitude());
+        }
+
+        const Matrix3A infinite = Matrix3A() * (1.0f / zero);
+        const Matrix3A singular = Matrix3A(Vector3A(), Vector3A(), Vector3A()).Inverse();
+        for(const Matrix3A &m : { infinite, singular, infinite.Transpose() })
+            Expect(m.row1.pad == 0.0f && m.row2.pad == 0.0f && m.row3.pad == 0.0f, "Matrix3A left a padding lane nonzero");
+    }
+
+
+    /// Float product kernel for R x 4 times 4x4, with the output written over either input
+    template<size_t R>
+    void CheckMatMul4(const std::string &_name, void (*_kernel)(const float*, const float*, float*)) {
+        const std::string name = _name + "<" + std::to_string(R) + ">";
+        const double tolerance = 16 * Epsilon<float>();
+        Random rnd(R);
+        const Matrix<float, R, 4> a = RandomFixed<float, R, 4>(rnd);
+        const Matrix4<float> b = RandomFixed<float, 4, 4>(rnd);
+        const MatrixN<double> expected = Multiply(ToMatrixN(a), ToMatrixN(b));
+
+        Matrix<float, R, 4> out;
+        _kernel(a.Data(), b.Data(), out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(out), expected), tolerance, name);
+        out = a;
+        _kernel(out.Data(), b.Data(), out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(out), expected), tolerance, name + " over the first operand");
+
+        if constexpr (R == 4) {
+            Matrix4<float> over = b;
+            _kernel(a.Data(), over.Data(), over.Data());
+            ExpectBelow(MaxDifference(ToMatrixN(over), expected), tolerance, name + " over the second operand");
+            over = a;
+            _kernel(over.Data(), over.Data(), over.Data());
+            ExpectBelow(MaxDifference(ToMatrixN(over), Multiply(ToMatrixN(a), ToMatrixN(a))), tolerance, name + " square in place");
+        }
+    }
+
+
+    /// Block inverse kernel: identity residual in and out of place, returned determinant, zero determinant of a singular input
+    template<typename T>
+    void CheckInverse4() {
+        const std::string name = std::string("FastInverse4<") + TypeName<T>() + ">";
+        Random rnd(2);
+        double residual = 0.0, in_place = 0.0, det_error = 0.0;
+        for(int n = 0; n < 100; n++) {
+            const Matrix4<T> a = RandomInvertible<T, 4>(rnd);
+            const MatrixN<T> an = ToMatrixN(a);
+            Matrix4<T> inv;
+            const T det = FastInverse4(a.Data(), inv.Data());
+            residual = std::max(residual, MaxDifference(Multiply(an, ToMatrixN(inv)), MatrixN<double>::MakeIdentity(4)));
+            const double reference = ReferenceDeterminant(an);
+            det_error = std::max(det_error, std::abs(static_cast<double>(det) - reference) / std::abs(reference));
+
+            inv = a;
+            FastInverse4(inv.Data(), inv.Data());
+            in_place = std::max(in_place, MaxDifference(Multiply(an, ToMatrixN(inv)), MatrixN<double>::MakeIdentity(4)));
+        }
+        ExpectBelow(residual, 16 * Epsilon<T>(), name + " identity residual");
+        ExpectBelow(in_place, 16 * Epsilon<T>(), name + " in place identity residual");
+        ExpectBelow(det_error, 16 * Epsilon<T>(), name + " determinant");
+
+        // the third row is the sum of the first two
+        Matrix4<T> singular = RandomFixed<T, 4, 4>(rnd);
+        singular[2] = singular[0] + singular[1];
+        Matrix4<T> inv;
+        ExpectBelow(std::abs(static_cast<double>(FastInverse4(singular.Data(), inv.Data()))), 16 * Epsilon<T>(), name + " determinant of a singular matrix");
+        Expect(FastInverse4(Matrix4<T>(singular * T()).Data(), inv.Data()) == T(), name + " determinant of the zero matrix");
+    }
+
+
+    void CheckSimdKernels() {
+        CheckMatMul4<3>("FastMatMul4Sse", FastMatMul4Sse<3>);
+        CheckMatMul4<4>("FastMatMul4Sse", FastMatMul4Sse<4>);
+        const CpuFeatures &cpu = GetCpuFeatures();
+        if(cpu.avx2 && cpu.fma) {
+            CheckMatMul4<3>("FastMatMul4Avx2", FastMatMul4Avx2<3>);
+            CheckMatMul4<4>("FastMatMul4Avx2", FastMatMul4Avx2<4>);
+        }
+
+        CheckInverse4<float>();
+        if(FastInverse4x4<double>::Enabled())
+            CheckInverse4<double>();
+    }
+
+
+    /// The double kernels are chosen at runtime, compare them and the operators using them with the scalar formulas
+    void CheckDoubleKernels() {
+        const bool enabled = FastRows4<double>::Enabled();
+        std::printf("double Matrix4 kernels %s\n", enabled ? "enabled" : "disabled");
+        const double tolerance = 16 * Epsilon<double>();
+        Random rnd(8);
+
+        const Matrix4<double> a = RandomInvertible<double, 4>(rnd), b = RandomFixed<double, 4, 4>(rnd);
+        const Matrix3x4<double> affine = RandomFixed<double, 3, 4>(rnd);
+        const Vector4<double> v(rnd.Next(), rnd.Next(), rnd.Next(), rnd.Next());
+        const MatrixN<double> an = ToMatrixN(a), bn = ToMatrixN(b);
+
+        ExpectBelow(MaxDifference(ToMatrixN(a * b), Multiply(an, bn)), tolerance, "Matrix4<double> product");
+        ExpectBelow(MaxDifference(ToMatrixN(affine * b), Multiply(ToMatrixN(affine), bn)), tolerance, "Matrix3x4<double> product");
+        ExpectBelow(MaxDifference(ToVectorN<double, 4>(a * v), Multiply(an, ToVectorN<double, 4>(v))), tolerance, "Matrix4<double> times vector");
+        ExpectBelow(MaxDifference(ToMatrixN(a.Transpose()), an.Transpose()), 0.0, "Matrix4<double> transpose");
+        Matrix4<double> product(a);
+        product *= b;
+        ExpectBelow(MaxDifference(ToMatrixN(product), Multiply(an, bn)), tolerance, "Matrix4<double> *=");
+        ExpectBelow(MaxDifference(Multiply(an, ToMatrixN(a.Inverse())), MatrixN<double>::MakeIdentity(4)), tolerance, "Matrix4<double> inverse");
+
+        if(!enabled)
+            return;
+
+        // the kernels themselves, including the documented aliasing of the output
+        Matrix4<double> out;
+        FastMatMul4<4>(a.Data(), b.Data(), out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(out), Multiply(an, bn)), tolerance, "FastMatMul4<double>");
+        out = a;
+        FastMatMul4<4>(out.Data(), b.Data(), out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(out), Multiply(an, bn)), tolerance, "FastMatMul4<double> in place");
+        Matrix3x4<double> affine_out;
+        FastMatMul4<3>(affine.Data(), b.Data(), affine_out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(affine_out), Multiply(ToMatrixN(affine), bn)), tolerance, "FastMatMul4<double> three rows");
+
+        Vector4<double> w = v;
+        FastMatVec4(a.Data(), &w.first, &w.first);
+        ExpectBelow(MaxDifference(ToVectorN<double, 4>(w), Multiply(an, ToVectorN<double, 4>(v))), tolerance, "FastMatVec4<double> in place");
+
+        out = a;
+        FastTranspose4(out.Data(), out.Data());
+        ExpectBelow(MaxDifference(ToMatrixN(out), an.Transpose()), 0.0, "FastTranspose4<double> in place");
+
+        out = a;
+        const double det = FastInverse4(out.Data(), out.Data());
+        ExpectBelow(MaxDifference(Multiply(an, ToMatrixN(out)), MatrixN<double>::MakeIdentity(4)), tolerance, "FastInverse4<double> in place");
+        ExpectBelow(std::abs(det - Matrix4<double>::Determinant(a)) / std::abs(det), tolerance, "FastInverse4<double> determinant");
+    }
+}
+}
+
+
+int main() {
+    TRS::Check::CheckShapes<float>();
+    TRS::Check::CheckShapes<double>();
+    TRS::Check::CheckSimdKernels();
+    TRS::Check::CheckAffineInverse<float>();
+    TRS::Check::CheckAffineInverse<double>();
+    TRS::Check::CheckColMatrix4<float>();
+    TRS::Check::CheckColMatrix4<double>();
+    TRS::Check::CheckPadLane();
+    TRS::Check::CheckDoubleKernels();
+    return TRS::Check::Finish("trs_fixed_check");
+}
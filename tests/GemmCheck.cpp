@@ -0,0 +1,132 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: GemmCheck.cpp - Blocked and threaded GEMM against a scalar reference over flags, scalars and edge tiles
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <trs/MatrixN.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    struct GemmShape {
+        size_t m, n, k;
+    };
+
+    // register tiles are 6 x 16 for float and 6 x 8 for double, kc is 256 and mc 144 or 96, so these shapes
+    // leave partial tiles in every direction and split k and m over several cache blocks
+    const GemmShape g_shapes[] = { { 1, 1, 1 }, { 6, 16, 8 }, { 7, 17, 5 }, { 13, 37, 300 }, { 5, 9, 513 }, { 150, 23, 40 } };
+
+
+    /// C = _alpha * op(A) * op(B) + _beta * C in double precision on strided storage
+    template<typename T>
+    std::vector<double> ReferenceGemm(bool _trans_a, bool _trans_b, const GemmShape &_s, double _alpha, const std::vector<T> &_a, size_t _lda,
+                                      const std::vector<T> &_b, size_t _ldb, double _beta, const std::vector<T> &_c, size_t _ldc) {
+        std::vector<double> c(_c.begin(), _c.end());
+        for(size_t i = 0; i < _s.m; i++) {
+            for(size_t j = 0; j < _s.n; j++) {
+                double sum = 0.0;
+                for(size_t p = 0; p < _s.k; p++) {
+                    const double a = static_cast<double>(_trans_a ? _a[p * _lda + i] : _a[i * _lda + p]);
+                    const double b = static_cast<double>(_trans_b ? _b[j * _ldb + p] : _b[p * _ldb + j]);
+                    sum += a * b;
+                }
+                // beta = 0 ignores what C held, NaN included
+                c[i * _ldc + j] = _alpha * sum + (_beta == 0.0 ? 0.0 : _beta * c[i * _ldc + j]);
+            }
+        }
+        return c;
+    }
+
+
+    template<typename T>
+    std::vector<T> RandomStorage(size_t _n, Random &_rnd) {
+        std::vector<T> v(_n);
+        for(T &x : v)
+            x = static_cast<T>(_rnd.Next());
+        return v;
+    }
+
+
+    /// Largest difference over the m x n block of C, padding past each row must keep its old value
+    template<typename T>
+    double GemmDifference(const std::vector<T> &_c, const std::vector<double> &_expected, const std::vector<T> &_before, const GemmShape &_s, size_t _ldc) {
+        double diff = 0.0;
+        for(size_t i = 0; i < _s.m; i++) {
+            for(size_t j = 0; j < _ldc; j++) {
+                const size_t at = i * _ldc + j;
+                if(j >= _s.n) {
+                    if(_c[at] != _before[at])
+                        return std::numeric_limits<double>::infinity();
+                } else diff = std::max(diff, std::abs(static_cast<double>(_c[at]) - _expected[at]));
+            }
+        }
+        return diff;
+    }
+
+
+    template<typename T>
+    void CheckGemm(const std::string &_mode) {
+        const std::string type = TypeName<T>();
+        Random rnd(12);
+
+        for(const GemmShape &s : g_shapes) {
+            for(int flags = 0; flags < 4; flags++) {
+                const bool trans_a = flags & 1, trans_b = flags & 2;
+                // row strides longer than the rows, as for blocks of larger matrices
+                const size_t lda = (trans_a ? s.m : s.k) + 3, ldb = (trans_b ? s.k : s.n) + 2, ldc = s.n + 5;
+                const std::vector<T> a = RandomStorage<T>((trans_a ? s.k : s.m) * lda, rnd);
+                const std::vector<T> b = RandomStorage<T>((trans_b ? s.n : s.k) * ldb, rnd);
+                const double tolerance = 4 * Epsilon<T>() * static_cast<double>(s.k + 2);
+
+                for(const double alpha : { 1.0, -0.75 }) {
+                    for(const double beta : { 0.0, 1.0, 0.5 }) {
+                        std::vector<T> c = RandomStorage<T>(s.m * ldc, rnd);
+                        if(beta == 0.0)
+                            c[0] = std::numeric_limits<T>::quiet_NaN();
+                        const std::vector<T> before(c);
+                        const std::vector<double> expected = ReferenceGemm(trans_a, trans_b, s, alpha, a, lda, b, ldb, beta, c, ldc);
+
+                        Gemm(trans_a, trans_b, s.m, s.n, s.k, static_cast<T>(alpha), a.data(), lda, b.data(), ldb, static_cast<T>(beta), c.data(), ldc);
+                        const std::string name = "Gemm<" + type + "> " + _mode + " " + std::to_string(s.m) + "x" + std::to_string(s.n) + "x" +
+                                                 std::to_string(s.k) + (trans_a ? " A^T" : " A") + (trans_b ? " B^T" : " B") +
+                                                 " alpha " + std::to_string(alpha) + " beta " + std::to_string(beta);
+                        ExpectBelow(GemmDifference(c, expected, before, s, ldc), tolerance, name);
+                    }
+                }
+            }
+        }
+
+        // the MatrixN overload with transposed operands, and its refusal of operands that do not conform
+        const MatrixN<T> a = RandomMatrix<T>(40, 19, rnd), b = RandomMatrix<T>(23, 40, rnd);
+        MatrixN<T> c = RandomMatrix<T>(19, 23, rnd);
+        const MatrixN<double> expected = Multiply(a.Transpose(), b.Transpose());
+        MatrixN<double> scaled(19, 23, 0.0);
+        for(size_t i = 0; i < 19; i++) {
+            for(size_t j = 0; j < 23; j++)
+                scaled[i][j] = 2.0 * expected[i][j] + 0.5 * static_cast<double>(c[i][j]);
+        }
+        const std::string name = "Gemm<" + type + "> " + _mode + " MatrixN";
+        Expect(Gemm(static_cast<T>(2), a, true, b, true, static_cast<T>(0.5), c), name + " refused conforming operands");
+        ExpectBelow(MaxDifference(c, scaled), 4 * Epsilon<T>() * 45, name);
+        const MatrixN<T> kept(c);
+        Expect(!Gemm(static_cast<T>(1), a, false, b, false, T(), c) && MaxDifference(c, kept) == 0.0, name + " accepted operands that do not conform");
+    }
+}
+}
+
+
+int main() {
+    TRS::ThreadPool &pool = TRS::GetThreadPool();
+    pool.SetThreadCount(1);
+    TRS::Check::CheckGemm<float>("serial");
+    TRS::Check::CheckGemm<double>("serial");
+
+    // a threshold of one multiply-add tiles every product over the pool
+    pool.SetThreadCount(4);
+    pool.SetGemmThreshold(1);
+    TRS::Check::CheckGemm<float>("threaded");
+    TRS::Check::CheckGemm<double>("threaded");
+    return TRS::Check::Finish("trs_gemm_check");
+}
@@ -0,0 +1,128 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: LUCheck.cpp - Triangular solves and residuals, inverses and determinants of the pivoted LU factorization
+/// author: Karl-Mihkel Ott
+
+#include <trs/MatrixN.h>
+#include <trs/LU.h>
+#include <trs/Triangular.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// Blocked and substitution paths of both triangular solves against X that was multiplied out
+    template<typename T>
+    void CheckTriangular() {
+        const std::string type = TypeName<T>();
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(15);
+
+        for(size_t n : { 3, 150 }) {
+            for(size_t nrhs : { size_t(1), TriangularBlocking::min_rhs, size_t(10) }) {
+                for(bool unit : { false, true }) {
+                    const std::string name = "Triangular<" + type + "> n" + std::to_string(n) + " nrhs" + std::to_string(nrhs) + (unit ? " unit" : "");
+
+                    // a dominant diagonal keeps the triangles well conditioned, a unit solve ignores the stored one
+                    MatrixN<T> lower(n, n, T()), upper(n, n, T());
+                    for(size_t i = 0; i < n; i++) {
+                        for(size_t j = 0; j < i; j++) {
+                            lower[i][j] = static_cast<T>(rnd.Next() / n);
+                            upper[j][i] = static_cast<T>(rnd.Next() / n);
+                        }
+                        lower[i][i] = unit ? static_cast<T>(1) : static_cast<T>(2 + rnd.Next());
+                        upper[i][i] = unit ? static_cast<T>(1) : static_cast<T>(2 + rnd.Next());
+                    }
+
+                    const MatrixN<T> x = RandomMatrix<T>(n, nrhs, rnd);
+                    for(bool is_lower : { true, false }) {
+                        const MatrixN<T> &a = is_lower ? lower : upper;
+                        const MatrixN<double> reference = Multiply(a, x);
+                        MatrixN<T> b(n, nrhs, T());
+                        for(size_t i = 0; i < n * nrhs; i++)
+                            b.Data()[i] = static_cast<T>(reference.Data()[i]);
+
+                        // garbage on the diagonal of unit solves must not be read
+                        MatrixN<T> stored(a);
+                        if(unit) {
+                            for(size_t i = 0; i < n; i++)
+                                stored[i][i] = static_cast<T>(7);
+                        }
+
+                        if(is_lower)
+                            SolveLowerTriangular(unit, n, nrhs, stored.Data(), n, b.Data(), nrhs);
+                        else
+                            SolveUpperTriangular(unit, n, nrhs, stored.Data(), n, b.Data(), nrhs);
+                        ExpectBelow(MaxDifference(b, x), tolerance * n, name + (is_lower ? " lower" : " upper") + " solution");
+                    }
+                }
+            }
+        }
+    }
+
+
+    /// MatrixN::Solve goes through LU without forming the inverse
+    template<typename T>
+    void CheckMatrixSolve() {
+        const std::string type = TypeName<T>();
+        Random rnd(16);
+        const MatrixN<T> a = RandomMatrix<T>(90, 90, rnd);
+        const VectorN<T> b = RandomVector<T>(90, rnd);
+        const MatrixN<T> rhs = RandomMatrix<T>(90, 5, rnd);
+        ExpectBelow(RelativeResidual(a, a.Solve(b), b), 16 * Epsilon<T>(), "MatrixN<" + type + ">::Solve vector residual");
+        ExpectBelow(RelativeResidual(a, a.Solve(rhs), rhs), 16 * Epsilon<T>(), "MatrixN<" + type + ">::Solve matrix residual");
+        Expect(a.Solve(VectorN<T>(4)).size() == 0, "MatrixN<" + type + ">::Solve of a short vector is not empty");
+    }
+
+
+    template<typename T>
+    void CheckLU() {
+        const std::string type = TypeName<T>();
+        const double tolerance = 16 * Epsilon<T>();
+        Random rnd(14);
+
+        // sizes below, at and above the 64 wide panel
+        for(size_t n : { 1, 5, 64, 150 }) {
+            const std::string name = "LU<" + type + "> n" + std::to_string(n);
+            const MatrixN<T> a = RandomMatrix<T>(n, n, rnd);
+            const LU<T> lu(a);
+            Expect(!lu.IsSingular(), name + " random matrix is singular");
+
+            const VectorN<T> b = RandomVector<T>(n, rnd);
+            ExpectBelow(RelativeResidual(a, lu.Solve(b), b), tolerance, name + " vector residual");
+
+            const MatrixN<T> rhs = RandomMatrix<T>(n, 7, rnd);
+            ExpectBelow(RelativeResidual(a, lu.Solve(rhs), rhs), tolerance, name + " matrix residual");
+
+            const MatrixN<T> inv = lu.Inverse();
+            ExpectBelow(RelativeResidual(a, inv, MatrixN<T>::MakeIdentity(n)), tolerance, name + " inverse residual");
+        }
+
+        // the first two rows of { { 2, 1, 0 }, { 1, 3, 1 }, { 0, 1, 4 } } swapped, which has determinant 18
+        const MatrixN<T> known = { { 1, 3, 1 }, { 2, 1, 0 }, { 0, 1, 4 } };
+        ExpectBelow(std::abs(static_cast<double>(LU<T>(known).Determinant()) + 18.0), 64 * Epsilon<T>(), "LU<" + type + "> known determinant");
+
+        // the last row repeats the first one exactly
+        MatrixN<T> singular = RandomMatrix<T>(6, 6, rnd);
+        std::copy(singular[0], singular[0] + 6, singular[5]);
+        const LU<T> lu(singular);
+        Expect(lu.IsSingular(), "LU<" + type + "> repeated row is not singular");
+        Expect(lu.Determinant() == T() && lu.Inverse().Rows() == 0 && lu.Solve(VectorN<T>(6)).size() == 0,
+               "LU<" + type + "> singular results are not empty");
+
+        const double rcond = static_cast<double>(LU<T>(MatrixN<T>::MakeIdentity(9)).ReciprocalCondition());
+        ExpectBelow(std::abs(rcond - 1.0), tolerance, "LU<" + type + "> identity reciprocal condition");
+    }
+}
+}
+
+
+int main() {
+    TRS::Check::CheckTriangular<float>();
+    TRS::Check::CheckTriangular<double>();
+    TRS::Check::CheckMatrixSolve<float>();
+    TRS::Check::CheckMatrixSolve<double>();
+    TRS::Check::CheckLU<float>();
+    TRS::Check::CheckLU<double>();
+    return TRS::Check::Finish("trs_lu_check");
+}
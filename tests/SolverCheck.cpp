@@ -0,0 +1,167 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: SolverCheck.cpp - Convergence and true residuals of the iterative solvers, reproducible parallel dot products
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <trs/SparseMatrixN.h>
+#include <trs/IterativeSolvers.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// Five point Laplacian on an _m x _m grid plus a first order convection term of strength _convection along x
+    template<typename T>
+    SparseMatrixN<T> GridOperator(size_t _m, double _convection) {
+        std::vector<Triplet<T>> triplets;
+        for(size_t y = 0; y < _m; y++) {
+            for(size_t x = 0; x < _m; x++) {
+                const size_t i = y * _m + x;
+                triplets.push_back({ i, i, static_cast<T>(4) });
+                if(x > 0)
+                    triplets.push_back({ i, i - 1, static_cast<T>(-1 - _convection) });
+                if(x + 1 < _m)
+                    triplets.push_back({ i, i + 1, static_cast<T>(-1 + _convection) });
+                if(y > 0)
+                    triplets.push_back({ i, i - _m, static_cast<T>(-1) });
+                if(y + 1 < _m)
+                    triplets.push_back({ i, i + _m, static_cast<T>(-1) });
+            }
+        }
+        return SparseMatrixN<T>::FromTriplets(_m * _m, _m * _m, triplets);
+    }
+
+
+    /// |b - A * x|_2 / |b|_2 with the product in double precision
+    template<typename T>
+    double TrueResidual(const MatrixN<T> &_a, const VectorN<T> &_x, const VectorN<T> &_b) {
+        if(_x.size() != _a.Columns())
+            return std::numeric_limits<double>::infinity();
+
+        const VectorN<double> ax = Multiply(_a, _x);
+        double r = 0.0, b = 0.0;
+        for(size_t i = 0; i < _b.size(); i++) {
+            const double d = static_cast<double>(_b[i]) - ax[i];
+            r += d * d;
+            b += static_cast<double>(_b[i]) * static_cast<double>(_b[i]);
+        }
+        return std::sqrt(r / b);
+    }
+
+
+    /// Converged within the iteration limit and the true residual agrees with the recursive one
+    template<typename T>
+    void ExpectSolved(const IterationResult<T> &_result, const MatrixN<T> &_a, const VectorN<T> &_x, const VectorN<T> &_b,
+                      const std::string &_what) {
+        Expect(_result.converged, _what + " did not converge", static_cast<double>(_result.relative_residual));
+        ExpectBelow(TrueResidual(_a, _x, _b), 4 * std::sqrt(Epsilon<T>()), _what + " true residual");
+    }
+
+
+    template<typename T>
+    void CheckSolvers() {
+        const std::string type = TypeName<T>();
+        Random rnd(25);
+
+        // 30 x 30 grid, the vector passes split over the pool with the low threshold set in main()
+        const SparseMatrixN<T> poisson = GridOperator<T>(30, 0.0);
+        const MatrixN<T> poisson_dense = poisson.ToDense();
+        const VectorN<T> b = RandomVector<T>(poisson.Rows(), rnd);
+
+        const std::string cg = "ConjugateGradient<" + type + ">";
+        VectorN<T> x;
+        const IterationResult<T> plain = ConjugateGradient(poisson, b, x);
+        ExpectSolved(plain, poisson_dense, x, b, cg + " Poisson");
+
+        // the solution is the starting guess of the next solve, which has nothing left to do
+        const IterationResult<T> warm = ConjugateGradient(poisson, b, x);
+        Expect(warm.converged && warm.iterations == 0, cg + " warm start iterated", static_cast<double>(warm.iterations));
+
+        x.clear();
+        ExpectSolved(ConjugateGradient(poisson, b, x, JacobiPreconditioner<T>(poisson)), poisson_dense, x, b, cg + " Jacobi");
+
+        const IncompleteCholesky<T> ic(poisson);
+        Expect(ic.IsValid() && ic.Shift() == T(), "IncompleteCholesky<" + type + "> of an M-matrix needed a shift");
+        x.clear();
+        const IterationResult<T> preconditioned = ConjugateGradient(poisson, b, x, ic);
+        ExpectSolved(preconditioned, poisson_dense, x, b, cg + " IC(0)");
+        Expect(preconditioned.iterations < plain.iterations, cg + " IC(0) did not save iterations", static_cast<double>(preconditioned.iterations));
+
+        // the same operator as a dense matrix and as a callback
+        x.clear();
+        ExpectSolved(ConjugateGradient(poisson_dense, b, x), poisson_dense, x, b, cg + " dense");
+        x.clear();
+        auto apply = [&](const VectorN<T> &_in, VectorN<T> &_out) { ApplyOperator(poisson, _in, _out); };
+        ExpectSolved(ConjugateGradient(apply, b, x), poisson_dense, x, b, cg + " callback");
+
+        x = RandomVector<T>(b.size(), rnd);
+        const IterationResult<T> zero = ConjugateGradient(poisson, VectorN<T>(b.size()), x);
+        Expect(zero.converged && zero.iterations == 0 && MaxDifference(x, VectorN<T>(b.size())) == 0.0, cg + " zero right hand side");
+
+        // convection makes the operator nonsymmetric
+        const SparseMatrixN<T> convection = GridOperator<T>(30, 0.5);
+        const MatrixN<T> convection_dense = convection.ToDense();
+        const std::string bicgstab = "BiCGSTAB<" + type + ">";
+        x.clear();
+        ExpectSolved(BiCGSTAB(convection, b, x), convection_dense, x, b, bicgstab + " convection");
+        x.clear();
+        ExpectSolved(BiCGSTAB(convection, b, x, JacobiPreconditioner<T>(convection)), convection_dense, x, b, bicgstab + " Jacobi");
+        x.clear();
+        ExpectSolved(BiCGSTAB(convection_dense, b, x), convection_dense, x, b, bicgstab + " dense");
+
+        VectorN<T> wrong;
+        Expect(!ConjugateGradient(poisson, VectorN<T>(7), wrong).converged, cg + " converged with a right hand side of the wrong length");
+    }
+
+
+    /// Dot products must give the same bits for any thread count and for however the pool splits the range
+    template<typename T>
+    void CheckDot() {
+        const std::string name = std::string("Dot<") + TypeName<T>() + ">";
+        Random rnd(125);
+        const size_t n = 1 << 20;
+        const VectorN<T> x = RandomVector<T>(n, rnd), y = RandomVector<T>(n, rnd);
+
+        ThreadPool &pool = GetThreadPool();
+        pool.SetThreadCount(1);
+        const T serial = Dot(x, y);
+        pool.SetThreadCount(4);
+        Expect(Dot(x, y) == serial, name + " depends on the thread count");
+
+        // fill this thread's chunk sums, then sum all ones while another thread owns the pool, which makes
+        // ParallelFor hand the whole range to one call
+        Expect(Dot(VectorN<T>(n, static_cast<T>(5)), VectorN<T>(n, static_cast<T>(1))) == static_cast<T>(5 * n), name + " of fives");
+        std::atomic<bool> started(false), done(false);
+        std::thread owner([&] {
+            pool.ParallelFor(0, 2, 1, [&](size_t, size_t) {
+                started = true;
+                while(!done)
+                    std::this_thread::yield();
+            });
+        });
+        while(!started)
+            std::this_thread::yield();
+
+        const VectorN<T> ones(n, static_cast<T>(1));
+        const T sum = Dot(ones, ones);
+        done = true;
+        owner.join();
+        Expect(sum == static_cast<T>(n), name + " of ones while the pool is busy", static_cast<double>(sum));
+        Expect(Dot(x, y) == serial, name + " after the pool was busy");
+    }
+}
+}
+
+
+int main() {
+    // a low threshold splits the vector passes over the pool as well
+    TRS::GetThreadPool().SetElementwiseThreshold(64);
+    TRS::Check::CheckSolvers<float>();
+    TRS::Check::CheckSolvers<double>();
+    TRS::Check::CheckDot<float>();
+    TRS::Check::CheckDot<double>();
+    return TRS::Check::Finish("trs_solver_check");
+}
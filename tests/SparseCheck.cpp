@@ -0,0 +1,76 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: SparseCheck.cpp - CSR construction and products of SparseMatrixN against dense references
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <trs/SparseMatrixN.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// Random pattern with about _density of the elements set, some rows are left empty
+    template<typename T>
+    std::vector<Triplet<T>> RandomTriplets(size_t _rows, size_t _cols, double _density, Random &_rnd) {
+        std::vector<Triplet<T>> triplets;
+        for(size_t i = 0; i < _rows; i++) {
+            if(i % 7 == 3)
+                continue;
+            for(size_t j = 0; j < _cols; j++) {
+                if(_rnd.Next() < 2.0 * _density - 1.0)
+                    triplets.push_back({ i, j, static_cast<T>(_rnd.Next()) });
+            }
+        }
+        return triplets;
+    }
+
+
+    template<typename T>
+    void CheckSparse() {
+        const std::string type = TypeName<T>();
+        Random rnd(17);
+
+        // duplicates are summed, entries may come in any order
+        const std::vector<Triplet<T>> duplicates = { { 1, 2, 1 }, { 0, 0, 3 }, { 1, 2, 2 }, { 1, 0, -1 } };
+        const SparseMatrixN<T> small = SparseMatrixN<T>::FromTriplets(2, 3, duplicates);
+        const MatrixN<T> expected = { { 3, 0, 0 }, { -1, 0, 3 } };
+        Expect(small.NonZeros() == 3 && MaxDifference(small.ToDense(), expected) == 0.0, "SparseMatrixN<" + type + "> FromTriplets");
+
+        // row lengths below and above the four lane gather, and enough rows to split over the pool
+        for(size_t n : { 9, 300 }) {
+            for(double density : { 0.05, 0.4 }) {
+                const std::string name = "SparseMatrixN<" + type + "> n" + std::to_string(n) + " density " + std::to_string(density);
+                const size_t cols = n + 5;
+                const SparseMatrixN<T> a = SparseMatrixN<T>::FromTriplets(n, cols, RandomTriplets<T>(n, cols, density, rnd));
+                const MatrixN<T> dense = a.ToDense();
+                Expect(MaxDifference(SparseMatrixN<T>(dense).ToDense(), dense) == 0.0, name + " dense round trip");
+                Expect(MaxDifference(a.Transpose().ToDense(), dense.Transpose()) == 0.0, name + " transpose");
+
+                const double tolerance = 4 * Epsilon<T>() * static_cast<double>(cols);
+                const VectorN<T> x = RandomVector<T>(cols, rnd);
+                ExpectBelow(MaxDifference(a * x, Multiply(dense, x)), tolerance, name + " SpMV");
+
+                const MatrixN<T> right = RandomMatrix<T>(cols, 6, rnd);
+                ExpectBelow(MaxDifference(a * right, Multiply(dense, right)), tolerance, name + " sparse x dense");
+
+                const MatrixN<T> left = RandomMatrix<T>(4, n, rnd);
+                ExpectBelow(MaxDifference(left * a, Multiply(left, dense)), tolerance, name + " dense x sparse");
+
+                Expect((a * VectorN<T>(n + 1)).size() == 0, name + " SpMV of a vector of the wrong length is not empty");
+                Expect((a * MatrixN<T>(n, 4, T())).Rows() == 0, name + " sparse x dense of the wrong inner size is not empty");
+                Expect((MatrixN<T>(4, cols, T()) * a).Rows() == 0, name + " dense x sparse of the wrong inner size is not empty");
+            }
+        }
+    }
+}
+}
+
+
+int main() {
+    // a low threshold splits the products over the pool as well
+    TRS::GetThreadPool().SetElementwiseThreshold(64);
+    TRS::Check::CheckSparse<float>();
+    TRS::Check::CheckSparse<double>();
+    return TRS::Check::Finish("trs_sparse_check");
+}
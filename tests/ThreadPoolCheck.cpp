@@ -0,0 +1,124 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: ThreadPoolCheck.cpp - Chunking, coverage and serial fallbacks of the shared thread pool
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <trs/ThreadPool.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// Every index of [_begin, _end) visited exactly once by chunks of at most _grain, or by one call over the whole range
+    template<typename Run>
+    void ExpectCoverage(size_t _begin, size_t _end, size_t _grain, const std::string &_what, Run &&_run) {
+        std::vector<std::atomic<int>> visits(_end);
+        std::atomic<bool> bounds(true);
+        _run([&](size_t _first, size_t _last) {
+            const bool whole = _first == _begin && _last == _end;
+            if(_first < _begin || _last > _end || _first >= _last || (_last - _first > _grain && !whole))
+                bounds = false;
+            for(size_t i = _first; i < std::min(_last, _end); i++)
+                visits[i]++;
+        });
+
+        bool once = true;
+        for(size_t i = 0; i < _end; i++)
+            once = once && visits[i] == (i >= _begin ? 1 : 0);
+        Expect(bounds, _what + " chunk outside the range or longer than the grain");
+        Expect(once, _what + " did not visit every index exactly once");
+    }
+
+
+    /// Elementwise and row results must not depend on the thread count or the threshold
+    std::vector<double> Evaluate(size_t _n) {
+        std::vector<double> out(_n);
+        ParallelElements(_n, [&](size_t _first, size_t _last) {
+            for(size_t i = _first; i < _last; i++)
+                out[i] = std::sin(static_cast<double>(i)) * 3.0;
+        });
+        ParallelRows(0, _n / 10, 10, [&](size_t _first, size_t _last) {
+            for(size_t r = _first; r < _last; r++) {
+                for(size_t j = 0; j < 10; j++)
+                    out[r * 10 + j] += static_cast<double>(r) / static_cast<double>(j + 1);
+            }
+        });
+        return out;
+    }
+
+
+    void CheckThreadPool() {
+        ThreadPool &pool = GetThreadPool();
+        const size_t n = 10007;
+        pool.SetThreadCount(1);
+        const std::vector<double> serial = Evaluate(n);
+
+        for(size_t threads : { 1, 2, 3, 4, 7 }) {
+            pool.SetThreadCount(threads);
+            Expect(pool.GetThreadCount() == threads, "ThreadPool thread count", static_cast<double>(pool.GetThreadCount()));
+            for(size_t threshold : { 1, 16, 1000, 100000 }) {
+                pool.SetElementwiseThreshold(threshold);
+                const std::string mode = std::to_string(threads) + " threads threshold " + std::to_string(threshold);
+
+                for(size_t grain : { 1, 7, 64, 20000 })
+                    ExpectCoverage(3, n, grain, "ParallelFor " + mode + " grain " + std::to_string(grain),
+                                   [&](auto _f) { pool.ParallelFor(3, n, grain, _f); });
+                ExpectCoverage(0, n, n, "ParallelElements " + mode, [&](auto _f) { ParallelElements(n, _f); });
+                ExpectCoverage(5, 900, 900, "ParallelRows " + mode, [&](auto _f) { ParallelRows(5, 900, 3, _f); });
+
+                size_t calls = 0;
+                pool.ParallelFor(9, 9, 1, [&](size_t, size_t) { calls++; });
+                ParallelRows(9, 4, 1, [&](size_t, size_t) { calls++; });
+                Expect(calls == 0, "ThreadPool " + mode + " ran an empty range", static_cast<double>(calls));
+
+                Expect(Evaluate(n) == serial, "ThreadPool " + mode + " results differ from one thread");
+
+                // nested calls from the workers and from the caller's chunks run their whole range directly
+                ExpectCoverage(0, 64, 64 * 64, "nested ParallelFor " + mode, [&](auto _f) {
+                    pool.ParallelFor(0, 8, 1, [&](size_t _first, size_t _last) {
+                        for(size_t i = _first; i < _last; i++)
+                            pool.ParallelFor(8 * i, 8 * i + 8, 1, _f);
+                    });
+                });
+            }
+        }
+
+        // while another thread owns the pool, a second caller gets its whole range in one call on its own thread
+        pool.SetThreadCount(4);
+        std::atomic<bool> started(false), done(false);
+        std::thread owner([&] {
+            pool.ParallelFor(0, 2, 1, [&](size_t, size_t) {
+                started = true;
+                while(!done)
+                    std::this_thread::yield();
+            });
+        });
+        while(!started)
+            std::this_thread::yield();
+
+        size_t calls = 0, first = 1, last = 0;
+        const std::thread::id caller = std::this_thread::get_id();
+        bool same_thread = true;
+        pool.ParallelFor(0, 1000, 10, [&](size_t _first, size_t _last) {
+            calls++;
+            first = _first;
+            last = _last;
+            same_thread = same_thread && std::this_thread::get_id() == caller;
+        });
+        const std::vector<double> busy = Evaluate(n);
+        done = true;
+        owner.join();
+        Expect(calls == 1 && first == 0 && last == 1000 && same_thread, "ParallelFor on a busy pool did not run serially", static_cast<double>(calls));
+        Expect(busy == serial, "ThreadPool results on a busy pool differ from one thread");
+    }
+}
+}
+
+
+int main() {
+    TRS::Check::CheckThreadPool();
+    return TRS::Check::Finish("trs_threadpool_check");
+}
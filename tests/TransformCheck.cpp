@@ -0,0 +1,287 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: TransformCheck.cpp - Every batch transform, matrix and quaternion kernel against the scalar formulas
+/// author: Karl-Mihkel Ott
+
+#include <vector>
+#include <trs/Vector.h>
+#include <trs/Matrix.h>
+#include <trs/Transform.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    // counts below, at and past every lane width so that each kernel hands a tail to the next narrower one
+    const size_t g_counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 37, 100 };
+
+    // written to the element past the batch, which no kernel may touch
+    const float g_guard = 1234.5f;
+
+    typedef void (*Transform3Kernel)(const Matrix4<float>&, const float*, float*, size_t, float);
+    typedef void (*Transform4Kernel)(const Matrix4<float>&, const float*, float*, size_t);
+    typedef void (*PairKernel)(const float*, const float*, float*, size_t);
+
+    template<typename K>
+    struct Variant {
+        const char *name;
+        K kernel;
+        bool supported;
+    };
+
+
+    Matrix4<float> RandomMatrix4(Random &_rnd) {
+        Matrix4<float> m;
+        for(size_t i = 0; i < 16; i++)
+            m.Data()[i] = static_cast<float>(_rnd.Next());
+        return m;
+    }
+
+
+    template<typename K>
+    std::vector<Variant<K>> Supported(const std::vector<Variant<K>> &_variants) {
+        std::vector<Variant<K>> supported;
+        for(const Variant<K> &v : _variants) {
+            if(v.supported)
+                supported.push_back(v);
+        }
+        return supported;
+    }
+
+
+    /// Largest difference of the first _n floats from the double reference, infinity when the guard after them was written
+    double BatchDifference(const float *_out, const std::vector<double> &_expected, size_t _n) {
+        if(_out[_n] != g_guard)
+            return std::numeric_limits<double>::infinity();
+
+        double diff = 0.0;
+        for(size_t i = 0; i < _n; i++)
+            diff = std::max(diff, std::abs(static_cast<double>(_out[i]) - _expected[i]));
+        return diff;
+    }
+
+
+    void CheckTransform3(const std::vector<Variant<Transform3Kernel>> &_variants) {
+        Random rnd(9);
+        const Matrix4<float> mat = RandomMatrix4(rnd);
+        const float *m = mat.Data();
+
+        for(const Variant<Transform3Kernel> &v : Supported(_variants)) {
+            for(size_t count : g_counts) {
+                for(float w : { 1.0f, 0.0f }) {
+                    const std::string name = std::string("Transform3 ") + v.name + " count " + std::to_string(count) + " w " + std::to_string(static_cast<int>(w));
+                    std::vector<float> in(3 * count + 1, g_guard), out(3 * count + 1, g_guard);
+                    std::vector<double> expected(3 * count);
+                    for(size_t i = 0; i < 3 * count; i++)
+                        in[i] = static_cast<float>(rnd.Next());
+                    for(size_t i = 0; i < count; i++) {
+                        for(size_t r = 0; r < 3; r++) {
+                            double sum = static_cast<double>(m[4 * r + 3]) * w;
+                            for(size_t c = 0; c < 3; c++)
+                                sum += static_cast<double>(m[4 * r + c]) * static_cast<double>(in[3 * i + c]);
+                            expected[3 * i + r] = sum;
+                        }
+                    }
+
+                    v.kernel(mat, in.data(), out.data(), count, w);
+                    ExpectBelow(BatchDifference(out.data(), expected, 3 * count), 16 * Epsilon<float>(), name);
+                    v.kernel(mat, in.data(), in.data(), count, w);
+                    ExpectBelow(BatchDifference(in.data(), expected, 3 * count), 16 * Epsilon<float>(), name + " in place");
+                }
+            }
+        }
+    }
+
+
+    void CheckTransform4(const std::vector<Variant<Transform4Kernel>> &_variants) {
+        Random rnd(10);
+        const Matrix4<float> mat = RandomMatrix4(rnd);
+        const float *m = mat.Data();
+
+        for(const Variant<Transform4Kernel> &v : Supported(_variants)) {
+            for(size_t count : g_counts) {
+                const std::string name = std::string("Transform4 ") + v.name + " count " + std::to_string(count);
+                // Vector4<float> keeps the 16 byte alignment the SSE kernel needs
+                std::vector<Vector4<float>> in(count + 1), out(count + 1);
+                float *pin = &in[0].first, *pout = &out[0].first;
+                std::fill(pin, pin + 4 * count + 4, g_guard);
+                std::fill(pout, pout + 4 * count + 4, g_guard);
+                std::vector<double> expected(4 * count);
+                for(size_t i = 0; i < 4 * count; i++)
+                    pin[i] = static_cast<float>(rnd.Next());
+                for(size_t i = 0; i < count; i++) {
+                    for(size_t r = 0; r < 4; r++) {
+                        double sum = 0.0;
+                        for(size_t c = 0; c < 4; c++)
+                            sum += static_cast<double>(m[4 * r + c]) * static_cast<double>(pin[4 * i + c]);
+                        expected[4 * i + r] = sum;
+                    }
+                }
+
+                v.kernel(mat, pin, pout, count);
+                ExpectBelow(BatchDifference(pout, expected, 4 * count), 16 * Epsilon<float>(), name);
+                v.kernel(mat, pin, pin, count);
+                ExpectBelow(BatchDifference(pin, expected, 4 * count), 16 * Epsilon<float>(), name + " in place");
+            }
+        }
+    }
+
+
+    /// Checks a kernel taking two arrays of _width float records against _reference, in place over either input too
+    void CheckPairs(const char *_what, size_t _width, void (*_reference)(const double*, const double*, double*),
+                    const std::vector<Variant<PairKernel>> &_variants) {
+        Random rnd(11);
+
+        for(const Variant<PairKernel> &v : Supported(_variants)) {
+            for(size_t count : g_counts) {
+                const std::string name = std::string(_what) + " " + v.name + " count " + std::to_string(count);
+                const size_t n = _width * count;
+                // whole Matrix4<float> records keep every record 16 byte aligned for the SSE kernels
+                const size_t records = (n + 4 + 15) / 16;
+                std::vector<Matrix4<float>> a(records), b(records), out(records);
+                float *pa = a[0].Data(), *pb = b[0].Data(), *pout = out[0].Data();
+                std::fill(pout, pout + 16 * records, g_guard);
+                std::vector<double> expected(n);
+                for(size_t i = 0; i < n; i++) {
+                    pa[i] = static_cast<float>(rnd.Next());
+                    pb[i] = static_cast<float>(rnd.Next());
+                }
+                pa[n] = pb[n] = g_guard;
+                for(size_t i = 0; i < count; i++) {
+                    double x[16], y[16];
+                    for(size_t j = 0; j < _width; j++) {
+                        x[j] = static_cast<double>(pa[_width * i + j]);
+                        y[j] = static_cast<double>(pb[_width * i + j]);
+                    }
+                    _reference(x, y, &expected[_width * i]);
+                }
+
+                const std::vector<Matrix4<float>> a0(a), b0(b);
+                v.kernel(pa, pb, pout, count);
+                ExpectBelow(BatchDifference(pout, expected, n), 16 * Epsilon<float>(), name);
+                v.kernel(pa, pb, pa, count);
+                ExpectBelow(BatchDifference(pa, expected, n), 16 * Epsilon<float>(), name + " in place over the first operand");
+                a = a0;
+                v.kernel(pa, pb, pb, count);
+                ExpectBelow(BatchDifference(pb, expected, n), 16 * Epsilon<float>(), name + " in place over the second operand");
+                b = b0;
+            }
+        }
+    }
+
+
+    void ReferenceMatMul4(const double *_a, const double *_b, double *_out) {
+        for(size_t i = 0; i < 4; i++) {
+            for(size_t j = 0; j < 4; j++) {
+                _out[4 * i + j] = 0.0;
+                for(size_t k = 0; k < 4; k++)
+                    _out[4 * i + j] += _a[4 * i + k] * _b[4 * k + j];
+            }
+        }
+    }
+
+
+    void ReferenceQuatMul(const double *_p, const double *_q, double *_out) {
+        _out[0] = _p[3] * _q[0] + _p[0] * _q[3] + _p[1] * _q[2] - _p[2] * _q[1];
+        _out[1] = _p[3] * _q[1] - _p[0] * _q[2] + _p[1] * _q[3] + _p[2] * _q[0];
+        _out[2] = _p[3] * _q[2] + _p[0] * _q[1] - _p[1] * _q[0] + _p[2] * _q[3];
+        _out[3] = _p[3] * _q[3] - _p[0] * _q[0] - _p[1] * _q[1] - _p[2] * _q[2];
+    }
+
+
+    template<void (*Kernel)(const float*, const float*, float*)>
+    void EachMatrix(const float *_a, const float *_b, float *_out, size_t _count) {
+        for(size_t i = 0; i < 16 * _count; i += 16)
+            Kernel(_a + i, _b + i, _out + i);
+    }
+
+
+    template<void (*Kernel)(const Matrix4<float>&, const float*, float*, size_t)>
+    void Transposed(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count) {
+        Matrix4<float> cols;
+        FastTranspose4(_mat.Data(), cols.Data());
+        Kernel(cols, _in, _out, _count);
+    }
+
+
+    void TransformPoints3(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        // the wrappers fix w, the other value is checked through the Point3D overloads
+        const Vector3<float> *in = reinterpret_cast<const Vector3<float>*>(_in);
+        Vector3<float> *out = reinterpret_cast<Vector3<float>*>(_out);
+        if(_w == 1.0f)
+            TransformPoints(_mat, in, out, _count);
+        else TransformVectors(_mat, in, out, _count);
+    }
+
+
+    void TransformPoints3D(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count, float _w) {
+        const Point3D<float> *in = reinterpret_cast<const Point3D<float>*>(_in);
+        Point3D<float> *out = reinterpret_cast<Point3D<float>*>(_out);
+        if(_w == 1.0f)
+            TransformPoints(_mat, in, out, _count);
+        else TransformVectors(_mat, in, out, _count);
+    }
+
+
+    void TransformVectors4(const Matrix4<float> &_mat, const float *_in, float *_out, size_t _count) {
+        TransformVectors(_mat, reinterpret_cast<const Vector4<float>*>(_in), reinterpret_cast<Vector4<float>*>(_out), _count);
+    }
+
+
+    void MultiplyMatrixArrays(const float *_a, const float *_b, float *_out, size_t _count) {
+        MultiplyMatrices(reinterpret_cast<const Matrix4<float>*>(_a), reinterpret_cast<const Matrix4<float>*>(_b),
+                         reinterpret_cast<Matrix4<float>*>(_out), _count);
+    }
+
+
+    void MultiplyQuaternionArrays(const float *_p, const float *_q, float *_out, size_t _count) {
+        MultiplyQuaternions(reinterpret_cast<const Quaternion*>(_p), reinterpret_cast<const Quaternion*>(_q),
+                            reinterpret_cast<Quaternion*>(_out), _count);
+    }
+}
+}
+
+
+int main() {
+    using namespace TRS::Check;
+    const TRS::CpuFeatures &cpu = TRS::GetCpuFeatures();
+    const bool avx2 = cpu.avx2 && cpu.fma, avx512 = cpu.avx512f && avx2;
+    std::printf("sse2 %d avx2+fma %d avx512f %d\n", cpu.sse2, avx2, avx512);
+
+    CheckTransform3({
+        { "scalar", TRS::ScalarTransform3, true },
+        { "SSE", TRS::FastTransform3Sse, cpu.sse2 },
+        { "AVX2", TRS::FastTransform3Avx2, avx2 },
+        { "AVX-512", TRS::FastTransform3Avx512, avx512 },
+        { "dispatch", TRS::FastTransform3, true },
+        { "Vector3", TransformPoints3, true },
+        { "Point3D", TransformPoints3D, true }
+    });
+
+    CheckTransform4({
+        { "scalar", TRS::ScalarTransform4, true },
+        { "SSE", Transposed<TRS::FastTransform4Sse>, cpu.sse2 },
+        { "AVX2", Transposed<TRS::FastTransform4Avx2>, avx2 },
+        { "AVX-512", Transposed<TRS::FastTransform4Avx512>, avx512 },
+        { "dispatch", TRS::FastTransform4, true },
+        { "Vector4", TransformVectors4, true }
+    });
+
+    CheckPairs("MatMul4", 16, ReferenceMatMul4, {
+        { "scalar", TRS::ScalarMatMul4, true },
+        { "SSE", EachMatrix<TRS::FastMatMul4Sse<4>>, cpu.sse2 },
+        { "AVX2", EachMatrix<TRS::FastMatMul4Avx2<4>>, avx2 },
+        { "AVX-512", EachMatrix<TRS::FastMatMul4Avx512>, avx512 },
+        { "dispatch", MultiplyMatrixArrays, true }
+    });
+
+    CheckPairs("QuatMul", 4, ReferenceQuatMul, {
+        { "scalar", TRS::ScalarQuatMul, true },
+        { "SSE", TRS::FastQuatMulSse, cpu.sse2 },
+        { "AVX2", TRS::FastQuatMulAvx2, avx2 },
+        { "AVX-512", TRS::FastQuatMulAvx512, avx512 },
+        { "dispatch", MultiplyQuaternionArrays, true }
+    });
+
+    return Finish("trs_transform_check");
+}
@@ -0,0 +1,250 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: UpdateCheck.cpp - Low rank updates of LU, Cholesky, LDLT and IncrementalInverse against full refactorizations
+/// author: Karl-Mihkel Ott
+
+#include <trs/MatrixN.h>
+#include <trs/LU.h>
+#include <trs/Cholesky.h>
+#include <trs/IncrementalInverse.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// _a + _sigma * _x * _y^T in double precision, rounded back to T
+    template<typename T>
+    MatrixN<T> AddOuter(const MatrixN<T> &_a, T _sigma, const MatrixN<T> &_x, const MatrixN<T> &_y) {
+        const MatrixN<double> xy = Multiply(_x, _y.Transpose());
+        MatrixN<T> m(_a);
+        for(size_t i = 0; i < _a.Rows() * _a.Columns(); i++)
+            m.Data()[i] = static_cast<T>(static_cast<double>(m.Data()[i]) + static_cast<double>(_sigma) * xy.Data()[i]);
+        return m;
+    }
+
+
+    template<typename T>
+    MatrixN<T> Column(const VectorN<T> &_x) {
+        MatrixN<T> m(_x.size(), 1, T());
+        std::copy(_x.begin(), _x.end(), m.Data());
+        return m;
+    }
+
+
+    /// Largest difference between the factors of an updated and a refactored matrix
+    template<typename T>
+    double FactorDifference(const MatrixN<T> &_updated, const MatrixN<T> &_refactored) {
+        double max = 0.0;
+        for(size_t i = 0; i < _refactored.Rows() * _refactored.Columns(); i++)
+            max = std::max(max, std::abs(static_cast<double>(_refactored.Data()[i])));
+        return MaxDifference(_updated, _refactored) / max;
+    }
+
+
+    /// log(|det(A)|) from the diagonal of U, the determinant itself overflows float for the larger sizes
+    template<typename T>
+    double LogAbsDeterminant(const LU<T> &_lu) {
+        double sum = 0.0;
+        for(size_t i = 0; i < _lu.Size(); i++)
+            sum += std::log(std::abs(static_cast<double>(_lu.Factors()[i][i])));
+        return sum;
+    }
+
+
+    template<typename T>
+    void CheckLUUpdate() {
+        const std::string type = TypeName<T>();
+        Random rnd(24);
+
+        for(size_t n : { 5, 64, 150 }) {
+            const std::string name = "LU<" + type + "> n" + std::to_string(n);
+            const double tolerance = 16 * Epsilon<T>() * n;
+            const MatrixN<T> a = RandomMatrix<T>(n, n, rnd);
+            const VectorN<T> u = RandomVector<T>(n, rnd), v = RandomVector<T>(n, rnd), b = RandomVector<T>(n, rnd);
+            const MatrixN<T> updated = AddOuter(a, static_cast<T>(1), Column(u), Column(v));
+
+            LU<T> lu(a);
+            Expect(lu.Update(u, v), name + " update failed");
+            ExpectBelow(RelativeResidual(updated, lu.Solve(b), b), tolerance, name + " updated residual");
+            ExpectBelow(RelativeResidual(updated, lu.Inverse(), MatrixN<T>::MakeIdentity(n)), tolerance, name + " updated inverse");
+            ExpectBelow(std::abs(LogAbsDeterminant(lu) - LogAbsDeterminant(LU<T>(updated))), tolerance, name + " updated log determinant");
+
+            // u = -A * e_0 and v = e_0 clear the first column, the factors must stay those of A
+            LU<T> singular(a);
+            VectorN<T> first(n), e0(n);
+            for(size_t i = 0; i < n; i++)
+                first[i] = -a[i][0];
+            e0[0] = static_cast<T>(1);
+            Expect(!singular.Update(first, e0), name + " update to a singular matrix succeeded");
+            ExpectBelow(RelativeResidual(a, singular.Solve(b), b), tolerance, name + " factors changed by a failed update");
+        }
+    }
+
+
+    template<typename T>
+    void CheckCholeskyUpdate() {
+        const std::string type = TypeName<T>();
+        Random rnd(124);
+
+        for(size_t n : { 5, 64, 150 }) {
+            const std::string name = "<" + type + "> n" + std::to_string(n);
+            const double tolerance = 16 * Epsilon<T>() * n;
+            const MatrixN<T> a = RandomSpd<T>(n, rnd);
+            const VectorN<T> x = RandomVector<T>(n, rnd), b = RandomVector<T>(n, rnd);
+            // rank 6 spans more than one column block of the factor update
+            const MatrixN<T> xs = RandomMatrix<T>(n, 6, rnd);
+            const MatrixN<T> plus_x = AddOuter(a, static_cast<T>(1), Column(x), Column(x));
+            const MatrixN<T> plus_xs = AddOuter(a, static_cast<T>(1), xs, xs);
+
+            Cholesky<T> cholesky(a);
+            Expect(cholesky.Update(x), "Cholesky" + name + " update failed");
+            ExpectBelow(FactorDifference(cholesky.Factor(), Cholesky<T>(plus_x).Factor()), tolerance, "Cholesky" + name + " updated factor");
+            ExpectBelow(RelativeResidual(plus_x, cholesky.Solve(b), b), tolerance, "Cholesky" + name + " updated residual");
+            Expect(cholesky.Downdate(x), "Cholesky" + name + " downdate failed");
+            ExpectBelow(FactorDifference(cholesky.Factor(), Cholesky<T>(a).Factor()), tolerance, "Cholesky" + name + " downdated factor");
+            Expect(cholesky.Update(xs), "Cholesky" + name + " rank 6 update failed");
+            ExpectBelow(FactorDifference(cholesky.Factor(), Cholesky<T>(plus_xs).Factor()), tolerance, "Cholesky" + name + " rank 6 updated factor");
+            Expect(cholesky.Downdate(xs), "Cholesky" + name + " rank 6 downdate failed");
+            ExpectBelow(RelativeResidual(a, cholesky.Solve(b), b), tolerance, "Cholesky" + name + " rank 6 downdated residual");
+
+            LDLT<T> ldlt(a);
+            Expect(ldlt.Update(x), "LDLT" + name + " update failed");
+            ExpectBelow(FactorDifference(ldlt.Factor(), LDLT<T>(plus_x).Factor()), tolerance, "LDLT" + name + " updated factor");
+            ExpectBelow(RelativeResidual(plus_x, ldlt.Solve(b), b), tolerance, "LDLT" + name + " updated residual");
+            Expect(ldlt.Downdate(x), "LDLT" + name + " downdate failed");
+            ExpectBelow(FactorDifference(ldlt.Factor(), LDLT<T>(a).Factor()), tolerance, "LDLT" + name + " downdated factor");
+            Expect(ldlt.Update(xs), "LDLT" + name + " rank 6 update failed");
+            ExpectBelow(FactorDifference(ldlt.Factor(), LDLT<T>(plus_xs).Factor()), tolerance, "LDLT" + name + " rank 6 updated factor");
+            Expect(ldlt.Downdate(xs), "LDLT" + name + " rank 6 downdate failed");
+            ExpectBelow(RelativeResidual(a, ldlt.Solve(b), b), tolerance, "LDLT" + name + " rank 6 downdated residual");
+
+            // I - e_0 * e_0^T has a zero pivot, the factors of I must survive the failed downdate
+            const MatrixN<T> identity = MatrixN<T>::MakeIdentity(n);
+            VectorN<T> e0(n);
+            e0[0] = static_cast<T>(1);
+            Cholesky<T> identity_cholesky(identity);
+            LDLT<T> identity_ldlt(identity);
+            Expect(!identity_cholesky.Downdate(e0) && MaxDifference(identity_cholesky.Factor(), identity) == 0.0,
+                   "Cholesky" + name + " downdate to a singular matrix");
+            Expect(!identity_ldlt.Downdate(e0) && MaxDifference(identity_ldlt.Factor(), identity) == 0.0,
+                   "LDLT" + name + " downdate to a singular matrix");
+        }
+    }
+
+
+    template<typename T>
+    void CheckIncrementalInverse() {
+        const std::string type = TypeName<T>();
+        Random rnd(224);
+
+        for(size_t n : { 5, 64, 150 }) {
+            const std::string name = "IncrementalInverse<" + type + "> n" + std::to_string(n);
+            // a dominant diagonal of 1.5 keeps the matrix well conditioned and the determinant in range
+            MatrixN<T> a = RandomMatrix<T>(n, n, rnd);
+            for(size_t i = 0; i < n * n; i++)
+                a.Data()[i] /= static_cast<T>(n);
+            for(size_t i = 0; i < n; i++)
+                a[i][i] += static_cast<T>(1.5);
+
+            // without the drift check every inverse below comes from the updates alone
+            IncrementalInverse<T> inverse(a);
+            inverse.SetDriftCheck(0, std::sqrt(std::numeric_limits<T>::epsilon()));
+            const T scale = static_cast<T>(1 / std::sqrt(static_cast<double>(n)));
+            for(size_t step = 0; step < 12; step++) {
+                const std::string update = name + " update " + std::to_string(step);
+                bool ok = true;
+                if(step % 4 == 0) {
+                    VectorN<T> u = RandomVector<T>(n, rnd), v = RandomVector<T>(n, rnd);
+                    for(size_t i = 0; i < n; i++) {
+                        u[i] *= scale;
+                        v[i] *= scale;
+                    }
+                    ok = inverse.Update(u, v);
+                    a = AddOuter(a, static_cast<T>(1), Column(u), Column(v));
+                } else if(step % 4 == 1) {
+                    MatrixN<T> u = RandomMatrix<T>(n, 3, rnd), v = RandomMatrix<T>(n, 3, rnd);
+                    for(size_t i = 0; i < n * 3; i++) {
+                        u.Data()[i] *= scale;
+                        v.Data()[i] *= scale;
+                    }
+                    ok = inverse.Update(u, v);
+                    a = AddOuter(a, static_cast<T>(1), u, v);
+                } else {
+                    const size_t index = (step * 7) % n;
+                    VectorN<T> values = RandomVector<T>(n, rnd);
+                    for(size_t i = 0; i < n; i++)
+                        values[i] /= static_cast<T>(n);
+                    values[index] += static_cast<T>(1.5);
+                    if(step % 4 == 2) {
+                        ok = inverse.ReplaceRow(index, values);
+                        std::copy(values.begin(), values.end(), a[index]);
+                    } else {
+                        ok = inverse.ReplaceColumn(index, values);
+                        for(size_t i = 0; i < n; i++)
+                            a[i][index] = values[i];
+                    }
+                }
+
+                const double tolerance = 16 * Epsilon<T>() * n * (step + 1);
+                Expect(ok, update + " failed");
+                ExpectBelow(MaxDifference(inverse.Matrix(), a), tolerance, update + " tracked matrix");
+                ExpectBelow(RelativeResidual(a, inverse.Inverse(), MatrixN<T>::MakeIdentity(n)), tolerance, update + " inverse residual");
+                const double det = static_cast<double>(LU<T>(a).Determinant());
+                ExpectBelow(std::abs(static_cast<double>(inverse.Determinant()) - det) / std::abs(det), tolerance, update + " determinant");
+            }
+            Expect(inverse.RefactorizationCount() == 1, name + " refactored without a drift check", static_cast<double>(inverse.RefactorizationCount()));
+        }
+
+        // small integers keep every update exact, so the matrix becomes exactly singular
+        const size_t n = 6;
+        const std::string name = "IncrementalInverse<" + type + "> exact";
+        MatrixN<T> a(n, n, static_cast<T>(1));
+        for(size_t i = 0; i < n; i++)
+            a[i][i] = static_cast<T>(3);
+        IncrementalInverse<T> inverse(a);
+        VectorN<T> row0(n), row1(n);
+        std::copy(a[0], a[0] + n, row0.begin());
+        std::copy(a[1], a[1] + n, row1.begin());
+        Expect(!inverse.ReplaceRow(1, row0) && inverse.IsSingular(), name + " repeated row is not singular");
+        Expect(inverse.Solve(row0).size() == 0 && inverse.Determinant() == T(), name + " singular results are not empty");
+        Expect(inverse.ReplaceRow(1, row1) && !inverse.IsSingular(), name + " restored row is singular");
+        ExpectBelow(RelativeResidual(a, inverse.Inverse(), MatrixN<T>::MakeIdentity(n)), 16 * Epsilon<T>() * n, name + " restored inverse residual");
+
+        // the Woodbury path sees the singular capacitance matrix of a rank 2 update that clears two columns
+        MatrixN<T> u(n, 2, T()), v(n, 2, T());
+        for(size_t i = 0; i < n; i++) {
+            u[i][0] = -a[i][0];
+            u[i][1] = -a[i][1];
+        }
+        v[0][0] = v[1][1] = static_cast<T>(1);
+        Expect(!inverse.Update(u, v) && inverse.IsSingular(), name + " rank 2 update to a singular matrix");
+        for(size_t i = 0; i < n; i++) {
+            u[i][0] = a[i][0];
+            u[i][1] = a[i][1];
+        }
+        Expect(inverse.Update(u, v) && MaxDifference(inverse.Matrix(), a) == 0.0, name + " rank 2 update back to A");
+        ExpectBelow(RelativeResidual(a, inverse.Inverse(), MatrixN<T>::MakeIdentity(n)), 16 * Epsilon<T>() * n, name + " rank 2 restored inverse residual");
+
+        // a 3 x 2 matrix is not kept, so updates sized for its rows must fail instead of writing past its columns
+        IncrementalInverse<T> rectangular;
+        const std::string rect = "IncrementalInverse<" + type + "> 3x2";
+        Expect(!rectangular.Compute(MatrixN<T>(3, 2, static_cast<T>(1))) && rectangular.Size() == 0 && rectangular.IsSingular(),
+               rect + " was accepted");
+        const VectorN<T> ones(3, static_cast<T>(1));
+        Expect(!rectangular.Update(ones, ones) && !rectangular.ReplaceRow(0, ones) && !rectangular.ReplaceColumn(0, ones),
+               rect + " rank 1 update succeeded");
+        Expect(!rectangular.Update(MatrixN<T>(3, 2, static_cast<T>(1)), MatrixN<T>(3, 2, static_cast<T>(1))), rect + " rank 2 update succeeded");
+    }
+}
+}
+
+
+int main() {
+    TRS::Check::CheckLUUpdate<float>();
+    TRS::Check::CheckLUUpdate<double>();
+    TRS::Check::CheckCholeskyUpdate<float>();
+    TRS::Check::CheckCholeskyUpdate<double>();
+    TRS::Check::CheckIncrementalInverse<float>();
+    TRS::Check::CheckIncrementalInverse<double>();
+    return TRS::Check::Finish("trs_update_check");
+}
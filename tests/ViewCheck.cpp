@@ -0,0 +1,154 @@
+/// trs-headers: Linear algebra structurs for DENG project
+/// licence: Apache, see LICENCE file
+/// file: ViewCheck.cpp - Strided block, row and column views, their assignment rules, Gemm and factorizations on blocks
+/// author: Karl-Mihkel Ott
+
+#include <trs/MatrixN.h>
+#include <trs/MatrixView.h>
+#include <trs/LU.h>
+#include <trs/Cholesky.h>
+#include "Check.h"
+
+namespace TRS {
+namespace Check {
+
+    /// Largest difference between the elements of a view and those of _m starting at _row, _col
+    template<typename T>
+    double BlockDifference(const MatrixView<const T> &_v, const MatrixN<T> &_m, size_t _row, size_t _col) {
+        double diff = 0.0;
+        for(size_t i = 0; i < _v.Rows(); i++) {
+            for(size_t j = 0; j < _v.Columns(); j++) {
+                diff = std::max(diff, std::abs(static_cast<double>(_v[i][j]) - static_cast<double>(_m[_row + i][_col + j])));
+                diff = std::max(diff, std::abs(static_cast<double>(_v.Element(i * _v.Columns() + j)) - static_cast<double>(_m[_row + i][_col + j])));
+            }
+        }
+        return diff;
+    }
+
+
+    /// Elements of _after outside the _rows x _cols block at _row, _col must equal those of _before
+    template<typename T>
+    bool OutsideUntouched(const MatrixN<T> &_before, const MatrixN<T> &_after, size_t _row, size_t _col, size_t _rows, size_t _cols) {
+        for(size_t i = 0; i < _before.Rows(); i++) {
+            for(size_t j = 0; j < _before.Columns(); j++) {
+                const bool inside = i >= _row && i < _row + _rows && j >= _col && j < _col + _cols;
+                if(!inside && _before[i][j] != _after[i][j])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+
+    template<typename T>
+    void CheckViews() {
+        const std::string name = std::string("MatrixView<") + TypeName<T>() + ">";
+        Random rnd(20);
+        const MatrixN<T> original = RandomMatrix<T>(12, 15, rnd);
+        MatrixN<T> m(original);
+
+        // element access through a block, a row and a column, all with row stride 15
+        MatrixView<T> block = m.Block(2, 3, 5, 7);
+        Expect(block.Stride() == 15 && block.Rows() == 5 && block.Columns() == 7, name + " block shape");
+        Expect(BlockDifference<T>(block, m, 2, 3) == 0.0, name + " block elements");
+        Expect(BlockDifference<T>(block.Block(1, 2, 3, 4), m, 3, 5) == 0.0, name + " block of a block elements");
+        VectorView<T> row = block.Row(3), column = block.Column(4);
+        Expect(column.Stride() == 15 && column.size() == 5 && row.size() == 7, name + " row and column shape");
+        bool elements = true;
+        for(size_t i = 0; i < 7; i++)
+            elements = elements && row[i] == m[5][3 + i];
+        for(size_t i = 0; i < 5; i++)
+            elements = elements && column[i] == m[2 + i][7] && column.Element(i) == m[2 + i][7];
+        elements = elements && column.Segment(1, 3)[2] == m[5][7];
+        Expect(elements, name + " row and column elements");
+
+        // expressions written through the views change the viewed elements only
+        const MatrixN<T> other = RandomMatrix<T>(5, 7, rnd);
+        MatrixN<double> expected(5, 7, 0.0);
+        for(size_t i = 0; i < 5; i++) {
+            for(size_t j = 0; j < 7; j++)
+                expected[i][j] = static_cast<double>(m[2 + i][3 + j]) + 2.0 * static_cast<double>(other[i][j]);
+        }
+        block += other * static_cast<T>(2);
+        ExpectBelow(MaxDifference(MatrixN<T>(block), expected), 4 * Epsilon<T>(), name + " block +=");
+        Expect(OutsideUntouched(original, m, 2, 3, 5, 7), name + " block += wrote outside the block");
+
+        MatrixN<T> before(m);
+        const VectorN<T> v = RandomVector<T>(5, rnd);
+        column = v;
+        Expect(MaxDifference(VectorN<T>(column), v) == 0.0 && OutsideUntouched(before, m, 2, 7, 5, 1), name + " column assignment");
+        before = m;
+        row -= row;
+        Expect(MaxDifference(VectorN<T>(row), VectorN<T>(7)) == 0.0 && OutsideUntouched(before, m, 5, 3, 1, 7), name + " row -=");
+        before = m;
+        m.Block(0, 10, 4, 3).Fill(static_cast<T>(7));
+        Expect(MaxDifference(MatrixN<T>(m.Block(0, 10, 4, 3)), MatrixN<T>(4, 3, static_cast<T>(7))) == 0.0 && OutsideUntouched(before, m, 0, 10, 4, 3),
+               name + " block fill");
+
+        // views of another shape are left untouched, even when they hold as many elements
+        before = m;
+        MatrixView<T> wide = m.Block(0, 0, 3, 4);
+        wide = m.Block(6, 0, 4, 3);
+        wide = other;
+        wide += m.Block(6, 0, 4, 3);
+        VectorView<T> segment = m.Column(1).Segment(0, 5);
+        segment = m.Row(8);
+        segment = VectorN<T>(6);
+        segment -= VectorN<T>(4);
+        Expect(MaxDifference(m, before) == 0.0, name + " assignment of another shape changed the matrix");
+    }
+
+
+    template<typename T>
+    void CheckBlockAlgorithms() {
+        const std::string name = std::string("MatrixView<") + TypeName<T>() + ">";
+        Random rnd(120);
+
+        // Gemm on blocks of larger matrices, with a transposed operand and the result written into a block
+        const MatrixN<T> a = RandomMatrix<T>(30, 40, rnd), b = RandomMatrix<T>(35, 25, rnd);
+        MatrixN<T> c = RandomMatrix<T>(20, 30, rnd);
+        const MatrixN<T> c_before(c);
+        const MatrixN<T> ab = a.Block(3, 5, 13, 17), bb = b.Block(4, 2, 11, 17);
+        const MatrixN<double> product = Multiply(ab, MatrixN<T>(bb.Transpose()));
+        MatrixN<double> expected(13, 11, 0.0);
+        for(size_t i = 0; i < 13; i++) {
+            for(size_t j = 0; j < 11; j++)
+                expected[i][j] = 1.5 * product[i][j] - 0.5 * static_cast<double>(c[6 + i][9 + j]);
+        }
+        Expect(Gemm<T>(static_cast<T>(1.5), a.Block(3, 5, 13, 17), false, b.Block(4, 2, 11, 17), true, static_cast<T>(-0.5), c.Block(6, 9, 13, 11)),
+               name + " Gemm refused conforming blocks");
+        ExpectBelow(MaxDifference(MatrixN<T>(c.Block(6, 9, 13, 11)), expected), 4 * Epsilon<T>() * 20, name + " Gemm on blocks");
+        Expect(OutsideUntouched(c_before, c, 6, 9, 13, 11), name + " Gemm wrote outside the block");
+        const MatrixN<T> kept(c);
+        Expect(!Gemm<T>(static_cast<T>(1), a.Block(3, 5, 13, 17), false, b.Block(4, 2, 11, 17), false, T(), c.Block(6, 9, 13, 11)) && MaxDifference(c, kept) == 0.0,
+               name + " Gemm accepted blocks that do not conform");
+
+        // factorizations of a block, right hand sides in a strided column of another matrix
+        const size_t n = 24;
+        MatrixN<T> big = RandomMatrix<T>(40, 50, rnd);
+        big.Block(7, 11, n, n) = RandomSpd<T>(n, rnd);
+        const MatrixN<T> spd = big.Block(7, 11, n, n);
+        MatrixN<T> rhs = RandomMatrix<T>(n, 6, rnd);
+        const VectorN<T> b_column = rhs.Column(2);
+
+        const Cholesky<T> llt(big.Block(7, 11, n, n));
+        Expect(llt.IsPositiveDefinite(), name + " Cholesky of a block is not positive definite");
+        Expect(llt.SolveInPlace(rhs.Column(2)), name + " Cholesky refused a strided column");
+        ExpectBelow(RelativeResidual(spd, VectorN<T>(rhs.Column(2)), b_column), 8 * Epsilon<T>(), name + " Cholesky solve in a strided column");
+
+        const LU<T> lu(big.Block(7, 11, n, n));
+        ExpectBelow(RelativeResidual(spd, lu.Solve(b_column), b_column), 8 * Epsilon<T>(), name + " LU of a block");
+    }
+}
+}
+
+
+int main() {
+    // a low threshold runs the view assignments on the pool as well
+    TRS::GetThreadPool().SetElementwiseThreshold(16);
+    TRS::Check::CheckViews<float>();
+    TRS::Check::CheckViews<double>();
+    TRS::Check::CheckBlockAlgorithms<float>();
+    TRS::Check::CheckBlockAlgorithms<double>();
+    return TRS::Check::Finish("trs_view_check");
+}